@@ -0,0 +1,373 @@
+/******************************************************************************
+    Test and benchmark of access levels
+
+    Builds a tree of groups of values of a single access level and of mixed
+    access levels, and a list of elements of mixed access levels. Every value
+    is read and written with every access level by arguments and by handle,
+    requests of lower access levels must be rejected. Handles visible to every
+    access level are compared with a walk over all terminating nodes. Reports
+    cost of a request and cost of enumeration of visible handles
+
+    Built twice: with ENABLE_ACCESS_CHECK set to 1 (bench-access) and to 0
+    (bench-access-nocheck), so that cost of the check may be compared
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "settings.h"
+#include "settings_private.h"
+
+#if (ENABLE_SLOT_TABLE != 1) || (ENABLE_NODE_CONSTRUCTORS != 1)
+#error "Test requires ENABLE_SLOT_TABLE and ENABLE_NODE_CONSTRUCTORS set to 1"
+#endif
+
+
+// Tree: GROUP_COUNT groups of PARAM_COUNT 32-bit values
+// Access level of a group is selected by group index: All, Service, Dev or mixed
+#define GROUP_COUNT         16
+#define PARAM_COUNT         64
+#define MIXED_GROUP         3
+
+// List of LIST_SIZE elements of ELEMENT_SIZE values of mixed access levels follows the groups
+#define LIST_GROUP          GROUP_COUNT
+#define LIST_SIZE           64
+#define ELEMENT_SIZE        4
+
+#define VALUE_COUNT         (GROUP_COUNT * PARAM_COUNT + LIST_SIZE * ELEMENT_SIZE)
+#define LEVEL_COUNT         (AccessByDev + 1)
+#define VALUE_MAX           1000000
+
+// Count of measured requests and enumerations
+#define BENCH_REQUESTS      2000000
+#define BENCH_ENUMERATIONS  20000
+
+
+// Terminating node reached by request arguments
+typedef struct {
+    uint32_t arg[3];
+    uint8_t accessLevel;
+    settingsHandle_t handle;
+} value_t;
+
+extern hNode_t *hRoot;
+
+static value_t values[VALUE_COUNT];
+static settingsHandle_t handles[VALUE_COUNT];
+static uint8_t visible[SETTINGS_SLOT_TABLE_SIZE];
+static volatile uint32_t sink;
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static uint8_t getGroupLevel(uint32_t group, uint32_t param)
+{
+    if (group % 4 == MIXED_GROUP)
+        return (uint8_t)(param % LEVEL_COUNT);
+    return (uint8_t)(group % 4);
+}
+
+
+static uint8_t getElementLevel(uint32_t param)
+{
+    static const uint8_t levels[ELEMENT_SIZE] = {AccessByAll, AccessByService, AccessByAll, AccessByDev};
+    return levels[param];
+}
+
+
+static void createTree(void)
+{
+    hNode_t *group;
+    uint32_t i, j, n = 0;
+    hRoot = createHNode(GROUP_COUNT + 1);
+    for (i=0; i<GROUP_COUNT; i++)
+    {
+        group = createHNode(PARAM_COUNT);
+        for (j=0; j<PARAM_COUNT; j++, n++)
+        {
+            addToHList(group, j, u32Node(getGroupLevel(i, j), RomStored, 0, VALUE_MAX, j, 0));
+            values[n].arg[0] = i;
+            values[n].arg[1] = j;
+            values[n].accessLevel = getGroupLevel(i, j);
+        }
+        addToHList(hRoot, i, group);
+    }
+    group = createHNode(ELEMENT_SIZE);
+    for (j=0; j<ELEMENT_SIZE; j++)
+        addToHList(group, j, u32Node(getElementLevel(j), RomStored, 0, VALUE_MAX, j, 0));
+    addToHList(hRoot, LIST_GROUP, createLNode(LIST_SIZE, group));
+    for (i=0; i<LIST_SIZE; i++)
+    {
+        for (j=0; j<ELEMENT_SIZE; j++, n++)
+        {
+            values[n].arg[0] = LIST_GROUP;
+            values[n].arg[1] = i;
+            values[n].arg[2] = j;
+            values[n].accessLevel = getElementLevel(j);
+        }
+    }
+}
+
+
+static void resolveValues(void)
+{
+    request_t rq;
+    uint32_t i;
+    memset(&rq, 0, sizeof(rq));
+    for (i=0; i<VALUE_COUNT; i++)
+    {
+        memcpy(rq.arg, values[i].arg, sizeof(values[i].arg));
+        values[i].handle = settingsResolve(&rq);
+    }
+}
+
+
+static void prepareRequest(request_t *rq, rqType type, uint8_t accLevel, const value_t *value, int32_t *data)
+{
+    memset(rq, 0, sizeof(request_t));
+    rq->rq = type;
+    rq->accLevel = accLevel;
+    memcpy(rq->arg, value->arg, sizeof(value->arg));
+    rq->val.i32 = data;
+    rq->raw = 0;
+}
+
+
+// Every value is read and written with every access level, by arguments and by handle
+static uint8_t testRequests(void)
+{
+    request_t rq;
+    resultType expected, result, byHandle;
+    int32_t data, stored;
+    uint32_t i;
+    uint8_t level;
+    uint8_t failed = 0;
+
+    for (i=0; i<VALUE_COUNT; i++)
+    {
+        if (values[i].handle == SETTINGS_INVALID_HANDLE)
+        {
+            printf("Value %u is not resolved\n", i);
+            failed = 1;
+            continue;
+        }
+        for (level=0; level<LEVEL_COUNT; level++)
+        {
+#if ENABLE_ACCESS_CHECK == 1
+            expected = (level >= values[i].accessLevel) ? Result_OK : Result_AccessDenied;
+#else
+            expected = Result_OK;
+#endif
+            prepareRequest(&rq, rqRead, level, &values[i], &data);
+            result = settingsRequest(&rq);
+            byHandle = settingsRequestByHandle(values[i].handle, &rq);
+            if ((result != expected) || (byHandle != expected) || (rq.result != expected))
+            {
+                printf("Read of value %u with access level %u: %d and %d by handle, expected %d\n", i, level, result, byHandle, expected);
+                failed = 1;
+            }
+
+            // Rejected write must leave the value unchanged
+            prepareRequest(&rq, rqRead, AccessByDev, &values[i], &stored);
+            settingsRequest(&rq);
+            data = (int32_t)(i * LEVEL_COUNT + level);
+            prepareRequest(&rq, rqWriteNoCb, level, &values[i], &data);
+            result = settingsRequest(&rq);
+            prepareRequest(&rq, rqRead, AccessByDev, &values[i], &data);
+            settingsRequest(&rq);
+            if ((result != expected) || (data != ((expected == Result_OK) ? (int32_t)(i * LEVEL_COUNT + level) : stored)))
+            {
+                printf("Write of value %u with access level %u: %d, value %d\n", i, level, result, data);
+                failed = 1;
+            }
+        }
+    }
+    return failed;
+}
+
+
+// Walk over all terminating nodes of a subtree, as made without access masks
+static uint32_t walkVisible(node_t *node, settingsHandle_t first, uint8_t accLevel, settingsHandle_t *out, uint32_t count)
+{
+    hNode_t *hnode;
+    lNode_t *lnode;
+    uint32_t i;
+    if (node->type == sNode)
+    {
+        if (((sNode_t *)node)->accessLevel <= accLevel)
+            out[count++] = first;
+    }
+    else if (node->type == hNode)
+    {
+        hnode = (hNode_t *)node;
+        for (i=0; i<hnode->hListSize; i++)
+            count = walkVisible(hnode->hList[i], first + hnode->hList[i]->slotOffset, accLevel, out, count);
+    }
+    else
+    {
+        lnode = (lNode_t *)node;
+        for (i=0; i<lnode->hListSize; i++)
+            count = walkVisible(lnode->element, first + lnode->element->slotOffset + lnode->elementSlotCount * i, accLevel, out, count);
+    }
+    return count;
+}
+
+
+// Compare visible handles of a subtree with values of the subtree
+static uint8_t checkVisible(uint32_t depth, const uint32_t *arg, uint8_t accLevel)
+{
+    request_t rq;
+    uint32_t i, count, expected = 0;
+
+    memset(&rq, 0, sizeof(rq));
+    memcpy(rq.arg, arg, depth * sizeof(uint32_t));
+    rq.accLevel = accLevel;
+    count = settingsGetVisibleHandles(&rq, depth, handles, VALUE_COUNT);
+    memset(visible, 0, sizeof(visible));
+    for (i=0; i<count; i++)
+    {
+        if ((handles[i] >= SETTINGS_SLOT_TABLE_SIZE) || visible[handles[i]])
+            return 1;
+        visible[handles[i]] = 1;
+    }
+    for (i=0; i<VALUE_COUNT; i++)
+    {
+        if ((memcmp(values[i].arg, arg, depth * sizeof(uint32_t)) == 0) && (values[i].accessLevel <= accLevel))
+        {
+            if (!visible[values[i].handle])
+                return 1;
+            expected++;
+        }
+    }
+    return (count != expected) ? 1 : 0;
+}
+
+
+static uint8_t testVisible(void)
+{
+    request_t rq;
+    uint32_t arg[2] = {0, 0};
+    uint8_t level;
+    uint8_t failed = 0;
+
+    for (level=0; level<LEVEL_COUNT; level++)
+    {
+        if (checkVisible(0, arg, level))
+        {
+            printf("Visible handles of tree with access level %u do not match\n", level);
+            failed = 1;
+        }
+        for (arg[0]=0; arg[0]<=LIST_GROUP; arg[0]++)
+        {
+            if (checkVisible(1, arg, level))
+            {
+                printf("Visible handles of group %u with access level %u do not match\n", arg[0], level);
+                failed = 1;
+            }
+        }
+        arg[0] = LIST_GROUP;
+        for (arg[1]=0; arg[1]<LIST_SIZE; arg[1]++)
+        {
+            if (checkVisible(2, arg, level))
+            {
+                printf("Visible handles of element %u with access level %u do not match\n", arg[1], level);
+                failed = 1;
+            }
+        }
+    }
+
+    // Output is limited by maxCount, wrong path gives no handles
+    memset(&rq, 0, sizeof(rq));
+    rq.accLevel = AccessByDev;
+    if (settingsGetVisibleHandles(&rq, 0, handles, 10) != 10)
+        failed = 1;
+    rq.arg[0] = LIST_GROUP + 1;
+    if (settingsGetVisibleHandles(&rq, 1, handles, VALUE_COUNT) != 0)
+        failed = 1;
+    rq.arg[0] = LIST_GROUP;
+    rq.arg[1] = LIST_SIZE;
+    if (settingsGetVisibleHandles(&rq, 2, handles, VALUE_COUNT) != 0)
+        failed = 1;
+    return failed;
+}
+
+
+static void benchmark(void)
+{
+    request_t rq;
+    uint64_t start;
+    int32_t data;
+    uint32_t i, sum = 0;
+    uint8_t level;
+
+    start = getTimeNs();
+    for (i=0; i<BENCH_REQUESTS; i++)
+    {
+        prepareRequest(&rq, rqRead, AccessByDev, &values[i % VALUE_COUNT], &data);
+        settingsRequest(&rq);
+        sum += data;
+    }
+    printf("Read by arguments:      %8.1f ns/request\n", (double)(getTimeNs() - start) / BENCH_REQUESTS);
+
+    prepareRequest(&rq, rqRead, AccessByDev, &values[0], &data);
+    start = getTimeNs();
+    for (i=0; i<BENCH_REQUESTS; i++)
+    {
+        settingsRequestByHandle(values[i % VALUE_COUNT].handle, &rq);
+        sum += data;
+    }
+    printf("Read by handle:         %8.1f ns/request\n", (double)(getTimeNs() - start) / BENCH_REQUESTS);
+
+    memset(&rq, 0, sizeof(rq));
+    for (level=0; level<LEVEL_COUNT; level++)
+    {
+        rq.accLevel = level;
+        start = getTimeNs();
+        for (i=0; i<BENCH_ENUMERATIONS; i++)
+            sum += settingsGetVisibleHandles(&rq, 0, handles, VALUE_COUNT);
+        printf("Visible handles, level %u: %6.2f us, ", level, (double)(getTimeNs() - start) / BENCH_ENUMERATIONS / 1000.0);
+        start = getTimeNs();
+        for (i=0; i<BENCH_ENUMERATIONS; i++)
+            sum += walkVisible((node_t *)hRoot, hRoot->slotOffset, level, handles, 0);
+        printf("walk over all nodes %6.2f us\n", (double)(getTimeNs() - start) / BENCH_ENUMERATIONS / 1000.0);
+    }
+    sink = sum;
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+
+    printf("*** Init ***\n");
+    createTree();
+    initSettings(1);
+    resolveValues();
+    printf("Access check is %s\n", (ENABLE_ACCESS_CHECK == 1) ? "enabled" : "disabled");
+
+    printf("*** Checking ***\n");
+    failed = testRequests();
+    failed |= testVisible();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    printf("*** Cost of access levels ***\n");
+    benchmark();
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,134 @@
+/******************************************************************************
+    Benchmark of typed C++ accessors
+
+    Reads the same value by C alias, by handle, by generated C accessor
+    and by Setting<> template, reports time per read.
+    Built with static tree (ENABLE_STATIC_TREE)
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "settings.hpp"
+
+
+// Count of measured reads
+#define BENCH_READS         50000000
+
+// Keeps compiler from hoisting RAM loads out of measured loop
+#if defined(__GNUC__)
+#define BENCH_BARRIER()     __asm__ __volatile__("" ::: "memory")
+#else
+#define BENCH_BARRIER()
+#endif
+
+
+typedef Setting<pGroup_B0, b0param_C0> settingC0;
+typedef Setting<pGroup_B0, b0param_C1> settingC1;
+typedef Setting<pGroup_B1, 5> settingC2;
+typedef Setting<pGroup_B2> settingB2;
+
+static volatile uint32_t sink;
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void report(const char *name, uint64_t time, uint32_t sum)
+{
+    sink = sum;
+    printf("%-16s %8.2f ns/read\n", name, (double)time / BENCH_READS);
+}
+
+
+int main()
+{
+    char str[C2_SIZE];
+    const char testStr[C2_SIZE] = "Typed accessor";
+    settingsHandle_t handle;
+    request_t rq = request_t();
+    uint64_t start;
+    uint32_t i, sum;
+    uint8_t failed = 0;
+
+    initSettings(1);
+
+    // Compile-time handles must match handles resolved by tree walk
+    printf("*** Checking ***\n");
+    rq.arg[0] = pGroup_B0;
+    rq.arg[1] = b0param_C0;
+    handle = settingsResolve(&rq);
+    if (handle != settingC0::handle)
+        failed = 1;
+    rq.arg[0] = pGroup_B1;
+    rq.arg[1] = 5;
+    if (settingsResolve(&rq) != settingC2::handle)
+        failed = 1;
+    if ((settingC1::write(7, rqWriteNoCb) != Result_OK) || (settingC1::read() != 7) ||
+        (settings_ReadI32(pGroup_B0, b0param_C1) != 7))
+        failed = 1;
+    if ((settingB2::write(100, rqWriteNoCb) != Result_OK) || (settingB2::read() != 100))
+        failed = 1;
+    settingC2::write(testStr, rqWriteNoCb);
+    settingC2::read(str);
+    if (memcmp(str, testStr, C2_SIZE) != 0)
+        failed = 1;
+    if (settingC0::read() != (uint32_t)settings_ReadI32(pGroup_B0, b0param_C0))
+        failed = 1;
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    printf("*** Reading B0.C0, %d reads ***\n", BENCH_READS);
+    sum = 0;
+    start = getTimeNs();
+    for (i=0; i<BENCH_READS; i++)
+    {
+        sum += settings_ReadI32(pGroup_B0, b0param_C0);
+        BENCH_BARRIER();
+    }
+    report("C alias", getTimeNs() - start, sum);
+
+    sum = 0;
+    start = getTimeNs();
+    for (i=0; i<BENCH_READS; i++)
+    {
+        sum += settings_ReadI32ByHandle(handle);
+        BENCH_BARRIER();
+    }
+    report("Handle", getTimeNs() - start, sum);
+
+    sum = 0;
+    start = getTimeNs();
+    for (i=0; i<BENCH_READS; i++)
+    {
+        sum += settings_get_B0_C0();
+        BENCH_BARRIER();
+    }
+    report("C accessor", getTimeNs() - start, sum);
+
+    sum = 0;
+    start = getTimeNs();
+    for (i=0; i<BENCH_READS; i++)
+    {
+        sum += settingC0::read();
+        BENCH_BARRIER();
+    }
+    report("Setting<>", getTimeNs() - start, sum);
+
+    return failed ? 1 : 0;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+    Benchmark of batch requests
+
+    Writes all C2 strings one by one and then as a single batch,
+    reports time per pass and ROM device traffic
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "settings.h"
+
+
+// Count of measured passes
+#define BENCH_PASSES        2000
+
+
+static char strings[C2_NODES_COUNT][C2_SIZE];
+static request_t requests[C2_NODES_COUNT];
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Prepare requests which write all C2 strings, text depends on pass
+static void prepareRequests(uint32_t pass)
+{
+    uint32_t i;
+    for (i=0; i<C2_NODES_COUNT; i++)
+    {
+        memset(strings[i], 0, C2_SIZE);
+        snprintf(strings[i], C2_SIZE, "Text %u of %u", i, pass);
+        requests[i].rq = rqWriteNoCb;
+        requests[i].arg[0] = pGroup_B1;
+        requests[i].arg[1] = i;
+        requests[i].raw = (uint8_t *)strings[i];
+    }
+}
+
+
+static void report(const char *name, uint64_t time, settingsRomStats_t *stats)
+{
+    printf("%-12s %10.2f us/pass %8.1f writes/pass %10.1f bytes/pass\n", name,
+           (double)time / 1000.0 / BENCH_PASSES,
+           (double)stats->writeCalls / BENCH_PASSES,
+           (double)stats->writeBytes / BENCH_PASSES);
+}
+
+
+int main()
+{
+    settingsRomStats_t *stats = getRomStats();
+    char str[C2_SIZE];
+    uint64_t start, time;
+    uint32_t pass, i;
+    uint32_t failed = 0;
+
+    printf("*** Init ***\n");
+    initSettings(0);
+
+    printf("*** Writing %d strings, %d passes ***\n", C2_NODES_COUNT, BENCH_PASSES);
+    memset(stats, 0, sizeof(settingsRomStats_t));
+    time = 0;
+    for (pass=0; pass<BENCH_PASSES; pass++)
+    {
+        prepareRequests(pass);
+        start = getTimeNs();
+        for (i=0; i<C2_NODES_COUNT; i++)
+            settingsRequest(&requests[i]);
+        time += getTimeNs() - start;
+    }
+    // Writes collected by ROM cache are counted too
+    flushSettingsToRom();
+    report("One by one", time, stats);
+
+    memset(stats, 0, sizeof(settingsRomStats_t));
+    time = 0;
+    for (pass=0; pass<BENCH_PASSES; pass++)
+    {
+        prepareRequests(pass);
+        start = getTimeNs();
+        settingsRequestBatch(requests, C2_NODES_COUNT);
+        time += getTimeNs() - start;
+    }
+    flushSettingsToRom();
+    report("Batch", time, stats);
+
+    // Values and CRC must survive restart
+    printf("*** Checking ***\n");
+    if (initSettings(0) != Result_OK)
+        failed = 1;
+    for (i=0; i<C2_NODES_COUNT; i++)
+    {
+        settings_ReadStr(pGroup_B1, i, str);
+        if (memcmp(str, strings[i], C2_SIZE) != 0)
+            failed = 1;
+    }
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed ? 1 : 0;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,30 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+# Tree of 1280 values
+DEFINES += SETTINGS_RAM_SIZE=16384 SETTINGS_ROM_SIZE=16384 SETTINGS_SLOT_TABLE_SIZE=2048 ENABLE_ACCESS_CHECK=1 ENABLE_SLOT_TABLE=1
+
+unix: LIBS += -lpthread
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        access.c \
+        ../settings.c \
+        ../settings_journal.c \
+        ../settings_private.c \
+        ../settings_rom.c \
+        ../settings_storage.c \
+        ../settings_tree.c \
+        ../utils.c
+
+HEADERS += \
+    ../settings.h \
+    ../settings_private.h \
+    ../settings_public.h \
+    ../settings_sim.h \
+    ../settings_storage.h \
+    ../settings_tree.h \
+    ../utils.h
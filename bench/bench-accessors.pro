@@ -0,0 +1,32 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+CONFIG += c++11
+
+# Typed accessors require generated static tree and slot table
+DEFINES += ENABLE_STATIC_TREE=1 ENABLE_NODE_CONSTRUCTORS=0 ENABLE_SLOT_TABLE=1
+
+unix: LIBS += -lpthread
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        accessors.cpp \
+        ../settings.c \
+        ../settings_journal.c \
+        ../settings_private.c \
+        ../settings_rom.c \
+        ../settings_storage.c \
+        ../settings_tree.c \
+        ../utils.c
+
+HEADERS += \
+    ../settings.h \
+    ../settings.hpp \
+    ../settings_private.h \
+    ../settings_public.h \
+    ../settings_sim.h \
+    ../settings_storage.h \
+    ../settings_tree.h \
+    ../utils.h
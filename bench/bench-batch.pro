@@ -0,0 +1,27 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+unix: LIBS += -lpthread
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        batch.c \
+        ../settings.c \
+        ../settings_journal.c \
+        ../settings_private.c \
+        ../settings_rom.c \
+        ../settings_storage.c \
+        ../settings_tree.c \
+        ../utils.c
+
+HEADERS += \
+    ../settings.h \
+    ../settings_private.h \
+    ../settings_public.h \
+    ../settings_sim.h \
+    ../settings_storage.h \
+    ../settings_tree.h \
+    ../utils.h
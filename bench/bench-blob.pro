@@ -0,0 +1,30 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+# Tables of 2048 bytes
+DEFINES += SETTINGS_RAM_SIZE=16384 SETTINGS_ROM_SIZE=16384 ENABLE_TRANSACTIONS=1 ROM_BULK_RESTORE=1 ENABLE_SLOT_TABLE=1
+
+unix: LIBS += -lpthread
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        blob.c \
+        ../settings.c \
+        ../settings_journal.c \
+        ../settings_private.c \
+        ../settings_rom.c \
+        ../settings_storage.c \
+        ../settings_tree.c \
+        ../utils.c
+
+HEADERS += \
+    ../settings.h \
+    ../settings_private.h \
+    ../settings_public.h \
+    ../settings_sim.h \
+    ../settings_storage.h \
+    ../settings_tree.h \
+    ../utils.h
@@ -0,0 +1,30 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+# Slice count of tested CRC16 calculation, 1, 4 or 8
+DEFINES += CRC16_SLICE_COUNT=8
+
+unix: LIBS += -lpthread
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        crc.c \
+        ../settings.c \
+        ../settings_journal.c \
+        ../settings_private.c \
+        ../settings_rom.c \
+        ../settings_storage.c \
+        ../settings_tree.c \
+        ../utils.c
+
+HEADERS += \
+    ../settings.h \
+    ../settings_private.h \
+    ../settings_public.h \
+    ../settings_sim.h \
+    ../settings_storage.h \
+    ../settings_tree.h \
+    ../utils.h
@@ -0,0 +1,30 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+# Concurrent writers are serialized by settings module
+DEFINES += SETTINGS_CONCURRENT_READERS=1 ENABLE_SUBSCRIPTIONS=1 SETTINGS_SLOT_TABLE_SIZE=1024 SETTINGS_MAX_SUBSCRIBERS=128 SETTINGS_WATCH_TRIE_SIZE=256 ENABLE_SLOT_TABLE=1
+
+unix: LIBS += -lpthread
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        events.c \
+        ../settings.c \
+        ../settings_journal.c \
+        ../settings_private.c \
+        ../settings_rom.c \
+        ../settings_storage.c \
+        ../settings_tree.c \
+        ../utils.c
+
+HEADERS += \
+    ../settings.h \
+    ../settings_private.h \
+    ../settings_public.h \
+    ../settings_sim.h \
+    ../settings_storage.h \
+    ../settings_tree.h \
+    ../utils.h
@@ -0,0 +1,323 @@
+/******************************************************************************
+    Test and benchmark of blob values
+
+    Checks reads and writes of a range in the middle of a blob: bytes around
+    the range are kept, only the range is written to ROM, CRC of the host node
+    is updated incrementally and survives reload from ROM. Also checks range
+    limits, change callbacks and ranges staged by a transaction. Reports cost
+    of updating one coefficient of a calibration table kept as a blob and as
+    a char array
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "settings.h"
+#include "settings_private.h"
+
+#if (ENABLE_SLOT_TABLE != 1) || (ENABLE_NODE_CONSTRUCTORS != 1) || (ENABLE_TRANSACTIONS != 1)
+#error "Test requires ENABLE_SLOT_TABLE, ENABLE_NODE_CONSTRUCTORS and ENABLE_TRANSACTIONS set to 1"
+#endif
+
+
+// Calibration table kept as a blob and as a char array, followed by a value
+#define TABLE_GROUP         0
+enum {
+    param_blob,
+    param_value,
+    param_chars,
+    PARAM_COUNT
+};
+#define TABLE_SIZE          2048
+
+// List of small blobs without default value
+#define LIST_GROUP          1
+#define LIST_SIZE           4
+#define LIST_BLOB_SIZE      256
+
+// Coefficient updated by tests and benchmark
+#define COEF_OFFSET         1000
+#define COEF_SIZE           4
+
+// Count of measured updates
+#define BENCH_UPDATES       200000
+
+
+extern hNode_t *hRoot;
+
+static uint8_t tableDefault[TABLE_SIZE];
+static settingsHandle_t blobHandle, charsHandle;
+static settingsHandle_t listHandles[LIST_SIZE];
+static uint32_t lastOffset, lastLength, changes;
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void onBlobChanged(rqType rq, const requestContext_t *ctx)
+{
+    (void)rq;
+    lastOffset = ctx->offset;
+    lastLength = ctx->length;
+    changes++;
+}
+
+
+static void createTree(void)
+{
+    hNode_t *group;
+    uint32_t i;
+    for (i=0; i<TABLE_SIZE; i++)
+        tableDefault[i] = (uint8_t)(i * 7);
+    hRoot = createHNode(2);
+    group = createHNode(PARAM_COUNT);
+    addToHList(group, param_blob, setChangeCallbackCtx(blobNode(AccessByAll, RomStored, TABLE_SIZE, tableDefault, 0), onBlobChanged));
+    addToHList(group, param_value, u32Node(AccessByAll, RomStored, 0, 1000, 10, 0));
+    addToHList(group, param_chars, charNode(AccessByAll, RomStored, TABLE_SIZE, 0, 0));
+    addToHList(hRoot, TABLE_GROUP, group);
+    addToHList(hRoot, LIST_GROUP, createLNode(LIST_SIZE, blobNode(AccessByAll, RomStored, LIST_BLOB_SIZE, 0, 0)));
+}
+
+
+static void resolveHandles(void)
+{
+    request_t rq;
+    uint32_t i;
+    memset(&rq, 0, sizeof(rq));
+    rq.arg[0] = TABLE_GROUP;
+    rq.arg[1] = param_blob;
+    blobHandle = settingsResolve(&rq);
+    rq.arg[1] = param_chars;
+    charsHandle = settingsResolve(&rq);
+    rq.arg[0] = LIST_GROUP;
+    for (i=0; i<LIST_SIZE; i++)
+    {
+        rq.arg[1] = i;
+        listHandles[i] = settingsResolve(&rq);
+    }
+}
+
+
+// Make a request for a range of blob
+static resultType request(settingsHandle_t handle, rqType type, uint32_t offset, uint32_t length, uint8_t *data)
+{
+    request_t rq;
+    memset(&rq, 0, sizeof(rq));
+    rq.rq = type;
+    rq.raw = data;
+    rq.offset = offset;
+    rq.length = length;
+    return settingsRequestByHandle(handle, &rq);
+}
+
+
+// Check that blob holds default value with the coefficient set to given bytes
+static uint8_t checkTable(const uint8_t *coef)
+{
+    uint8_t table[TABLE_SIZE];
+    uint8_t expected[TABLE_SIZE];
+    memcpy(expected, tableDefault, TABLE_SIZE);
+    memcpy(&expected[COEF_OFFSET], coef, COEF_SIZE);
+    memset(table, 0, TABLE_SIZE);
+    request(blobHandle, rqRead, 0, 0, table);
+    return (memcmp(table, expected, TABLE_SIZE) != 0);
+}
+
+
+static uint8_t testPartialUpdate(void)
+{
+    static const uint8_t coef[COEF_SIZE] = {0xDE, 0xAD, 0xBE, 0xEF};
+    settingsRomStats_t *stats = getRomStats();
+    uint8_t data[COEF_SIZE + 2];
+    uint8_t failed = 0;
+
+    // Defaults written by init are flushed first, so that only the update is counted
+    flushSettingsToRom();
+    memset(stats, 0, sizeof(settingsRomStats_t));
+    request(blobHandle, rqWrite, COEF_OFFSET, COEF_SIZE, (uint8_t *)coef);
+    flushSettingsToRom();
+#if ROM_DUAL_BANK == 1
+    // Whole image is written to inactive bank, followed by trailer
+    if (stats->writeCalls != 2)
+#elif SETTINGS_ROM_WRITE_MODE == ROM_WRITE_BACK
+    // Pages holding the range and host node CRC are written only
+    if ((stats->writeBytes > 4 * SETTINGS_ROM_PAGE_SIZE) || (stats->writeCalls != 2))
+#else
+    // Range and host node CRC are written only
+    if ((stats->writeBytes != COEF_SIZE + NODE_CRC_SIZE) || (stats->writeCalls != 2))
+#endif
+    {
+        printf("Partial update wrote %u bytes by %u writes\n", stats->writeBytes, stats->writeCalls);
+        failed = 1;
+    }
+    if (checkTable(coef))
+    {
+        printf("Partial update changed bytes around the range\n");
+        failed = 1;
+    }
+    if ((changes != 1) || (lastOffset != COEF_OFFSET) || (lastLength != COEF_SIZE))
+    {
+        printf("Changed range is not passed to callback\n");
+        failed = 1;
+    }
+
+    // Range is read with one neighbour byte on both sides
+    request(blobHandle, rqRead, COEF_OFFSET - 1, COEF_SIZE + 2, data);
+    if ((data[0] != tableDefault[COEF_OFFSET - 1]) || (memcmp(&data[1], coef, COEF_SIZE) != 0) ||
+        (data[COEF_SIZE + 1] != tableDefault[COEF_OFFSET + COEF_SIZE]))
+    {
+        printf("Range read does not match\n");
+        failed = 1;
+    }
+
+    // Length of 0 selects the rest of value
+    request(blobHandle, rqWrite, TABLE_SIZE - 2, 0, (uint8_t *)coef);
+    request(blobHandle, rqRead, TABLE_SIZE - 4, 4, data);
+    if ((data[0] != tableDefault[TABLE_SIZE - 4]) || (data[2] != coef[0]) || (data[3] != coef[1]) || (lastLength != 2))
+    {
+        printf("Range at the end does not match\n");
+        failed = 1;
+    }
+    request(blobHandle, rqWrite, TABLE_SIZE - 2, 0, &tableDefault[TABLE_SIZE - 2]);
+    return failed;
+}
+
+
+// Ranges which do not fit value are rejected
+static uint8_t testLimits(void)
+{
+    uint8_t data[8] = {0};
+    uint8_t failed = 0;
+    failed |= (request(blobHandle, rqValidate, TABLE_SIZE - 4, 4, data) != Result_OK);
+    failed |= (request(blobHandle, rqValidate, TABLE_SIZE - 4, 5, data) != Result_ValidateError);
+    failed |= (request(blobHandle, rqValidate, TABLE_SIZE + 1, 0, data) != Result_ValidateError);
+    failed |= (request(blobHandle, rqValidate, 4, 0xFFFFFFFF, data) != Result_ValidateError);
+    failed |= (request(blobHandle, rqValidate, 0, 4, 0) != Result_ValidateError);
+    failed |= (request(blobHandle, rqRead, TABLE_SIZE, 1, data) != Result_ValidateError);
+    if (failed)
+        printf("Range limits are not checked\n");
+    return failed;
+}
+
+
+// Ranges of list elements are kept by transaction until commit
+static uint8_t testTransaction(void)
+{
+    uint8_t data[LIST_BLOB_SIZE];
+    uint8_t pattern[16];
+    uint32_t i;
+    uint8_t failed = 0;
+
+    memset(pattern, 0x5A, sizeof(pattern));
+    settingsBegin();
+    for (i=0; i<LIST_SIZE; i++)
+        request(listHandles[i], rqWrite, 100 + i, sizeof(pattern), pattern);
+    memset(pattern, 0, sizeof(pattern));
+    settingsCommit();
+    for (i=0; i<LIST_SIZE; i++)
+    {
+        request(listHandles[i], rqRead, 0, 0, data);
+        if ((data[100 + i - 1] != 0) || (data[100 + i] != 0x5A) || (data[100 + i + 15] != 0x5A) || (data[100 + i + 16] != 0))
+            failed = 1;
+    }
+    if (failed)
+        printf("Transaction ranges do not match\n");
+    return failed;
+}
+
+
+// Values and CRC survive reload from ROM
+static uint8_t testReload(void)
+{
+    static const uint8_t coef[COEF_SIZE] = {0xDE, 0xAD, 0xBE, 0xEF};
+    uint8_t data[LIST_BLOB_SIZE];
+    uint8_t failed = 0;
+
+    flushSettingsToRom();
+    if (initSettings(0) != Result_OK)
+    {
+        printf("CRC does not match after reload\n");
+        failed = 1;
+    }
+    request(listHandles[LIST_SIZE - 1], rqRead, 0, 0, data);
+    if (checkTable(coef) || (data[100 + LIST_SIZE - 1] != 0x5A))
+    {
+        printf("Reloaded values do not match\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+
+static void report(const char *name, uint64_t time, settingsRomStats_t *stats)
+{
+    printf("%-12s %10.2f us/update %10.1f ROM bytes/update\n", name,
+           (double)time / 1000.0 / BENCH_UPDATES, (double)stats->writeBytes / BENCH_UPDATES);
+}
+
+
+// Update of one coefficient of calibration table
+static void benchmark(void)
+{
+    settingsRomStats_t *stats = getRomStats();
+    uint8_t table[TABLE_SIZE];
+    uint64_t start;
+    uint32_t i;
+
+    memset(stats, 0, sizeof(settingsRomStats_t));
+    start = getTimeNs();
+    for (i=0; i<BENCH_UPDATES; i++)
+        request(blobHandle, rqWriteNoCb, COEF_OFFSET, COEF_SIZE, (uint8_t *)&i);
+    flushSettingsToRom();
+    report("Blob range", getTimeNs() - start, stats);
+
+    // Char array is read, modified and written as a whole
+    memset(stats, 0, sizeof(settingsRomStats_t));
+    start = getTimeNs();
+    for (i=0; i<BENCH_UPDATES; i++)
+    {
+        request(charsHandle, rqRead, 0, 0, table);
+        memcpy(&table[COEF_OFFSET], &i, COEF_SIZE);
+        request(charsHandle, rqWriteNoCb, 0, 0, table);
+    }
+    flushSettingsToRom();
+    report("Char array", getTimeNs() - start, stats);
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+
+    printf("*** Init ***\n");
+    createTree();
+    initSettings(1);
+    resolveHandles();
+
+    printf("*** Checking ***\n");
+    failed = testPartialUpdate();
+    failed |= testLimits();
+    failed |= testTransaction();
+    failed |= testReload();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    printf("*** Cost of coefficient update ***\n");
+    benchmark();
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
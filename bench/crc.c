@@ -0,0 +1,150 @@
+/******************************************************************************
+    Test and benchmark of CRC16 calculation
+
+    Compares getCRC16() with the byte-wise calculation it replaces on random
+    data of random length, alignment and seed, and checks the CRC of
+    "123456789". Reports time per call of both for lengths from a single
+    value to a big host node. Slice count is set by CRC16_SLICE_COUNT
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "settings.h"
+#include "settings_private.h"
+
+
+// Random cases compared with byte-wise calculation
+#define TEST_CASES          200000
+#define TEST_DATA_SIZE      4096
+
+// CRC of "123456789" with seed 0 (CRC-16/UMTS)
+#define CHECK_VALUE         0xFEE8
+
+// Total count of bytes processed by every measurement
+#define BENCH_BYTES         200000000
+
+
+static uint16_t byteTable[256];
+static uint8_t data[TEST_DATA_SIZE + 8];
+static volatile uint32_t sink;
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Byte-wise calculation, as made before slice tables were added
+static void makeByteTable(void)
+{
+    uint16_t r;
+    uint32_t i,j;
+    for(i=0; i<256; i++)
+    {
+        r = i << 8;
+        for(j=0; j<8; j++)
+        {
+            if (r & (1 << 15))
+                r = (r << 1) ^ 0x8005;
+            else
+                r <<= 1;
+        }
+        byteTable[i] = r;
+    }
+}
+
+
+static uint16_t getByteCRC16(uint8_t *data, uint16_t len, uint16_t crc)
+{
+    while(len--)
+    {
+        crc = byteTable[((crc>>8)^*data++) & 0xFF] ^ (crc<<8);
+    }
+    return crc;
+}
+
+
+static uint8_t testEquivalence(void)
+{
+    uint32_t i, offset, len;
+    uint16_t seed;
+    uint8_t failed = 0;
+
+    if ((getCRC16((uint8_t *)"123456789", 9, 0) != CHECK_VALUE) || (getByteCRC16((uint8_t *)"123456789", 9, 0) != CHECK_VALUE))
+    {
+        printf("Check value does not match\n");
+        failed = 1;
+    }
+    srand(1);
+    for (i=0; i<sizeof(data); i++)
+        data[i] = (uint8_t)rand();
+    for (i=0; (i<TEST_CASES) && !failed; i++)
+    {
+        // Short lengths are tested more often, they exercise the tail loop
+        offset = (uint32_t)rand() % 8;
+        len = (i & 1) ? (uint32_t)rand() % 32 : (uint32_t)rand() % (TEST_DATA_SIZE + 1);
+        seed = (uint16_t)rand();
+        if (getCRC16(&data[offset], (uint16_t)len, seed) != getByteCRC16(&data[offset], (uint16_t)len, seed))
+        {
+            printf("CRC does not match: offset %u, length %u, seed 0x%04X\n", offset, len, seed);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+
+static void benchmark(void)
+{
+    static const uint16_t lengths[] = {2, 20, 64, 256, 700, 4096};
+    uint64_t start, bytewise;
+    uint32_t i, j, calls;
+    uint16_t crc = 0;
+
+    for (i=0; i<sizeof(lengths)/sizeof(lengths[0]); i++)
+    {
+        calls = BENCH_BYTES / lengths[i];
+        start = getTimeNs();
+        for (j=0; j<calls; j++)
+            crc = getByteCRC16(data, lengths[i], crc);
+        bytewise = getTimeNs() - start;
+        start = getTimeNs();
+        for (j=0; j<calls; j++)
+            crc = getCRC16(data, lengths[i], crc);
+        printf("%4u bytes: byte-wise %9.1f ns, slice-by-%u %9.1f ns\n", lengths[i], (double)bytewise / calls,
+               CRC16_SLICE_COUNT, (double)(getTimeNs() - start) / calls);
+    }
+    sink = crc;
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+
+    makeCRC16Table();
+    makeByteTable();
+
+    printf("*** Checking slice-by-%u ***\n", CRC16_SLICE_COUNT);
+    failed = testEquivalence();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    printf("*** Time per call ***\n");
+    benchmark();
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,402 @@
+/******************************************************************************
+    Test and benchmark of change subscriptions
+
+    Checks delivery of change events to subscribers of values and subtrees,
+    coalescing of repeated changes and counting of dropped events. Then a group
+    is written by several threads while events are dispatched by another one,
+    and every subscriber must end with the latest values. Elements of a list
+    are watched as a subtree and one by one. Reports cost of a write with and
+    without subscribers, and cost of event dispatch with few and many subscriptions
+
+    Settings module must be built with SETTINGS_CONCURRENT_READERS set to 1
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "settings.h"
+#include "settings_private.h"
+
+#if (SETTINGS_CONCURRENT_READERS != 1) || (ENABLE_SLOT_TABLE != 1) || (ENABLE_SUBSCRIPTIONS != 1) || (ENABLE_NODE_CONSTRUCTORS != 1)
+#error "Test requires SETTINGS_CONCURRENT_READERS, ENABLE_SLOT_TABLE, ENABLE_SUBSCRIPTIONS and ENABLE_NODE_CONSTRUCTORS set to 1"
+#endif
+
+
+// Tree: GROUP_COUNT groups of PARAM_COUNT 32-bit values
+#define GROUP_COUNT         8
+#define PARAM_COUNT         32
+#define VALUE_COUNT         (GROUP_COUNT * PARAM_COUNT)
+#define VALUE_MAX           1000000
+
+// List of LIST_SIZE 32-bit values follows the groups
+#define LIST_GROUP          GROUP_COUNT
+#define LIST_SIZE           35
+
+// Group written by concurrent test, its values fit event queue
+#define CONCURRENT_GROUP    2
+#define CONCURRENT_WRITERS  4
+#define CONCURRENT_WRITES   200000
+
+// Count of measured writes
+#define BENCH_WRITES        1000000
+
+// Count of measured dispatches, every one delivers PARAM_COUNT events
+#define BENCH_DISPATCHES    20000
+
+
+// Subscriber state
+typedef struct {
+    uint32_t events;                // Count of delivered events
+    uint32_t changes;               // Sum of merged changes
+    settingsHandle_t handle;        // Node of the last event
+    uint32_t lastArg;               // Last argument of the node of the last event
+    int32_t value;                  // Value of the node read by the last event
+    int32_t mirror[PARAM_COUNT];    // Values of a group, updated by events
+    settingsHandle_t mirrorBase;    // Handle of the first value of the group
+} subscriberState_t;
+
+extern hNode_t *hRoot;
+
+static atomic_int stopFlag;
+static volatile uint32_t sink;
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void createTree(void)
+{
+    hNode_t *group;
+    uint32_t i, j;
+    hRoot = createHNode(GROUP_COUNT + 1);
+    for (i=0; i<GROUP_COUNT; i++)
+    {
+        group = createHNode(PARAM_COUNT);
+        for (j=0; j<PARAM_COUNT; j++)
+            addToHList(group, j, u32Node(AccessByAll, RomStored, 0, VALUE_MAX, j, 0));
+        addToHList(hRoot, i, group);
+    }
+    addToHList(hRoot, LIST_GROUP, createLNode(LIST_SIZE, u32Node(AccessByAll, RomStored, 0, VALUE_MAX, 0, 0)));
+}
+
+
+static void writeValue(rqType type, uint32_t group, uint32_t param, int32_t value)
+{
+    request_t rq;
+    rq.rq = type;
+    rq.accLevel = AccessByAll;
+    rq.arg[0] = group;
+    rq.arg[1] = param;
+    rq.val.i32 = &value;
+    rq.raw = 0;
+    settingsRequest(&rq);
+}
+
+
+static void onEvent(const settingsEvent_t *event, void *userData)
+{
+    subscriberState_t *state = (subscriberState_t *)userData;
+    state->events++;
+    state->changes += event->changes;
+    state->handle = event->handle;
+    state->lastArg = event->arg[event->depth - 1];
+    state->value = settings_ReadI32ByHandle(event->handle);
+    if (event->handle - state->mirrorBase < PARAM_COUNT)
+        state->mirror[event->handle - state->mirrorBase] = state->value;
+}
+
+
+static uint32_t subscribe(uint32_t depth, uint32_t group, uint32_t param, subscriberState_t *state)
+{
+    request_t rq;
+    rq.arg[0] = group;
+    rq.arg[1] = param;
+    memset(state, 0, sizeof(subscriberState_t));
+    return settingsSubscribe(&rq, depth, onEvent, state);
+}
+
+
+static uint8_t check(const char *name, uint8_t passed)
+{
+    printf("%-40s %s\n", name, passed ? "ok" : "FAILED");
+    return passed ? 0 : 1;
+}
+
+
+// Check delivery, coalescing and dropping of events
+static uint8_t testEvents(void)
+{
+    static subscriberState_t value, group, tree;
+    request_t rq;
+    settingsEventStats_t stats;
+    settingsHandle_t handle;
+    uint32_t i, j, valueId;
+    uint8_t failed = 0;
+
+    valueId = subscribe(2, 0, 5, &value);
+    subscribe(1, 1, 0, &group);
+    subscribe(0, 0, 0, &tree);
+    rq.arg[0] = 0;
+    rq.arg[1] = 5;
+    handle = settingsResolve(&rq);
+
+    for (i=1; i<=10; i++)
+        writeValue(rqWrite, 0, 5, i * 100);
+    settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+    failed |= check("Repeated writes make one event", (value.events == 1) && (value.changes == 10) && (tree.events == 1));
+    failed |= check("Event has the latest value", (value.handle == handle) && (value.value == 1000));
+    failed |= check("Other subtree is not notified", group.events == 0);
+
+    writeValue(rqWrite, 1, 3, 3);
+    writeValue(rqWrite, 1, 7, 7);
+    settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+    failed |= check("Subtree subscriber gets every node", (group.events == 2) && (tree.events == 3) && (value.events == 1));
+
+    writeValue(rqWriteNoCb, 0, 5, 1);
+    failed |= check("Write without callback makes no event", settingsDispatchEvents(SETTINGS_DISPATCH_ALL) == 0);
+
+    settingsUnsubscribe(valueId);
+    writeValue(rqWrite, 0, 5, 2);
+    settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+    failed |= check("Removed subscriber is not notified", (value.events == 1) && (tree.events == 4));
+
+    // Every value is changed twice, queue fits a part of them
+    memcpy(&stats, getEventStats(), sizeof(stats));
+    for (j=0; j<2; j++)
+    {
+        for (i=0; i<VALUE_COUNT; i++)
+            writeValue(rqWrite, i / PARAM_COUNT, i % PARAM_COUNT, j);
+    }
+    i = settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+    stats.posted = getEventStats()->posted - stats.posted;
+    stats.coalesced = getEventStats()->coalesced - stats.coalesced;
+    stats.dropped = getEventStats()->dropped - stats.dropped;
+    printf("Overflow: %u changes, %u coalesced, %u dropped, %u delivered\n", stats.posted, stats.coalesced, stats.dropped, i);
+    failed |= check("Overflow is counted", (i == SETTINGS_EVENT_QUEUE_SIZE) && (stats.posted == 2 * VALUE_COUNT) &&
+                                           (stats.coalesced + stats.dropped + i == stats.posted));
+    writeValue(rqWrite, GROUP_COUNT - 1, PARAM_COUNT - 1, 5);
+    failed |= check("Dropped node is queued by next change", settingsDispatchEvents(SETTINGS_DISPATCH_ALL) == 1);
+    return failed;
+}
+
+
+// Check watches of list elements and reuse of watch trie entries
+static uint8_t testWatches(void)
+{
+    static subscriberState_t list, element, churn;
+    uint32_t i, id, listId, elementId;
+    uint8_t failed = 0;
+
+    listId = subscribe(1, LIST_GROUP, 0, &list);
+    elementId = subscribe(2, LIST_GROUP, 3, &element);
+    writeValue(rqWrite, LIST_GROUP, 3, 33);
+    writeValue(rqWrite, LIST_GROUP, 30, 300);
+    settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+    failed |= check("List watcher gets every element", (list.events == 2) && (list.lastArg == 30) && (list.value == 300));
+    failed |= check("Element watcher gets its element only", (element.events == 1) && (element.lastArg == 3) && (element.value == 33));
+
+    // Paths of removed subscriptions are kept in trie until it is full
+    for (i=0; i<VALUE_COUNT; i++)
+    {
+        id = subscribe(2, i / PARAM_COUNT, i % PARAM_COUNT, &churn);
+        if (id == SETTINGS_INVALID_SUBSCRIPTION)
+            break;
+        settingsUnsubscribe(id);
+    }
+    writeValue(rqWrite, LIST_GROUP, 5, 5);
+    writeValue(rqWrite, 0, 0, 5);
+    settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+    failed |= check("Trie is rebuilt for new subscriptions", (i == VALUE_COUNT) && (list.events == 3) &&
+                                                             (element.events == 1) && (churn.events == 0));
+    settingsUnsubscribe(listId);
+    settingsUnsubscribe(elementId);
+    return failed;
+}
+
+
+static void *writerThread(void *arg)
+{
+    uint32_t state = (uint32_t)(uintptr_t)arg, i;
+    for (i=0; i<CONCURRENT_WRITES; i++)
+    {
+        state = state * 1103515245 + 12345;
+        writeValue(rqWrite, CONCURRENT_GROUP, (state >> 16) % PARAM_COUNT, (int32_t)((state >> 8) % VALUE_MAX));
+    }
+    return 0;
+}
+
+
+static void *dispatcherThread(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&stopFlag))
+        settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+    return 0;
+}
+
+
+// Write a group by several threads while events are dispatched, subscribers must see the latest values
+static uint8_t testConcurrent(void)
+{
+    static subscriberState_t mirrors[2];
+    pthread_t writers[CONCURRENT_WRITERS], dispatcher;
+    settingsEventStats_t stats;
+    request_t rq;
+    uint32_t i, j;
+    uint8_t failed = 0;
+
+    rq.arg[0] = CONCURRENT_GROUP;
+    rq.arg[1] = 0;
+    for (i=0; i<2; i++)
+    {
+        subscribe(1, CONCURRENT_GROUP, 0, &mirrors[i]);
+        mirrors[i].mirrorBase = settingsResolve(&rq);
+        for (j=0; j<PARAM_COUNT; j++)
+            mirrors[i].mirror[j] = settings_ReadI32(CONCURRENT_GROUP, j);
+    }
+    memcpy(&stats, getEventStats(), sizeof(stats));
+
+    atomic_store(&stopFlag, 0);
+    pthread_create(&dispatcher, 0, dispatcherThread, 0);
+    for (i=0; i<CONCURRENT_WRITERS; i++)
+        pthread_create(&writers[i], 0, writerThread, (void *)(uintptr_t)(i + 1));
+    for (i=0; i<CONCURRENT_WRITERS; i++)
+        pthread_join(writers[i], 0);
+    atomic_store(&stopFlag, 1);
+    pthread_join(dispatcher, 0);
+    settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+
+    stats.posted = getEventStats()->posted - stats.posted;
+    stats.coalesced = getEventStats()->coalesced - stats.coalesced;
+    stats.dropped = getEventStats()->dropped - stats.dropped;
+    stats.dispatched = getEventStats()->dispatched - stats.dispatched;
+    printf("%u writers: %u changes, %u coalesced, %u dropped, %u delivered\n", CONCURRENT_WRITERS,
+           stats.posted, stats.coalesced, stats.dropped, stats.dispatched);
+    for (i=0; i<PARAM_COUNT; i++)
+    {
+        for (j=0; j<2; j++)
+        {
+            if (mirrors[j].mirror[i] != settings_ReadI32(CONCURRENT_GROUP, i))
+                failed = 1;
+        }
+    }
+    failed = check("Subscribers see the latest values", !failed);
+    failed |= check("Every change is delivered or coalesced", (stats.dropped == 0) &&
+                                                              (stats.posted == CONCURRENT_WRITERS * CONCURRENT_WRITES) &&
+                                                              (stats.coalesced + stats.dispatched == stats.posted));
+    return failed;
+}
+
+
+static double measureWrites(uint32_t group, uint8_t dispatch)
+{
+    uint64_t start;
+    uint32_t i;
+    start = getTimeNs();
+    for (i=0; i<BENCH_WRITES; i++)
+    {
+        writeValue(rqWrite, group, i % PARAM_COUNT, i & 0xFFFF);
+        if (dispatch)
+            sink += settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+    }
+    return (double)(getTimeNs() - start) / BENCH_WRITES;
+}
+
+
+static void onBenchEvent(const settingsEvent_t *event, void *userData)
+{
+    *(uint32_t *)userData += event->changes;
+}
+
+
+// Get time of event dispatch, all values of group 1 are changed before every dispatch
+static double measureDispatch(void)
+{
+    uint64_t start, time = 0;
+    uint32_t i, j;
+    for (i=0; i<BENCH_DISPATCHES; i++)
+    {
+        for (j=0; j<PARAM_COUNT; j++)
+            writeValue(rqWrite, 1, j, i & 0xFFFF);
+        start = getTimeNs();
+        settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+        time += getTimeNs() - start;
+    }
+    return (double)time / (BENCH_DISPATCHES * PARAM_COUNT);
+}
+
+
+static void benchmark(void)
+{
+    static uint32_t changes, others;
+    request_t rq;
+    double none, unwatched, watched, dispatched, few, many;
+    uint32_t i, count = 1;
+
+    // Tree is initialized again to remove subscriptions
+    initSettings(1);
+    none = measureWrites(0, 0);
+    rq.arg[0] = 1;
+    settingsSubscribe(&rq, 1, onBenchEvent, &changes);
+    unwatched = measureWrites(0, 0);
+    watched = measureWrites(1, 0);
+    settingsDispatchEvents(SETTINGS_DISPATCH_ALL);
+    dispatched = measureWrites(1, 1);
+    few = measureDispatch();
+
+    // Other values and list elements are watched one by one
+    for (i=0; (i<(GROUP_COUNT + 1) * PARAM_COUNT) && (count < SETTINGS_MAX_SUBSCRIBERS); i++)
+    {
+        rq.arg[0] = i / PARAM_COUNT;
+        rq.arg[1] = i % PARAM_COUNT;
+        if ((rq.arg[0] != 1) && (settingsSubscribe(&rq, 2, onBenchEvent, &others) != SETTINGS_INVALID_SUBSCRIPTION))
+            count++;
+    }
+    many = measureDispatch();
+    printf("No subscribers:         %8.1f ns/write\n", none);
+    printf("Value is not watched:   %8.1f ns/write\n", unwatched);
+    printf("Value is watched:       %8.1f ns/write (events are coalesced)\n", watched);
+    printf("Write and dispatch:     %8.1f ns/write, %.1f ns more\n", dispatched, dispatched - watched);
+    printf("Dispatch, 1 subscription:   %6.1f ns/event\n", few);
+    printf("Dispatch, %u subscriptions: %6.1f ns/event\n", count, many);
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+
+    printf("*** Init ***\n");
+    createTree();
+    initSettings(1);
+
+    printf("*** Events ***\n");
+    failed = testEvents();
+    failed |= testWatches();
+
+    printf("*** Concurrent writers ***\n");
+    failed |= testConcurrent();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    printf("*** Cost of events ***\n");
+    benchmark();
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,187 @@
+/******************************************************************************
+    Benchmark of handle-based access
+
+    Resolves all terminating nodes of the tree created by initSettings() to
+    handles, checks that handles access the same values as request arguments,
+    then reports time per request made by arguments (tree walk) and by handle
+    (slot table) for integer reads, string reads and RAM-only integer writes
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "settings.h"
+#include "settings_private.h"
+
+#if ENABLE_SLOT_TABLE != 1
+#error "Test requires ENABLE_SLOT_TABLE set to 1"
+#endif
+
+
+// Count of measured requests
+#define BENCH_REQUESTS      5000000
+
+
+static settingsHandle_t intHandles[b0param_Count];
+static settingsHandle_t strHandles[C2_NODES_COUNT];
+static volatile uint32_t sink;
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void resolveHandles(void)
+{
+    request_t rq;
+    uint32_t i;
+    memset(&rq, 0, sizeof(rq));
+    rq.arg[0] = pGroup_B0;
+    for (i=0; i<b0param_Count; i++)
+    {
+        rq.arg[1] = i;
+        intHandles[i] = settingsResolve(&rq);
+    }
+    rq.arg[0] = pGroup_B1;
+    for (i=0; i<C2_NODES_COUNT; i++)
+    {
+        rq.arg[1] = i;
+        strHandles[i] = settingsResolve(&rq);
+    }
+}
+
+
+// Handles must address the same values as request arguments
+static uint8_t checkHandles(void)
+{
+    request_t rq;
+    char byArgs[C2_SIZE], byHandle[C2_SIZE];
+    uint32_t i;
+    uint8_t failed = 0;
+
+    for (i=0; i<b0param_Count; i++)
+    {
+        if ((intHandles[i] == SETTINGS_INVALID_HANDLE) ||
+            (settings_ReadI32ByHandle(intHandles[i]) != settings_ReadI32(pGroup_B0, i)))
+        {
+            printf("Handle of C%u does not match\n", i);
+            failed = 1;
+        }
+    }
+    memset(&rq, 0, sizeof(rq));
+    rq.rq = rqRead;
+    rq.raw = (uint8_t *)byHandle;
+    for (i=0; i<C2_NODES_COUNT; i++)
+    {
+        settings_ReadStr(pGroup_B1, i, byArgs);
+        if ((strHandles[i] == SETTINGS_INVALID_HANDLE) || (settingsRequestByHandle(strHandles[i], &rq) != Result_OK) ||
+            (memcmp(byArgs, byHandle, C2_SIZE) != 0))
+        {
+            printf("Handle of C2[%u] does not match\n", i);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+
+static void report(const char *name, uint64_t byArgs, uint64_t byHandle)
+{
+    printf("%-14s by arguments %7.2f ns, by handle %7.2f ns\n", name,
+           (double)byArgs / BENCH_REQUESTS, (double)byHandle / BENCH_REQUESTS);
+}
+
+
+static void benchmark(void)
+{
+    request_t rq;
+    char str[C2_SIZE];
+    int32_t value;
+    uint64_t start, byArgs;
+    uint32_t i, sum = 0;
+
+    start = getTimeNs();
+    for (i=0; i<BENCH_REQUESTS; i++)
+        sum += settings_ReadI32(pGroup_B0, i % b0param_Count);
+    byArgs = getTimeNs() - start;
+    start = getTimeNs();
+    for (i=0; i<BENCH_REQUESTS; i++)
+        sum += settings_ReadI32ByHandle(intHandles[i % b0param_Count]);
+    report("Integer read", byArgs, getTimeNs() - start);
+
+    memset(&rq, 0, sizeof(rq));
+    rq.rq = rqRead;
+    rq.accLevel = AccessByDev;
+    rq.arg[0] = pGroup_B1;
+    rq.raw = (uint8_t *)str;
+    start = getTimeNs();
+    for (i=0; i<BENCH_REQUESTS; i++)
+    {
+        rq.arg[1] = i % C2_NODES_COUNT;
+        settingsRequest(&rq);
+        sum += (uint8_t)str[0];
+    }
+    byArgs = getTimeNs() - start;
+    start = getTimeNs();
+    for (i=0; i<BENCH_REQUESTS; i++)
+    {
+        settingsRequestByHandle(strHandles[i % C2_NODES_COUNT], &rq);
+        sum += (uint8_t)str[0];
+    }
+    report("String read", byArgs, getTimeNs() - start);
+
+    // C1 is written in RAM only, so that ROM device is not measured
+    rq.rq = rqApplyNoCb;
+    rq.arg[0] = pGroup_B0;
+    rq.arg[1] = b0param_C1;
+    rq.raw = 0;
+    rq.val.i32 = &value;
+    start = getTimeNs();
+    for (i=0; i<BENCH_REQUESTS; i++)
+    {
+        value = (int32_t)(i & 0x3F);
+        settingsRequest(&rq);
+    }
+    byArgs = getTimeNs() - start;
+    start = getTimeNs();
+    for (i=0; i<BENCH_REQUESTS; i++)
+    {
+        value = (int32_t)(i & 0x3F);
+        settingsRequestByHandle(intHandles[b0param_C1], &rq);
+    }
+    report("Integer write", byArgs, getTimeNs() - start);
+    sink = sum;
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+
+    printf("*** Init ***\n");
+    initSettings(1);
+    resolveHandles();
+
+    printf("*** Checking ***\n");
+    failed = checkHandles();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    printf("*** Requests by arguments and by handle ***\n");
+    benchmark();
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,170 @@
+/******************************************************************************
+    Test of host node CRC kept by write requests
+
+    Makes random writes by arguments, by handle and by batch and checks after
+    each of them that CRC of host nodes matches values, so that image is
+    restored from ROM. Then checks that CRC invalidated by
+    resetSettingsToDefaults() is handled the same way by all request APIs:
+    with incremental CRC it stays invalid and defaults are restored on next
+    start, otherwise a write makes CRC of the host node valid again
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "settings_private.h"
+
+#if ENABLE_SLOT_TABLE != 1
+#error "Test requires ENABLE_SLOT_TABLE set to 1"
+#endif
+
+
+// Count of random writes
+#define TEST_WRITES         3000
+
+// Value of C0 written before reset
+#define RESET_TEST_VALUE    1
+
+// Value of C0 expected after reset followed by a write to C1
+// Dual-bank image is rejected by its header after reset
+#if (USE_INCREMENTAL_CRC == 1) || (ROM_DUAL_BANK == 1)
+#define RESET_EXPECTED      12345
+#else
+#define RESET_EXPECTED      RESET_TEST_VALUE
+#endif
+
+// Ways to make a request
+enum {
+    api_args,
+    api_handle,
+    api_batch,
+    API_COUNT
+};
+
+static const char *apiNames[API_COUNT] = {"arguments", "handle", "batch"};
+
+
+// Write C0, C1 or one of C2 elements with random value
+static void randomWrite(uint32_t api)
+{
+    request_t rqs[2];
+    request_t *rq;
+    char str[2][C2_SIZE];
+    int32_t value[2];
+    uint32_t i, count;
+
+    memset(rqs, 0, sizeof(rqs));
+    count = (api == api_batch) ? 2 : 1;
+    for (i=0; i<count; i++)
+    {
+        rq = &rqs[i];
+        rq->rq = rqWriteNoCb;
+        rq->accLevel = AccessByDev;
+        if (rand() & 1)
+        {
+            rq->arg[0] = pGroup_B0;
+            rq->arg[1] = (uint32_t)rand() % b0param_Count;
+            value[i] = (rq->arg[1] == b0param_C0) ? rand() % 100001 : rand() % 145;
+            rq->val.i32 = &value[i];
+        }
+        else
+        {
+            // String is written with random length, so that bytes after terminator are kept
+            memset(str[i], 0, C2_SIZE);
+            memset(str[i], 'a' + rand() % 26, (uint32_t)rand() % C2_SIZE);
+            rq->arg[0] = pGroup_B1;
+            rq->arg[1] = (uint32_t)rand() % C2_NODES_COUNT;
+            rq->raw = (uint8_t *)str[i];
+        }
+    }
+    if (api == api_args)
+        settingsRequest(&rqs[0]);
+    else if (api == api_handle)
+        settingsRequestByHandle(settingsResolve(&rqs[0]), &rqs[0]);
+    else
+        settingsRequestBatch(rqs, count);
+}
+
+
+// CRC stored in ROM is checked against values on reload
+static uint8_t testWrites(void)
+{
+    uint32_t i, api;
+    uint8_t failed = 0;
+
+    initSettings(1);
+    srand(1);
+    for (i=0; (i<TEST_WRITES) && !failed; i++)
+    {
+        api = i % API_COUNT;
+        randomWrite(api);
+        flushSettingsToRom();
+        if (initSettings(0) != Result_OK)
+        {
+            printf("CRC does not match after write %u by %s\n", i, apiNames[api]);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+
+// Reset followed by a write to the same host node gives the same result whatever API is used
+static uint8_t testReset(void)
+{
+    request_t rq;
+    int32_t value = 7;
+    uint32_t api;
+    uint8_t failed = 0;
+
+    for (api=0; api<API_COUNT; api++)
+    {
+        initSettings(1);
+        settings_WriteI32NoCbf(pGroup_B0, b0param_C0, RESET_TEST_VALUE);
+        resetSettingsToDefaults();
+        memset(&rq, 0, sizeof(rq));
+        rq.rq = rqWriteNoCb;
+        rq.accLevel = AccessByDev;
+        rq.arg[0] = pGroup_B0;
+        rq.arg[1] = b0param_C1;
+        rq.val.i32 = &value;
+        if (api == api_args)
+            settingsRequest(&rq);
+        else if (api == api_handle)
+            settingsRequestByHandle(settingsResolve(&rq), &rq);
+        else
+            settingsRequestBatch(&rq, 1);
+        flushSettingsToRom();
+        initSettings(0);
+        if (settings_ReadI32(pGroup_B0, b0param_C0) != RESET_EXPECTED)
+        {
+            printf("Reset is not handled as expected after write by %s\n", apiNames[api]);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+
+    printf("*** Checking CRC after writes ***\n");
+    failed = testWrites();
+    printf("*** Checking CRC after reset ***\n");
+    failed |= testReset();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,94 @@
+/******************************************************************************
+    Benchmark of flash wear and latency
+
+    Makes a series of parameter changes and reports flash traffic, erase counts
+    and device busy time of the simulated flash device.
+    Build with SETTINGS_ROM_BACKEND set to ROM_BACKEND_JOURNAL (bench-journal.pro)
+    and with default in-place backend (bench-inplace.pro) to compare
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "settings_private.h"
+#include "settings_sim.h"
+
+
+// Count of parameter changes
+#define BENCH_CHANGES       5000
+
+
+// Change one of parameters, value depends on change index
+static void change(uint32_t index)
+{
+    request_t rq;
+    char str[C2_SIZE];
+    switch (index % 3)
+    {
+        case 0:
+            settings_WriteI32NoCbf(pGroup_B0, b0param_C0, index);
+            break;
+        case 1:
+            settings_WriteI32NoCbf(pGroup_B0, b0param_C1, index % 100);
+            break;
+        default:
+            memset(str, 0, C2_SIZE);
+            snprintf(str, C2_SIZE, "Text %u", index);
+            rq.rq = rqWriteNoCb;
+            rq.arg[0] = pGroup_B1;
+            rq.arg[1] = index % C2_NODES_COUNT;
+            rq.raw = (uint8_t *)str;
+            settingsRequest(&rq);
+            break;
+    }
+}
+
+
+int main()
+{
+    simFlashStats_t *stats = simGetFlashStats();
+    char str[C2_SIZE], expected[C2_SIZE];
+    uint32_t i, last;
+    uint8_t failed = 0;
+
+    printf("*** Init ***\n");
+    initSettings(0);
+    memset(stats, 0, sizeof(simFlashStats_t));
+
+    printf("*** %s backend, %d changes ***\n",
+           (SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL) ? "Journal" : "In-place", BENCH_CHANGES);
+    for (i=0; i<BENCH_CHANGES; i++)
+        change(i);
+    // Changes collected by ROM cache are written before restart
+    flushSettingsToRom();
+    printf("Written: %10.1f bytes/change\n", (double)stats->writeBytes / BENCH_CHANGES);
+    printf("Programmed: %7.1f bytes/change\n", (double)stats->programBytes / BENCH_CHANGES);
+    printf("Erases: %11u total, most worn block is erased %u times since start\n", stats->erases, stats->maxBlockErases);
+    printf("Busy: %13.1f us/change\n", (double)stats->busyNs / 1000.0 / BENCH_CHANGES);
+
+    printf("*** Restart ***\n");
+    settingsRomDropCache();
+    if (initSettings(0) != Result_OK)
+        failed = 1;
+    last = BENCH_CHANGES - 1;
+    while (last % 3 != 2)
+        last--;
+    settings_ReadStr(pGroup_B1, last % C2_NODES_COUNT, str);
+    memset(expected, 0, C2_SIZE);
+    snprintf(expected, C2_SIZE, "Text %u", last);
+    if (strcmp(str, expected) != 0)
+        failed = 1;
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,153 @@
+/******************************************************************************
+    Test of ROM image written before image header was added
+
+    Saves an image, then moves its tree to address 0 as it was placed by
+    firmware without image header. Checks that values are restored from such
+    image and that it is saved again with header. Checks that erased storage
+    is not taken for a legacy image
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "settings.h"
+#include "settings_private.h"
+#include "settings_storage.h"
+#include "utils.h"
+
+#if LEGACY_IMAGE_MIGRATION != 1
+#error "Test requires LEGACY_IMAGE_MIGRATION set to 1"
+#endif
+
+
+#define STORAGE_PATH        "bench-legacy.bin"
+
+// Values written before image is moved
+#define TEST_C0             777
+#define TEST_C2_INDEX       3
+#define TEST_C2             "Legacy text"
+
+
+static settingsFileStorage_t storage;
+static uint8_t image[SETTINGS_STORAGE_SIZE];
+
+
+// Reopen storage, so that nothing is kept from previous run
+static void openStorage(void)
+{
+    if (storage.fd > 0)
+        settingsFileStorageClose(&storage);
+    settingsFileStorageOpen(&storage, STORAGE_PATH, SETTINGS_STORAGE_SIZE);
+    settingsSetStorageDriver(&storage.driver);
+}
+
+
+static void writeStr(uint32_t index, const char *str)
+{
+    request_t rq;
+    char value[C2_SIZE];
+    memset(value, 0, sizeof(value));
+    strncpy(value, str, C2_SIZE - 1);
+    memset(&rq, 0, sizeof(rq));
+    rq.rq = rqWriteNoCb;
+    rq.accLevel = AccessByDev;
+    rq.arg[0] = pGroup_B1;
+    rq.arg[1] = index;
+    rq.raw = (uint8_t *)value;
+    settingsRequest(&rq);
+}
+
+
+static uint8_t testMigration(void)
+{
+    char str[C2_SIZE];
+    uint32_t version = 0;
+    uint8_t failed = 0;
+
+    initSettings(1);
+    settings_WriteI32NoCbf(pGroup_B0, b0param_C0, TEST_C0);
+    writeStr(TEST_C2_INDEX, TEST_C2);
+    flushSettingsToRom();
+
+    // Tree is moved over the header
+    pread(storage.fd, image, SETTINGS_STORAGE_SIZE, 0);
+    memmove(image, &image[ROM_HEADER_SIZE], SETTINGS_STORAGE_SIZE - ROM_HEADER_SIZE);
+    pwrite(storage.fd, image, SETTINGS_STORAGE_SIZE, 0);
+    openStorage();
+
+    if (initSettings(0) != Result_OK)
+    {
+        printf("Legacy image is not accepted\n");
+        failed = 1;
+    }
+    settings_ReadStr(pGroup_B1, TEST_C2_INDEX, str);
+    if ((settings_ReadI32(pGroup_B0, b0param_C0) != TEST_C0) || (strcmp(str, TEST_C2) != 0))
+    {
+        printf("Values are not restored from legacy image\n");
+        failed = 1;
+    }
+
+    // Image is saved with header
+    pread(storage.fd, image, SETTINGS_STORAGE_SIZE, 0);
+    bytesToU32MsbFirst(&image[ROM_HEADER_VERSION_OFFSET], &version, 2);
+    openStorage();
+    if ((version != SETTINGS_ROM_FORMAT_VERSION) || (initSettings(0) != Result_OK) ||
+        (settings_ReadI32(pGroup_B0, b0param_C0) != TEST_C0))
+    {
+        printf("Legacy image is not saved with header\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+
+// Erased or zeroed storage restores defaults
+static uint8_t testErased(void)
+{
+    uint8_t pattern[2] = {0xFF, 0x00};
+    uint32_t i;
+    uint8_t failed = 0;
+
+    for (i=0; i<sizeof(pattern); i++)
+    {
+        memset(image, pattern[i], SETTINGS_STORAGE_SIZE);
+        pwrite(storage.fd, image, SETTINGS_STORAGE_SIZE, 0);
+        openStorage();
+        if ((initSettings(0) == Result_OK) || (settings_ReadI32(pGroup_B0, b0param_C0) != 12345))
+        {
+            printf("Storage filled with 0x%02X is taken for legacy image\n", pattern[i]);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+
+    unlink(STORAGE_PATH);
+    openStorage();
+
+    printf("*** Checking legacy image ***\n");
+    failed = testMigration();
+    printf("*** Checking erased storage ***\n");
+    failed |= testErased();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    settingsFileStorageClose(&storage);
+    unlink(STORAGE_PATH);
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
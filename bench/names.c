@@ -0,0 +1,231 @@
+/******************************************************************************
+    Benchmark of lookup by path name
+
+    Builds a synthetic tree of 10000 parameters: groups of named integer values
+    and of byte tables. Every path name is resolved by settingsResolveName() and
+    by linear search in a name table, reports time per lookup and time of
+    slot table and name index build
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "settings.h"
+#include "settings_private.h"
+
+#if (ENABLE_SLOT_TABLE != 1) || (ENABLE_NAME_INDEX != 1)
+#error "Test requires ENABLE_SLOT_TABLE and ENABLE_NAME_INDEX set to 1"
+#endif
+
+
+// Synthetic tree: GROUP_COUNT x (PARAM_COUNT values + table of TABLE_SIZE bytes)
+#define GROUP_COUNT         50
+#define PARAM_COUNT         100
+#define TABLE_SIZE          100
+#define NAME_COUNT          (GROUP_COUNT * (PARAM_COUNT + TABLE_SIZE))
+#define NAME_LENGTH         32
+
+// Count of measured lookups
+#define BENCH_LOOKUPS       2000000
+#define BENCH_LINEAR        20000
+
+
+typedef struct {
+    char name[NAME_LENGTH];
+    settingsHandle_t handle;        // Handle resolved by arguments
+} nameEntry_t;
+
+extern hNode_t *hRoot;
+
+static char groupNames[GROUP_COUNT][NAME_LENGTH];
+static char paramNames[PARAM_COUNT][NAME_LENGTH];
+static nameEntry_t entries[NAME_COUNT];
+static uint32_t order[NAME_COUNT];
+static volatile uint32_t sink;
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Create tree, its layout and slot table with name index
+// Returns time of slot table build
+static uint64_t initTree(void)
+{
+    nodeInitContext_t ctx;
+    hNode_t *group;
+    uint32_t ramSize, romSize, slotCount;
+    uint32_t i, j;
+    uint64_t start;
+
+    for (i=0; i<PARAM_COUNT; i++)
+        snprintf(paramNames[i], NAME_LENGTH, "param%u", i);
+    hRoot = setName(createHNode(GROUP_COUNT), "root");
+    for (i=0; i<GROUP_COUNT; i++)
+    {
+        snprintf(groupNames[i], NAME_LENGTH, "group%u", i);
+        group = setName(createHNode(PARAM_COUNT + 1), groupNames[i]);
+        for (j=0; j<PARAM_COUNT; j++)
+            addToHList(group, j, setName(u16Node(AccessByAll, RomStored, 0, 60000, j, 0), paramNames[j]));
+        addToHList(group, PARAM_COUNT, setName(createLNode(TABLE_SIZE, u8Node(AccessByAll, RomStored, 0, 255, 0, 0)), "table"));
+        addToHList(hRoot, i, group);
+    }
+
+    ctx.depth = 0;
+    ctx.maxDepth = 0;
+    ctx.maxAllowedDepth = 10;
+    ctx.ramAlign = 1;
+    ctx.ramPadding = 0;
+    initNode((node_t *)hRoot, &ramSize, &romSize, &slotCount, &ctx);
+    hRoot->ramOffset = 0;
+    hRoot->romOffset = ROM_HEADER_SIZE;
+    hRoot->slotOffset = 0;
+    printf("Tree of %u parameters: RAM %u, ROM %u bytes\n", slotCount, ramSize, romSize);
+
+    start = getTimeNs();
+    buildSlotTable(slotCount);
+    return getTimeNs() - start;
+}
+
+
+// Make path names of all parameters and resolve them by arguments
+static void makeNames(void)
+{
+    request_t rq;
+    uint32_t i, j, n = 0;
+
+    memset(&rq, 0, sizeof(rq));
+    for (i=0; i<GROUP_COUNT; i++)
+    {
+        rq.arg[0] = i;
+        for (j=0; j<PARAM_COUNT + TABLE_SIZE; j++, n++)
+        {
+            if (j < PARAM_COUNT)
+            {
+                snprintf(entries[n].name, NAME_LENGTH, "group%u.param%u", i, j);
+                rq.arg[1] = j;
+            }
+            else
+            {
+                snprintf(entries[n].name, NAME_LENGTH, "group%u.table[%u]", i, j - PARAM_COUNT);
+                rq.arg[1] = PARAM_COUNT;
+                rq.arg[2] = j - PARAM_COUNT;
+            }
+            entries[n].handle = settingsResolve(&rq);
+        }
+    }
+    // Lookups are made in random order, so that caches do not favor any method
+    srand(1);
+    for (i=0; i<NAME_COUNT; i++)
+        order[i] = i;
+    for (i=NAME_COUNT-1; i>0; i--)
+    {
+        j = (uint32_t)rand() % (i + 1);
+        n = order[i];
+        order[i] = order[j];
+        order[j] = n;
+    }
+}
+
+
+// Check that every name is resolved to the node of its arguments, and that wrong names are rejected
+static uint8_t checkNames(void)
+{
+    static const char *wrongNames[] = {"group0", "group0.table", "group0.param100", "group50.param0", "group0.table[100]",
+                                       "group0.table[01]", "group0.param1x", "group0param1", "root.group0.param1", "", 0};
+    uint32_t i;
+    uint8_t failed = 0;
+
+    for (i=0; i<NAME_COUNT; i++)
+    {
+        if ((entries[i].handle == SETTINGS_INVALID_HANDLE) || (settingsResolveName(entries[i].name) != entries[i].handle))
+        {
+            printf("%s is not resolved\n", entries[i].name);
+            failed = 1;
+        }
+    }
+    for (i=0; wrongNames[i]; i++)
+    {
+        if (settingsResolveName(wrongNames[i]) != SETTINGS_INVALID_HANDLE)
+        {
+            printf("%s is resolved\n", wrongNames[i]);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+
+// Lookup in a table of names, as made by tools which do not use name index
+static settingsHandle_t findLinear(const char *name)
+{
+    uint32_t i;
+    for (i=0; i<NAME_COUNT; i++)
+    {
+        if (strcmp(entries[i].name, name) == 0)
+            return entries[i].handle;
+    }
+    return SETTINGS_INVALID_HANDLE;
+}
+
+
+static void report(const char *name, uint64_t time, uint32_t count)
+{
+    printf("%-16s %10.1f ns/lookup\n", name, (double)time / count);
+}
+
+
+int main(void)
+{
+    uint64_t start, buildTime;
+    uint32_t i, sum;
+    uint8_t failed;
+
+    printf("*** Init ***\n");
+    buildTime = initTree();
+    printf("Slot table and name index built in %.2f ms\n", (double)buildTime / 1000000.0);
+    makeNames();
+
+    printf("*** Checking ***\n");
+    failed = checkNames();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    printf("*** Lookup of %d names ***\n", NAME_COUNT);
+    sum = 0;
+    start = getTimeNs();
+    for (i=0; i<BENCH_LOOKUPS; i++)
+        sum += settingsResolveName(entries[order[i % NAME_COUNT]].name);
+    report("Name index", getTimeNs() - start, BENCH_LOOKUPS);
+
+    // Unknown names differ from existing ones by the last character only
+    for (i=0; i<NAME_COUNT; i++)
+        strcat(entries[i].name, "x");
+    start = getTimeNs();
+    for (i=0; i<BENCH_LOOKUPS; i++)
+        sum += settingsResolveName(entries[order[i % NAME_COUNT]].name);
+    report("Name index, miss", getTimeNs() - start, BENCH_LOOKUPS);
+    for (i=0; i<NAME_COUNT; i++)
+        entries[i].name[strlen(entries[i].name) - 1] = 0;
+
+    start = getTimeNs();
+    for (i=0; i<BENCH_LINEAR; i++)
+        sum += findLinear(entries[order[i % NAME_COUNT]].name);
+    report("Linear table", getTimeNs() - start, BENCH_LINEAR);
+    sink = sum;
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
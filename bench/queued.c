@@ -0,0 +1,170 @@
+/******************************************************************************
+    Test of queued ROM mode
+
+    Runs on simulated ROM with write latency of SIM_ROM_WRITE_LATENCY_US.
+    Checks that write requests take RAM time only while ROM writer works in
+    background, that settingsWaitIdle() drains the queue, that every range
+    written to ROM is either queued or merged with a pending one, and that
+    values survive reload once the queue is drained
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "settings.h"
+#include "settings_private.h"
+#include "settings_sim.h"
+
+#if (SETTINGS_ROM_WRITE_MODE != ROM_WRITE_QUEUED) || (ROM_WRITER_USE_PTHREAD != 1) || (SIM_ROM_WRITE_LATENCY_US == 0)
+#error "Test requires ROM_WRITE_QUEUED mode with ROM writer thread and SIM_ROM_WRITE_LATENCY_US set"
+#endif
+
+
+// Count of measured write requests
+#define TEST_WRITES         5000
+
+// Count of ROM ranges written by a request: value and CRC of the host node
+#define RANGES_PER_WRITE    2
+
+// Count of C2 elements written by test
+// Written ranges must fit SETTINGS_ROM_QUEUE_SIZE, so that requests never wait for free queue entry
+#define TEST_STRINGS        4
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Writes of C0 and C2 elements return without waiting for ROM device
+static uint8_t testLatency(void)
+{
+    settingsRomQueueStats_t *queue = getRomQueueStats();
+    request_t rq;
+    char str[C2_SIZE];
+    uint64_t start, time, maxTime, totalTime;
+    uint32_t i;
+    uint8_t failed = 0;
+
+    memset(&rq, 0, sizeof(rq));
+    rq.rq = rqWriteNoCb;
+    rq.accLevel = AccessByDev;
+    rq.arg[0] = pGroup_B1;
+    rq.raw = (uint8_t *)str;
+    maxTime = 0;
+    totalTime = 0;
+    for (i=0; i<TEST_WRITES; i++)
+    {
+        memset(str, 0, C2_SIZE);
+        memset(str, 'a' + i % 26, 1 + i % (C2_SIZE - 1));
+        rq.arg[1] = i % TEST_STRINGS;
+        start = getTimeNs();
+        if (i & 1)
+            settingsRequest(&rq);
+        else
+            settings_WriteI32NoCbf(pGroup_B0, b0param_C0, i);
+        time = getTimeNs() - start;
+        totalTime += time;
+        if (time > maxTime)
+            maxTime = time;
+    }
+    printf("Request: %.2f us average, %.2f us max, ROM write latency %u us, %u ranges pending\n",
+           (double)totalTime / 1000.0 / TEST_WRITES, (double)maxTime / 1000.0, SIM_ROM_WRITE_LATENCY_US, queue->depth);
+    // Single requests may be preempted by ROM writer thread, so average time is checked
+    if (totalTime / TEST_WRITES >= (uint64_t)SIM_ROM_WRITE_LATENCY_US * 1000 / 10)
+    {
+        printf("Request waited for ROM device\n");
+        failed = 1;
+    }
+    if (queue->stalls != 0)
+    {
+        printf("Requests stalled on full queue %u times\n", queue->stalls);
+        failed = 1;
+    }
+    return failed;
+}
+
+
+// Queue is empty after settingsWaitIdle(), and statistics match ROM traffic
+static uint8_t testIdle(void)
+{
+    settingsRomQueueStats_t *queue = getRomQueueStats();
+    settingsRomStats_t *stats = getRomStats();
+    uint8_t failed = 0;
+
+    settingsWaitIdle();
+    printf("Ranges: %u enqueued, %u coalesced, %u device writes, max depth %u\n",
+           queue->enqueued, queue->coalesced, queue->written, queue->maxDepth);
+    if (queue->depth != 0)
+    {
+        printf("Queue is not drained\n");
+        failed = 1;
+    }
+    if (queue->enqueued + queue->coalesced != TEST_WRITES * RANGES_PER_WRITE)
+    {
+        printf("Enqueued and coalesced ranges do not add up to %u writes\n", TEST_WRITES * RANGES_PER_WRITE);
+        failed = 1;
+    }
+    // Writer splits ranges into chunks and makes every device write
+    if ((queue->written < queue->enqueued) || (queue->written != stats->writeCalls) || (queue->coalesced == 0))
+    {
+        printf("Device writes do not match queue\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+
+// Drained values survive power loss
+static uint8_t testReload(void)
+{
+    int32_t c0, c1;
+    uint8_t failed = 0;
+
+    c0 = settings_ReadI32(pGroup_B0, b0param_C0);
+    c1 = settings_ReadI32(pGroup_B0, b0param_C1);
+    settingsRomDropCache();
+    if (initSettings(0) != Result_OK)
+    {
+        printf("CRC does not match after reload\n");
+        failed = 1;
+    }
+    if ((settings_ReadI32(pGroup_B0, b0param_C0) != c0) || (settings_ReadI32(pGroup_B0, b0param_C1) != c1))
+    {
+        printf("Reloaded values do not match\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+
+    printf("*** Init ***\n");
+    initSettings(1);
+    memset(getRomQueueStats(), 0, sizeof(settingsRomQueueStats_t));
+    memset(getRomStats(), 0, sizeof(settingsRomStats_t));
+
+    printf("*** Checking ***\n");
+    failed = testLatency();
+    failed |= testIdle();
+    failed |= testReload();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,48 @@
+/******************************************************************************
+    Benchmark of startup restore
+
+    Counts ROM device reads made by initSettings() when the image is restored
+    from ROM. Built with and without ROM_BULK_RESTORE to compare reads per
+    node with bulk transfers of up to SETTINGS_ROM_READ_CHUNK bytes. Calls are
+    counted rather than time: simulated ROM reads take no time, while on a
+    serial EEPROM every call costs an addressing transaction
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "settings_private.h"
+
+
+int main(void)
+{
+    settingsRomStats_t *stats = getRomStats();
+    uint8_t failed = 0;
+
+    printf("*** Init ***\n");
+    initSettings(1);
+
+    // Cache is dropped, so that restore reads ROM device like startup does
+    printf("*** Restore, ROM_BULK_RESTORE = %d ***\n", ROM_BULK_RESTORE);
+    settingsRomDropCache();
+    memset(stats, 0, sizeof(settingsRomStats_t));
+    if (initSettings(0) != Result_OK)
+    {
+        printf("Image is not restored\n");
+        failed = 1;
+    }
+    printf("Device reads: %u calls, %u bytes\n", stats->readCalls, stats->readBytes);
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,418 @@
+/******************************************************************************
+    Benchmark suite on synthetic trees
+
+    Builds a tree of given width, depth and list size, then measures init time,
+    validateNode() time, read and write latency percentiles, CRC throughput and
+    ROM traffic per write. Results may be saved as JSON to track regressions.
+
+    Usage: bench-synthetic [--width W] [--depth D] [--list L] [--ops N] [--json file]
+        width   Children of every hierarchy node, values in every bottom node
+        depth   Count of hierarchy levels, values of the bottom level take depth arguments
+        list    Size of list of 32-bit values in every bottom node, 0 for none
+        ops     Count of measured reads and writes
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "settings.h"
+#include "settings_private.h"
+#include "settings_sim.h"
+
+#if ENABLE_NODE_CONSTRUCTORS != 1
+#error "Synthetic trees require ENABLE_NODE_CONSTRUCTORS set to 1"
+#endif
+
+
+// Size of char values
+#define CHAR_VALUE_SIZE     16
+
+// Maximum of 32-bit values
+#define U32_VALUE_MAX       0x0FFFFFFF
+
+// Count of validateNode() runs
+#define VALIDATE_RUNS       20
+
+// Amount of data processed by CRC benchmark (bytes)
+#define CRC_BLOCK_SIZE      32768
+#define CRC_TOTAL_SIZE      (64 * 1024 * 1024)
+
+
+typedef struct {
+    uint32_t width;
+    uint32_t depth;
+    uint32_t list;
+    uint32_t ops;
+    const char *json;
+} benchConfig_t;
+
+
+// Terminating node reached by the tree walk
+typedef struct {
+    uint32_t arg[SETTINGS_MAX_DEPTH];
+    uint32_t size;
+    uint32_t maxValue;              // 0 for char values
+} leaf_t;
+
+
+// Latency distribution of a request type
+typedef struct {
+    double mean;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t p999;
+    uint32_t max;
+} latency_t;
+
+
+extern hNode_t *hRoot;
+
+static benchConfig_t cfg = {8, 3, 16, 100000, 0};
+static leaf_t *leaves;
+static uint32_t leafCount;
+static uint32_t randomState = 1;
+static volatile uint32_t sink;
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static uint32_t getRandom(void)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+
+static void addLeaf(const uint32_t *path, uint32_t depth, uint32_t size, uint32_t maxValue)
+{
+    leaf_t *leaf = &leaves[leafCount++];
+    memset(leaf, 0, sizeof(leaf_t));
+    memcpy(leaf->arg, path, depth * sizeof(uint32_t));
+    leaf->size = size;
+    leaf->maxValue = maxValue;
+}
+
+
+// Bottom node values cycle through all types
+static sNode_t *createValue(uint32_t index, const uint32_t *path, uint32_t depth)
+{
+    static const char dflt[CHAR_VALUE_SIZE] = "Synthetic";
+    switch (index % 4)
+    {
+        case 0:
+            addLeaf(path, depth, 1, 0xFF);
+            return u8Node(AccessByAll, RomStored, 0, 0xFF, index & 0xFF, 0);
+        case 1:
+            addLeaf(path, depth, 2, 0xFFFF);
+            return u16Node(AccessByAll, RomStored, 0, 0xFFFF, index, 0);
+        case 2:
+            addLeaf(path, depth, 4, U32_VALUE_MAX);
+            return u32Node(AccessByAll, RomStored, 0, U32_VALUE_MAX, index, 0);
+        default:
+            addLeaf(path, depth, CHAR_VALUE_SIZE, 0);
+            return charNode(AccessByAll, RomStored, CHAR_VALUE_SIZE, dflt, 0);
+    }
+}
+
+
+// Create hierarchy node of given level (root is level 1) with all its children
+static hNode_t *createGroup(uint32_t level, uint32_t *path)
+{
+    hNode_t *node;
+    uint32_t i;
+    uint8_t bottom = (level == cfg.depth);
+
+    node = createHNode(cfg.width + ((bottom && cfg.list) ? 1 : 0));
+    for (i=0; i<cfg.width; i++)
+    {
+        path[level - 1] = i;
+        if (bottom)
+            addToHList(node, i, createValue(i, path, level));
+        else
+            addToHList(node, i, createGroup(level + 1, path));
+    }
+    if (bottom && cfg.list)
+    {
+        path[level - 1] = cfg.width;
+        addToHList(node, cfg.width, createLNode(cfg.list, u32Node(AccessByAll, RomStored, 0, U32_VALUE_MAX, 0, 0)));
+        for (i=0; i<cfg.list; i++)
+        {
+            path[level] = i;
+            addLeaf(path, level + 1, 4, U32_VALUE_MAX);
+        }
+    }
+    return node;
+}
+
+
+// Check tree shape against module limits and create the tree
+// Returns 0 if the tree can not be created
+static uint8_t createTree(uint32_t *ramSize, uint32_t *romSize)
+{
+    uint32_t path[SETTINGS_MAX_DEPTH];
+    nodeInitContext_t ctx;
+    uint32_t slotCount;
+    uint64_t count = 1;
+    uint32_t i;
+
+    // Tree walk takes at most SETTINGS_MAX_DEPTH - 1 arguments
+    if ((cfg.width == 0) || (cfg.width > 0xFFFE) || (cfg.depth == 0) || (cfg.list > 0xFFFF) ||
+        (cfg.depth + (cfg.list ? 1 : 0) > SETTINGS_MAX_DEPTH - 1))
+    {
+        printf("Tree shape is not supported\n");
+        return 0;
+    }
+    for (i=1; (i<cfg.depth) && (count <= SETTINGS_SLOT_TABLE_SIZE); i++)
+        count *= cfg.width;
+    count *= cfg.width + cfg.list;
+    if (count > SETTINGS_SLOT_TABLE_SIZE)
+    {
+        printf("Tree has more than %d values (SETTINGS_SLOT_TABLE_SIZE)\n", SETTINGS_SLOT_TABLE_SIZE);
+        return 0;
+    }
+
+    leaves = (leaf_t *)malloc((size_t)count * sizeof(leaf_t));
+    leafCount = 0;
+    hRoot = createGroup(1, path);
+
+    ctx.depth = 0;
+    ctx.maxDepth = 0;
+    ctx.maxAllowedDepth = 10;
+    ctx.ramAlign = 1;
+    ctx.ramPadding = 0;
+    initNode((node_t *)hRoot, ramSize, romSize, &slotCount, &ctx);
+    if ((*ramSize > SETTINGS_RAM_SIZE) || (ROM_HEADER_SIZE + *romSize > ROM_IMAGE_LIMIT))
+    {
+        printf("Tree takes %u RAM and %u ROM bytes, SETTINGS_RAM_SIZE or SETTINGS_ROM_SIZE is too small\n", *ramSize, *romSize);
+        return 0;
+    }
+    return 1;
+}
+
+
+static int compareSamples(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+static latency_t getLatency(uint32_t *samples, uint32_t count)
+{
+    latency_t latency;
+    uint64_t sum = 0;
+    uint32_t i;
+    qsort(samples, count, sizeof(uint32_t), compareSamples);
+    for (i=0; i<count; i++)
+        sum += samples[i];
+    latency.mean = (double)sum / count;
+    latency.p50 = samples[(uint64_t)count * 500 / 1000];
+    latency.p90 = samples[(uint64_t)count * 900 / 1000];
+    latency.p99 = samples[(uint64_t)count * 990 / 1000];
+    latency.p999 = samples[(uint64_t)count * 999 / 1000];
+    latency.max = samples[count - 1];
+    return latency;
+}
+
+
+// Make request for a random value, time of every request is stored to samples
+static void runRequests(rqType rqt, uint32_t *samples)
+{
+    char str[CHAR_VALUE_SIZE];
+    request_t rq;
+    leaf_t *leaf;
+    int32_t value;
+    uint64_t start;
+    uint32_t i;
+
+    memset(&rq, 0, sizeof(rq));
+    rq.rq = rqt;
+    rq.accLevel = AccessByAll;
+    for (i=0; i<cfg.ops; i++)
+    {
+        leaf = &leaves[getRandom() % leafCount];
+        memcpy(rq.arg, leaf->arg, sizeof(rq.arg));
+        if (leaf->maxValue)
+        {
+            value = (int32_t)(i % (leaf->maxValue + 1));
+            rq.val.i32 = &value;
+            rq.raw = 0;
+        }
+        else
+        {
+            memset(str, 0, CHAR_VALUE_SIZE);
+            snprintf(str, CHAR_VALUE_SIZE, "W%u", i);
+            rq.raw = (uint8_t *)str;
+        }
+        start = getTimeNs();
+        settingsRequest(&rq);
+        samples[i] = (uint32_t)(getTimeNs() - start);
+    }
+}
+
+
+static void printLatency(FILE *f, const char *name, latency_t *latency)
+{
+    fprintf(f, "  \"%s\": {\"meanNs\": %.1f, \"p50Ns\": %u, \"p90Ns\": %u, \"p99Ns\": %u, \"p999Ns\": %u, \"maxNs\": %u},\n",
+            name, latency->mean, latency->p50, latency->p90, latency->p99, latency->p999, latency->max);
+}
+
+
+static uint8_t parseArgs(int argc, char **argv)
+{
+    int i;
+    for (i=1; i<argc; i++)
+    {
+        if ((strcmp(argv[i], "--json") == 0) && (i + 1 < argc))
+            cfg.json = argv[++i];
+        else if ((strcmp(argv[i], "--width") == 0) && (i + 1 < argc))
+            cfg.width = (uint32_t)strtoul(argv[++i], 0, 0);
+        else if ((strcmp(argv[i], "--depth") == 0) && (i + 1 < argc))
+            cfg.depth = (uint32_t)strtoul(argv[++i], 0, 0);
+        else if ((strcmp(argv[i], "--list") == 0) && (i + 1 < argc))
+            cfg.list = (uint32_t)strtoul(argv[++i], 0, 0);
+        else if ((strcmp(argv[i], "--ops") == 0) && (i + 1 < argc))
+            cfg.ops = (uint32_t)strtoul(argv[++i], 0, 0);
+        else
+            return 0;
+    }
+    return (cfg.ops != 0);
+}
+
+
+int main(int argc, char **argv)
+{
+    static uint8_t crcBlock[CRC_BLOCK_SIZE];
+    settingsRomStats_t *romStats = getRomStats();
+    simFlashStats_t *flashStats = simGetFlashStats();
+    uint32_t *samples;
+    uint32_t ramSize, romSize, i;
+    uint32_t initWriteBytes, writeBytes, writeCalls, programBytes;
+    uint64_t start, initDefaultsNs, initRestoreNs, validateNs, crcNs, timerNs;
+    latency_t readLatency, writeLatency;
+    uint16_t crc;
+    FILE *f;
+
+    if (!parseArgs(argc, argv))
+    {
+        printf("Usage: %s [--width W] [--depth D] [--list L] [--ops N] [--json file]\n", argv[0]);
+        return 1;
+    }
+    if (!createTree(&ramSize, &romSize))
+        return 1;
+    printf("*** Tree: width %u, depth %u, list %u, %u values, RAM %u, ROM %u bytes ***\n",
+           cfg.width, cfg.depth, cfg.list, leafCount, ramSize, romSize);
+
+    // Empty ROM, defaults are restored and written
+    memset(romStats, 0, sizeof(settingsRomStats_t));
+    start = getTimeNs();
+    initSettings(0);
+    initDefaultsNs = getTimeNs() - start;
+    initWriteBytes = romStats->writeBytes;
+
+    start = getTimeNs();
+    initSettings(0);
+    initRestoreNs = getTimeNs() - start;
+
+    // Image is loaded untimed, so that only validation is measured
+    validateNs = 0;
+    for (i=0; i<VALIDATE_RUNS; i++)
+    {
+        settingsLoadImage(romSize);
+        start = getTimeNs();
+        validateNode((node_t *)hRoot, hRoot->ramOffset, hRoot->romOffset, RESTORE_FROM_RAM);
+        validateNs += getTimeNs() - start;
+    }
+    validateNs /= VALIDATE_RUNS;
+    printf("Init: %.1f us with defaults, %.1f us restored from ROM, validateNode() %.1f us\n",
+           initDefaultsNs / 1000.0, initRestoreNs / 1000.0, validateNs / 1000.0);
+
+    // Latency samples include one clock read
+    start = getTimeNs();
+    for (i=0; i<1000; i++)
+        sink += (uint32_t)getTimeNs();
+    timerNs = (getTimeNs() - start) / 1000;
+
+    samples = (uint32_t *)malloc((size_t)cfg.ops * sizeof(uint32_t));
+    runRequests(rqRead, samples);
+    readLatency = getLatency(samples, cfg.ops);
+
+    memset(romStats, 0, sizeof(settingsRomStats_t));
+    memset(flashStats, 0, sizeof(simFlashStats_t));
+    runRequests(rqWriteNoCb, samples);
+    writeLatency = getLatency(samples, cfg.ops);
+    // Cached writes are counted when they reach the device
+    settingsFlushDirty(SETTINGS_FLUSH_ALL);
+    settingsWaitIdle();
+    writeBytes = romStats->writeBytes;
+    writeCalls = romStats->writeCalls;
+    programBytes = flashStats->programBytes;
+    free(samples);
+
+    printf("Read:  mean %.1f ns, p50 %u, p90 %u, p99 %u, p99.9 %u, max %u ns\n", readLatency.mean,
+           readLatency.p50, readLatency.p90, readLatency.p99, readLatency.p999, readLatency.max);
+    printf("Write: mean %.1f ns, p50 %u, p90 %u, p99 %u, p99.9 %u, max %u ns\n", writeLatency.mean,
+           writeLatency.p50, writeLatency.p90, writeLatency.p99, writeLatency.p999, writeLatency.max);
+    printf("ROM per write: %.1f bytes in %.2f device writes, %.1f flash bytes programmed\n",
+           (double)writeBytes / cfg.ops, (double)writeCalls / cfg.ops, (double)programBytes / cfg.ops);
+
+    for (i=0; i<CRC_BLOCK_SIZE; i++)
+        crcBlock[i] = (uint8_t)getRandom();
+    crc = NODE_CRC_SEED;
+    start = getTimeNs();
+    for (i=0; i<CRC_TOTAL_SIZE / CRC_BLOCK_SIZE; i++)
+        crc = getCRC16(crcBlock, CRC_BLOCK_SIZE, crc);
+    crcNs = getTimeNs() - start;
+    sink += crc;
+    printf("CRC16: %.1f MB/s\n", (double)CRC_TOTAL_SIZE * 1000.0 / crcNs);
+
+    if (cfg.json == 0)
+        return 0;
+    f = fopen(cfg.json, "w");
+    if (f == 0)
+    {
+        printf("%s can not be written\n", cfg.json);
+        return 1;
+    }
+    fprintf(f, "{\n");
+    fprintf(f, "  \"tree\": {\"width\": %u, \"depth\": %u, \"list\": %u, \"values\": %u, \"ramBytes\": %u, \"romBytes\": %u},\n",
+            cfg.width, cfg.depth, cfg.list, leafCount, ramSize, romSize);
+    fprintf(f, "  \"config\": {\"romWriteMode\": %d, \"romBackend\": %d, \"romDualBank\": %d, \"ramLayout\": %d, \"ramNativeEndian\": %d, "
+            "\"concurrentReaders\": %d, \"incrementalCrc\": %d, \"crcSliceCount\": %d},\n",
+            SETTINGS_ROM_WRITE_MODE, SETTINGS_ROM_BACKEND, ROM_DUAL_BANK, SETTINGS_RAM_LAYOUT, SETTINGS_RAM_NATIVE_ENDIAN,
+            SETTINGS_CONCURRENT_READERS, USE_INCREMENTAL_CRC, CRC16_SLICE_COUNT);
+    fprintf(f, "  \"init\": {\"defaultsUs\": %.1f, \"restoreUs\": %.1f, \"validateUs\": %.1f, \"romWriteBytes\": %u},\n",
+            initDefaultsNs / 1000.0, initRestoreNs / 1000.0, validateNs / 1000.0, initWriteBytes);
+    fprintf(f, "  \"ops\": %u,\n", cfg.ops);
+    fprintf(f, "  \"timerOverheadNs\": %u,\n", (uint32_t)timerNs);
+    printLatency(f, "read", &readLatency);
+    fprintf(f, "  \"writeRom\": {\"bytesPerOp\": %.2f, \"callsPerOp\": %.3f, \"flashProgramBytesPerOp\": %.1f},\n",
+            (double)writeBytes / cfg.ops, (double)writeCalls / cfg.ops, (double)programBytes / cfg.ops);
+    printLatency(f, "write", &writeLatency);
+    fprintf(f, "  \"crc16MBps\": %.1f\n", (double)CRC_TOTAL_SIZE * 1000.0 / crcNs);
+    fprintf(f, "}\n");
+    fclose(f);
+    printf("Results saved to %s\n", cfg.json);
+    return 0;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,383 @@
+/******************************************************************************
+    Test and benchmark of signed, 64-bit and floating point values
+
+    Checks defaults, raw form, limits and change callbacks of i8, i16, i32, u64,
+    i64, f32 and f64 nodes, negative values passed by settings_ReadI32() and
+    settings_WriteI32(), staging of 64-bit values by a transaction, and reload
+    of all values from ROM. Reports cost of reading a calibration table of
+    floats against a table of integers scaled to fixed point
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "settings.h"
+#include "settings_private.h"
+
+#if (ENABLE_SLOT_TABLE != 1) || (ENABLE_NODE_CONSTRUCTORS != 1) || (ENABLE_TRANSACTIONS != 1)
+#error "Test requires ENABLE_SLOT_TABLE, ENABLE_NODE_CONSTRUCTORS and ENABLE_TRANSACTIONS set to 1"
+#endif
+
+
+// Group of values of every type
+#define TYPED_GROUP         0
+enum {
+    param_i8,
+    param_i16,
+    param_i32,
+    param_u64,
+    param_i64,
+    param_f32,
+    param_f64,
+    param_u32,
+    PARAM_COUNT
+};
+
+// Calibration tables of CAL_SIZE coefficients: floats and integers scaled by CAL_SCALE
+#define CAL_F32_GROUP       1
+#define CAL_I32_GROUP       2
+#define CAL_SIZE            256
+#define CAL_SCALE           1000000
+
+// Count of measured coefficient reads
+#define BENCH_READS         20000000
+
+
+extern hNode_t *hRoot;
+
+static settingsHandle_t handles[PARAM_COUNT];
+static settingsHandle_t calF32[CAL_SIZE];
+static settingsHandle_t calI32[CAL_SIZE];
+static float lastF32;
+static double lastF64;
+static uint32_t f32Changes, f64Changes;
+static volatile float sink;
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void onF32Changed(rqType rq, const requestContext_t *ctx)
+{
+    (void)rq;
+    lastF32 = ctx->value.f32;
+    f32Changes++;
+}
+
+
+static void onF64Changed(rqType rq, uint32_t lastArg)
+{
+    (void)rq;
+    (void)lastArg;
+    lastF64 = getCallbackCache()->f64;
+    f64Changes++;
+}
+
+
+static void createTree(void)
+{
+    hNode_t *group;
+    hRoot = createHNode(3);
+    group = createHNode(PARAM_COUNT);
+    addToHList(group, param_i8, i8Node(AccessByAll, RomStored, -100, 100, -5, 0));
+    addToHList(group, param_i16, i16Node(AccessByAll, RomStored, -30000, 30000, -1234, 0));
+    addToHList(group, param_i32, i32Node(AccessByAll, RomStored, INT32_MIN, 2000000000, -70000, 0));
+    addToHList(group, param_u64, u64Node(AccessByAll, RomStored, 1000, 1000000000000000000ULL, 12345678901234ULL, 0));
+    addToHList(group, param_i64, i64Node(AccessByAll, RomStored, -1000000000000000LL, 1000000000000000LL, -12345678901234LL, 0));
+    addToHList(group, param_f32, setChangeCallbackCtx(f32Node(AccessByAll, RomStored, -1.5f, 1000.0f, 0.25f, 0), onF32Changed));
+    addToHList(group, param_f64, f64Node(AccessByAll, RomStored, -1e300, 1e300, 3.141592653589793, onF64Changed));
+    addToHList(group, param_u32, u32Node(AccessByAll, RomStored, 0, 4000000000U, 3000000000U, 0));
+    addToHList(hRoot, TYPED_GROUP, group);
+    addToHList(hRoot, CAL_F32_GROUP, createLNode(CAL_SIZE, f32Node(AccessByAll, RomStored, -10.0f, 10.0f, 1.0f, 0)));
+    addToHList(hRoot, CAL_I32_GROUP, createLNode(CAL_SIZE, i32Node(AccessByAll, RomStored, -10 * CAL_SCALE, 10 * CAL_SCALE, CAL_SCALE, 0)));
+}
+
+
+static void resolveHandles(void)
+{
+    request_t rq;
+    uint32_t i;
+    memset(&rq, 0, sizeof(rq));
+    rq.arg[0] = TYPED_GROUP;
+    for (i=0; i<PARAM_COUNT; i++)
+    {
+        rq.arg[1] = i;
+        handles[i] = settingsResolve(&rq);
+    }
+    for (i=0; i<CAL_SIZE; i++)
+    {
+        rq.arg[1] = i;
+        rq.arg[0] = CAL_F32_GROUP;
+        calF32[i] = settingsResolve(&rq);
+        rq.arg[0] = CAL_I32_GROUP;
+        calI32[i] = settingsResolve(&rq);
+    }
+}
+
+
+// Make a request of given type, value is passed by pointer to its native type or in raw form
+static resultType request(rqType type, uint32_t param, void *value, uint8_t *raw)
+{
+    request_t rq;
+    memset(&rq, 0, sizeof(rq));
+    rq.rq = type;
+    rq.accLevel = AccessByDev;
+    rq.arg[0] = TYPED_GROUP;
+    rq.arg[1] = param;
+    rq.val.u64 = (uint64_t *)value;
+    rq.raw = raw;
+    return settingsRequest(&rq);
+}
+
+
+static uint8_t checkRaw(uint32_t param, const uint8_t *expected, uint32_t size)
+{
+    uint8_t raw[8];
+    request(rqRead, param, 0, raw);
+    if (memcmp(raw, expected, size) != 0)
+    {
+        printf("Raw form of parameter %u does not match\n", param);
+        return 1;
+    }
+    return 0;
+}
+
+
+static uint8_t testDefaults(void)
+{
+    static const uint8_t rawI16[2] = {0xFB, 0x2E};
+    static const uint8_t rawU64[8] = {0x00, 0x00, 0x0B, 0x3A, 0x73, 0xCE, 0x2F, 0xF2};
+    static const uint8_t rawF32[4] = {0x3E, 0x80, 0x00, 0x00};
+    static const uint8_t rawF64[8] = {0x40, 0x09, 0x21, 0xFB, 0x54, 0x44, 0x2D, 0x18};
+    int32_t i32;
+    uint64_t u64;
+    int64_t i64;
+    float f32;
+    double f64;
+    uint8_t failed = 0;
+
+    request(rqRead, param_i8, &i32, 0);
+    failed |= (i32 != -5);
+    request(rqRead, param_i16, &i32, 0);
+    failed |= (i32 != -1234);
+    request(rqRead, param_i32, &i32, 0);
+    failed |= (i32 != -70000);
+    request(rqRead, param_u64, &u64, 0);
+    failed |= (u64 != 12345678901234ULL);
+    request(rqRead, param_i64, &i64, 0);
+    failed |= (i64 != -12345678901234LL);
+    request(rqRead, param_f32, &f32, 0);
+    failed |= (f32 != 0.25f);
+    request(rqRead, param_f64, &f64, 0);
+    failed |= (f64 != 3.141592653589793);
+    request(rqRead, param_u32, &i32, 0);
+    failed |= ((uint32_t)i32 != 3000000000U);
+    if (failed)
+        printf("Default values do not match\n");
+
+    // Raw form is MSB first
+    failed |= checkRaw(param_i16, rawI16, 2);
+    failed |= checkRaw(param_u64, rawU64, 8);
+    failed |= checkRaw(param_f32, rawF32, 4);
+    failed |= checkRaw(param_f64, rawF64, 8);
+    return failed;
+}
+
+
+// Every value is checked against its own limits
+static uint8_t testLimits(void)
+{
+    int32_t i32;
+    uint64_t u64;
+    int64_t i64;
+    float f32;
+    double f64;
+    uint8_t failed = 0;
+
+    i32 = -101;
+    failed |= (request(rqValidate, param_i8, &i32, 0) != Result_ValidateError);
+    i32 = -100;
+    failed |= (request(rqValidate, param_i8, &i32, 0) != Result_OK);
+    request(rqGetMin, param_i8, &i32, 0);
+    failed |= (i32 != -100);
+    i32 = 30001;
+    failed |= (request(rqValidate, param_i16, &i32, 0) != Result_ValidateError);
+    i32 = INT32_MIN;
+    failed |= (request(rqValidate, param_i32, &i32, 0) != Result_OK);
+    i32 = (int32_t)3000000000U;
+    failed |= (request(rqValidate, param_u32, &i32, 0) != Result_OK);
+    u64 = 999;
+    failed |= (request(rqValidate, param_u64, &u64, 0) != Result_ValidateError);
+    request(rqGetMax, param_u64, &u64, 0);
+    failed |= (u64 != 1000000000000000000ULL);
+    i64 = -1000000000000001LL;
+    failed |= (request(rqValidate, param_i64, &i64, 0) != Result_ValidateError);
+    f32 = 1000.5f;
+    failed |= (request(rqValidate, param_f32, &f32, 0) != Result_ValidateError);
+    f32 = NAN;
+    failed |= (request(rqValidate, param_f32, &f32, 0) != Result_ValidateError);
+    f32 = -1.5f;
+    failed |= (request(rqValidate, param_f32, &f32, 0) != Result_OK);
+    f64 = INFINITY;
+    failed |= (request(rqValidate, param_f64, &f64, 0) != Result_ValidateError);
+    if (failed)
+        printf("Limits are not checked\n");
+    return failed;
+}
+
+
+static uint8_t testWrites(void)
+{
+    static const uint8_t rawI64[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE};
+    uint64_t u64;
+    int64_t i64;
+    float f32;
+    double f64;
+    uint8_t failed = 0;
+
+    // Negative values are passed by 32-bit aliases
+    settings_WriteI32(TYPED_GROUP, param_i8, -100);
+    settings_WriteI32(TYPED_GROUP, param_i16, -30000);
+    settings_WriteI32(TYPED_GROUP, param_i32, INT32_MIN);
+    if ((settings_ReadI32(TYPED_GROUP, param_i8) != -100) || (settings_ReadI32ByHandle(handles[param_i8]) != -100) ||
+        (settings_ReadI32(TYPED_GROUP, param_i16) != -30000) || (settings_ReadI32ByHandle(handles[param_i32]) != INT32_MIN))
+    {
+        printf("Negative values do not match\n");
+        failed = 1;
+    }
+
+    // New value is passed to change callbacks
+    f32 = -1.25f;
+    request(rqWrite, param_f32, &f32, 0);
+    f64 = -2.5e100;
+    request(rqWrite, param_f64, &f64, 0);
+    if ((f32Changes != 1) || (lastF32 != -1.25f) || (f64Changes != 1) || (lastF64 != -2.5e100) ||
+        (settings_ReadF32ByHandle(handles[param_f32]) != -1.25f))
+    {
+        printf("Change callbacks do not match\n");
+        failed = 1;
+    }
+
+    // 64-bit values are kept by transaction until commit
+    settingsBegin();
+    u64 = 1000000000000000000ULL;
+    request(rqWriteNoCb, param_u64, &u64, 0);
+    request(rqWriteNoCb, param_i64, 0, (uint8_t *)rawI64);
+    u64 = 0;
+    settingsCommit();
+    request(rqRead, param_u64, &u64, 0);
+    request(rqRead, param_i64, &i64, 0);
+    if ((u64 != 1000000000000000000ULL) || (i64 != -2))
+    {
+        printf("Transaction values do not match\n");
+        failed = 1;
+    }
+    settingsRequestByHandle(calF32[10], &(request_t){.rq = rqWriteNoCb, .val.f32 = &(float){-0.5f}});
+    return failed;
+}
+
+
+// Values are reloaded from ROM
+static uint8_t testReload(void)
+{
+    uint64_t u64;
+    int64_t i64;
+    double f64;
+    uint8_t failed = 0;
+
+    flushSettingsToRom();
+    initSettings(0);
+    request(rqRead, param_u64, &u64, 0);
+    request(rqRead, param_i64, &i64, 0);
+    request(rqRead, param_f64, &f64, 0);
+    if ((settings_ReadI32(TYPED_GROUP, param_i8) != -100) || (settings_ReadI32(TYPED_GROUP, param_i32) != INT32_MIN) ||
+        (u64 != 1000000000000000000ULL) || (i64 != -2) || (f64 != -2.5e100) ||
+        (settings_ReadF32ByHandle(handles[param_f32]) != -1.25f) || (settings_ReadF32ByHandle(calF32[10]) != -0.5f))
+    {
+        printf("Reloaded values do not match\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+
+// Calibration of samples by a table of coefficients
+static void benchmark(void)
+{
+    request_t rq;
+    uint64_t start;
+    float sum, coef;
+    int32_t scaled;
+    uint32_t i;
+
+    sum = 0;
+    start = getTimeNs();
+    for (i=0; i<BENCH_READS; i++)
+        sum += (float)i * settings_ReadF32ByHandle(calF32[i % CAL_SIZE]);
+    printf("Float table:            %6.2f ns/coefficient\n", (double)(getTimeNs() - start) / BENCH_READS);
+
+    start = getTimeNs();
+    for (i=0; i<BENCH_READS; i++)
+        sum += (float)i * ((float)settings_ReadI32ByHandle(calI32[i % CAL_SIZE]) * (1.0f / CAL_SCALE));
+    printf("Scaled integer table:   %6.2f ns/coefficient\n", (double)(getTimeNs() - start) / BENCH_READS);
+
+    memset(&rq, 0, sizeof(rq));
+    rq.rq = rqRead;
+    rq.val.f32 = &coef;
+    start = getTimeNs();
+    for (i=0; i<BENCH_READS; i++)
+    {
+        settingsRequestByHandle(calF32[i % CAL_SIZE], &rq);
+        sum += (float)i * coef;
+    }
+    printf("Float by request:       %6.2f ns/coefficient\n", (double)(getTimeNs() - start) / BENCH_READS);
+
+    rq.val.i32 = &scaled;
+    start = getTimeNs();
+    for (i=0; i<BENCH_READS; i++)
+    {
+        settingsRequestByHandle(calI32[i % CAL_SIZE], &rq);
+        sum += (float)i * ((float)scaled * (1.0f / CAL_SCALE));
+    }
+    printf("Scaled by request:      %6.2f ns/coefficient\n", (double)(getTimeNs() - start) / BENCH_READS);
+    sink = sum;
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+
+    printf("*** Init ***\n");
+    createTree();
+    initSettings(1);
+    resolveHandles();
+
+    printf("*** Checking ***\n");
+    failed = testDefaults();
+    failed |= testLimits();
+    failed |= testWrites();
+    failed |= testReload();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+
+    printf("*** Cost of calibration table ***\n");
+    benchmark();
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,194 @@
+/******************************************************************************
+    Test of write-back ROM mode
+
+    Checks that changes are collected in ROM cache and do not reach ROM
+    device until settingsFlushDirty() is called: writes only mark pages dirty,
+    rewriting the same values does not add dirty pages, and dirty pages are
+    lost on power loss. Then checks that a limited flush writes at most the
+    given count of pages and returns count of pages left, and that values
+    survive reload once all pages are flushed
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "settings_private.h"
+
+#if (SETTINGS_ROM_WRITE_MODE != ROM_WRITE_BACK) || (ROM_DUAL_BANK != 0)
+#error "Test requires ROM_WRITE_BACK mode without ROM_DUAL_BANK"
+#endif
+
+
+// Maximum count of pages written by one call of settingsFlushDirty()
+#define FLUSH_STEP          2
+
+// Default values of the testbench tree
+#define C0_DEFAULT          12345
+#define C2_DEFAULT          "Default text"
+
+
+// Write C0, C1 and all C2 elements with values derived from a letter
+static void writeAll(char letter)
+{
+    request_t rq;
+    char str[C2_SIZE];
+    uint32_t i;
+
+    settings_WriteI32NoCbf(pGroup_B0, b0param_C0, letter * 100);
+    settings_WriteI32NoCbf(pGroup_B0, b0param_C1, letter - 'a');
+    memset(&rq, 0, sizeof(rq));
+    rq.rq = rqWriteNoCb;
+    rq.accLevel = AccessByDev;
+    rq.arg[0] = pGroup_B1;
+    rq.raw = (uint8_t *)str;
+    for (i=0; i<C2_NODES_COUNT; i++)
+    {
+        memset(str, 0, C2_SIZE);
+        memset(str, letter, 1 + i % (C2_SIZE - 1));
+        rq.arg[1] = i;
+        settingsRequest(&rq);
+    }
+}
+
+
+// Check values written by writeAll()
+static uint8_t checkAll(char letter)
+{
+    char str[C2_SIZE];
+    uint32_t i;
+
+    if ((settings_ReadI32(pGroup_B0, b0param_C0) != letter * 100) || (settings_ReadI32(pGroup_B0, b0param_C1) != letter - 'a'))
+        return 1;
+    for (i=0; i<C2_NODES_COUNT; i++)
+    {
+        settings_ReadStr(pGroup_B1, i, str);
+        if ((strlen(str) != 1 + i % (C2_SIZE - 1)) || (str[0] != letter))
+            return 1;
+    }
+    return 0;
+}
+
+
+// Writes mark pages dirty and do not access device
+static uint8_t testDeferred(void)
+{
+    settingsRomStats_t *stats = getRomStats();
+    char str[C2_SIZE];
+    uint32_t dirty;
+    uint8_t failed = 0;
+
+    initSettings(1);
+    if (settingsFlushDirty(0) != 0)
+    {
+        printf("Pages are dirty after init\n");
+        failed = 1;
+    }
+    memset(stats, 0, sizeof(settingsRomStats_t));
+    writeAll('a');
+    dirty = settingsFlushDirty(0);
+    printf("Values written, %u dirty pages of %u bytes\n", dirty, SETTINGS_ROM_PAGE_SIZE);
+    if ((stats->writeCalls != 0) || (dirty == 0))
+    {
+        printf("Writes are not collected in cache: %u device writes, %u dirty pages\n", stats->writeCalls, dirty);
+        failed = 1;
+    }
+
+    // The same pages are changed again
+    writeAll('b');
+    if ((stats->writeCalls != 0) || (settingsFlushDirty(0) != dirty))
+    {
+        printf("Rewrite of the same values changed count of dirty pages\n");
+        failed = 1;
+    }
+
+    // Device still keeps defaults saved by init
+    settingsRomDropCache();
+    initSettings(0);
+    settings_ReadStr(pGroup_B1, 0, str);
+    if ((settings_ReadI32(pGroup_B0, b0param_C0) != C0_DEFAULT) || (strcmp(str, C2_DEFAULT) != 0))
+    {
+        printf("Values reached ROM without flush\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+
+// Limited flush writes at most FLUSH_STEP pages per call
+static uint8_t testPartialFlush(void)
+{
+    settingsRomStats_t *stats = getRomStats();
+    uint32_t dirty, left, written, total, calls;
+    uint8_t failed = 0;
+
+    writeAll('c');
+    dirty = settingsFlushDirty(0);
+    memset(stats, 0, sizeof(settingsRomStats_t));
+    total = 0;
+    calls = 0;
+    while ((dirty != 0) && !failed)
+    {
+        written = stats->writeBytes;
+        left = settingsFlushDirty(FLUSH_STEP);
+        written = (stats->writeBytes - written) / SETTINGS_ROM_PAGE_SIZE;
+        if ((written == 0) || (written > FLUSH_STEP) || (dirty - left != written))
+        {
+            printf("Flush of %u pages wrote %u pages, %u of %u pages left\n", FLUSH_STEP, written, left, dirty);
+            failed = 1;
+        }
+        total += written;
+        dirty = left;
+        calls++;
+    }
+    printf("Flushed %u pages by %u calls, %u device writes\n", total, calls, stats->writeCalls);
+    if (dirty != 0)
+    {
+        printf("Dirty pages are not flushed\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+
+// Flushed values survive power loss
+static uint8_t testReload(void)
+{
+    uint8_t failed = 0;
+
+    settingsRomDropCache();
+    if (initSettings(0) != Result_OK)
+    {
+        printf("CRC does not match after reload\n");
+        failed = 1;
+    }
+    if (checkAll('c'))
+    {
+        printf("Reloaded values do not match\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+
+    printf("*** Checking ***\n");
+    failed = testDeferred();
+    failed |= testPartialFlush();
+    failed |= testReload();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,203 @@
+/******************************************************************************
+    Power loss test for transactions
+
+    A transaction which changes C0, C1 and one of C2 strings is committed, and power
+    is cut after every possible count of bytes written to ROM. After restart either
+    all old or all new values must be restored, and ROM image must be valid.
+    The same changes made by separate requests are checked for comparison.
+    With ROM_DUAL_BANK both ways must be atomic, and the restored bank must be
+    verified by its CRC and have generation of the restored values
+    Settings module must be built with simulated ROM driver (__NOROM__)
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "settings_private.h"
+#include "settings_sim.h"
+
+#if ENABLE_TRANSACTIONS != 1
+#error "Power loss test requires ENABLE_TRANSACTIONS set to 1"
+#endif
+
+
+// Index of C2 string changed by test
+#define TEST_STR_INDEX              3
+
+
+typedef struct {
+    int32_t c0;
+    int32_t c1;
+    char str[C2_SIZE];
+} testValues_t;
+
+typedef enum {
+    StateOld,
+    StateNew,
+    StateMixed,
+    StateDefaults
+} restoredState;
+
+typedef struct {
+    uint32_t count[StateDefaults + 1];
+    uint32_t bankErrors;            // Restarts with unverified bank or wrong generation
+} testStats_t;
+
+static const testValues_t oldValues = {100, 10, "Old text"};
+static const testValues_t newValues = {200, 20, "New text"};
+
+
+static void writeValues(const testValues_t *values)
+{
+    request_t rq;
+    char str[C2_SIZE];
+    settings_WriteI32NoCbf(pGroup_B0, b0param_C0, values->c0);
+    settings_WriteI32NoCbf(pGroup_B0, b0param_C1, values->c1);
+    memcpy(str, values->str, C2_SIZE);
+    rq.rq = rqWriteNoCb;
+    rq.arg[0] = pGroup_B1;
+    rq.arg[1] = TEST_STR_INDEX;
+    rq.raw = (uint8_t *)str;
+    settingsRequest(&rq);
+}
+
+
+static void readValues(testValues_t *values)
+{
+    values->c0 = settings_ReadI32(pGroup_B0, b0param_C0);
+    values->c1 = settings_ReadI32(pGroup_B0, b0param_C1);
+    settings_ReadStr(pGroup_B1, TEST_STR_INDEX, values->str);
+}
+
+
+static uint8_t isEqual(const testValues_t *a, const testValues_t *b)
+{
+    return (a->c0 == b->c0) && (a->c1 == b->c1) && (memcmp(a->str, b->str, C2_SIZE) == 0);
+}
+
+
+// Write cached and queued changes to ROM
+static void flush(void)
+{
+    settingsFlushDirty(SETTINGS_FLUSH_ALL);
+    settingsWaitIdle();
+}
+
+
+// Start from a valid image holding old values
+static void prepare(void)
+{
+    simRomPowerCut(SIM_ROM_POWER_ON);
+    settingsRomDropCache();
+    initSettings(1);
+    writeValues(&oldValues);
+    flush();
+}
+
+
+// Restart after power loss and check restored values
+static restoredState restart(void)
+{
+    testValues_t values;
+    resultType result;
+    settingsWaitIdle();
+    simRomPowerCut(SIM_ROM_POWER_ON);
+    settingsRomDropCache();
+    result = initSettings(0);
+    if (result != Result_OK)
+        return StateDefaults;
+    readValues(&values);
+    if (isEqual(&values, &oldValues))
+        return StateOld;
+    if (isEqual(&values, &newValues))
+        return StateNew;
+    return StateMixed;
+}
+
+
+static void writeNewValues(void)
+{
+    writeValues(&newValues);
+    flush();
+}
+
+
+static void commitNewValues(void)
+{
+    settingsBegin();
+    writeValues(&newValues);
+    settingsCommit();
+}
+
+
+// Run changes with power cut after every possible count of written bytes
+static uint32_t runPowerCuts(void (*change)(void), testStats_t *stats)
+{
+    uint32_t bytes, cut, generation;
+    restoredState state;
+    memset(stats, 0, sizeof(testStats_t));
+    prepare();
+    simGetFlashStats()->writeBytes = 0;
+    change();
+    bytes = simGetFlashStats()->writeBytes;
+    for (cut=0; cut<=bytes; cut++)
+    {
+        prepare();
+        generation = settingsRomGeneration();
+        simRomPowerCut(cut);
+        change();
+        state = restart();
+        stats->count[state]++;
+#if ROM_DUAL_BANK == 1
+        // Change is written by one bank switch
+        if (!settingsRomImageVerified() || (settingsRomGeneration() != generation + ((state == StateNew) ? 1 : 0)))
+            stats->bankErrors++;
+#else
+        (void)generation;
+#endif
+    }
+    return bytes;
+}
+
+
+static void printStats(const char *name, uint32_t bytes, testStats_t *stats)
+{
+    printf("%-12s %5d %5d %5d %5d %8d %5d\n", name, bytes + 1, stats->count[StateOld], stats->count[StateNew],
+           stats->count[StateMixed], stats->count[StateDefaults], stats->bankErrors);
+}
+
+
+int main(void)
+{
+    testStats_t txnStats, plainStats;
+    uint32_t txnBytes, plainBytes;
+    uint32_t failed;
+
+    printf("*** Power loss test ***\n");
+    txnBytes = runPowerCuts(commitNewValues, &txnStats);
+    plainBytes = runPowerCuts(writeNewValues, &plainStats);
+    printf("changes      cuts   old   new mixed defaults  bank\n");
+    printStats("transaction", txnBytes, &txnStats);
+    printStats("requests", plainBytes, &plainStats);
+
+    failed = (txnStats.count[StateMixed] != 0) || (txnStats.count[StateDefaults] != 0) ||
+             (txnStats.count[StateOld] == 0) || (txnStats.count[StateNew] == 0);
+#if ROM_DUAL_BANK == 1
+    failed |= (plainStats.count[StateMixed] != 0) || (plainStats.count[StateDefaults] != 0) ||
+              (plainStats.count[StateOld] == 0) || (plainStats.count[StateNew] == 0) ||
+              (txnStats.bankErrors != 0) || (plainStats.bankErrors != 0);
+#endif
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed ? 1 : 0;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -0,0 +1,28 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+# Transactions are enabled for this testbench only, they require ROM cache
+DEFINES += ENABLE_TRANSACTIONS=1 ROM_BULK_RESTORE=1
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.c \
+        ../settings.c \
+        ../settings_journal.c \
+        ../settings_private.c \
+        ../settings_rom.c \
+        ../settings_storage.c \
+        ../settings_tree.c \
+        ../utils.c
+
+HEADERS += \
+    ../settings.h \
+    ../settings_private.h \
+    ../settings_public.h \
+    ../settings_sim.h \
+    ../settings_storage.h \
+    ../settings_tree.h \
+    ../utils.h
@@ -4,75 +4,187 @@
 #include "settings.h"
 #include "settings_public.h"
 #include "settings_private.h"
+#if ENABLE_STATIC_TREE == 1
+#include "settings_tree.h"
+#endif
 
 
 // Uncomment line below to use simulated ROM driver
+// Otherwise storage driver must be registered by settingsSetStorageDriver() before initSettings()
 #define __NOROM__
 
+#ifdef __NOROM__
+#include "settings_sim.h"
+#endif
+
+// Simulated ROM is a flash device. Its statistics are collected by the timing model below
+// In-place writes of direct backend are modeled as erase and program of every affected block
+#define SIM_FLASH_PROGRAM_NS_PER_BYTE   2700    // 0.7 ms per 256-byte page
+#define SIM_FLASH_ERASE_NS              45000000
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+#define SIM_ROM_SIZE                    SETTINGS_FLASH_SIZE
+#define SIM_FLASH_BLOCK_SIZE            SETTINGS_FLASH_BLOCK_SIZE
+#else
+#define SIM_ROM_SIZE                    SETTINGS_ROM_SIZE
+#define SIM_FLASH_BLOCK_SIZE            4096
+#endif
+#define SIM_FLASH_BLOCK_COUNT           ((SIM_ROM_SIZE + SIM_FLASH_BLOCK_SIZE - 1) / SIM_FLASH_BLOCK_SIZE)
+
 
 // RAM is private
 extern uint8_t ram[SETTINGS_RAM_SIZE];
 
-// Declare ROM driver interface
-void readRom(uint32_t ramAddr, uint32_t romAddr, uint32_t count);
-void writeRom(uint32_t romAddr, uint32_t ramAddr, uint32_t count);
-
 // Global are used to store size of RAM
-static uint32_t ramSize, romSize;
+static uint32_t ramSize, romSize, slotCount;
 
 //-----------------------------------//
 // Testbench ROM driver
 #ifdef __NOROM__
 
-#define SETTINGS_ROM_SIZE               SETTINGS_RAM_SIZE
-static uint8_t rom[SETTINGS_ROM_SIZE];
+static uint8_t rom[SIM_ROM_SIZE];
+
+// Count of bytes which are written before simulated power loss, see simRomPowerCut()
+static uint32_t simBytesLeft = SIM_ROM_POWER_ON;
+
+static simFlashStats_t flashStats;
+static uint32_t blockErases[SIM_FLASH_BLOCK_COUNT];
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+static uint8_t flashReady;
+#endif
+
+#if SIM_ROM_WRITE_LATENCY_US > 0
+#include <unistd.h>
+#endif
+
+// Simulate power loss after given count of bytes is written to ROM, all following writes are lost
+// Pass SIM_ROM_POWER_ON to restore normal operation
+void simRomPowerCut(uint32_t bytesLeft)
+{
+    simBytesLeft = bytesLeft;
+}
 
-void readRom(uint32_t ramAddr, uint32_t romAddr, uint32_t count)
+// Get statistics of simulated flash device
+// Counters may be cleared by caller
+simFlashStats_t *simGetFlashStats(void)
 {
-    SETTINGS_ASSERT_TRUE((romAddr < SETTINGS_ROM_SIZE) && ((romAddr + count) <= SETTINGS_ROM_SIZE));
-    memcpy(&ram[ramAddr], &rom[romAddr], count);
+    return &flashStats;
 }
 
 
-void writeRom(uint32_t romAddr, uint32_t ramAddr, uint32_t count)
+static void simEraseBlock(uint32_t block)
 {
-    SETTINGS_ASSERT_TRUE((romAddr < SETTINGS_ROM_SIZE) && ((romAddr + count) <= SETTINGS_ROM_SIZE));
-    memcpy(&rom[romAddr], &ram[ramAddr], count);
+    flashStats.erases++;
+    flashStats.busyNs += SIM_FLASH_ERASE_NS;
+    if (++blockErases[block] > flashStats.maxBlockErases)
+        flashStats.maxBlockErases = blockErases[block];
 }
 
-#else
 
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+// Flash is erased initially
+static void simFlashInit(void)
+{
+    if (flashReady)
+        return;
+    memset(rom, 0xFF, sizeof(rom));
+    flashReady = 1;
+}
+#endif
 
-// Reading from EEPROM and writing to EERPOM is allowed on startup only
-// Settings module does not need to read EEPROM again after init is done
-// Writing during normal operation should be done in queued manner to 
-// avoid stalling of system task
 
-void readRom(uint32_t ramAddr, uint32_t romAddr, uint32_t count)
+static void simRead(void *ctx, uint32_t romAddr, uint8_t *data, uint32_t count)
 {
-    // TODO
+    (void)ctx;
+    SETTINGS_ASSERT_TRUE((romAddr < SIM_ROM_SIZE) && ((romAddr + count) <= SIM_ROM_SIZE));
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+    simFlashInit();
+#endif
+    memcpy(data, &rom[romAddr], count);
 }
 
 
-void writeRom(uint32_t romAddr, uint32_t ramAddr, uint32_t count)
+static void simWrite(void *ctx, uint32_t romAddr, const uint8_t *data, uint32_t count)
 {
-    // TODO
+    uint32_t i;
+    (void)ctx;
+    SETTINGS_ASSERT_TRUE((romAddr < SIM_ROM_SIZE) && ((romAddr + count) <= SIM_ROM_SIZE));
+#if SIM_ROM_WRITE_LATENCY_US > 0
+    usleep(SIM_ROM_WRITE_LATENCY_US);
+#endif
+    if (simBytesLeft != SIM_ROM_POWER_ON)
+    {
+        if (count > simBytesLeft)
+            count = simBytesLeft;
+        simBytesLeft -= count;
+    }
+    if (count == 0)
+        return;
+    flashStats.writeBytes += count;
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+    // Programming can only clear bits of erased bytes
+    simFlashInit();
+    for (i=0; i<count; i++)
+    {
+        SETTINGS_ASSERT_TRUE(rom[romAddr + i] == 0xFF);
+        rom[romAddr + i] &= data[i];
+    }
+    flashStats.programBytes += count;
+    flashStats.busyNs += (uint64_t)count * SIM_FLASH_PROGRAM_NS_PER_BYTE;
+#else
+    memcpy(&rom[romAddr], data, count);
+    for (i = romAddr / SIM_FLASH_BLOCK_SIZE; i <= (romAddr + count - 1) / SIM_FLASH_BLOCK_SIZE; i++)
+    {
+        simEraseBlock(i);
+        flashStats.programBytes += SIM_FLASH_BLOCK_SIZE;
+        flashStats.busyNs += (uint64_t)SIM_FLASH_BLOCK_SIZE * SIM_FLASH_PROGRAM_NS_PER_BYTE;
+    }
+#endif
+}
+
+
+// Erase block of flash device. Used by journal backend only
+static void simErase(void *ctx, uint32_t blockAddr)
+{
+    (void)ctx;
+    SETTINGS_ASSERT_TRUE((blockAddr % SIM_FLASH_BLOCK_SIZE) == 0);
+    // Erase is lost if power is off
+    if (simBytesLeft == 0)
+        return;
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+    simFlashInit();
+#endif
+    memset(&rom[blockAddr], 0xFF, SIM_FLASH_BLOCK_SIZE);
+    simEraseBlock(blockAddr / SIM_FLASH_BLOCK_SIZE);
 }
 
+
+// Simulated ROM has nothing to flush, writes are complete when driver returns
+static const settingsStorageDriver_t simStorage = {
+    simRead, simWrite, 0, simErase, 0, SIM_ROM_SIZE, SIM_FLASH_BLOCK_SIZE, 0
+};
+
 #endif
 //-----------------------------------//
 
+#if ENABLE_STATIC_TREE == 0
 // Default text for C2 params (all)
 static const char dfltC2[C2_SIZE] = "Default text";
+#endif
 
-// Callback for all B0 params
-static void onB0ParamsChanged(rqType rq, uint32_t pId);
+// Callback for all B0 params, legacy form (see onChangeCallback)
+// Callbacks are referenced by generated tree too (see settings_tree.json)
+void onB0ParamsChanged(rqType rq, uint32_t pId);
 
 // Callback for C2
-static void onC2ParamsChanged(rqType rq, uint32_t pId);
+void onC2ParamsChanged(rqType rq, const requestContext_t *ctx);
+
 
+#if ENABLE_STATIC_TREE == 1
 
-#if ENABLE_NODE_CONSTRUCTORS == 0
+// Tree is defined by settings_tree.c
+extern hNode_t *hRoot;
+
+#elif ENABLE_NODE_CONSTRUCTORS == 0
 
 // Integer node:                       Access type     Storage type    Minimum                 Maximum                 Default                 Callback
 // b0param_C0
@@ -86,7 +198,7 @@ static hNode_t hNode_B0 = hNode(hNodes_B0);
 
 // b1param_C2i
 // Char node:                          Access type     Storage type    Size        Default                 Callback
-static sNode_t node_C2 = charNode (  AccessByAll,       RomStored,     C2_SIZE,    dfltC2,                  onC2ParamsChanged    );
+static sNode_t node_C2 = charNodeCtx (  AccessByAll,    RomStored,     C2_SIZE,    dfltC2,                  onC2ParamsChanged    );
 static lNode_t lNode_B1 = lNode(C2_NODES_COUNT, (node_t *)&node_C2);
 
 // Integer node:                   Access type     Storage type    Minimum                 Maximum                 Default                 Callback
@@ -109,55 +221,124 @@ resultType initSettings(uint8_t useDefaults)
 {
     nodeInitContext_t ctx;
     resultType result;
+    uint8_t restoreMode;
+    uint8_t legacyImage = 0;
 
 #if ENABLE_NODE_CONSTRUCTORS == 1
     hNode_t *hNode_B0;
     lNode_t *lNode_B1;
 
-    hNode_B0 = createHNode(2);
-    addToHList(hNode_B0, 0,           u32Node (  AccessByAll,    RomStored,        0,                      100000,                   12345,                onB0ParamsChanged));     // C0
-    addToHList(hNode_B0, 1,           u32Node (  AccessByAll,    RomStored,        0,                      144,                         5,                 onB0ParamsChanged));     // C1
+    // Tree is created once. Application may create its own tree before init (see bench/synthetic.c)
+    if (hRoot == 0)
+    {
+        hNode_B0 = setName(createHNode(2), "B0");
+        addToHList(hNode_B0, 0, setName(u32Node (  AccessByAll,    RomStored,        0,                      100000,                   12345,                onB0ParamsChanged), "C0"));
+        addToHList(hNode_B0, 1, setName(u32Node (  AccessByAll,    RomStored,        0,                      144,                         5,                 onB0ParamsChanged), "C1"));
 
-    lNode_B1 = createLNode(35, charNode (  AccessByAll,       RomStored,     C2_SIZE,    dfltC2,                  onC2ParamsChanged));    // C2
+        lNode_B1 = setName(createLNode(35, setName(setChangeCallbackCtx(charNode (  AccessByAll,       RomStored,     C2_SIZE,    dfltC2,   0), onC2ParamsChanged), "C2")), "B1");
 
-    hRoot = createHNode(3);             // A0
-    addToHList(hRoot, 0, hNode_B0);
-    addToHList(hRoot, 1, lNode_B1);
-    addToHList(hRoot, 2, u16Node (  AccessByAll,    NotRomStored,      1,                      1024,                  16,                     0));   // B2
+        hRoot = setName(createHNode(3), "A0");
+        addToHList(hRoot, 0, hNode_B0);
+        addToHList(hRoot, 1, lNode_B1);
+        addToHList(hRoot, 2, setName(u16Node (  AccessByAll,    NotRomStored,      1,                      1024,                  16,                     0), "B2"));
+    }
 #endif
 
+#ifdef __NOROM__
+    // Application may register its own storage driver before init
+    if (settingsGetStorageDriver() == 0)
+        settingsSetStorageDriver(&simStorage);
+#endif
+    // Reading from EEPROM and writing to EERPOM is allowed on startup only
+    // Settings module does not need to read EEPROM again after init is done
+    // Writing during normal operation should be done in queued manner to
+    // avoid stalling of system task (see SETTINGS_ROM_WRITE_MODE)
+
     // Create CRC16 lookup table
     makeCRC16Table();
 
+#if ENABLE_STATIC_TREE == 1
+    // RAM and ROM map has been created by generator, descriptors are const
+    ramSize = SETTINGS_TREE_RAM_SIZE;
+    romSize = SETTINGS_TREE_ROM_SIZE;
+    slotCount = SETTINGS_TREE_SLOT_COUNT;
+    ctx.maxDepth = SETTINGS_TREE_DEPTH;
+    ctx.ramPadding = SETTINGS_TREE_RAM_PADDING;
+    SETTINGS_ASSERT_TRUE(ROM_HEADER_SIZE + romSize <= ROM_IMAGE_LIMIT);
+#else
     // Create RAM and ROM map for the whole tree
     ctx.depth = 0;
     ctx.maxDepth = 0;
     ctx.maxAllowedDepth = 10;
+    ctx.ramAlign = 1;
+    ctx.ramPadding = 0;
     // InitNode is first initialization stage, it does not actualy use RAM or ROM, only tree structure is created
-    initNode((node_t *)hRoot, &ramSize, &romSize, &ctx);
+    initNode((node_t *)hRoot, &ramSize, &romSize, &slotCount, &ctx);
     SETTINGS_ASSERT_TRUE(ramSize <= SETTINGS_RAM_SIZE);
-    hRoot->ramOffset = 0;       // Start address for RAM
-    hRoot->romOffset = 0;       // Start address for ROM
+    SETTINGS_ASSERT_TRUE(ROM_HEADER_SIZE + romSize <= ROM_IMAGE_LIMIT);
+    hRoot->ramOffset = 0;                   // Start address for RAM
+    hRoot->romOffset = ROM_HEADER_SIZE;     // Start address for ROM, image header is placed first
+    hRoot->slotOffset = 0;      // Start index for slots
+#endif
 
     SETTINGS_DEBUG("Settings total RAM: %d, ROM %d bytes, depth %d\n", ramSize, romSize, ctx.maxDepth);
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_ALIGNED
+    // Compact layout differs by padding only
+    SETTINGS_DEBUG("Aligned RAM layout: %d bytes of padding, compact layout takes %d bytes\n", ctx.ramPadding, ramSize - ctx.ramPadding);
+#endif
+#if ENABLE_SLOT_TABLE == 1
+    // Resolve all terminating nodes for handle-based access
+    buildSlotTable(slotCount);
+#endif
 #if USE_SETTINGS_MEMORY_ALLOC == 1
     SETTINGS_DEBUG("Main RAM: %d of %d bytes, descriptor RAM: %d of %d bytes\n", ramSize, SETTINGS_RAM_SIZE, getAllocMemoryUsed(), SETTINGS_ALLOC_MEMORY_SIZE);
 #endif
     
-    // Restore whole RAM from external ROM device
-    // Non-ROM stored parameters that are read from ROM are ignored and get their values from nodes description
-    // TODO
-    // if (Eeprom::IsEepromOk())
-    //     Eeprom::Read(0, ram, ramSize);
+    // Finish transaction commit which could be interrupted by power loss
+    settingsRomRecover();
+
+    // Restore whole ROM image from external ROM device
+    // Non-ROM stored parameters are not stored in ROM and get their values from nodes description
+    // In dual-bank mode the newest valid bank is selected here
+#if (ROM_BULK_RESTORE == 1) || (ROM_DUAL_BANK == 1)
+    settingsRomLoad(ROM_HEADER_SIZE + romSize);
+#endif
+    restoreMode = RESTORE_DEFAULTS;
+    if (!useDefaults)
+    {
+        // Image is accepted only if it has been saved for the same tree layout
+        result = settingsLoadImage(romSize);
+        if (result == Result_OK)
+        {
+            restoreMode = settingsRomImageVerified() ? RESTORE_FROM_BANK : RESTORE_FROM_RAM;
+        }
+        else if (result == Result_LegacyImage)
+        {
+            restoreMode = RESTORE_FROM_RAM;
+            legacyImage = 1;
+        }
+        else
+        {
+            SETTINGS_DEBUG("ROM image %s\n", "does not match settings tree");
+        }
+    }
 
     // Validate values and check CRC
-    result = validateNode((node_t *)hRoot, hRoot->ramOffset, hRoot->romOffset, useDefaults);
+    result = validateNode((node_t *)hRoot, hRoot->ramOffset, hRoot->romOffset, restoreMode);
     SETTINGS_DEBUG("Validate result 0x%02X %s\n", result, (result & Result_UpdatedRom) ? "(defaults restored)" : "");
 
+    // Legacy image is moved after the header as a whole
+    if (legacyImage)
+    {
+        SETTINGS_DEBUG("ROM image %s\n", "has no header and is saved again");
+        settingsSaveImage(romSize);
+        flushSettingsToRom();
+    }
     // ROM should be updated (may take some time)
-    if (result & Result_UpdatedRom)
+    else if (result & Result_UpdatedRom)
     {
-        // TODO
+        writeRomHeader(romSize);
+        flushSettingsToRom();
     }
 
     return (resultType)(result & Result_UpdatedRom);
@@ -168,21 +349,24 @@ void resetSettingsToDefaults(void)
 {
     // Defaults will be restored on next system start due to wrong CRC
     invalidateNodeCrc((node_t *)hRoot, hRoot->ramOffset, hRoot->romOffset, 1);
+#if ROM_DUAL_BANK == 1
+    // Node CRCs are not checked if image is restored from a verified bank,
+    // so image header is made not to match the tree, and the whole tree gets defaults
+    writeRomHeader(0);
+#endif
 }
 
 
 void flushSettingsToRom(void)
 {
-    // Copy whole RAM to external ROM device
-    // TODO
-    //drvEeprom_EraseAll();
-    //drvEeprom_Write(0, ram, ramSize);
+    // Write all changes collected by ROM cache to external ROM device
+    settingsFlushDirty(SETTINGS_FLUSH_ALL);
 }
 
 
 
 
-static void onB0ParamsChanged(rqType rq, uint32_t pId)
+void onB0ParamsChanged(rqType rq, uint32_t pId)
 {
     // Last argument is passed by pId
     switch (pId)
@@ -198,12 +382,11 @@ static void onB0ParamsChanged(rqType rq, uint32_t pId)
 }
 
 
-static void onC2ParamsChanged(rqType rq, uint32_t pId)
+void onC2ParamsChanged(rqType rq, const requestContext_t *ctx)
 {
-    // Last argument is passed by pId and can be also obtained by argHistory
-    // In this example, we use getRequestArg(0) which is equal to pId
-    // In more complex cases, getRequestArg(1), getRequestArg(2) and so on may be called
-    printf("C2 param changed, index is: %d, new value is: %s\n", getRequestArg(0), getCallbackCache()->str);
+    // All request arguments are provided by context, indexed by depth
+    // In this example, ctx->arg[0] is pGroup_B1 and ctx->arg[1] is index of C2 element
+    printf("C2 param changed, index is: %d, new value is: %s\n", ctx->arg[ctx->depth - 1], ctx->value.str);
 }
 
 
@@ -214,6 +397,7 @@ int32_t settings_ReadI32(uint32_t pGroup, uint32_t param)
     request_t rq;
     int32_t val32 = 0;
     rq.rq = rqRead;
+    rq.accLevel = AccessByDev;
     rq.arg[0] = pGroup;
     rq.arg[1] = param;
     rq.val.i32 = &val32;
@@ -229,6 +413,7 @@ int32_t settings_ReadI32_4(uint32_t pGroup, uint32_t param, uint32_t param2, uin
     request_t rq;
     int32_t val32 = 0;
     rq.rq = rqRead;
+    rq.accLevel = AccessByDev;
     rq.arg[0] = pGroup;
     rq.arg[1] = param;
     rq.arg[2] = param2;
@@ -245,6 +430,7 @@ void settings_WriteI32(uint32_t pGroup, uint32_t param, int32_t value)
 {
     request_t rq;
     rq.rq = rqWrite;
+    rq.accLevel = AccessByDev;
     rq.arg[0] = pGroup;
     rq.arg[1] = param;
     rq.val.i32 = &value;
@@ -257,6 +443,7 @@ void settings_WriteI32_4(uint32_t pGroup, uint32_t param, uint32_t param2, uint3
 {
     request_t rq;
     rq.rq = rqWrite;
+    rq.accLevel = AccessByDev;
     rq.arg[0] = pGroup;
     rq.arg[1] = param;
     rq.arg[2] = param2;
@@ -273,6 +460,7 @@ void settings_WriteI32NoCbf(uint32_t pGroup, uint32_t param, int32_t value)
 {
     request_t rq;
     rq.rq = rqWriteNoCb;
+    rq.accLevel = AccessByDev;
     rq.arg[0] = pGroup;
     rq.arg[1] = param;
     rq.val.i32 = &value;
@@ -287,6 +475,7 @@ void settings_ReadStr(uint32_t pGroup, uint32_t param, char *str)
 {
     request_t rq;
     rq.rq = rqRead;
+    rq.accLevel = AccessByDev;
     rq.arg[0] = pGroup;
     rq.arg[1] = param;
     rq.raw = (uint8_t *)str;
@@ -299,6 +488,7 @@ void settings_WriteStr(uint32_t pGroup, uint32_t param, char *str)
 {
     request_t rq;
     rq.rq = rqWrite;
+    rq.accLevel = AccessByDev;
     rq.arg[0] = pGroup;
     rq.arg[1] = param;
     rq.raw = (uint8_t *)str;
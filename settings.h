@@ -38,11 +38,30 @@ extern "C"
     resultType initSettings(uint8_t useDefaults);
     void resetSettingsToDefaults(void);
     void flushSettingsToRom(void);
+    void settingsSetStorageDriver(const settingsStorageDriver_t *driver);
 
     // Functions below are provided by settings_private
     resultType settingsRequest(request_t *rqst);
+    resultType settingsRequestBatch(request_t *rqs, uint32_t n);
+    resultType settingsBegin(void);
+    resultType settingsCommit(void);
+    void settingsAbort(void);
     uint32_t getRequestArg(uint32_t historyIndex);
     callbackCache_t *getCallbackCache(void);
+    settingsHandle_t settingsResolve(request_t *rqst);
+    resultType settingsRequestByHandle(settingsHandle_t handle, request_t *rqst);
+    int32_t settings_ReadI32ByHandle(settingsHandle_t handle);
+    float settings_ReadF32ByHandle(settingsHandle_t handle);
+    uint32_t settingsGetVisibleHandles(request_t *rqst, uint32_t depth, settingsHandle_t *handles, uint32_t maxCount);
+    settingsHandle_t settingsResolveName(const char *name);
+    uint32_t settingsSubscribe(request_t *rqst, uint32_t depth, settingsEventCallback callback, void *userData);
+    void settingsUnsubscribe(uint32_t id);
+    uint32_t settingsDispatchEvents(uint32_t maxEvents);
+    settingsEventStats_t *getEventStats(void);
+    uint32_t settingsFlushDirty(uint32_t maxPages);
+    settingsRomStats_t *getRomStats(void);
+    void settingsWaitIdle(void);
+    settingsRomQueueStats_t *getRomQueueStats(void);
 
     // Convenience aliases
     int32_t settings_ReadI32(uint32_t pGroup, uint32_t param);
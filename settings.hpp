@@ -0,0 +1,178 @@
+/******************************************************************************
+    Typed C++ accessors of settings module
+
+    Path of a value is given by request arguments and is checked and resolved to a slot
+    at compile time, using layout generated by tools/settings_gen.py (settings_tree.h).
+    Value type is the type of the node: 8-bit to 64-bit integer, float, double, char[N]
+    or settingsTree::Blob, which is read and written by ranges.
+    Reads of values with default request handler are inlined to a direct RAM load,
+    other requests are passed to the handle-based API.
+
+    Usage:
+        uint32_t c0 = Setting<pGroup_B0, b0param_C0>::read();
+        Setting<pGroup_B0, b0param_C1>::write(7);
+        char str[C2_SIZE];
+        Setting<pGroup_B1, 5>::read(str);
+        Setting<pGroup_Cal, cal_Table>::write(16, 4, coefficient);
+
+    Requires ENABLE_STATIC_TREE and ENABLE_SLOT_TABLE
+******************************************************************************/
+#ifndef SETTINGS_HPP
+#define SETTINGS_HPP
+
+#include <string.h>
+#include "settings.h"
+#include "settings_private.h"
+#include "settings_tree.h"
+
+#if (ENABLE_STATIC_TREE == 0) || (ENABLE_SLOT_TABLE == 0)
+#error "Typed accessors require ENABLE_STATIC_TREE and ENABLE_SLOT_TABLE set to 1"
+#endif
+
+
+namespace settingsTree
+{
+    // Load of value from RAM by value type
+    template<typename T> struct RamLoad;
+    template<> struct RamLoad<uint8_t> { static uint32_t load(uint32_t addr) { return SETTINGS_RAM_U8(addr); } };
+    template<> struct RamLoad<uint16_t> { static uint32_t load(uint32_t addr) { return SETTINGS_RAM_U16(addr); } };
+    template<> struct RamLoad<uint32_t> { static uint32_t load(uint32_t addr) { return SETTINGS_RAM_U32(addr); } };
+    template<> struct RamLoad<uint64_t> { static uint64_t load(uint32_t addr) { return SETTINGS_RAM_U64(addr); } };
+    template<> struct RamLoad<int8_t> { static int32_t load(uint32_t addr) { return SETTINGS_RAM_I8(addr); } };
+    template<> struct RamLoad<int16_t> { static int32_t load(uint32_t addr) { return SETTINGS_RAM_I16(addr); } };
+    template<> struct RamLoad<int32_t> { static int32_t load(uint32_t addr) { return SETTINGS_RAM_I32(addr); } };
+    template<> struct RamLoad<int64_t> { static int64_t load(uint32_t addr) { return SETTINGS_RAM_I64(addr); } };
+    template<> struct RamLoad<float> { static float load(uint32_t addr) { return SETTINGS_RAM_F32(addr); } };
+    template<> struct RamLoad<double> { static double load(uint32_t addr) { return SETTINGS_RAM_F64(addr); } };
+
+    // Value passed by request, 8-bit to 32-bit integers are passed as int32_t
+    template<typename T> struct RequestValue
+    {
+        typedef int32_t type;
+        static void set(request_t &rq, type *value) { rq.val.i32 = value; }
+    };
+    template<> struct RequestValue<uint64_t>
+    {
+        typedef uint64_t type;
+        static void set(request_t &rq, type *value) { rq.val.u64 = value; }
+    };
+    template<> struct RequestValue<int64_t>
+    {
+        typedef int64_t type;
+        static void set(request_t &rq, type *value) { rq.val.i64 = value; }
+    };
+    template<> struct RequestValue<float>
+    {
+        typedef float type;
+        static void set(request_t &rq, type *value) { rq.val.f32 = value; }
+    };
+    template<> struct RequestValue<double>
+    {
+        typedef double type;
+        static void set(request_t &rq, type *value) { rq.val.f64 = value; }
+    };
+
+    template<typename T, typename U> struct IsSame { static const bool value = false; };
+    template<typename T> struct IsSame<T, T> { static const bool value = true; };
+}
+
+
+// Value addressed by request arguments
+// Setting<...> with arguments which do not address a value fails to compile
+template<uint32_t... args>
+struct Setting
+{
+    typedef settingsTree::Value<args...> layout;
+    typedef typename layout::type type;
+
+    static const settingsHandle_t handle = layout::handle;
+    static const uint32_t size = layout::size;
+
+    typedef settingsTree::RequestValue<type> requestValue;
+
+    // Read numeric value
+    static type read()
+    {
+        static_assert(!settingsTree::IsSame<type, char>::value, "Char value must be read to char[size] array");
+        static_assert(!settingsTree::IsSame<type, settingsTree::Blob>::value, "Blob value must be read by range");
+#if SETTINGS_CONCURRENT_READERS == 0
+        if (layout::direct)
+            return (type)settingsTree::RamLoad<type>::load(layout::ramAddr);
+#endif
+        if (settingsTree::IsSame<typename requestValue::type, int32_t>::value)
+            return (type)settings_ReadI32ByHandle(layout::handle);
+        if (settingsTree::IsSame<type, float>::value)
+            return (type)settings_ReadF32ByHandle(layout::handle);
+        typename requestValue::type value = 0;
+        request_t rq = request_t();
+        rq.rq = rqRead;
+        requestValue::set(rq, &value);
+        settingsRequestByHandle(layout::handle, &rq);
+        return (type)value;
+    }
+
+    // Read char value, string is not 0-terminated
+    static void read(char (&str)[layout::size])
+    {
+        static_assert(settingsTree::IsSame<type, char>::value, "Numeric value must be read by read()");
+#if SETTINGS_CONCURRENT_READERS == 0
+        if (layout::direct)
+        {
+            memcpy(str, &ram[layout::ramAddr], layout::size);
+            return;
+        }
+#endif
+        request_t rq = request_t();
+        rq.rq = rqRead;
+        rq.raw = (uint8_t *)str;
+        settingsRequestByHandle(layout::handle, &rq);
+    }
+
+    // Write numeric value. Use rqWriteNoCb to skip change callbacks
+    static resultType write(type value, rqType rqt = rqWrite)
+    {
+        static_assert(!settingsTree::IsSame<type, char>::value, "Char value must be written from char[size] array");
+        static_assert(!settingsTree::IsSame<type, settingsTree::Blob>::value, "Blob value must be written by range");
+        typename requestValue::type data = (typename requestValue::type)value;
+        request_t rq = request_t();
+        rq.rq = rqt;
+        requestValue::set(rq, &data);
+        return settingsRequestByHandle(layout::handle, &rq);
+    }
+
+    // Write char value
+    static resultType write(const char (&str)[layout::size], rqType rqt = rqWrite)
+    {
+        static_assert(settingsTree::IsSame<type, char>::value, "Numeric value must be written by write(value)");
+        request_t rq = request_t();
+        rq.rq = rqt;
+        rq.raw = (uint8_t *)str;
+        return settingsRequestByHandle(layout::handle, &rq);
+    }
+
+    // Read range of blob value, length of 0 selects bytes from offset to the end
+    static resultType read(uint32_t offset, uint32_t length, uint8_t *data)
+    {
+        static_assert(settingsTree::IsSame<type, settingsTree::Blob>::value, "Only blob value may be read by range");
+        request_t rq = request_t();
+        rq.rq = rqRead;
+        rq.raw = data;
+        rq.offset = offset;
+        rq.length = length;
+        return settingsRequestByHandle(layout::handle, &rq);
+    }
+
+    // Write range of blob value, only the range is written to ROM
+    static resultType write(uint32_t offset, uint32_t length, const uint8_t *data, rqType rqt = rqWrite)
+    {
+        static_assert(settingsTree::IsSame<type, settingsTree::Blob>::value, "Only blob value may be written by range");
+        request_t rq = request_t();
+        rq.rq = rqt;
+        rq.raw = (uint8_t *)data;
+        rq.offset = offset;
+        rq.length = length;
+        return settingsRequestByHandle(layout::handle, &rq);
+    }
+};
+
+#endif // SETTINGS_HPP
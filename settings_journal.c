@@ -0,0 +1,274 @@
+/******************************************************************************
+    Journaled ROM backend of settings module
+    Emulates byte-addressable ROM on a flash device: every write is appended to a journal
+    as a record, so that flash blocks are erased only when the journal is compacted
+
+    This file should not be modified for configuration reasons
+******************************************************************************/
+
+#include <string.h>
+#include "settings_private.h"
+#include "settings_public.h"
+
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+
+#define JOURNAL_HALF_SIZE       (SETTINGS_FLASH_SIZE / 2)
+#define JOURNAL_HALF_BASE(half) ((half) * JOURNAL_HALF_SIZE)
+#define JOURNAL_PAGE_COUNT      ((SETTINGS_ROM_SIZE + SETTINGS_ROM_PAGE_SIZE - 1) / SETTINGS_ROM_PAGE_SIZE)
+#define JOURNAL_ERASED_ADDR     0xFFFFFFFF
+
+#define PAGE_BIT_TEST(map, page)    ((map)[(page) >> 5] & (1UL << ((page) & 0x1F)))
+#define PAGE_BIT_SET(map, page)     ((map)[(page) >> 5] |= (1UL << ((page) & 0x1F)))
+
+#if JOURNAL_HALF_SIZE % SETTINGS_FLASH_BLOCK_SIZE
+#error "Half of SETTINGS_FLASH_SIZE must be a multiple of SETTINGS_FLASH_BLOCK_SIZE"
+#endif
+
+#if JOURNAL_HALF_SIZE < (JOURNAL_HEADER_SIZE + SETTINGS_ROM_SIZE + \
+                         (SETTINGS_ROM_SIZE / SETTINGS_JOURNAL_RECORD_SIZE + JOURNAL_PAGE_COUNT) * JOURNAL_RECORD_OVERHEAD)
+#error "Half of SETTINGS_FLASH_SIZE must fit the whole ROM image"
+#endif
+
+
+// ROM image rebuilt from journal
+static uint8_t image[SETTINGS_ROM_SIZE];
+// Pages of image which have ever been written. Only these are copied by compaction
+static uint32_t pageWritten[(JOURNAL_PAGE_COUNT + 31) / 32];
+static uint32_t activeHalf;
+static uint32_t sequence;
+static uint32_t appendAddr;             // Flash address of the next record
+static uint8_t mounted;
+
+// External functions
+
+    uint16_t getCRC16(uint8_t *data, uint16_t len, uint16_t crc);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    void u32toBytesMsbFirst(uint32_t *number, uint8_t *bytes, uint32_t count);
+    void bytesToU32MsbFirst(uint8_t *bytes, uint32_t *number, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+    // Prototypes
+
+    static void mount(void);
+    static uint8_t readHeader(uint32_t half, uint32_t *seq);
+    static uint8_t replay(uint32_t half);
+    static void compact(void);
+    static uint32_t appendRecord(uint32_t flashAddr, uint32_t romAddr, uint32_t count);
+    static void markWritten(uint32_t romAddr, uint32_t count);
+
+
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// Journal
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+// Rebuild image from the newest valid half
+// If the journal ends with a torn record, or no valid half is found, image is compacted into the other half,
+// so that following records are appended to erased flash
+static void mount(void)
+{
+    uint32_t seq[2];
+    uint8_t valid[2];
+    uint32_t half;
+    memset(image, 0xFF, sizeof(image));
+    memset(pageWritten, 0, sizeof(pageWritten));
+    valid[0] = readHeader(0, &seq[0]);
+    valid[1] = readHeader(1, &seq[1]);
+    mounted = 1;
+    if (!valid[0] && !valid[1])
+    {
+        activeHalf = 1;
+        sequence = 0;
+        compact();
+        return;
+    }
+    // Sequence counter may wrap around
+    if (valid[0] && valid[1])
+        half = ((int32_t)(seq[1] - seq[0]) > 0) ? 1 : 0;
+    else
+        half = valid[1] ? 1 : 0;
+    activeHalf = half;
+    sequence = seq[half];
+    if (!replay(half))
+        compact();
+}
+
+
+// Read and check header of a half
+// Returns 1 if header is valid
+static uint8_t readHeader(uint32_t half, uint32_t *seq)
+{
+    uint8_t header[JOURNAL_HEADER_SIZE];
+    uint32_t magic, crc;
+    storageRead(JOURNAL_HALF_BASE(half), header, JOURNAL_HEADER_SIZE);
+    bytesToU32MsbFirst(&header[JOURNAL_MAGIC_OFFSET], &magic, 2);
+    bytesToU32MsbFirst(&header[JOURNAL_SEQUENCE_OFFSET], seq, 4);
+    bytesToU32MsbFirst(&header[JOURNAL_CRC_OFFSET], &crc, NODE_CRC_SIZE);
+    return (magic == JOURNAL_MAGIC) && (crc == getCRC16(header, JOURNAL_CRC_OFFSET, NODE_CRC_SEED));
+}
+
+
+// Apply records of a half to image
+// Returns 1 if journal ends with erased flash, 0 if it ends with a torn record
+static uint8_t replay(uint32_t half)
+{
+    uint8_t record[JOURNAL_RECORD_HEADER_SIZE + SETTINGS_JOURNAL_RECORD_SIZE + NODE_CRC_SIZE];
+    uint32_t flashAddr, flashEnd, romAddr, count, crc;
+    flashAddr = JOURNAL_HALF_BASE(half) + JOURNAL_HEADER_SIZE;
+    flashEnd = JOURNAL_HALF_BASE(half) + JOURNAL_HALF_SIZE;
+    while (flashAddr + JOURNAL_RECORD_OVERHEAD <= flashEnd)
+    {
+        appendAddr = flashAddr;
+        storageRead(flashAddr, record, JOURNAL_RECORD_HEADER_SIZE);
+        bytesToU32MsbFirst(&record[0], &romAddr, 4);
+        bytesToU32MsbFirst(&record[4], &count, 2);
+        if ((romAddr == JOURNAL_ERASED_ADDR) && (count == 0xFFFF))
+            return 1;
+        if ((count == 0) || (count > SETTINGS_JOURNAL_RECORD_SIZE) || (romAddr + count > SETTINGS_ROM_SIZE) ||
+            (flashAddr + JOURNAL_RECORD_OVERHEAD + count > flashEnd))
+            return 0;
+        storageRead(flashAddr + JOURNAL_RECORD_HEADER_SIZE, &record[JOURNAL_RECORD_HEADER_SIZE], count + NODE_CRC_SIZE);
+        bytesToU32MsbFirst(&record[JOURNAL_RECORD_HEADER_SIZE + count], &crc, NODE_CRC_SIZE);
+        if (crc != getCRC16(record, JOURNAL_RECORD_HEADER_SIZE + count, NODE_CRC_SEED))
+            return 0;
+        memcpy(&image[romAddr], &record[JOURNAL_RECORD_HEADER_SIZE], count);
+        markWritten(romAddr, count);
+        flashAddr += JOURNAL_RECORD_OVERHEAD + count;
+    }
+    appendAddr = flashAddr;
+    return 1;
+}
+
+
+// Copy written pages of image to the other half and make it active
+// Header is written last, so that the half becomes valid only when the copy is complete.
+// Previous half is left intact and is erased by the next compaction
+static void compact(void)
+{
+    uint8_t header[JOURNAL_HEADER_SIZE];
+    uint32_t half, flashAddr, page, runStart, runEnd, count, value;
+    half = activeHalf ^ 1;
+    storageErase(JOURNAL_HALF_BASE(half), JOURNAL_HALF_SIZE);
+    flashAddr = JOURNAL_HALF_BASE(half) + JOURNAL_HEADER_SIZE;
+    page = 0;
+    while (page < JOURNAL_PAGE_COUNT)
+    {
+        if (!PAGE_BIT_TEST(pageWritten, page))
+        {
+            page++;
+            continue;
+        }
+        runStart = page * SETTINGS_ROM_PAGE_SIZE;
+        while ((page < JOURNAL_PAGE_COUNT) && PAGE_BIT_TEST(pageWritten, page))
+            page++;
+        runEnd = page * SETTINGS_ROM_PAGE_SIZE;
+        if (runEnd > SETTINGS_ROM_SIZE)
+            runEnd = SETTINGS_ROM_SIZE;
+        for (; runStart < runEnd; runStart += count)
+        {
+            count = runEnd - runStart;
+            if (count > SETTINGS_JOURNAL_RECORD_SIZE)
+                count = SETTINGS_JOURNAL_RECORD_SIZE;
+            flashAddr = appendRecord(flashAddr, runStart, count);
+        }
+    }
+    sequence++;
+    value = JOURNAL_MAGIC;
+    u32toBytesMsbFirst(&value, &header[JOURNAL_MAGIC_OFFSET], 2);
+    u32toBytesMsbFirst(&sequence, &header[JOURNAL_SEQUENCE_OFFSET], 4);
+    value = getCRC16(header, JOURNAL_CRC_OFFSET, NODE_CRC_SEED);
+    u32toBytesMsbFirst(&value, &header[JOURNAL_CRC_OFFSET], NODE_CRC_SIZE);
+    storageFlush();
+    storageWrite(JOURNAL_HALF_BASE(half), header, JOURNAL_HEADER_SIZE);
+    // Previous half is erased by the next compaction, so this one must be durable first
+    storageFlush();
+    activeHalf = half;
+    appendAddr = flashAddr;
+}
+
+
+// Program a record holding image bytes
+// Returns flash address following the record
+static uint32_t appendRecord(uint32_t flashAddr, uint32_t romAddr, uint32_t count)
+{
+    uint8_t record[JOURNAL_RECORD_HEADER_SIZE + SETTINGS_JOURNAL_RECORD_SIZE + NODE_CRC_SIZE];
+    uint32_t crc;
+    SETTINGS_ASSERT_TRUE((count != 0) && (count <= SETTINGS_JOURNAL_RECORD_SIZE));
+    u32toBytesMsbFirst(&romAddr, &record[0], 4);
+    u32toBytesMsbFirst(&count, &record[4], 2);
+    memcpy(&record[JOURNAL_RECORD_HEADER_SIZE], &image[romAddr], count);
+    crc = getCRC16(record, JOURNAL_RECORD_HEADER_SIZE + count, NODE_CRC_SEED);
+    u32toBytesMsbFirst(&crc, &record[JOURNAL_RECORD_HEADER_SIZE + count], NODE_CRC_SIZE);
+    storageWrite(flashAddr, record, JOURNAL_RECORD_OVERHEAD + count);
+    return flashAddr + JOURNAL_RECORD_OVERHEAD + count;
+}
+
+
+static void markWritten(uint32_t romAddr, uint32_t count)
+{
+    uint32_t page;
+    for (page = romAddr / SETTINGS_ROM_PAGE_SIZE; page <= (romAddr + count - 1) / SETTINGS_ROM_PAGE_SIZE; page++)
+        PAGE_BIT_SET(pageWritten, page);
+}
+
+
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// Public
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+// Read data from image
+// Journal is replayed on first access
+void journalRead(uint32_t romAddr, uint8_t *data, uint32_t count)
+{
+    SETTINGS_ASSERT_TRUE((romAddr + count) <= SETTINGS_ROM_SIZE);
+    if (!mounted)
+        mount();
+    memcpy(data, &image[romAddr], count);
+}
+
+
+// Write data to image and append it to journal
+// If active half is full, image is compacted into the other half instead
+void journalWrite(uint32_t romAddr, const uint8_t *data, uint32_t count)
+{
+    uint32_t chunk;
+    SETTINGS_ASSERT_TRUE((romAddr + count) <= SETTINGS_ROM_SIZE);
+    if (!mounted)
+        mount();
+    memcpy(&image[romAddr], data, count);
+    markWritten(romAddr, count);
+    for (; count != 0; romAddr += chunk, count -= chunk)
+    {
+        chunk = (count > SETTINGS_JOURNAL_RECORD_SIZE) ? SETTINGS_JOURNAL_RECORD_SIZE : count;
+        if (appendAddr + JOURNAL_RECORD_OVERHEAD + chunk > JOURNAL_HALF_BASE(activeHalf) + JOURNAL_HALF_SIZE)
+        {
+            // Compacted image holds the rest of data
+            compact();
+            return;
+        }
+        appendAddr = appendRecord(appendAddr, romAddr, chunk);
+    }
+}
+
+
+// Forget image, journal is replayed again on next access
+// Intended use: simulating restart in testbenches
+void journalUnmount(void)
+{
+    mounted = 0;
+}
+
+#endif  // ROM_BACKEND_JOURNAL
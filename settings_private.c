@@ -10,6 +10,13 @@
 #if (ENABLE_NODE_CONSTRUCTORS == 1) && (USE_SETTINGS_MEMORY_ALLOC == 0)
 #include <stdlib.h>
 #endif
+#if SETTINGS_CONCURRENT_READERS == 1
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if (SETTINGS_CONCURRENT_READERS == 1) || (ENABLE_SUBSCRIPTIONS == 1)
+#include <stdatomic.h>
+#endif
 
 
 #if ENABLE_NODE_CONSTRUCTORS == 1
@@ -27,19 +34,105 @@ uint32_t allocRamAddr = 0;
 // Local data storage
 uint8_t ram[SETTINGS_RAM_SIZE];
 
-// Argument history may be useful for determining changed value index in multy-dimensional lists
+// Request arguments and new value for legacy callbacks (see onChangeCallback)
+// Filled by notifyChange() right before such callback is called
 uint32_t argHistory[SETTINGS_MAX_DEPTH];
 callbackCache_t callbackCache;
-static uint16_t crcTable[256];
+static uint16_t crcTable[CRC16_SLICE_COUNT][256];
+static uint16_t crcShiftTable[32];
+
+#if ENABLE_SLOT_TABLE == 1
+// Resolved terminating nodes, indexed by handle
+static slot_t slotTable[SETTINGS_SLOT_TABLE_SIZE];
+static uint32_t slotTableSize;
+#endif
+
+#if ENABLE_NAME_INDEX == 1
+// Perfect hash index of slot path names, see settingsResolveName()
+#define NAME_BUCKET_LOAD        4           // Average count of slots per bucket
+#define NAME_BUCKET_COUNT       ((SETTINGS_SLOT_TABLE_SIZE + NAME_BUCKET_LOAD - 1) / NAME_BUCKET_LOAD)
+#define NAME_SEED_MAX           0xFFFF
+#define NAME_LIST_END           0xFFFFFFFF
+#define NAME_INDEX_DIGITS       5           // List indexes are 16-bit
+#define NAME_HASH_BASIS         0xCBF29CE484222325ULL
+#define NAME_HASH_PRIME         0x100000001B3ULL
+static settingsHandle_t nameIndex[SETTINGS_SLOT_TABLE_SIZE];
+static uint16_t nameSeed[NAME_BUCKET_COUNT];
+static uint32_t nameIndexSize;
+static uint32_t nameBucketCount;
+// Slot lists of buckets, used while index is built
+static uint32_t nameBucketHead[NAME_BUCKET_COUNT];
+static uint32_t nameLink[SETTINGS_SLOT_TABLE_SIZE];
+#endif
+
+#if ENABLE_SUBSCRIPTIONS == 1
+// Subscriptions, changed by dispatcher thread only (see settingsSubscribe())
+static subscriber_t subscribers[SETTINGS_MAX_SUBSCRIBERS];
+static atomic_uint subscriberCount;
+// Trie of watched paths, subscriptions of every path are linked by subscriber_t.next
+#define WATCH_NONE              0xFFFF
+#define WATCH_ROOT              0xFFFE
+#define WATCH_TRIE_MASK         (SETTINGS_WATCH_TRIE_SIZE - 1)
+#define WATCH_TRIE_LIMIT        (SETTINGS_WATCH_TRIE_SIZE * 3 / 4)     // Trie is rebuilt to take more entries
+static watchNode_t watchTrie[SETTINGS_WATCH_TRIE_SIZE];
+static uint32_t watchTrieUsed;
+static uint16_t watchRootSubscriber;            // First subscription of the whole tree
+// Count of subscriptions watching every slot
+static atomic_uchar slotWatchers[SETTINGS_SLOT_TABLE_SIZE];
+// Count of changes of every slot since its event has been queued, 0 if no event is pending
+static atomic_uint slotChanges[SETTINGS_SLOT_TABLE_SIZE];
+// Bounded MPSC queue of slot handles. Sequence of an entry equals queue position when entry is free,
+// and is one more when entry is written. Producers claim positions by eventHead, dispatcher reads at eventTail
+#define EVENT_QUEUE_MASK        (SETTINGS_EVENT_QUEUE_SIZE - 1)
+static atomic_uint eventSeq[SETTINGS_EVENT_QUEUE_SIZE];
+static settingsHandle_t eventQueue[SETTINGS_EVENT_QUEUE_SIZE];
+static atomic_uint eventHead;
+static uint32_t eventTail;
+static atomic_uint eventsPosted, eventsCoalesced, eventsDropped;
+static uint32_t eventsDispatched;
+static settingsEventStats_t eventStats;
+#endif
+
+#if ENABLE_TRANSACTIONS == 1
+// Write requests made within a transaction and their values, see settingsBegin()
+static request_t txnRequests[SETTINGS_TXN_MAX_REQUESTS];
+static uint64_t txnBuffer[SETTINGS_TXN_BUFFER_SIZE / 8];
+static uint32_t txnCount;
+static uint32_t txnBufferUsed;
+static uint8_t txnActive;
+#define TXN_STAGED(rq)      (((rq) != rqRead) && (((rq) & ~rqWrite) == 0))
+#endif
+
+#if SETTINGS_CONCURRENT_READERS == 1
+// Sequence counters, odd value means that a write is in progress
+static atomic_uint seqLock[SETTINGS_SEQLOCK_COUNT];
+// Serializes all requests except reads
+static pthread_mutex_t writerLock = PTHREAD_MUTEX_INITIALIZER;
+// Nesting level of write requests made by current thread (requests may be made by change callbacks)
+static _Thread_local uint32_t writerDepth;
+#define SEQLOCK_OF(hostRamAddr)     (&seqLock[(hostRamAddr) % SETTINGS_SEQLOCK_COUNT])
+#endif
 
 // Root node must be defined in top module
 extern hNode_t *hRoot;
 
+// Default handlers of integer and floating point nodes
+#define IS_NUMERIC_HANDLER(handler) (((handler) == handleRequestU32) || ((handler) == handleRequestI32) || \
+                                     ((handler) == handleRequestU64) || ((handler) == handleRequestI64) || \
+                                     ((handler) == handleRequestF32) || ((handler) == handleRequestF64))
+
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+// Size of values which byte order differs in RAM and ROM, 1 for other nodes
+#define VALUE_SWAP_SIZE(snode)      (IS_NUMERIC_HANDLER((snode)->rqHandler) ? (snode)->size : 1)
+// Size of buffer for values converted to ROM byte order
+#define VALUE_SWAP_BUFFER_SIZE      64
+#else
+#define VALUE_SWAP_SIZE(snode)      1
+#endif
+
 // External functions
 
     uint16_t getCRC16(uint8_t *data, uint16_t len, uint16_t crc);
-    void readRom(uint32_t ramAddr, uint32_t romAddr, uint32_t count);
-    void writeRom(uint32_t romAddr, uint32_t ramAddr, uint32_t count);
 
 #ifdef __cplusplus
 extern "C"
@@ -48,6 +141,8 @@ extern "C"
 
     void u32toBytesMsbFirst(uint32_t *number, uint8_t *bytes, uint32_t count);
     void bytesToU32MsbFirst(uint8_t *bytes, uint32_t *number, uint32_t count);
+    void u64toBytesMsbFirst(uint64_t *number, uint8_t *bytes);
+    void bytesToU64MsbFirst(uint8_t *bytes, uint64_t *number);
 
 #ifdef __cplusplus
 }
@@ -55,11 +150,96 @@ extern "C"
 
     // Prototypes
 
-    static void pushArg(uint32_t *argHistory, uint32_t argHistorySize, uint32_t arg);
-    static void popArg(uint32_t *argHistory, uint32_t argHistorySize);
+    static uint32_t getCrcRamAddr(node_t *node, uint32_t nodeRamBase);
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_ALIGNED
+    static uint32_t getValueAlign(sNode_t *snode);
+    static uint32_t alignRamOffset(uint32_t offset, uint32_t align, nodeInitContext_t *ctx);
+#endif
     static uint32_t getNodeCrc(node_t *node, uint32_t nodeRamBase);
     static void updateNodeCRC(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase);
     static resultType checkNodeCRC(node_t *node, uint32_t nodeRamBase);
+    static resultType locateNode(request_t *rqst, slot_t *slot, nodeTrail_t *trail);
+    static void initTrail(nodeTrail_t *trail);
+    static int32_t compareArgs(request_t *a, request_t *b);
+#if USE_INCREMENTAL_CRC == 0
+    static void updateHostCRC(slot_t *slot, uint8_t writeToRom);
+#endif
+    static resultType executeRequest(slot_t *slot, request_t *rqst, uint8_t deferCrc);
+    static uint8_t requestModifiesRam(rqType rq);
+    static resultType runRequest(slot_t *slot, request_t *rqst, uint8_t deferCrc);
+    static resultType runBatch(request_t *rqs, uint32_t n);
+#if ENABLE_TRANSACTIONS == 1
+    static resultType stageRequest(slot_t *slot, request_t *rqst);
+    static void clearTransaction(void);
+#endif
+    static void lockWriter(rqType rq);
+    static void unlockWriter(rqType rq);
+#if SETTINGS_CONCURRENT_READERS == 1
+    static uint32_t seqReadBegin(atomic_uint *seq);
+    static uint8_t seqReadRetry(atomic_uint *seq, uint32_t start);
+#endif
+    static void streamNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase, romStream_t *stream);
+    static void loadImagePayload(uint32_t romAddr, uint32_t treeRomSize);
+#if LEGACY_IMAGE_MIGRATION == 1
+    static resultType checkTreeCRC(node_t *node, uint32_t nodeRamBase);
+#endif
+    static void streamData(romStream_t *stream, uint32_t ramAddr, uint32_t count, uint32_t size);
+    static void streamFlush(romStream_t *stream);
+    static uint32_t loadValue(const uint8_t *data, uint32_t size);
+    static void storeValue(uint32_t value, uint8_t *data, uint32_t size);
+    static void readRomValue(uint32_t ramAddr, uint32_t romAddr, uint32_t size);
+    static void writeRomValue(uint32_t romAddr, uint32_t ramAddr, uint32_t size);
+    static int32_t signExtend(uint32_t value, uint32_t size);
+    static uint64_t loadValue64(const uint8_t *data);
+    static void storeValue64(uint64_t value, uint8_t *data);
+    static float loadF32(const uint8_t *data);
+    static void storeF32(float value, uint8_t *data);
+    static double loadF64(const uint8_t *data);
+    static void storeF64(double value, uint8_t *data);
+    static uint32_t f32ToBits(float value);
+    static uint64_t f64ToBits(double value);
+    static uint32_t getRawValue(uint8_t *raw, uint32_t size);
+    static void putRawValue(uint32_t value, uint8_t *raw, uint32_t size);
+    static uint64_t getRawValue64(uint8_t *raw);
+    static void putRawValue64(uint64_t value, uint8_t *raw);
+    static uint8_t getBlobRange(uint32_t size, request_t *rqst, uint32_t *offset, uint32_t *length);
+    static uint16_t getValueCRC16(uint8_t *data, uint32_t count, uint32_t size, uint16_t crc);
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+    static void swapValues(uint8_t *data, uint32_t count, uint32_t size);
+#endif
+#if USE_INCREMENTAL_CRC == 1
+    static uint32_t getCrcTail(slot_t *slot);
+    static uint16_t mulModCRC16(uint16_t a, uint16_t b);
+#endif
+#if ENABLE_SLOT_TABLE == 1
+    static void fillSlotTable(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase, uint32_t nodeSlotBase, slot_t *path);
+    static void initSlot(slot_t *slot, slot_t *path, sNode_t *node, uint32_t ramAddr, uint32_t romAddr, node_t *host, uint32_t hostRamBase, uint32_t hostRomBase);
+    static uint32_t loadSlotValue(slot_t *slot);
+    static node_t *findPathNode(const uint16_t *arg, uint32_t depth, settingsHandle_t *first);
+    static uint32_t getNodeSlotCount(node_t *node);
+    static uint32_t addVisibleHandles(node_t *node, settingsHandle_t first, uint8_t visible, settingsHandle_t *handles, uint32_t count, uint32_t maxCount);
+#endif
+#if ENABLE_NAME_INDEX == 1
+    static void buildNameIndex(void);
+    static uint8_t placeNameBucket(uint32_t bucket);
+    static uint32_t getNameBucketSize(uint32_t bucket);
+    static uint32_t getNameBucket(uint64_t hash);
+    static uint32_t getNamePosition(uint64_t hash, uint32_t seed);
+    static uint64_t hashName(uint64_t hash, const char *str);
+    static uint64_t mixNameHash(uint64_t hash);
+    static const char *formatNameIndex(uint32_t index, char *buffer);
+    static uint8_t getSlotNameHash(slot_t *slot, uint64_t *hash);
+    static uint8_t matchSlotName(slot_t *slot, const char *name);
+    static uint8_t matchNamePart(const char **name, const char *part);
+#endif
+#if ENABLE_SUBSCRIPTIONS == 1
+    static void initEvents(void);
+    static void postEvent(const requestContext_t *ctx);
+    static uint32_t getWatchers(const uint16_t *arg, uint32_t depth, uint16_t *ids);
+    static uint8_t addWatch(uint32_t id);
+    static void buildWatchTrie(void);
+    static uint32_t findWatchNode(uint32_t parent, uint32_t arg);
+#endif
 
 
 
@@ -69,7 +249,28 @@ extern "C"
 //-----------------------------------------------------------------//
 //-----------------------------------------------------------------//
 
-resultType initNode(node_t *node, uint32_t *ramSize, uint32_t *romSize, nodeInitContext_t *ctx)
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_ALIGNED
+// Get RAM alignment of value in aligned layout
+// Integer values are aligned to their size, char arrays and blobs are not aligned
+static uint32_t getValueAlign(sNode_t *snode)
+{
+    if ((snode->rqHandler == handleRequestCharArray) || (snode->rqHandler == handleRequestBlob))
+        return 1;
+    return ((snode->size == 2) || (snode->size == 4) || (snode->size == 8)) ? snode->size : 1;
+}
+
+
+// Round RAM offset up to alignment. Padding is counted for cost report
+static uint32_t alignRamOffset(uint32_t offset, uint32_t align, nodeInitContext_t *ctx)
+{
+    uint32_t aligned = (offset + align - 1) & ~(align - 1);
+    ctx->ramPadding += aligned - offset;
+    return aligned;
+}
+#endif
+
+
+resultType initNode(node_t *node, uint32_t *ramSize, uint32_t *romSize, uint32_t *slotCount, nodeInitContext_t *ctx)
 {
     hNode_t *hnode;
     lNode_t *lnode;
@@ -77,7 +278,12 @@ resultType initNode(node_t *node, uint32_t *ramSize, uint32_t *romSize, nodeInit
     uint16_t i;
     uint32_t ramOffset = 0;
     uint32_t romOffset = 0;
-    uint32_t nodeRamSize, nodeRomSize;
+    uint32_t slotOffset = 0;
+    uint32_t nodeRamSize, nodeRomSize, nodeSlotCount;
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_ALIGNED
+    uint32_t align, nodeAlign = 1, padding;
+    uint8_t hot, pass;
+#endif
     ctx->depth++;
     if (ctx->depth > ctx->maxDepth)
     {
@@ -87,6 +293,7 @@ resultType initNode(node_t *node, uint32_t *ramSize, uint32_t *romSize, nodeInit
             SETTINGS_ASSERT_NEVER_EXECUTE();
             *ramSize = 0;
             *romSize = 0;
+            *slotCount = 0;
             return Result_DepthExceeded;
         }
     }
@@ -94,9 +301,13 @@ resultType initNode(node_t *node, uint32_t *ramSize, uint32_t *romSize, nodeInit
     {
         case hNode:
             hnode = (hNode_t *)node;
+            hnode->accessMask = 0;
 
             // First few bytes are used by CRC
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_COMPACT
+            hnode->crcOffset = 0;
             ramOffset += NODE_CRC_SIZE;
+#endif
             romOffset += NODE_CRC_SIZE;
 
             // Init terminating nodes
@@ -110,14 +321,42 @@ resultType initNode(node_t *node, uint32_t *ramSize, uint32_t *romSize, nodeInit
 #endif
                 if (hnode->hList[i]->type == sNode)
                 {
-                    initNode(hnode->hList[i], &nodeRamSize, &nodeRomSize, ctx);
+                    initNode(hnode->hList[i], &nodeRamSize, &nodeRomSize, &nodeSlotCount, ctx);
+                    hnode->accessMask |= hnode->hList[i]->accessMask;
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_COMPACT
                     hnode->hList[i]->ramOffset = ramOffset;
-                    hnode->hList[i]->romOffset = romOffset;
                     ramOffset += nodeRamSize;
+#endif
+                    hnode->hList[i]->romOffset = romOffset;
+                    hnode->hList[i]->slotOffset = slotOffset;
                     romOffset += nodeRomSize;
+                    slotOffset += nodeSlotCount;
                 }
             }
 
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_ALIGNED
+            // Terminating nodes are placed in RAM by groups: hot ones first, then all others,
+            // both by descending alignment, so that padding is only required between groups
+            for (pass=0; pass<8; pass++)
+            {
+                hot = (pass < 4) ? 1 : 0;
+                align = 8 >> (pass % 4);
+                for (i=0; i<hnode->hListSize; i++)
+                {
+                    snode = (sNode_t *)hnode->hList[i];
+                    if ((snode == 0) || (snode->type != sNode) || ((snode->hot != 0) != hot) || (getValueAlign(snode) != align))
+                        continue;
+                    ramOffset = alignRamOffset(ramOffset, align, ctx);
+                    snode->ramOffset = ramOffset;
+                    ramOffset += snode->size;
+                    nodeAlign = (align > nodeAlign) ? align : nodeAlign;
+                }
+            }
+            // CRC follows terminating nodes
+            hnode->crcOffset = ramOffset;
+            ramOffset += NODE_CRC_SIZE;
+#endif
+
             // Here ROM offset may be page-aligned for hierarchy nodes if necessary
             // Init hierarchy nodes
             for (i=0; i<hnode->hListSize; i++)
@@ -126,46 +365,87 @@ resultType initNode(node_t *node, uint32_t *ramSize, uint32_t *romSize, nodeInit
                     continue;
                 if ((hnode->hList[i]->type == hNode) || (hnode->hList[i]->type == lNode))
                 {
-                    initNode(hnode->hList[i], &nodeRamSize, &nodeRomSize, ctx);
+                    initNode(hnode->hList[i], &nodeRamSize, &nodeRomSize, &nodeSlotCount, ctx);
+                    hnode->accessMask |= hnode->hList[i]->accessMask;
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_ALIGNED
+                    ramOffset = alignRamOffset(ramOffset, ctx->ramAlign, ctx);
+                    nodeAlign = (ctx->ramAlign > nodeAlign) ? ctx->ramAlign : nodeAlign;
+#endif
                     hnode->hList[i]->ramOffset = ramOffset;
                     hnode->hList[i]->romOffset = romOffset;
+                    hnode->hList[i]->slotOffset = slotOffset;
                     // Here ROM offset may be page-aligned for hierarchy nodes if necessary
                     ramOffset += nodeRamSize;
                     romOffset += nodeRomSize;
+                    slotOffset += nodeSlotCount;
                 }
             }
 
-            // Return used amount of RAM and ROM
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_ALIGNED
+            // Size is padded, so that alignment is kept if node is a list element
+            ramOffset = alignRamOffset(ramOffset, nodeAlign, ctx);
+            ctx->ramAlign = nodeAlign;
+#endif
+            // Return used amount of RAM, ROM and slots
+            hnode->slotCount = slotOffset;
             *ramSize = ramOffset;
             *romSize = romOffset;
+            *slotCount = slotOffset;
             break;
 
         case lNode:
             lnode = (lNode_t *)node;
 
             // First few bytes are used by CRC
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_COMPACT
+            lnode->crcOffset = 0;
             ramOffset += NODE_CRC_SIZE;
+#endif
             romOffset += NODE_CRC_SIZE;
 
-            initNode(lnode->element, &nodeRamSize, &nodeRomSize, ctx);
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_ALIGNED
+            padding = ctx->ramPadding;
+            initNode(lnode->element, &nodeRamSize, &nodeRomSize, &nodeSlotCount, ctx);
+            // Padding inside element is repeated by every element
+            if (lnode->hListSize > 0)
+                ctx->ramPadding += (ctx->ramPadding - padding) * (lnode->hListSize - 1);
+#else
+            initNode(lnode->element, &nodeRamSize, &nodeRomSize, &nodeSlotCount, ctx);
+#endif
             lnode->element->ramOffset = ramOffset;
             lnode->element->romOffset = romOffset;
+            lnode->element->slotOffset = slotOffset;
+            lnode->accessMask = lnode->element->accessMask;
             lnode->elementRamSize = nodeRamSize;
             lnode->elementRomSize = nodeRomSize;
+            lnode->elementSlotCount = nodeSlotCount;
             // Here ROM offset may be page-aligned for hierarchy nodes if necessary
             ramOffset += nodeRamSize * lnode->hListSize;
             romOffset += nodeRomSize * lnode->hListSize;
+            slotOffset += nodeSlotCount * lnode->hListSize;
 
-            // Return used amount of RAM and ROM
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_ALIGNED
+            // CRC follows elements. Alignment of the list is alignment of element
+            lnode->crcOffset = ramOffset;
+            ramOffset += NODE_CRC_SIZE;
+            ramOffset = alignRamOffset(ramOffset, ctx->ramAlign, ctx);
+#endif
+            // Return used amount of RAM, ROM and slots
             *ramSize = ramOffset;
             *romSize = romOffset;
+            *slotCount = slotOffset;
             break;
 
         case sNode:
             snode = (sNode_t *)node;
-            // Return used amount of RAM and ROM
+            snode->accessMask = ACCESS_MASK(snode->accessLevel);
+            // Return used amount of RAM, ROM and slots
             *ramSize = snode->size;
             *romSize = (snode->storage == RomStored) ? snode->size : 0;
+            *slotCount = 1;
+#if SETTINGS_RAM_LAYOUT == RAM_LAYOUT_ALIGNED
+            ctx->ramAlign = getValueAlign(snode);
+#endif
             break;
 
         default:
@@ -177,7 +457,7 @@ resultType initNode(node_t *node, uint32_t *ramSize, uint32_t *romSize, nodeInit
 }
 
 
-resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase, uint8_t useDefaults)
+resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase, uint8_t restoreMode)
 {
     hNode_t *hnode;
     lNode_t *lnode;
@@ -186,6 +466,7 @@ resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase
     uint32_t ramAddr, romAddr;
     resultType result, nodeResult, snodeResult;
     resultType crcCheckResult;
+    rqType rq;
     switch (node->type)
     {
         case hNode:
@@ -202,18 +483,16 @@ resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase
                 if (hnode->hList[i] == 0)
                     continue;
 #endif
-                pushArg(argHistory, SETTINGS_MAX_DEPTH, i);
                 ramAddr = nodeRamBase + hnode->hList[i]->ramOffset;
                 romAddr = nodeRomBase + hnode->hList[i]->romOffset;
-                nodeResult = validateNode(hnode->hList[i], ramAddr, romAddr, useDefaults);
-                popArg(argHistory, SETTINGS_MAX_DEPTH);
+                nodeResult = validateNode(hnode->hList[i], ramAddr, romAddr, restoreMode);
                 if (hnode->hList[i]->type == sNode)
                     snodeResult = (resultType)(snodeResult | nodeResult);
                 else
                     result = (resultType)(result | nodeResult);
             }
 
-            if (useDefaults)
+            if (restoreMode == RESTORE_DEFAULTS)
             {
                 // All nodes have been restored already. Update hnode CRC
                 updateNodeCRC((node_t *)hnode, nodeRamBase, nodeRomBase);
@@ -224,8 +503,10 @@ resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase
                 if (snodeResult == Result_OK)
                 {
                     // All snodes are valid. Restore and check hnode CRC
-                    readRom(nodeRamBase, nodeRomBase, NODE_CRC_SIZE);
-                    crcCheckResult = checkNodeCRC((node_t *)hnode, nodeRamBase);
+                    // CRC of image restored from verified bank is correct
+                    if (restoreMode == RESTORE_FROM_ROM)
+                        readRom(getCrcRamAddr(node, nodeRamBase), nodeRomBase, NODE_CRC_SIZE);
+                    crcCheckResult = (restoreMode == RESTORE_FROM_BANK) ? Result_OK : checkNodeCRC((node_t *)hnode, nodeRamBase);
                 }
                 if ((snodeResult != Result_OK) || (crcCheckResult != Result_OK))
                 {
@@ -234,11 +515,9 @@ resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase
                     {
                         if (hnode->hList[i]->type != sNode)
                             continue;
-                        pushArg(argHistory, SETTINGS_MAX_DEPTH, i);
                         ramAddr = nodeRamBase + hnode->hList[i]->ramOffset;
                         romAddr = nodeRomBase + hnode->hList[i]->romOffset;
-                        nodeResult = validateNode(hnode->hList[i], ramAddr, romAddr, 1);
-                        popArg(argHistory, SETTINGS_MAX_DEPTH);
+                        nodeResult = validateNode(hnode->hList[i], ramAddr, romAddr, RESTORE_DEFAULTS);
                     }
                     // Update hnode CRC
                     updateNodeCRC((node_t *)hnode, nodeRamBase, nodeRomBase);
@@ -256,18 +535,16 @@ resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase
             for (i=0; i<lnode->hListSize; i++)
             {
                 // Here ROM offset may be page-aligned for hierarchy nodes if necessary
-                pushArg(argHistory, SETTINGS_MAX_DEPTH, i);
                 ramAddr = nodeRamBase + lnode->element->ramOffset + (lnode->elementRamSize * i);
                 romAddr = nodeRomBase + lnode->element->romOffset + (lnode->elementRomSize * i);
-                nodeResult = validateNode(lnode->element, ramAddr, romAddr, useDefaults);
-                popArg(argHistory, SETTINGS_MAX_DEPTH);
+                nodeResult = validateNode(lnode->element, ramAddr, romAddr, restoreMode);
                 if (lnode->element->type == sNode)
                     snodeResult = (resultType)(snodeResult | nodeResult);
                 else
                     result = (resultType)(result | nodeResult);
             }
 
-            if (useDefaults)
+            if (restoreMode == RESTORE_DEFAULTS)
             {
                 // All nodes have been restored already. Update lnode CRC
                 updateNodeCRC((node_t *)lnode, nodeRamBase, nodeRomBase);
@@ -278,8 +555,9 @@ resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase
                 if (snodeResult == Result_OK)
                 {
                     // All snodes are valid. Restore and check lnode CRC
-                    readRom(nodeRamBase, nodeRomBase, NODE_CRC_SIZE);
-                    crcCheckResult = checkNodeCRC((node_t *)lnode, nodeRamBase);
+                    if (restoreMode == RESTORE_FROM_ROM)
+                        readRom(getCrcRamAddr(node, nodeRamBase), nodeRomBase, NODE_CRC_SIZE);
+                    crcCheckResult = (restoreMode == RESTORE_FROM_BANK) ? Result_OK : checkNodeCRC((node_t *)lnode, nodeRamBase);
                 }
                 if ((snodeResult != Result_OK) || (crcCheckResult != Result_OK))
                 {
@@ -288,11 +566,9 @@ resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase
                         if (lnode->element->type != sNode)
                             break;
                         // Here ROM offset may be page-aligned for hierarchy nodes if necessary
-                        pushArg(argHistory, SETTINGS_MAX_DEPTH, i);
                         ramAddr = nodeRamBase + lnode->element->ramOffset + (lnode->elementRamSize * i);
                         romAddr = nodeRomBase + lnode->element->romOffset + (lnode->elementRomSize * i);
-                        nodeResult = validateNode(lnode->element, ramAddr, romAddr, 1);
-                        popArg(argHistory, SETTINGS_MAX_DEPTH);
+                        nodeResult = validateNode(lnode->element, ramAddr, romAddr, RESTORE_DEFAULTS);
                     }
                     // Update hnode CRC
                     updateNodeCRC((node_t *)lnode, nodeRamBase, nodeRomBase);
@@ -304,7 +580,13 @@ resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase
         case sNode:
             snode = (sNode_t *)node;
             SETTINGS_ASSERT_TRUE(snode->rqHandler != 0);
-            result = snode->rqHandler((useDefaults) ? rqRestoreDefault : rqRestoreValidate, snode, nodeRamBase, nodeRomBase, 0);
+            if (restoreMode == RESTORE_DEFAULTS)
+                rq = rqRestoreDefault;
+            else if ((restoreMode == RESTORE_FROM_RAM) || (restoreMode == RESTORE_FROM_BANK))
+                rq = rqRestoreLoaded;
+            else
+                rq = rqRestoreValidate;
+            result = snode->rqHandler(rq, snode, nodeRamBase, nodeRomBase, 0);
             break;
 
         default:
@@ -316,6 +598,16 @@ resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase
 }
 
 
+// Get absolute RAM address of host node CRC
+static uint32_t getCrcRamAddr(node_t *node, uint32_t nodeRamBase)
+{
+    if (node->type == hNode)
+        return nodeRamBase + ((hNode_t *)node)->crcOffset;
+    SETTINGS_ASSERT_TRUE(node->type == lNode);
+    return nodeRamBase + ((lNode_t *)node)->crcOffset;
+}
+
+
 static uint32_t getNodeCrc(node_t *node, uint32_t nodeRamBase)
 {
     uint32_t crc = NODE_CRC_SEED;
@@ -340,7 +632,7 @@ static uint32_t getNodeCrc(node_t *node, uint32_t nodeRamBase)
                     snode = (sNode_t *)hnode->hList[i];
                     if (snode->storage == RomStored)
                     {
-                        crc = getCRC16(&ram[nodeRamBase + snode->ramOffset], snode->size, crc);
+                        crc = getValueCRC16(&ram[nodeRamBase + snode->ramOffset], snode->size, VALUE_SWAP_SIZE(snode), crc);
                     }
                 }
             }
@@ -353,7 +645,8 @@ static uint32_t getNodeCrc(node_t *node, uint32_t nodeRamBase)
                 snode = (sNode_t *)lnode->element;
                 if (snode->storage == RomStored)
                 {
-                    crc = getCRC16(&ram[nodeRamBase + snode->ramOffset], lnode->elementRamSize * lnode->hListSize, crc);
+                    crc = getValueCRC16(&ram[nodeRamBase + snode->ramOffset], lnode->elementRamSize * lnode->hListSize,
+                                        VALUE_SWAP_SIZE(snode), crc);
                 }
             }
             break;
@@ -376,8 +669,8 @@ static void updateNodeCRC(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBa
             // Get CRC for current data
             crc = getNodeCrc(node, nodeRamBase);
             // Update stored CRC
-            u32toBytesMsbFirst(&crc, &ram[nodeRamBase], NODE_CRC_SIZE);
-            writeRom(nodeRomBase, nodeRamBase, NODE_CRC_SIZE);
+            u32toBytesMsbFirst(&crc, &ram[getCrcRamAddr(node, nodeRamBase)], NODE_CRC_SIZE);
+            writeRom(nodeRomBase, getCrcRamAddr(node, nodeRamBase), NODE_CRC_SIZE);
             //SETTINGS_DEBUG("CRC update at %d", nodeRamBase + cnode->ownSize);
             break;
 
@@ -397,7 +690,7 @@ static resultType checkNodeCRC(node_t *node, uint32_t nodeRamBase)
         case hNode:
         case lNode:
             // Get stored CRC
-            bytesToU32MsbFirst(&ram[nodeRamBase], &storedCrc, NODE_CRC_SIZE);
+            bytesToU32MsbFirst(&ram[getCrcRamAddr(node, nodeRamBase)], &storedCrc, NODE_CRC_SIZE);
             // Get CRC for current data
             crc = getNodeCrc(node, nodeRamBase);
             if (crc != storedCrc)
@@ -431,8 +724,8 @@ resultType invalidateNodeCrc(node_t *node, uint32_t nodeRamBase, uint32_t nodeRo
         case hNode:
             hnode = (hNode_t *)node;
             // Set invalid CRC
-            memset(&ram[nodeRamBase], 0, NODE_CRC_SIZE);
-            writeRom(nodeRomBase, nodeRamBase, NODE_CRC_SIZE);
+            memset(&ram[getCrcRamAddr(node, nodeRamBase)], 0, NODE_CRC_SIZE);
+            writeRom(nodeRomBase, getCrcRamAddr(node, nodeRamBase), NODE_CRC_SIZE);
             result = (resultType)(result | Result_UpdatedRom);
             if (!wholeTree)
                 break;
@@ -445,19 +738,17 @@ resultType invalidateNodeCrc(node_t *node, uint32_t nodeRamBase, uint32_t nodeRo
                 if (hnode->hList[i] == 0)
                     continue;
 #endif
-                pushArg(argHistory, SETTINGS_MAX_DEPTH, i);
                 ramAddr = nodeRamBase + hnode->hList[i]->ramOffset;
                 romAddr = nodeRomBase + hnode->hList[i]->romOffset;
                 result = (resultType)(result | invalidateNodeCrc(hnode->hList[i], ramAddr, romAddr, wholeTree));
-                popArg(argHistory, SETTINGS_MAX_DEPTH);
             }
             break;
 
         case lNode:
             lnode = (lNode_t *)node;
             // Set invalid CRC
-            memset(&ram[nodeRamBase], 0, NODE_CRC_SIZE);
-            writeRom(nodeRomBase, nodeRamBase, NODE_CRC_SIZE);
+            memset(&ram[getCrcRamAddr(node, nodeRamBase)], 0, NODE_CRC_SIZE);
+            writeRom(nodeRomBase, getCrcRamAddr(node, nodeRamBase), NODE_CRC_SIZE);
             result = (resultType)(result | Result_UpdatedRom);
             if (!wholeTree)
                 break;
@@ -465,11 +756,9 @@ resultType invalidateNodeCrc(node_t *node, uint32_t nodeRamBase, uint32_t nodeRo
             for (i=0; i<lnode->hListSize; i++)
             {
                 // Here ROM offset may be page-aligned for hierarchy nodes if necessary
-                pushArg(argHistory, SETTINGS_MAX_DEPTH, i);
                 ramAddr = nodeRamBase + lnode->element->ramOffset + (lnode->elementRamSize * i);
                 romAddr = nodeRomBase + lnode->element->romOffset + (lnode->elementRomSize * i);
                 result = (resultType)(result | invalidateNodeCrc(lnode->element, ramAddr, romAddr, wholeTree));
-                popArg(argHistory, SETTINGS_MAX_DEPTH);
             }
             break;
 
@@ -486,280 +775,3047 @@ resultType invalidateNodeCrc(node_t *node, uint32_t nodeRamBase, uint32_t nodeRo
 
 //-----------------------------------------------------------------//
 //-----------------------------------------------------------------//
-// CRC
+// ROM image
 //-----------------------------------------------------------------//
 //-----------------------------------------------------------------//
 
-void makeCRC16Table(void)
+// Get hash of ROM layout of the tree
+// Any change of node types, list sizes or sizes of ROM stored values changes the hash
+uint16_t getTreeHash(node_t *node, uint16_t crc)
 {
-    uint16_t r;
-    uint32_t i,j;
-    for(i=0; i<256; i++)
+    hNode_t *hnode;
+    lNode_t *lnode;
+    sNode_t *snode;
+    uint16_t i;
+    uint32_t value;
+    uint8_t buffer[5];
+    buffer[0] = (uint8_t)node->type;
+    switch (node->type)
     {
-        r = i << 8;
-        for(j=0; j<8; j++)
-        {
-            if (r & (1 << 15))
-                r = (r << 1) ^ 0x8005;
-            else
-                r <<= 1;
-        }
-        crcTable[i] = r;
-   }
-}
+        case hNode:
+            hnode = (hNode_t *)node;
+            value = hnode->hListSize;
+            u32toBytesMsbFirst(&value, &buffer[1], 4);
+            crc = getCRC16(buffer, sizeof(buffer), crc);
+            for (i=0; i<hnode->hListSize; i++)
+            {
+                if (hnode->hList[i] == 0)
+                    continue;
+                crc = getTreeHash(hnode->hList[i], crc);
+            }
+            break;
 
+        case lNode:
+            lnode = (lNode_t *)node;
+            value = lnode->hListSize;
+            u32toBytesMsbFirst(&value, &buffer[1], 4);
+            crc = getCRC16(buffer, sizeof(buffer), crc);
+            crc = getTreeHash(lnode->element, crc);
+            break;
 
-uint16_t getCRC16(uint8_t *data, uint16_t len, uint16_t crc)
-{
-    while(len--)
-    {
-        crc = crcTable[((crc>>8)^*data++) & 0xFF] ^ (crc<<8);
+        case sNode:
+            snode = (sNode_t *)node;
+            value = (snode->storage == RomStored) ? snode->size : 0;
+            u32toBytesMsbFirst(&value, &buffer[1], 4);
+            crc = getCRC16(buffer, sizeof(buffer), crc);
+            break;
+
+        default:
+            SETTINGS_ASSERT_NEVER_EXECUTE();
+            break;
     }
     return crc;
 }
 
 
-//-----------------------------------------------------------------//
-//-----------------------------------------------------------------//
-// Public
-//-----------------------------------------------------------------//
-//-----------------------------------------------------------------//
+// Write ROM image header for current tree
+void writeRomHeader(uint32_t treeRomSize)
+{
+    uint8_t header[ROM_HEADER_SIZE];
+    uint32_t value;
+    value = SETTINGS_ROM_FORMAT_VERSION;
+    u32toBytesMsbFirst(&value, &header[ROM_HEADER_VERSION_OFFSET], 2);
+    value = getTreeHash((node_t *)hRoot, NODE_CRC_SEED);
+    u32toBytesMsbFirst(&value, &header[ROM_HEADER_HASH_OFFSET], 2);
+    u32toBytesMsbFirst(&treeRomSize, &header[ROM_HEADER_LENGTH_OFFSET], 4);
+    value = getCRC16(header, ROM_HEADER_CRC_OFFSET, NODE_CRC_SEED);
+    u32toBytesMsbFirst(&value, &header[ROM_HEADER_CRC_OFFSET], NODE_CRC_SIZE);
+    writeRomData(0, header, ROM_HEADER_SIZE);
+}
 
-resultType settingsRequest(request_t *rqst)
+
+// Check ROM image header and restore all ROM stored values and CRCs to RAM
+// Values are not validated, validateNode() with RESTORE_FROM_RAM must be called after
+// Result_LegacyImage is returned if image has no header, but has been written for the same tree
+// before header was added. Such image must be saved again by settingsSaveImage()
+resultType settingsLoadImage(uint32_t treeRomSize)
 {
-    node_t *pNode = (node_t *)hRoot;
-    hNode_t *nnode = 0;
-    lNode_t *lnode = 0;
-    node_t *pHostNode = (node_t *)hRoot;                // Should be updated before use
-    uint32_t hostNodeRamOffset = hRoot->ramOffset;      // Should be updated before use
-    uint32_t hostNodeRomOffset = hRoot->romOffset;      // Should be updated before use
-    uint32_t currArg, argIndex = 0;
-    uint32_t ramOffset = hRoot->ramOffset;
-    uint32_t romOffset = hRoot->romOffset;
+    uint8_t header[ROM_HEADER_SIZE];
+    uint32_t value, crc;
     resultType result = Result_OK;
+    readRomData(0, header, ROM_HEADER_SIZE);
+    bytesToU32MsbFirst(&header[ROM_HEADER_CRC_OFFSET], &crc, NODE_CRC_SIZE);
+    if (crc != getCRC16(header, ROM_HEADER_CRC_OFFSET, NODE_CRC_SEED))
+        result = Result_ImageMismatch;
+    bytesToU32MsbFirst(&header[ROM_HEADER_VERSION_OFFSET], &value, 2);
+    if (value != SETTINGS_ROM_FORMAT_VERSION)
+        result = Result_ImageMismatch;
+    bytesToU32MsbFirst(&header[ROM_HEADER_HASH_OFFSET], &value, 2);
+    if (value != getTreeHash((node_t *)hRoot, NODE_CRC_SEED))
+        result = Result_ImageMismatch;
+    bytesToU32MsbFirst(&header[ROM_HEADER_LENGTH_OFFSET], &value, 4);
+    if (value != treeRomSize)
+        result = Result_ImageMismatch;
 
-    // Move through the node tree according to the argument list
-    while(pNode->type != sNode)
+    if (result == Result_OK)
     {
-        if (argIndex >= SETTINGS_MAX_DEPTH - 1)
-        {
-            result = Result_DepthExceeded;
+        loadImagePayload(hRoot->romOffset, treeRomSize);
+        return Result_OK;
+    }
+#if LEGACY_IMAGE_MIGRATION == 1
+    // Legacy image has the same layout placed at address 0
+    // It is accepted only if CRCs of all host nodes match, so that erased ROM or image of another tree is rejected
+    loadImagePayload(0, treeRomSize);
+    if (checkTreeCRC((node_t *)hRoot, hRoot->ramOffset) == Result_OK)
+        return Result_LegacyImage;
+#endif
+    return Result_ImageMismatch;
+}
+
+
+// Restore all ROM stored values and CRCs to RAM from image placed at given address
+static void loadImagePayload(uint32_t romAddr, uint32_t treeRomSize)
+{
+    romStream_t stream;
+    stream.romAddr = romAddr;
+    stream.romEnd = romAddr + treeRomSize;
+    stream.count = 0;
+    stream.pos = 0;
+    stream.save = 0;
+    streamNode((node_t *)hRoot, hRoot->ramOffset, romAddr, &stream);
+}
+
+
+#if LEGACY_IMAGE_MIGRATION == 1
+// Check CRCs of a host node and all host nodes below it
+static resultType checkTreeCRC(node_t *node, uint32_t nodeRamBase)
+{
+    hNode_t *hnode;
+    lNode_t *lnode;
+    uint16_t i;
+    if (checkNodeCRC(node, nodeRamBase) != Result_OK)
+        return Result_ValidateError;
+    switch (node->type)
+    {
+        case hNode:
+            hnode = (hNode_t *)node;
+            for (i=0; i<hnode->hListSize; i++)
+            {
+                if ((hnode->hList[i] == 0) || (hnode->hList[i]->type == sNode))
+                    continue;
+                if (checkTreeCRC(hnode->hList[i], nodeRamBase + hnode->hList[i]->ramOffset) != Result_OK)
+                    return Result_ValidateError;
+            }
             break;
-        }
-        currArg = rqst->arg[argIndex++];
-        pushArg(argHistory, SETTINGS_MAX_DEPTH, currArg);
-        switch(pNode->type)
-        {
-            case hNode:
-                pHostNode = pNode;                  // Save hNode for CRC update if required by sNode request handler
-                hostNodeRamOffset = ramOffset;      // Save RAM address
-                hostNodeRomOffset = romOffset;      // Save ROM address
-                nnode = (hNode_t *)pNode;
-                SETTINGS_ASSERT_TRUE(currArg < nnode->hListSize);
-                SETTINGS_ASSERT_TRUE(nnode->hList);
-                pNode = nnode->hList[currArg];
-                SETTINGS_ASSERT_TRUE(pNode);
-                ramOffset += pNode->ramOffset;
-                romOffset += pNode->romOffset;
-                break;
 
-            case lNode:
-                pHostNode = pNode;                  // Save lNode for CRC update if required by sNode request handler
-                hostNodeRamOffset = ramOffset;      // Save RAM address
-                hostNodeRomOffset = romOffset;      // Save ROM address
-                lnode = (lNode_t *)pNode;
-                SETTINGS_ASSERT_TRUE(currArg < lnode->hListSize);
-                pNode = lnode->element;
-                SETTINGS_ASSERT_TRUE(pNode);
-                ramOffset += lnode->element->ramOffset + lnode->elementRamSize * currArg;
-                romOffset += lnode->element->romOffset + lnode->elementRomSize * currArg;
+        case lNode:
+            lnode = (lNode_t *)node;
+            if (lnode->element->type == sNode)
                 break;
+            for (i=0; i<lnode->hListSize; i++)
+            {
+                if (checkTreeCRC(lnode->element, nodeRamBase + lnode->element->ramOffset + (lnode->elementRamSize * i)) != Result_OK)
+                    return Result_ValidateError;
+            }
+            break;
 
-            default:
-                SETTINGS_ASSERT_NEVER_EXECUTE();
-                result = Result_UnknownNodeType;
-                break;
-        }
-    }
-    if (result == Result_OK)
-    {
-        // Terminating node is found
-        SETTINGS_ASSERT_TRUE(((sNode_t *)pNode)->rqHandler);
-        result = ((sNode_t *)pNode)->rqHandler(rqst->rq, (sNode_t *)pNode, ramOffset, romOffset, rqst);
-        if (result & Result_UpdatedRom)
-        {
-            // Hide ROM flag
-            result = (resultType)(result & ~Result_UpdatedRom);
-            updateNodeCRC(pHostNode, hostNodeRamOffset, hostNodeRomOffset);
-        }
+        default:
+            SETTINGS_ASSERT_NEVER_EXECUTE();
+            break;
     }
-    rqst->result = result;
-    return result;
+    return Result_OK;
 }
+#endif
 
 
-static void pushArg(uint32_t *argHistory, uint32_t argHistorySize, uint32_t arg)
+// Write header and all ROM stored values and CRCs from RAM to ROM as a sequential stream
+void settingsSaveImage(uint32_t treeRomSize)
 {
-    uint32_t i;
-    for (i=argHistorySize-1; i>0; i--)
-    {
-        argHistory[i] = argHistory[i - 1];
-    }
-    argHistory[0] = arg;
+    romStream_t stream;
+    writeRomHeader(treeRomSize);
+    stream.romAddr = hRoot->romOffset;
+    stream.romEnd = hRoot->romOffset + treeRomSize;
+    stream.count = 0;
+    stream.pos = 0;
+    stream.save = 1;
+    streamNode((node_t *)hRoot, hRoot->ramOffset, hRoot->romOffset, &stream);
+    streamFlush(&stream);
+    SETTINGS_ASSERT_TRUE(stream.romAddr == stream.romEnd);
 }
 
 
-static void popArg(uint32_t *argHistory, uint32_t argHistorySize)
+// Move node data between RAM and ROM stream
+// Nodes are visited in the same order as initNode() places them in ROM, so stream is never rewound
+static void streamNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase, romStream_t *stream)
 {
-    uint32_t i;
-    for (i=0; i<argHistorySize-1; i++)
+    hNode_t *hnode;
+    lNode_t *lnode;
+    sNode_t *snode;
+    uint16_t i;
+    // Stream position must follow the ROM layout
+    SETTINGS_ASSERT_TRUE(stream->romAddr + (stream->save ? stream->count : stream->pos) == nodeRomBase);
+    switch (node->type)
     {
-        argHistory[i] = argHistory[i + 1];
+        case hNode:
+            hnode = (hNode_t *)node;
+            streamData(stream, getCrcRamAddr(node, nodeRamBase), NODE_CRC_SIZE, 1);
+            // Terminating nodes are placed first
+            for (i=0; i<hnode->hListSize; i++)
+            {
+                if ((hnode->hList[i] == 0) || (hnode->hList[i]->type != sNode))
+                    continue;
+                snode = (sNode_t *)hnode->hList[i];
+                if (snode->storage == RomStored)
+                    streamData(stream, nodeRamBase + snode->ramOffset, snode->size, VALUE_SWAP_SIZE(snode));
+            }
+            // Hierarchy and list nodes follow
+            for (i=0; i<hnode->hListSize; i++)
+            {
+                if ((hnode->hList[i] == 0) || (hnode->hList[i]->type == sNode))
+                    continue;
+                streamNode(hnode->hList[i], nodeRamBase + hnode->hList[i]->ramOffset, nodeRomBase + hnode->hList[i]->romOffset, stream);
+            }
+            break;
+
+        case lNode:
+            lnode = (lNode_t *)node;
+            streamData(stream, getCrcRamAddr(node, nodeRamBase), NODE_CRC_SIZE, 1);
+            if (lnode->element->type == sNode)
+            {
+                snode = (sNode_t *)lnode->element;
+                if (snode->storage == RomStored)
+                    streamData(stream, nodeRamBase + snode->ramOffset, lnode->elementRamSize * lnode->hListSize, VALUE_SWAP_SIZE(snode));
+            }
+            else
+            {
+                for (i=0; i<lnode->hListSize; i++)
+                {
+                    streamNode(lnode->element, nodeRamBase + lnode->element->ramOffset + (lnode->elementRamSize * i),
+                               nodeRomBase + lnode->element->romOffset + (lnode->elementRomSize * i), stream);
+                }
+            }
+            break;
+
+        default:
+            SETTINGS_ASSERT_NEVER_EXECUTE();
+            break;
     }
-    argHistory[argHistorySize - 1] = 0;
 }
 
 
-// Get argument from request.
-// Index of 0 returns last argument,
-// index of 1 returns argument before last one and so on up to first argument
-// Intended use: determining address of an element in a multydimensional list
-uint32_t getRequestArg(uint32_t historyIndex)
+// Copy data between RAM and stream buffer
+// Buffer is written to or read from ROM as soon as it is full or empty
+// Data is an array of values of given size, which byte order is converted if it differs in RAM and ROM
+static void streamData(romStream_t *stream, uint32_t ramAddr, uint32_t count, uint32_t size)
 {
-    SETTINGS_ASSERT_TRUE(historyIndex < SETTINGS_MAX_DEPTH);
-    return argHistory[historyIndex];
+    uint32_t n;
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+    uint32_t start = ramAddr, total = count;
+#else
+    // Byte order is the same in RAM and ROM
+    (void)size;
+#endif
+    while (count)
+    {
+        if (stream->save)
+        {
+            n = SETTINGS_ROM_STREAM_CHUNK - stream->count;
+            n = (count < n) ? count : n;
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+            if (size > 1)
+            {
+                // Values are not split between blocks
+                n -= n % size;
+                if (n == 0)
+                {
+                    streamFlush(stream);
+                    continue;
+                }
+            }
+#endif
+            memcpy(&stream->data[stream->count], &ram[ramAddr], n);
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+            if (size > 1)
+                swapValues(&stream->data[stream->count], n, size);
+#endif
+            stream->count += n;
+            if (stream->count == SETTINGS_ROM_STREAM_CHUNK)
+                streamFlush(stream);
+        }
+        else
+        {
+            if (stream->pos == stream->count)
+            {
+                // Read next block
+                stream->romAddr += stream->count;
+                stream->count = stream->romEnd - stream->romAddr;
+                stream->count = (stream->count < SETTINGS_ROM_STREAM_CHUNK) ? stream->count : SETTINGS_ROM_STREAM_CHUNK;
+                stream->pos = 0;
+                SETTINGS_ASSERT_TRUE(stream->count);
+                readRomData(stream->romAddr, stream->data, stream->count);
+            }
+            n = stream->count - stream->pos;
+            n = (count < n) ? count : n;
+            memcpy(&ram[ramAddr], &stream->data[stream->pos], n);
+            stream->pos += n;
+        }
+        ramAddr += n;
+        count -= n;
+    }
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+    // Loaded values are converted in place, image is loaded before any concurrent access
+    if (!stream->save && (size > 1))
+        swapValues(&ram[start], total, size);
+#endif
 }
 
 
-// Get cached values for callback functions
-// Intended use: using new value for change event
-// Every handler should use cache as appropriate
-callbackCache_t *getCallbackCache(void)
+// Write buffered data to ROM
+static void streamFlush(romStream_t *stream)
 {
-    return &callbackCache;
+    if (stream->count == 0)
+        return;
+    writeRomData(stream->romAddr, stream->data, stream->count);
+    stream->romAddr += stream->count;
+    stream->count = 0;
 }
 
 
 //-----------------------------------------------------------------//
 //-----------------------------------------------------------------//
-// Public helpers
+// Integer values
 //-----------------------------------------------------------------//
 //-----------------------------------------------------------------//
-#if USE_SETTINGS_MEMORY_ALLOC == 1
-// Simple memory management
-void *settingsAlloc(uint32_t size)
+
+// Get integer value from RAM
+static uint32_t loadValue(const uint8_t *data, uint32_t size)
 {
-    void *pRam = &allocRam[allocRamAddr];
-    uint32_t nextAddr = allocRamAddr + size;
-    if (nextAddr <= allocRamSize)
+    uint32_t value = 0;
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+    switch (size)
     {
-        // OK
-        allocRamAddr = nextAddr;
-        memset(pRam, 0, size);
+        case 1:
+            value = data[0];
+            break;
+        case 2:
+            value = settingsRamLoad16(data);
+            break;
+        case 4:
+            value = settingsRamLoad32(data);
+            break;
+        default:
+            // Little-endian value of any size is a prefix of 32-bit one
+            memcpy(&value, data, size);
+            break;
     }
+#else
+    bytesToU32MsbFirst((uint8_t *)data, &value, size);
+#endif
+    return value;
+}
+
+
+// Put integer value to RAM
+static void storeValue(uint32_t value, uint8_t *data, uint32_t size)
+{
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+    uint16_t value16;
+    switch (size)
+    {
+        case 1:
+            data[0] = (uint8_t)value;
+            break;
+        case 2:
+            value16 = (uint16_t)value;
+            memcpy(data, &value16, 2);
+            break;
+        default:
+            memcpy(data, &value, size);
+            break;
+    }
+#else
+    u32toBytesMsbFirst(&value, data, size);
+#endif
+}
+
+
+// Copy integer value from ROM to RAM
+static void readRomValue(uint32_t ramAddr, uint32_t romAddr, uint32_t size)
+{
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+    uint8_t buffer[8];
+    SETTINGS_ASSERT_TRUE(size <= 8);
+    readRomData(romAddr, buffer, size);
+    if (size == 8)
+        storeValue64(getRawValue64(buffer), &ram[ramAddr]);
+    else
+        storeValue(getRawValue(buffer, size), &ram[ramAddr], size);
+#else
+    readRom(ramAddr, romAddr, size);
+#endif
+}
+
+
+// Copy integer value from RAM to ROM
+static void writeRomValue(uint32_t romAddr, uint32_t ramAddr, uint32_t size)
+{
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+    uint8_t buffer[8];
+    SETTINGS_ASSERT_TRUE(size <= 8);
+    if (size == 8)
+        putRawValue64(loadValue64(&ram[ramAddr]), buffer);
     else
+        putRawValue(loadValue(&ram[ramAddr], size), buffer, size);
+    writeRomData(romAddr, buffer, size);
+#else
+    writeRom(romAddr, ramAddr, size);
+#endif
+}
+
+
+// Get 8-bit to 32-bit signed value from its bits
+static int32_t signExtend(uint32_t value, uint32_t size)
+{
+    switch (size)
     {
-        // Out of memory
-        pRam = 0;
+        case 1:
+            return (int8_t)value;
+        case 2:
+            return (int16_t)value;
+        default:
+            return (int32_t)value;
     }
-    return pRam;
 }
 
 
-uint32_t getAllocMemoryUsed(void)
+// Get 64-bit value from RAM
+static uint64_t loadValue64(const uint8_t *data)
 {
-    return allocRamAddr;
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+    return settingsRamLoad64(data);
+#else
+    return ((uint64_t)loadValue(data, 4) << 32) | loadValue(&data[4], 4);
+#endif
 }
+
+
+// Put 64-bit value to RAM
+static void storeValue64(uint64_t value, uint8_t *data)
+{
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+    memcpy(data, &value, 8);
+#else
+    storeValue((uint32_t)(value >> 32), data, 4);
+    storeValue((uint32_t)value, &data[4], 4);
 #endif
+}
 
 
-#if ENABLE_NODE_CONSTRUCTORS == 1
-sNode_t *createSNode(uint16_t size)
+// Floating point values are kept in RAM and ROM as integers of the same size and bits
+static float loadF32(const uint8_t *data)
 {
-    sNode_t *snode = (sNode_t *)SETTINGS_ALLOCATE(sizeof(sNode_t));
-    SETTINGS_ASSERT_TRUE(snode != 0);
-    snode->type = sNode;
-    snode->size = size;
-    return snode;
+    return settingsBitsToF32(loadValue(data, 4));
 }
 
 
-hNode_t *createHNode(uint16_t elementsCount)
+static void storeF32(float value, uint8_t *data)
 {
-    hNode_t *hnode = (hNode_t *)SETTINGS_ALLOCATE(sizeof(hNode_t));
-    SETTINGS_ASSERT_TRUE(hnode != 0);
-    hnode->type = hNode;
-    hnode->hList = (node_t **)SETTINGS_ALLOCATE(elementsCount * sizeof(node_t *));
-    hnode->hListSize = elementsCount;
-    SETTINGS_ASSERT_TRUE(hnode->hList != 0);
-    return hnode;
+    storeValue(f32ToBits(value), data, 4);
 }
 
 
-lNode_t *createLNode(uint16_t elementsCount, void *node)
+static double loadF64(const uint8_t *data)
 {
-    lNode_t *lnode = (lNode_t *)SETTINGS_ALLOCATE(sizeof(lNode_t));
-    SETTINGS_ASSERT_TRUE(lnode != 0);
-    lnode->type = lNode;
-    lnode->element = (node_t *)node;
-    lnode->hListSize = elementsCount;
-    return lnode;
+    return settingsBitsToF64(loadValue64(data));
 }
 
 
-void addToHList(hNode_t *hnode, uint32_t index, void *node)
+static void storeF64(double value, uint8_t *data)
 {
-    if (index < hnode->hListSize)
+    storeValue64(f64ToBits(value), data);
+}
+
+
+static uint32_t f32ToBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    return bits;
+}
+
+
+static uint64_t f64ToBits(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    return bits;
+}
+
+
+// Get value from raw form, which is MSB first
+static uint32_t getRawValue(uint8_t *raw, uint32_t size)
+{
+    uint32_t value;
+    bytesToU32MsbFirst(raw, &value, size);
+    return value;
+}
+
+
+// Put value to raw form
+static void putRawValue(uint32_t value, uint8_t *raw, uint32_t size)
+{
+    u32toBytesMsbFirst(&value, raw, size);
+}
+
+
+static uint64_t getRawValue64(uint8_t *raw)
+{
+    uint64_t value;
+    bytesToU64MsbFirst(raw, &value);
+    return value;
+}
+
+
+static void putRawValue64(uint64_t value, uint8_t *raw)
+{
+    u64toBytesMsbFirst(&value, raw);
+}
+
+
+// Get range of blob value addressed by request
+// Returns 0 if range does not fit value of given size
+static uint8_t getBlobRange(uint32_t size, request_t *rqst, uint32_t *offset, uint32_t *length)
+{
+    if (rqst->offset > size)
+        return 0;
+    *offset = rqst->offset;
+    *length = (rqst->length != 0) ? rqst->length : size - rqst->offset;
+    return (*length <= size - *offset);
+}
+
+
+// Get CRC of values as they are stored in ROM
+// Data is an array of values of given size, size 1 means that byte order is the same in RAM and ROM
+static uint16_t getValueCRC16(uint8_t *data, uint32_t count, uint32_t size, uint16_t crc)
+{
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+    uint8_t buffer[VALUE_SWAP_BUFFER_SIZE];
+    uint32_t n;
+    if (size > 1)
     {
-        if (hnode->hList[index] == 0)
+        while (count)
         {
-            hnode->hList[index] = (node_t *)node;
+            n = (count < sizeof(buffer)) ? count : sizeof(buffer) - sizeof(buffer) % size;
+            memcpy(buffer, data, n);
+            swapValues(buffer, n, size);
+            crc = getCRC16(buffer, (uint16_t)n, crc);
+            data += n;
+            count -= n;
         }
-        else
+        return crc;
+    }
+#else
+    // Byte order is the same in RAM and ROM
+    (void)size;
+#endif
+    return getCRC16(data, (uint16_t)count, crc);
+}
+
+
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+// Reverse byte order of every value in place
+// Loops for 16-bit and 32-bit values are vectorized by compiler if target has byte shuffle instructions
+// (e.g. SSSE3, NEON), so bulk images are converted fast
+static void swapValues(uint8_t *data, uint32_t count, uint32_t size)
+{
+    uint32_t i, j;
+    uint32_t value32;
+    uint16_t value16;
+    uint8_t temp;
+    switch (size)
+    {
+        case 2:
+            for (i=0; i<count/2; i++)
+            {
+                memcpy(&value16, &data[i * 2], 2);
+                value16 = (uint16_t)((value16 >> 8) | (value16 << 8));
+                memcpy(&data[i * 2], &value16, 2);
+            }
+            break;
+        case 4:
+            for (i=0; i<count/4; i++)
+            {
+                memcpy(&value32, &data[i * 4], 4);
+                value32 = (value32 >> 24) | ((value32 >> 8) & 0x0000FF00) | ((value32 << 8) & 0x00FF0000) | (value32 << 24);
+                memcpy(&data[i * 4], &value32, 4);
+            }
+            break;
+        default:
+            for (i=0; i<count; i+=size)
+            {
+                for (j=0; j<size/2; j++)
+                {
+                    temp = data[i + j];
+                    data[i + j] = data[i + size - 1 - j];
+                    data[i + size - 1 - j] = temp;
+                }
+            }
+            break;
+    }
+}
+#endif  // SETTINGS_RAM_NATIVE_ENDIAN
+
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// CRC
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+void makeCRC16Table(void)
+{
+    uint16_t r;
+    uint32_t i,j;
+    for(i=0; i<256; i++)
+    {
+        r = i << 8;
+        for(j=0; j<8; j++)
         {
-            SETTINGS_ASSERT_NEVER_EXECUTE();
+            if (r & (1 << 15))
+                r = (r << 1) ^ 0x8005;
+            else
+                r <<= 1;
+        }
+        crcTable[0][i] = r;
+   }
+    // Slice tables: table k holds CRC of a byte followed by k zero bytes
+    for(j=1; j<CRC16_SLICE_COUNT; j++)
+    {
+        for(i=0; i<256; i++)
+        {
+            r = crcTable[j - 1][i];
+            crcTable[j][i] = crcTable[0][r >> 8] ^ (uint16_t)(r << 8);
         }
     }
-    else
+#if USE_INCREMENTAL_CRC == 1
+    // Shift table: entry k holds x^(8 * 2^k) mod P, i.e. effect of 2^k zero bytes on CRC
+    crcShiftTable[0] = 0x0100;
+    for(i=1; i<32; i++)
     {
-        SETTINGS_ASSERT_NEVER_EXECUTE();
+        crcShiftTable[i] = mulModCRC16(crcShiftTable[i - 1], crcShiftTable[i - 1]);
     }
+#endif
 }
 
-#endif  // ENABLE_NODE_CONSTRUCTORS
 
-//-----------------------------------------------------------------//
-//-----------------------------------------------------------------//
-//-----------------------------------------------------------------//
-//-----------------------------------------------------------------//
+uint16_t getCRC16(uint8_t *data, uint16_t len, uint16_t crc)
+{
+#if CRC16_SLICE_COUNT == 8
+    while(len >= 8)
+    {
+        crc = crcTable[7][data[0] ^ (crc >> 8)] ^ crcTable[6][data[1] ^ (crc & 0xFF)] ^
+              crcTable[5][data[2]] ^ crcTable[4][data[3]] ^
+              crcTable[3][data[4]] ^ crcTable[2][data[5]] ^
+              crcTable[1][data[6]] ^ crcTable[0][data[7]];
+        data += 8;
+        len -= 8;
+    }
+#elif CRC16_SLICE_COUNT == 4
+    while(len >= 4)
+    {
+        crc = crcTable[3][data[0] ^ (crc >> 8)] ^ crcTable[2][data[1] ^ (crc & 0xFF)] ^
+              crcTable[1][data[2]] ^ crcTable[0][data[3]];
+        data += 4;
+        len -= 4;
+    }
+#elif CRC16_SLICE_COUNT != 1
+#error "Unsupported CRC16_SLICE_COUNT"
+#endif
+    while(len--)
+    {
+        crc = crcTable[0][((crc>>8)^*data++) & 0xFF] ^ (crc<<8);
+    }
+    return crc;
+}
+
+
+#if USE_INCREMENTAL_CRC == 1
+// Multiply two polynomials modulo CRC16 polynomial
+static uint16_t mulModCRC16(uint16_t a, uint16_t b)
+{
+    uint16_t r = 0;
+    int32_t i;
+    for(i=15; i>=0; i--)
+    {
+        r = (r & (1 << 15)) ? (uint16_t)((r << 1) ^ 0x8005) : (uint16_t)(r << 1);
+        if (b & (1 << i))
+            r ^= a;
+    }
+    return r;
+}
+
+
+// Get CRC of data followed by a number of zero bytes, given CRC of the data only
+// Takes O(log(zeroBytes)) steps
+uint16_t shiftCRC16(uint16_t crc, uint32_t zeroBytes)
+{
+    uint32_t i;
+    for(i=0; (zeroBytes != 0) && (crc != 0); i++, zeroBytes >>= 1)
+    {
+        if (zeroBytes & 0x01)
+            crc = mulModCRC16(crc, crcShiftTable[i]);
+    }
+    return crc;
+}
+#endif
+
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// Public
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+resultType settingsRequest(request_t *rqst)
+{
+    slot_t slot;
+    nodeTrail_t trail;
+    resultType result;
+
+    lockWriter(rqst->rq);
+    // Move through the node tree according to the argument list
+    initTrail(&trail);
+    result = locateNode(rqst, &slot, &trail);
+#if ENABLE_TRANSACTIONS == 1
+    if ((result == Result_OK) && TXN_STAGED(rqst->rq) && txnActive)
+    {
+        result = stageRequest(&slot, rqst);
+        unlockWriter(rqst->rq);
+        rqst->result = result;
+        return result;
+    }
+#endif
+    if (result == Result_OK)
+    {
+#if USE_INCREMENTAL_CRC == 1
+        if (requestModifiesRam(rqst->rq))
+            slot.crcTail = getCrcTail(&slot);
+#endif
+        result = runRequest(&slot, rqst, 0);
+    }
+    unlockWriter(rqst->rq);
+    rqst->result = result;
+    return result;
+}
+
+
+// Host node flags used by settingsRequestBatch()
+#define HOST_RAM_MODIFIED       0x01
+#define HOST_ROM_UPDATED        0x02
+
+// Run a number of requests
+// Requests are executed in order of their paths, so that tree walk is shared by requests with common leading arguments.
+// CRC of every affected host node is updated once, and ROM writes are deferred and coalesced into contiguous ranges.
+// Requests to the same node are executed in given order. Results are returned by every request,
+// function returns first error in order of execution or Result_OK
+// Within a transaction write requests are staged one by one, like by settingsRequest()
+resultType settingsRequestBatch(request_t *rqs, uint32_t n)
+{
+    resultType result;
+    lockWriter(rqWrite);
+#if ENABLE_TRANSACTIONS == 1
+    if (txnActive)
+    {
+        result = Result_OK;
+        for (; n != 0; n--, rqs++)
+        {
+            if ((settingsRequest(rqs) != Result_OK) && (result == Result_OK))
+                result = rqs->result;
+        }
+        unlockWriter(rqWrite);
+        return result;
+    }
+#endif
+    settingsRomBeginDefer();
+    result = runBatch(rqs, n);
+    settingsRomEndDefer();
+    unlockWriter(rqWrite);
+    return result;
+}
+
+
+#if ENABLE_TRANSACTIONS == 1
+// Start a transaction
+// Following write requests made by this thread are not executed, but stored together with their values
+// until settingsCommit() or settingsAbort() is called. Requests are checked for valid path only.
+// Reads return committed values. Write requests of other threads wait until the transaction is finished
+resultType settingsBegin(void)
+{
+    lockWriter(rqWrite);
+    if (txnActive)
+    {
+        unlockWriter(rqWrite);
+        return Result_TransactionState;
+    }
+    clearTransaction();
+    txnActive = 1;
+    return Result_OK;
+}
+
+
+// Validate and execute all requests made since settingsBegin()
+// If any value is invalid, nothing is changed and the transaction is aborted.
+// Requests are executed as a batch (see settingsRequestBatch()), and all ROM changes are written by
+// settingsRomCommitDefer(), so that either all or none of them survive power loss.
+// ROM writes made by change callbacks during commit are part of the commit and must fit commit log
+resultType settingsCommit(void)
+{
+    request_t rqst;
+    resultType result = Result_OK;
+    uint32_t i;
+    if (!txnActive)
+        return Result_TransactionState;
+    for (i=0; (i<txnCount) && (result == Result_OK); i++)
+    {
+        if (txnRequests[i].rq & rqApplyNoCb)
+        {
+            rqst = txnRequests[i];
+            rqst.rq = rqValidate;
+            result = settingsRequest(&rqst);
+        }
+    }
+    if (result != Result_OK)
+    {
+        settingsAbort();
+        return result;
+    }
+    // Requests made by change callbacks are executed immediately
+    txnActive = 0;
+    settingsRomBeginDefer();
+    result = runBatch(txnRequests, txnCount);
+    settingsRomCommitDefer();
+    clearTransaction();
+    unlockWriter(rqWrite);
+    return result;
+}
+
+
+// Discard all requests made since settingsBegin()
+void settingsAbort(void)
+{
+    if (!txnActive)
+        return;
+    txnActive = 0;
+    clearTransaction();
+    unlockWriter(rqWrite);
+}
+
+
+// Store write request and its value until commit
+// Value is copied, so that caller's buffer may be reused
+static resultType stageRequest(slot_t *slot, request_t *rqst)
+{
+    request_t *staged;
+    uint32_t size, offset, i;
+    if (txnCount == SETTINGS_TXN_MAX_REQUESTS)
+        return Result_TransactionFull;
+    staged = &txnRequests[txnCount];
+    *staged = *rqst;
+    for (i=0; i<slot->depth; i++)
+        staged->arg[i] = slot->arg[i];
+    if (rqst->rq & rqApplyNoCb)
+    {
+        // Value is 32-bit unless node has a 64-bit value, blob requests carry their range only
+        size = ((rqst->raw != 0) || (slot->size == 8)) ? slot->size : sizeof(int32_t);
+        if ((slot->rqHandler == handleRequestBlob) && !getBlobRange(slot->size, rqst, &offset, &size))
+            return Result_ValidateError;
+        if (txnBufferUsed + size > SETTINGS_TXN_BUFFER_SIZE)
+            return Result_TransactionFull;
+        if (rqst->raw != 0)
+        {
+            staged->raw = (uint8_t *)txnBuffer + txnBufferUsed;
+            memcpy(staged->raw, rqst->raw, size);
+        }
+        else
+        {
+            staged->val.u64 = (uint64_t *)((uint8_t *)txnBuffer + txnBufferUsed);
+            memcpy(staged->val.u64, rqst->val.u64, size);
+        }
+        txnBufferUsed += (size + 7) & ~7UL;
+    }
+    txnCount++;
+    return Result_OK;
+}
+
+
+static void clearTransaction(void)
+{
+    txnCount = 0;
+    txnBufferUsed = 0;
+}
+#endif  // ENABLE_TRANSACTIONS
+
+
+// Run requests of a batch, ROM writes must be deferred by caller
+static resultType runBatch(request_t *rqs, uint32_t n)
+{
+    slot_t slots[SETTINGS_BATCH_SIZE];
+    uint8_t order[SETTINGS_BATCH_SIZE];
+    uint8_t hostFlags[SETTINGS_BATCH_SIZE];
+    nodeTrail_t trail;
+    resultType result, batchResult = Result_OK;
+    request_t *rqst;
+    slot_t *slot;
+    uint32_t count, i, j, host;
+    uint8_t index, flags;
+
+    while (n != 0)
+    {
+        // Requests are processed by parts of up to SETTINGS_BATCH_SIZE
+        count = (n < SETTINGS_BATCH_SIZE) ? n : SETTINGS_BATCH_SIZE;
+
+        // Sort requests by arguments, so that every walk resumes from the path of previous request
+        for (i=0; i<count; i++)
+        {
+            index = (uint8_t)i;
+            for (j=i; (j>0) && (compareArgs(&rqs[order[j - 1]], &rqs[index]) > 0); j--)
+                order[j] = order[j - 1];
+            order[j] = index;
+        }
+
+        // Resolve all requests in sorted order
+        initTrail(&trail);
+        for (i=0; i<count; i++)
+        {
+            index = order[i];
+            rqs[index].result = locateNode(&rqs[index], &slots[index], &trail);
+            if (rqs[index].result != Result_OK)
+                slots[index].node = 0;
+#if USE_INCREMENTAL_CRC == 1
+            else if (requestModifiesRam(rqs[index].rq))
+                slots[index].crcTail = getCrcTail(&slots[index]);
+#endif
+            // Requests to the same node are adjacent, but arguments beyond node depth could reorder them
+            // Their order in batch is restored
+            for (j=i; (j>0) && (slots[index].node != 0) && (slots[order[j - 1]].node == slots[index].node) &&
+                      (slots[order[j - 1]].ramOffset == slots[index].ramOffset) && (order[j - 1] > index); j--)
+                order[j] = order[j - 1];
+            order[j] = index;
+        }
+
+        // Run requests and mark affected host nodes
+        // Requests of a host node are adjacent in sorted order, flags are collected at the first of them.
+        // Nodes of a nested host may split the run, then CRC of the host is written once per part
+        host = count;
+        for (i=0; i<count; i++)
+        {
+            index = order[i];
+            rqst = &rqs[index];
+            slot = &slots[index];
+            hostFlags[index] = 0;
+            if (slot->node == 0)
+            {
+                if (batchResult == Result_OK)
+                    batchResult = rqst->result;
+                continue;
+            }
+            result = runRequest(slot, rqst, 1);
+            flags = (requestModifiesRam(rqst->rq) && (slot->node->storage == RomStored)) ? HOST_RAM_MODIFIED : 0;
+            if (result & Result_UpdatedRom)
+                flags |= HOST_ROM_UPDATED;
+            rqst->result = (resultType)(result & ~Result_UpdatedRom);
+            if ((rqst->result != Result_OK) && (batchResult == Result_OK))
+                batchResult = rqst->result;
+            if ((host == count) || (slots[order[host]].hostRamOffset != slot->hostRamOffset))
+                host = i;
+            hostFlags[order[host]] |= flags;
+        }
+
+        // Update CRC of affected host nodes
+        // Incremental CRC has been updated in RAM by every request, the same way as by single requests,
+        // so a CRC invalidated by resetSettingsToDefaults() stays invalid. It is written to ROM once per host node
+        for (i=0; i<count; i++)
+        {
+            index = order[i];
+#if USE_INCREMENTAL_CRC == 1
+            if (hostFlags[index] & HOST_ROM_UPDATED)
+                writeRom(slots[index].hostRomOffset, slots[index].crcRamOffset, NODE_CRC_SIZE);
+#else
+            if (hostFlags[index] != 0)
+                updateHostCRC(&slots[index], hostFlags[index] & HOST_ROM_UPDATED);
+#endif
+        }
+        rqs += count;
+        n -= count;
+    }
+    return batchResult;
+}
+
+
+// Find terminating node for request arguments
+// Absolute addresses of the node and its host node are returned by slot
+// Walk is resumed from the deepest node shared with the previous request made with the same trail
+static resultType locateNode(request_t *rqst, slot_t *slot, nodeTrail_t *trail)
+{
+    node_t *pNode;
+    hNode_t *nnode = 0;
+    lNode_t *lnode = 0;
+    uint32_t currArg, level = 0;
+    uint32_t ramOffset, romOffset;
+    resultType result = Result_OK;
+
+    // Skip levels shared with previous request
+    while ((level < trail->depth) && (rqst->arg[level] == trail->arg[level]))
+        level++;
+    pNode = trail->node[level];
+    ramOffset = trail->ramOffset[level];
+    romOffset = trail->romOffset[level];
+
+    while(pNode->type != sNode)
+    {
+        if (level >= SETTINGS_MAX_DEPTH - 1)
+        {
+            result = Result_DepthExceeded;
+            break;
+        }
+        currArg = rqst->arg[level];
+        switch(pNode->type)
+        {
+            case hNode:
+                nnode = (hNode_t *)pNode;
+                SETTINGS_ASSERT_TRUE(currArg < nnode->hListSize);
+                SETTINGS_ASSERT_TRUE(nnode->hList);
+                pNode = nnode->hList[currArg];
+                SETTINGS_ASSERT_TRUE(pNode);
+                ramOffset += pNode->ramOffset;
+                romOffset += pNode->romOffset;
+                break;
+
+            case lNode:
+                lnode = (lNode_t *)pNode;
+                SETTINGS_ASSERT_TRUE(currArg < lnode->hListSize);
+                pNode = lnode->element;
+                SETTINGS_ASSERT_TRUE(pNode);
+                ramOffset += lnode->element->ramOffset + lnode->elementRamSize * currArg;
+                romOffset += lnode->element->romOffset + lnode->elementRomSize * currArg;
+                break;
+
+            default:
+                SETTINGS_ASSERT_NEVER_EXECUTE();
+                result = Result_UnknownNodeType;
+                break;
+        }
+        if (result != Result_OK)
+            break;
+        trail->arg[level++] = currArg;
+        trail->node[level] = pNode;
+        trail->ramOffset[level] = ramOffset;
+        trail->romOffset[level] = romOffset;
+    }
+    trail->depth = level;
+    if (result == Result_OK)
+    {
+        // Terminating node is found. Host node which holds CRC is the last node passed
+        SETTINGS_ASSERT_TRUE(level > 0);
+        slot->node = (sNode_t *)pNode;
+        slot->rqHandler = slot->node->rqHandler;
+        slot->size = slot->node->size;
+        slot->accessLevel = slot->node->accessLevel;
+        slot->ramOffset = ramOffset;
+        slot->romOffset = romOffset;
+        slot->hostNode = trail->node[level - 1];
+        slot->hostRamOffset = trail->ramOffset[level - 1];
+        slot->hostRomOffset = trail->romOffset[level - 1];
+        slot->crcRamOffset = getCrcRamAddr(slot->hostNode, slot->hostRamOffset);
+        slot->depth = level;
+        for (currArg=0; currArg<level; currArg++)
+            slot->arg[currArg] = (uint16_t)trail->arg[currArg];
+#if ENABLE_ACCESS_CHECK == 1
+        // Caller may access nodes of its own and lower access levels
+        if ((uint32_t)rqst->accLevel < slot->accessLevel)
+            result = Result_AccessDenied;
+#endif
+    }
+    return result;
+}
+
+
+// Start tree walk from root node
+static void initTrail(nodeTrail_t *trail)
+{
+    trail->depth = 0;
+    trail->node[0] = (node_t *)hRoot;
+    trail->ramOffset[0] = hRoot->ramOffset;
+    trail->romOffset[0] = hRoot->romOffset;
+}
+
+
+// Compare arguments of two requests
+// Returns negative value, 0 or positive value if first request arguments are less, equal or greater than second ones
+static int32_t compareArgs(request_t *a, request_t *b)
+{
+    uint32_t i;
+    for (i=0; i<SETTINGS_MAX_DEPTH; i++)
+    {
+        if (a->arg[i] != b->arg[i])
+            return (a->arg[i] < b->arg[i]) ? -1 : 1;
+    }
+    return 0;
+}
+
+
+#if USE_INCREMENTAL_CRC == 0
+// Recalculate CRC of a host node and optionally write it to ROM
+static void updateHostCRC(slot_t *slot, uint8_t writeToRom)
+{
+    uint32_t crc;
+    crc = getNodeCrc(slot->hostNode, slot->hostRamOffset);
+    u32toBytesMsbFirst(&crc, &ram[slot->crcRamOffset], NODE_CRC_SIZE);
+    if (writeToRom)
+        writeRom(slot->hostRomOffset, slot->crcRamOffset, NODE_CRC_SIZE);
+}
+#endif
+
+
+// Run request for a terminating node and update CRC of the host node if ROM has been modified
+// If deferCrc is set, host node CRC is left to caller and Result_UpdatedRom is returned.
+// With incremental CRC, the CRC is updated in RAM anyway and only its ROM write is left to caller
+static resultType executeRequest(slot_t *slot, request_t *rqst, uint8_t deferCrc)
+{
+    resultType result;
+    requestContext_t ctx;
+#if USE_INCREMENTAL_CRC == 1
+    uint32_t crc, crcDelta = 0;
+    uint32_t offset = 0, length = slot->size;
+    uint8_t updateCrc = requestModifiesRam(rqst->rq) && (slot->node->storage == RomStored);
+    if (updateCrc)
+    {
+        // CRC is linear: stored CRC is updated by CRC of (old ^ new) value bytes,
+        // shifted by the number of payload bytes following the value.
+        // Blob requests change their range only, bytes around it do not change CRC
+        if ((slot->rqHandler == handleRequestBlob) && !getBlobRange(slot->size, rqst, &offset, &length))
+            length = 0;
+        crcDelta = getValueCRC16(&ram[slot->ramOffset + offset], length, VALUE_SWAP_SIZE(slot->node), 0);
+    }
+#endif
+    // Path is referenced, not copied. New value is set by request handler
+    ctx.depth = slot->depth;
+    ctx.arg = slot->arg;
+    rqst->ctx = &ctx;
+    SETTINGS_ASSERT_TRUE(slot->rqHandler);
+    result = slot->rqHandler(rqst->rq, slot->node, slot->ramOffset, slot->romOffset, rqst);
+    // Context is on stack and is valid during handler call only
+    rqst->ctx = 0;
+#if USE_INCREMENTAL_CRC == 1
+    if (updateCrc)
+    {
+        crcDelta ^= getValueCRC16(&ram[slot->ramOffset + offset], length, VALUE_SWAP_SIZE(slot->node), 0);
+        if (crcDelta != 0)
+        {
+            bytesToU32MsbFirst(&ram[slot->crcRamOffset], &crc, NODE_CRC_SIZE);
+            crc ^= shiftCRC16((uint16_t)crcDelta, slot->crcTail + slot->size - offset - length);
+            u32toBytesMsbFirst(&crc, &ram[slot->crcRamOffset], NODE_CRC_SIZE);
+        }
+    }
+    if (deferCrc)
+        return result;
+    if (result & Result_UpdatedRom)
+    {
+        // Hide ROM flag
+        result = (resultType)(result & ~Result_UpdatedRom);
+        writeRom(slot->hostRomOffset, slot->crcRamOffset, NODE_CRC_SIZE);
+    }
+#else
+    if (deferCrc)
+        return result;
+    if (result & Result_UpdatedRom)
+    {
+        // Hide ROM flag
+        result = (resultType)(result & ~Result_UpdatedRom);
+        updateNodeCRC(slot->hostNode, slot->hostRamOffset, slot->hostRomOffset);
+    }
+#endif
+    return result;
+}
+
+
+// Run request for a terminating node
+// Reads are made lock-free if concurrent readers are enabled, caller must hold writer lock for other requests
+static resultType runRequest(slot_t *slot, request_t *rqst, uint8_t deferCrc)
+{
+#if SETTINGS_CONCURRENT_READERS == 1
+    atomic_uint *seq = SEQLOCK_OF(slot->hostRamOffset);
+    uint32_t start;
+    resultType result;
+    if (rqst->rq == rqRead)
+    {
+        // Reads made by change callbacks of current thread do not race with writer
+        if (writerDepth != 0)
+            return executeRequest(slot, rqst, deferCrc);
+        do
+        {
+            start = seqReadBegin(seq);
+            result = executeRequest(slot, rqst, deferCrc);
+        }
+        while (seqReadRetry(seq, start));
+        return result;
+    }
+    // Nested write to the same host node from a callback keeps the counter odd
+    start = atomic_load_explicit(seq, memory_order_relaxed);
+    if ((start & 1) == 0)
+    {
+        atomic_store_explicit(seq, start + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+    }
+    result = executeRequest(slot, rqst, deferCrc);
+    if ((start & 1) == 0)
+        atomic_store_explicit(seq, start + 2, memory_order_release);
+    return result;
+#else
+    return executeRequest(slot, rqst, deferCrc);
+#endif
+}
+
+
+// Serialize requests which are not lock-free
+static void lockWriter(rqType rq)
+{
+#if SETTINGS_CONCURRENT_READERS == 1
+    if (rq == rqRead)
+        return;
+    if (writerDepth++ == 0)
+        pthread_mutex_lock(&writerLock);
+#else
+    (void)rq;
+#endif
+}
+
+
+static void unlockWriter(rqType rq)
+{
+#if SETTINGS_CONCURRENT_READERS == 1
+    if (rq == rqRead)
+        return;
+    if (--writerDepth == 0)
+        pthread_mutex_unlock(&writerLock);
+#else
+    (void)rq;
+#endif
+}
+
+
+#if SETTINGS_CONCURRENT_READERS == 1
+// Wait until no write is in progress and return sequence counter
+static uint32_t seqReadBegin(atomic_uint *seq)
+{
+    uint32_t start;
+    while ((start = atomic_load_explicit(seq, memory_order_acquire)) & 1)
+    {
+        // Writer may be stalled by ROM device
+        sched_yield();
+    }
+    return start;
+}
+
+
+// Check if a write has been made after seqReadBegin()
+static uint8_t seqReadRetry(atomic_uint *seq, uint32_t start)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return (atomic_load_explicit(seq, memory_order_relaxed) != start) ? 1 : 0;
+}
+#endif
+
+
+// Check if request may change value in RAM
+static uint8_t requestModifiesRam(rqType rq)
+{
+    return ((rq & rqApplyNoCb) || (rq == rqRestoreValidate)) ? 1 : 0;
+}
+
+
+#if USE_INCREMENTAL_CRC == 1
+// Get count of host node CRC payload bytes following the value of terminating node
+static uint32_t getCrcTail(slot_t *slot)
+{
+    hNode_t *hnode;
+    lNode_t *lnode;
+    sNode_t *snode;
+    uint32_t i, tail = 0;
+    switch (slot->hostNode->type)
+    {
+        case hNode:
+            // Payload is made of ROM stored terminating nodes, in list order
+            hnode = (hNode_t *)slot->hostNode;
+            for (i=hnode->hListSize; i>0; i--)
+            {
+                snode = (sNode_t *)hnode->hList[i - 1];
+                if (snode == slot->node)
+                    break;
+                if ((snode != 0) && (snode->type == sNode) && (snode->storage == RomStored))
+                    tail += snode->size;
+            }
+            break;
+
+        case lNode:
+            // Payload is the whole array of elements
+            lnode = (lNode_t *)slot->hostNode;
+            tail = slot->hostRamOffset + lnode->element->ramOffset + (lnode->elementRamSize * lnode->hListSize);
+            tail -= slot->ramOffset + slot->size;
+            break;
+
+        default:
+            SETTINGS_ASSERT_NEVER_EXECUTE();
+            break;
+    }
+    return tail;
+}
+#endif
+
+
+#if ENABLE_SLOT_TABLE == 1
+// Build table of resolved terminating nodes
+// Must be called after InitNode() when root offsets are set
+void buildSlotTable(uint32_t slotCount)
+{
+    slot_t path;
+    SETTINGS_ASSERT_TRUE(slotCount <= SETTINGS_SLOT_TABLE_SIZE);
+    slotTableSize = slotCount;
+    path.depth = 0;
+    fillSlotTable((node_t *)hRoot, hRoot->ramOffset, hRoot->romOffset, 0, &path);
+#if ENABLE_NAME_INDEX == 1
+    buildNameIndex();
+#endif
+#if ENABLE_SUBSCRIPTIONS == 1
+    initEvents();
+#endif
+}
+
+
+static void fillSlotTable(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase, uint32_t nodeSlotBase, slot_t *path)
+{
+    hNode_t *hnode;
+    lNode_t *lnode;
+    node_t *child;
+    uint32_t i, depth;
+    uint32_t ramAddr, romAddr, slotIndex;
+
+    depth = path->depth;
+    SETTINGS_ASSERT_TRUE(depth < SETTINGS_MAX_DEPTH - 1);
+    path->depth = depth + 1;
+    if (node->type == hNode)
+    {
+        hnode = (hNode_t *)node;
+        for (i=0; i<hnode->hListSize; i++)
+        {
+            child = hnode->hList[i];
+            if (child == 0)
+                continue;
+            path->arg[depth] = (uint16_t)i;
+            ramAddr = nodeRamBase + child->ramOffset;
+            romAddr = nodeRomBase + child->romOffset;
+            slotIndex = nodeSlotBase + child->slotOffset;
+            if (child->type == sNode)
+            {
+                initSlot(&slotTable[slotIndex], path, (sNode_t *)child, ramAddr, romAddr, node, nodeRamBase, nodeRomBase);
+            }
+            else
+            {
+                fillSlotTable(child, ramAddr, romAddr, slotIndex, path);
+            }
+        }
+    }
+    else if (node->type == lNode)
+    {
+        lnode = (lNode_t *)node;
+        child = lnode->element;
+        for (i=0; i<lnode->hListSize; i++)
+        {
+            path->arg[depth] = (uint16_t)i;
+            ramAddr = nodeRamBase + child->ramOffset + (lnode->elementRamSize * i);
+            romAddr = nodeRomBase + child->romOffset + (lnode->elementRomSize * i);
+            slotIndex = nodeSlotBase + child->slotOffset + (lnode->elementSlotCount * i);
+            if (child->type == sNode)
+            {
+                initSlot(&slotTable[slotIndex], path, (sNode_t *)child, ramAddr, romAddr, node, nodeRamBase, nodeRomBase);
+            }
+            else
+            {
+                fillSlotTable(child, ramAddr, romAddr, slotIndex, path);
+            }
+        }
+    }
+    else
+    {
+        SETTINGS_ASSERT_NEVER_EXECUTE();
+    }
+    path->depth = depth;
+}
+
+
+static void initSlot(slot_t *slot, slot_t *path, sNode_t *node, uint32_t ramAddr, uint32_t romAddr, node_t *host, uint32_t hostRamBase, uint32_t hostRomBase)
+{
+    *slot = *path;
+    slot->node = node;
+    slot->rqHandler = node->rqHandler;
+    slot->size = node->size;
+    slot->accessLevel = node->accessLevel;
+    slot->ramOffset = ramAddr;
+    slot->romOffset = romAddr;
+    slot->hostNode = host;
+    slot->hostRamOffset = hostRamBase;
+    slot->hostRomOffset = hostRomBase;
+    slot->crcRamOffset = getCrcRamAddr(host, hostRamBase);
+#if USE_INCREMENTAL_CRC == 1
+    slot->crcTail = getCrcTail(slot);
+#endif
+}
+
+
+// Resolve request arguments to a handle of terminating node
+// Handle remains valid until the tree is re-initialized
+settingsHandle_t settingsResolve(request_t *rqst)
+{
+    node_t *pNode = (node_t *)hRoot;
+    hNode_t *nnode;
+    lNode_t *lnode;
+    uint32_t currArg, argIndex = 0;
+    uint32_t slotIndex = hRoot->slotOffset;
+
+    while(pNode->type != sNode)
+    {
+        if (argIndex >= SETTINGS_MAX_DEPTH - 1)
+            return SETTINGS_INVALID_HANDLE;
+        currArg = rqst->arg[argIndex++];
+        switch(pNode->type)
+        {
+            case hNode:
+                nnode = (hNode_t *)pNode;
+                if ((currArg >= nnode->hListSize) || (nnode->hList[currArg] == 0))
+                    return SETTINGS_INVALID_HANDLE;
+                pNode = nnode->hList[currArg];
+                slotIndex += pNode->slotOffset;
+                break;
+
+            case lNode:
+                lnode = (lNode_t *)pNode;
+                if (currArg >= lnode->hListSize)
+                    return SETTINGS_INVALID_HANDLE;
+                pNode = lnode->element;
+                slotIndex += pNode->slotOffset + lnode->elementSlotCount * currArg;
+                break;
+
+            default:
+                SETTINGS_ASSERT_NEVER_EXECUTE();
+                return SETTINGS_INVALID_HANDLE;
+        }
+    }
+    SETTINGS_ASSERT_TRUE(slotIndex < slotTableSize);
+    return slotIndex;
+}
+
+
+// Run request for a node resolved by settingsResolve()
+// Request arguments are ignored
+resultType settingsRequestByHandle(settingsHandle_t handle, request_t *rqst)
+{
+    slot_t *slot;
+    resultType result;
+    SETTINGS_ASSERT_TRUE(handle < slotTableSize);
+    slot = &slotTable[handle];
+#if ENABLE_ACCESS_CHECK == 1
+    if ((uint32_t)rqst->accLevel < slot->accessLevel)
+    {
+        rqst->result = Result_AccessDenied;
+        return Result_AccessDenied;
+    }
+#endif
+    lockWriter(rqst->rq);
+#if ENABLE_TRANSACTIONS == 1
+    if (TXN_STAGED(rqst->rq) && txnActive)
+        result = stageRequest(slot, rqst);
+    else
+#endif
+    result = runRequest(slot, rqst, 0);
+    unlockWriter(rqst->rq);
+    rqst->result = result;
+    return result;
+}
+
+
+// Load 8-bit to 32-bit value of a slot from RAM
+static uint32_t loadSlotValue(slot_t *slot)
+{
+#if SETTINGS_CONCURRENT_READERS == 1
+    atomic_uint *seq = SEQLOCK_OF(slot->hostRamOffset);
+    uint32_t start, val32;
+    if (writerDepth == 0)
+    {
+        do
+        {
+            start = seqReadBegin(seq);
+            val32 = loadValue(&ram[slot->ramOffset], slot->size);
+        }
+        while (seqReadRetry(seq, start));
+        return val32;
+    }
+#endif
+    return loadValue(&ram[slot->ramOffset], slot->size);
+}
+
+
+// Fast read of a 8-bit to 32-bit integer
+// Value is decoded directly from RAM unless node has custom request handler
+int32_t settings_ReadI32ByHandle(settingsHandle_t handle)
+{
+    slot_t *slot;
+    request_t rq;
+    uint32_t val32 = 0;
+    SETTINGS_ASSERT_TRUE(handle < slotTableSize);
+    slot = &slotTable[handle];
+    if (slot->rqHandler == handleRequestU32)
+        return (int32_t)loadSlotValue(slot);
+    if (slot->rqHandler == handleRequestI32)
+        return signExtend(loadSlotValue(slot), slot->size);
+    rq.rq = rqRead;
+    rq.val.i32 = (int32_t *)&val32;
+    rq.raw = 0;
+    runRequest(slot, &rq, 0);
+    return (int32_t)val32;
+}
+
+
+// Fast read of a float
+// Value is decoded directly from RAM unless node has custom request handler
+float settings_ReadF32ByHandle(settingsHandle_t handle)
+{
+    slot_t *slot;
+    request_t rq;
+    float value = 0;
+    SETTINGS_ASSERT_TRUE(handle < slotTableSize);
+    slot = &slotTable[handle];
+    if (slot->rqHandler == handleRequestF32)
+        return settingsBitsToF32(loadSlotValue(slot));
+    rq.rq = rqRead;
+    rq.val.f32 = &value;
+    rq.raw = 0;
+    runRequest(slot, &rq, 0);
+    return value;
+}
+
+
+// Get handles of terminating nodes of a subtree which may be accessed with access level of request
+// Subtree is addressed by first depth arguments of request, depth of 0 selects whole tree.
+// Access masks allow to skip subtrees without such nodes and to take subtrees of such nodes only as a whole,
+// so only subtrees of mixed access levels are walked. Intended use: export of settings by service port
+// Returns count of handles, up to maxCount
+uint32_t settingsGetVisibleHandles(request_t *rqst, uint32_t depth, settingsHandle_t *handles, uint32_t maxCount)
+{
+    node_t *node;
+    uint16_t arg[SETTINGS_MAX_DEPTH];
+    settingsHandle_t first;
+    uint32_t i;
+    if (depth >= SETTINGS_MAX_DEPTH)
+        return 0;
+    for (i=0; i<depth; i++)
+    {
+        if (rqst->arg[i] > 0xFFFF)
+            return 0;
+        arg[i] = (uint16_t)rqst->arg[i];
+    }
+    node = findPathNode(arg, depth, &first);
+    if (node == 0)
+        return 0;
+    return addVisibleHandles(node, first, ACCESS_MASK_UP_TO(rqst->accLevel), handles, 0, maxCount);
+}
+
+
+static uint32_t addVisibleHandles(node_t *node, settingsHandle_t first, uint8_t visible, settingsHandle_t *handles, uint32_t count, uint32_t maxCount)
+{
+    hNode_t *hnode;
+    lNode_t *lnode;
+    node_t *child;
+    uint32_t i, n;
+    if ((node->accessMask & visible) == 0)
+        return count;
+    if (node->type == sNode)
+    {
+        if (count < maxCount)
+            handles[count++] = first;
+        return count;
+    }
+    if ((node->accessMask & ~visible) == 0)
+    {
+        // Terminating nodes of a subtree have consecutive handles
+        n = getNodeSlotCount(node);
+        for (i=0; (i<n) && (count<maxCount); i++)
+            handles[count++] = first + i;
+        return count;
+    }
+    if (node->type == hNode)
+    {
+        hnode = (hNode_t *)node;
+        for (i=0; i<hnode->hListSize; i++)
+        {
+            child = hnode->hList[i];
+            if (child == 0)
+                continue;
+            // Terminating children are checked here, as there are many of them in mixed subtrees
+            if (child->type == sNode)
+            {
+                if ((child->accessMask & visible) && (count < maxCount))
+                    handles[count++] = first + child->slotOffset;
+            }
+            else
+            {
+                count = addVisibleHandles(child, first + child->slotOffset, visible, handles, count, maxCount);
+            }
+        }
+    }
+    else if (node->type == lNode)
+    {
+        lnode = (lNode_t *)node;
+        for (i=0; i<lnode->hListSize; i++)
+            count = addVisibleHandles(lnode->element, first + lnode->element->slotOffset + lnode->elementSlotCount * i, visible, handles, count, maxCount);
+    }
+    else
+    {
+        SETTINGS_ASSERT_NEVER_EXECUTE();
+    }
+    return count;
+}
+
+
+// Find node addressed by arguments and handle of its first terminating node
+// Returns 0 if there is no such node
+static node_t *findPathNode(const uint16_t *arg, uint32_t depth, settingsHandle_t *first)
+{
+    node_t *pNode = (node_t *)hRoot;
+    hNode_t *hnode;
+    lNode_t *lnode;
+    uint32_t i, slotIndex = hRoot->slotOffset;
+
+    for (i=0; i<depth; i++)
+    {
+        if (pNode->type == hNode)
+        {
+            hnode = (hNode_t *)pNode;
+            if ((arg[i] >= hnode->hListSize) || (hnode->hList[arg[i]] == 0))
+                return 0;
+            pNode = hnode->hList[arg[i]];
+            slotIndex += pNode->slotOffset;
+        }
+        else if (pNode->type == lNode)
+        {
+            lnode = (lNode_t *)pNode;
+            if (arg[i] >= lnode->hListSize)
+                return 0;
+            pNode = lnode->element;
+            slotIndex += pNode->slotOffset + lnode->elementSlotCount * arg[i];
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    *first = slotIndex;
+    return pNode;
+}
+
+
+// Get count of terminating nodes of a subtree
+static uint32_t getNodeSlotCount(node_t *node)
+{
+    lNode_t *lnode;
+    uint32_t count = 0;
+    switch (node->type)
+    {
+        case sNode:
+            count = 1;
+            break;
+
+        case hNode:
+            count = ((hNode_t *)node)->slotCount;
+            break;
+
+        case lNode:
+            lnode = (lNode_t *)node;
+            count = lnode->elementSlotCount * lnode->hListSize;
+            break;
+
+        default:
+            SETTINGS_ASSERT_NEVER_EXECUTE();
+            break;
+    }
+    return count;
+}
+#endif  // ENABLE_SLOT_TABLE
+
+
+#if ENABLE_NAME_INDEX == 1
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// Name index
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+// Resolve path name to a handle of terminating node
+// Hierarchy children are addressed by names separated by dots, list elements by decimal index in brackets,
+// for example "B0.C1" or "B1[10]". Returns SETTINGS_INVALID_HANDLE if there is no such node
+settingsHandle_t settingsResolveName(const char *name)
+{
+    uint64_t hash;
+    settingsHandle_t handle;
+    if (nameIndexSize == 0)
+        return SETTINGS_INVALID_HANDLE;
+    hash = mixNameHash(hashName(NAME_HASH_BASIS, name));
+    handle = nameIndex[getNamePosition(hash, nameSeed[getNameBucket(hash)])];
+    // Unknown name is mapped to a position of some other slot
+    if ((slotTable[handle].nameHash != hash) || !matchSlotName(&slotTable[handle], name))
+        return SETTINGS_INVALID_HANDLE;
+    return handle;
+}
+
+
+// Build perfect hash index of slot path names
+// Slots are distributed to buckets by hash, then every bucket gets a seed which places all its slots
+// to free index positions. Buckets are placed from the biggest one, while the index is mostly empty
+static void buildNameIndex(void)
+{
+    uint64_t hash;
+    uint32_t i, size, maxSize, bucket, named = 0;
+
+    for (i=0; i<slotTableSize; i++)
+    {
+        if (getSlotNameHash(&slotTable[i], &hash))
+            named++;
+    }
+    nameIndexSize = named;
+    nameBucketCount = (named + NAME_BUCKET_LOAD - 1) / NAME_BUCKET_LOAD;
+    for (i=0; i<nameBucketCount; i++)
+    {
+        nameBucketHead[i] = NAME_LIST_END;
+        nameSeed[i] = 0;
+    }
+    for (i=0; i<nameIndexSize; i++)
+        nameIndex[i] = SETTINGS_INVALID_HANDLE;
+
+    // Link slots of every bucket
+    maxSize = 0;
+    for (i=0; i<slotTableSize; i++)
+    {
+        if (!getSlotNameHash(&slotTable[i], &hash))
+            continue;
+        slotTable[i].nameHash = hash;
+        bucket = getNameBucket(hash);
+        nameLink[i] = nameBucketHead[bucket];
+        nameBucketHead[bucket] = i;
+        size = getNameBucketSize(bucket);
+        maxSize = (size > maxSize) ? size : maxSize;
+    }
+
+    for (size = maxSize; size > 0; size--)
+    {
+        for (bucket=0; bucket<nameBucketCount; bucket++)
+        {
+            if (getNameBucketSize(bucket) != size)
+                continue;
+            if (!placeNameBucket(bucket))
+            {
+                // Path names must be unique, equal names give equal hashes which no seed can separate
+                nameIndexSize = 0;
+                SETTINGS_ASSERT_NEVER_EXECUTE();
+                return;
+            }
+            // Bucket is not visited again
+            nameBucketHead[bucket] = NAME_LIST_END;
+        }
+    }
+}
+
+
+// Find seed which places all slots of a bucket to free index positions
+// Returns 0 if there is no such seed
+static uint8_t placeNameBucket(uint32_t bucket)
+{
+    uint32_t seed, i, k;
+    settingsHandle_t *position;
+    for (seed=0; seed<=NAME_SEED_MAX; seed++)
+    {
+        for (i = nameBucketHead[bucket]; i != NAME_LIST_END; i = nameLink[i])
+        {
+            position = &nameIndex[getNamePosition(slotTable[i].nameHash, seed)];
+            if (*position != SETTINGS_INVALID_HANDLE)
+                break;
+            *position = i;
+        }
+        if (i == NAME_LIST_END)
+        {
+            nameSeed[bucket] = (uint16_t)seed;
+            return 1;
+        }
+        // Release positions taken with this seed
+        for (k = nameBucketHead[bucket]; k != i; k = nameLink[k])
+            nameIndex[getNamePosition(slotTable[k].nameHash, seed)] = SETTINGS_INVALID_HANDLE;
+    }
+    return 0;
+}
+
+
+static uint32_t getNameBucketSize(uint32_t bucket)
+{
+    uint32_t i, size = 0;
+    for (i = nameBucketHead[bucket]; i != NAME_LIST_END; i = nameLink[i])
+        size++;
+    return size;
+}
+
+
+// Map low half of name hash to a bucket
+static uint32_t getNameBucket(uint64_t hash)
+{
+    return (uint32_t)(((uint64_t)(uint32_t)hash * nameBucketCount) >> 32);
+}
+
+
+// Map high half of name hash, mixed with seed of its bucket, to index position
+static uint32_t getNamePosition(uint64_t hash, uint32_t seed)
+{
+    uint32_t x = (uint32_t)(hash >> 32) ^ (seed * 0x9E3779B9);
+    x ^= x >> 16;
+    x *= 0x85EBCA6B;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35;
+    x ^= x >> 16;
+    return (uint32_t)(((uint64_t)x * nameIndexSize) >> 32);
+}
+
+
+// Add characters of a string to FNV-1a hash
+static uint64_t hashName(uint64_t hash, const char *str)
+{
+    while (*str)
+    {
+        hash ^= (uint8_t)*str++;
+        hash *= NAME_HASH_PRIME;
+    }
+    return hash;
+}
+
+
+// Spread differences of similar names over all hash bits
+// Both halves of the result are used by the index
+static uint64_t mixNameHash(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+
+// Format list index as decimal number without leading zeros
+// Returns pointer to the first digit within buffer
+static const char *formatNameIndex(uint32_t index, char *buffer)
+{
+    char *digit = &buffer[NAME_INDEX_DIGITS];
+    *digit = 0;
+    do
+    {
+        *--digit = (char)('0' + index % 10);
+        index /= 10;
+    }
+    while (index != 0);
+    return digit;
+}
+
+
+// Get hash of slot path name
+// Returns 0 if any hierarchy child on the path has no name
+static uint8_t getSlotNameHash(slot_t *slot, uint64_t *hash)
+{
+    node_t *node = (node_t *)hRoot;
+    char buffer[NAME_INDEX_DIGITS + 1];
+    uint32_t i;
+
+    *hash = NAME_HASH_BASIS;
+    for (i=0; i<slot->depth; i++)
+    {
+        if (node->type == hNode)
+        {
+            node = ((hNode_t *)node)->hList[slot->arg[i]];
+            if ((node->name == 0) || (node->name[0] == 0))
+                return 0;
+            if (i != 0)
+                *hash = hashName(*hash, ".");
+            *hash = hashName(*hash, node->name);
+        }
+        else
+        {
+            *hash = hashName(*hash, "[");
+            *hash = hashName(*hash, formatNameIndex(slot->arg[i], buffer));
+            *hash = hashName(*hash, "]");
+            node = ((lNode_t *)node)->element;
+        }
+    }
+    *hash = mixNameHash(*hash);
+    return 1;
+}
+
+
+// Check that name is exactly the path name of a slot
+static uint8_t matchSlotName(slot_t *slot, const char *name)
+{
+    node_t *node = (node_t *)hRoot;
+    char buffer[NAME_INDEX_DIGITS + 1];
+    uint32_t i;
+
+    for (i=0; i<slot->depth; i++)
+    {
+        if (node->type == hNode)
+        {
+            node = ((hNode_t *)node)->hList[slot->arg[i]];
+            if ((i != 0) && !matchNamePart(&name, "."))
+                return 0;
+            if (!matchNamePart(&name, node->name))
+                return 0;
+        }
+        else
+        {
+            if (!matchNamePart(&name, "[") || !matchNamePart(&name, formatNameIndex(slot->arg[i], buffer)) || !matchNamePart(&name, "]"))
+                return 0;
+            node = ((lNode_t *)node)->element;
+        }
+    }
+    return (*name == 0);
+}
+
+
+// Skip part of a name if it matches, returns 0 otherwise
+static uint8_t matchNamePart(const char **name, const char *part)
+{
+    const char *str = *name;
+    while (*part)
+    {
+        if (*str++ != *part++)
+            return 0;
+    }
+    *name = str;
+    return 1;
+}
+#endif  // ENABLE_NAME_INDEX
+
+
+#if ENABLE_SUBSCRIPTIONS == 1
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// Subscriptions
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+// Subscribe to changes of a node addressed by first depth arguments of request
+// Node may be a terminating node or a hierarchy or list node, then all its terminating nodes are watched.
+// Subscriptions are kept in a trie of watched paths, so an event finds its subscribers in O(depth).
+// Depth of 0 watches whole tree. Callback is called by settingsDispatchEvents() for every changed node.
+// Subscriptions must be made by the thread which calls settingsDispatchEvents(), after initSettings().
+// They are removed when the tree is initialized again
+// Returns subscription id or SETTINGS_INVALID_SUBSCRIPTION
+uint32_t settingsSubscribe(request_t *rqst, uint32_t depth, settingsEventCallback callback, void *userData)
+{
+    subscriber_t *sub;
+    node_t *node;
+    uint16_t arg[SETTINGS_MAX_DEPTH];
+    settingsHandle_t first;
+    uint32_t i, id;
+
+    if ((callback == 0) || (depth >= SETTINGS_MAX_DEPTH))
+        return SETTINGS_INVALID_SUBSCRIPTION;
+    for (i=0; i<depth; i++)
+    {
+        if (rqst->arg[i] > 0xFFFF)
+            return SETTINGS_INVALID_SUBSCRIPTION;
+        arg[i] = (uint16_t)rqst->arg[i];
+    }
+    node = findPathNode(arg, depth, &first);
+    if (node == 0)
+        return SETTINGS_INVALID_SUBSCRIPTION;
+    for (id=0; (id<SETTINGS_MAX_SUBSCRIBERS) && (subscribers[id].callback != 0); id++);
+    if (id == SETTINGS_MAX_SUBSCRIBERS)
+        return SETTINGS_INVALID_SUBSCRIPTION;
+
+    sub = &subscribers[id];
+    sub->first = first;
+    sub->count = getNodeSlotCount(node);
+    sub->depth = depth;
+    if (sub->count == 0)
+        return SETTINGS_INVALID_SUBSCRIPTION;
+    if (!addWatch(id))
+    {
+        // Drop paths left by removed subscriptions
+        buildWatchTrie();
+        if (!addWatch(id))
+            return SETTINGS_INVALID_SUBSCRIPTION;
+    }
+    sub->userData = userData;
+    sub->callback = callback;
+    for (i=0; i<sub->count; i++)
+        atomic_fetch_add_explicit(&slotWatchers[first + i], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&subscriberCount, 1, memory_order_relaxed);
+    return id;
+}
+
+
+// Remove subscription made by settingsSubscribe()
+// May be called by subscriber callback
+void settingsUnsubscribe(uint32_t id)
+{
+    subscriber_t *sub;
+    uint16_t *link;
+    uint32_t i;
+    if ((id >= SETTINGS_MAX_SUBSCRIBERS) || (subscribers[id].callback == 0))
+        return;
+    sub = &subscribers[id];
+    for (i=0; i<sub->count; i++)
+        atomic_fetch_sub_explicit(&slotWatchers[sub->first + i], 1, memory_order_relaxed);
+    // Trie entry is left until trie is rebuilt
+    link = (sub->depth != 0) ? &watchTrie[sub->watchNode].subscriber : &watchRootSubscriber;
+    while (*link != id)
+        link = &subscribers[*link].next;
+    *link = sub->next;
+    sub->callback = 0;
+    atomic_fetch_sub_explicit(&subscriberCount, 1, memory_order_relaxed);
+}
+
+
+// Deliver pending change events to subscribers, up to maxEvents events
+// Subscribers are called by this function only, so it may be called by a low priority task.
+// Changes made by subscribers are delivered within the same call if maxEvents allows
+// Returns count of delivered events
+uint32_t settingsDispatchEvents(uint32_t maxEvents)
+{
+    settingsEvent_t event;
+    subscriber_t *sub;
+    uint16_t ids[SETTINGS_MAX_SUBSCRIBERS];
+    uint32_t pos, i, n, count = 0;
+
+    while (count < maxEvents)
+    {
+        pos = eventTail;
+        if (atomic_load_explicit(&eventSeq[pos & EVENT_QUEUE_MASK], memory_order_acquire) != pos + 1)
+            break;
+        event.handle = eventQueue[pos & EVENT_QUEUE_MASK];
+        atomic_store_explicit(&eventSeq[pos & EVENT_QUEUE_MASK], pos + SETTINGS_EVENT_QUEUE_SIZE, memory_order_release);
+        eventTail = pos + 1;
+        // Changes made from now on post a new event
+        event.changes = atomic_exchange_explicit(&slotChanges[event.handle], 0, memory_order_acq_rel);
+        event.depth = slotTable[event.handle].depth;
+        event.arg = slotTable[event.handle].arg;
+        // Subscriptions are collected first, so that callbacks may change them
+        n = getWatchers(event.arg, event.depth, ids);
+        for (i=0; i<n; i++)
+        {
+            sub = &subscribers[ids[i]];
+            if (sub->callback != 0)
+                sub->callback(&event, sub->userData);
+        }
+        count++;
+    }
+    eventsDispatched += count;
+    return count;
+}
+
+
+// Get change event statistics
+// Counters are updated by concurrent requests, so they are copied by every call
+settingsEventStats_t *getEventStats(void)
+{
+    eventStats.posted = atomic_load_explicit(&eventsPosted, memory_order_relaxed);
+    eventStats.coalesced = atomic_load_explicit(&eventsCoalesced, memory_order_relaxed);
+    eventStats.dropped = atomic_load_explicit(&eventsDropped, memory_order_relaxed);
+    eventStats.dispatched = eventsDispatched;
+    return &eventStats;
+}
+
+
+// Remove all subscriptions and pending events, slot handles are changed by new tree
+static void initEvents(void)
+{
+    uint32_t i;
+    for (i=0; i<SETTINGS_MAX_SUBSCRIBERS; i++)
+        subscribers[i].callback = 0;
+    buildWatchTrie();
+    atomic_store(&subscriberCount, 0);
+    for (i=0; i<SETTINGS_SLOT_TABLE_SIZE; i++)
+    {
+        atomic_store(&slotWatchers[i], 0);
+        atomic_store(&slotChanges[i], 0);
+    }
+    for (i=0; i<SETTINGS_EVENT_QUEUE_SIZE; i++)
+        atomic_store(&eventSeq[i], i);
+    atomic_store(&eventHead, 0);
+    eventTail = 0;
+}
+
+
+// Post change event of a terminating node
+// Called within request, possibly by several threads at once. Does not wait for dispatcher
+static void postEvent(const requestContext_t *ctx)
+{
+    settingsHandle_t handle;
+    uint32_t pos, seq;
+
+    if (atomic_load_explicit(&subscriberCount, memory_order_relaxed) == 0)
+        return;
+    if (findPathNode(ctx->arg, ctx->depth, &handle) == 0)
+    {
+        SETTINGS_ASSERT_NEVER_EXECUTE();
+        return;
+    }
+    if (atomic_load_explicit(&slotWatchers[handle], memory_order_relaxed) == 0)
+        return;
+    atomic_fetch_add_explicit(&eventsPosted, 1, memory_order_relaxed);
+    // Pending event is delivered after this change, so subscribers see the new value
+    if (atomic_fetch_add_explicit(&slotChanges[handle], 1, memory_order_acq_rel) != 0)
+    {
+        atomic_fetch_add_explicit(&eventsCoalesced, 1, memory_order_relaxed);
+        return;
+    }
+    pos = atomic_load_explicit(&eventHead, memory_order_relaxed);
+    while (1)
+    {
+        seq = atomic_load_explicit(&eventSeq[pos & EVENT_QUEUE_MASK], memory_order_acquire);
+        if (seq == pos)
+        {
+            // Entry is free, claim it
+            if (atomic_compare_exchange_weak_explicit(&eventHead, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if ((int32_t)(seq - pos) < 0)
+        {
+            // Queue is full. Next change of the node will try again
+            atomic_store_explicit(&slotChanges[handle], 0, memory_order_relaxed);
+            atomic_fetch_add_explicit(&eventsDropped, 1, memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            // Entry has been claimed by another producer
+            pos = atomic_load_explicit(&eventHead, memory_order_relaxed);
+        }
+    }
+    eventQueue[pos & EVENT_QUEUE_MASK] = handle;
+    atomic_store_explicit(&eventSeq[pos & EVENT_QUEUE_MASK], pos + 1, memory_order_release);
+}
+
+
+// Get subscriptions watching a node, from whole tree down to the node
+// Trie is walked along node path, so time does not depend on count of subscriptions
+// Returns count of subscriptions
+static uint32_t getWatchers(const uint16_t *arg, uint32_t depth, uint16_t *ids)
+{
+    uint32_t level, entry, parent = WATCH_ROOT, count = 0;
+    uint16_t id = watchRootSubscriber;
+    for (level=0; ; level++)
+    {
+        for (; id != WATCH_NONE; id = subscribers[id].next)
+            ids[count++] = id;
+        if (level == depth)
+            break;
+        entry = findWatchNode(parent, arg[level]);
+        if (!watchTrie[entry].used)
+            break;
+        id = watchTrie[entry].subscriber;
+        parent = entry;
+    }
+    return count;
+}
+
+
+// Add path of a subscription to watch trie and link subscription to its entry
+// Returns 0 if trie is full
+static uint8_t addWatch(uint32_t id)
+{
+    subscriber_t *sub = &subscribers[id];
+    watchNode_t *node;
+    const uint16_t *arg = slotTable[sub->first].arg;
+    uint32_t level, entry, parent = WATCH_ROOT;
+    for (level=0; level<sub->depth; level++)
+    {
+        entry = findWatchNode(parent, arg[level]);
+        node = &watchTrie[entry];
+        if (!node->used)
+        {
+            if (watchTrieUsed >= WATCH_TRIE_LIMIT)
+                return 0;
+            watchTrieUsed++;
+            node->parent = (uint16_t)parent;
+            node->arg = arg[level];
+            node->subscriber = WATCH_NONE;
+            node->used = 1;
+        }
+        parent = entry;
+    }
+    sub->watchNode = (uint16_t)parent;
+    if (sub->depth != 0)
+    {
+        sub->next = watchTrie[parent].subscriber;
+        watchTrie[parent].subscriber = (uint16_t)id;
+    }
+    else
+    {
+        sub->next = watchRootSubscriber;
+        watchRootSubscriber = (uint16_t)id;
+    }
+    return 1;
+}
+
+
+// Make watch trie of active subscriptions
+static void buildWatchTrie(void)
+{
+    uint32_t id;
+    memset(watchTrie, 0, sizeof(watchTrie));
+    watchTrieUsed = 0;
+    watchRootSubscriber = WATCH_NONE;
+    for (id=0; id<SETTINGS_MAX_SUBSCRIBERS; id++)
+    {
+        if (subscribers[id].callback != 0)
+            addWatch(id);
+    }
+}
+
+
+// Find trie entry of a child node
+// Returns the entry if child is in trie, or the free entry where it should be placed
+static uint32_t findWatchNode(uint32_t parent, uint32_t arg)
+{
+    uint32_t entry = ((((parent << 16) | arg) * 0x9E3779B1u) >> 16) & WATCH_TRIE_MASK;
+    while (watchTrie[entry].used && ((watchTrie[entry].parent != parent) || (watchTrie[entry].arg != arg)))
+        entry = (entry + 1) & WATCH_TRIE_MASK;
+    return entry;
+}
+#endif  // ENABLE_SUBSCRIPTIONS
+
+
+// Call change callback of a terminating node
+// Request handlers should call it after a value has been applied, with new value set in context
+void notifyChange(sNode_t *pNode, rqType rq, requestContext_t *ctx)
+{
+    uint32_t i;
+    if (pNode->changeCallbackCtx)
+        pNode->changeCallbackCtx(rq, ctx);
+    if (pNode->changeCallback)
+    {
+        // Legacy callback takes arguments and value from globals
+        for (i=0; i<SETTINGS_MAX_DEPTH; i++)
+            argHistory[i] = (i < ctx->depth) ? ctx->arg[ctx->depth - 1 - i] : 0;
+        callbackCache = ctx->value;
+        pNode->changeCallback(rq, argHistory[0]);
+    }
+#if ENABLE_SUBSCRIPTIONS == 1
+    postEvent(ctx);
+#endif
+}
+
+
+// Get argument from request.
+// Index of 0 returns last argument,
+// index of 1 returns argument before last one and so on up to first argument
+// Intended use: determining address of an element in a multydimensional list
+// Valid within legacy change callback only, new callbacks get arguments by request context
+uint32_t getRequestArg(uint32_t historyIndex)
+{
+    SETTINGS_ASSERT_TRUE(historyIndex < SETTINGS_MAX_DEPTH);
+    return argHistory[historyIndex];
+}
+
+
+// Get cached values for callback functions
+// Intended use: using new value for change event
+// Valid within legacy change callback only, new callbacks get value by request context
+callbackCache_t *getCallbackCache(void)
+{
+    return &callbackCache;
+}
+
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// Public helpers
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+#if USE_SETTINGS_MEMORY_ALLOC == 1
+// Simple memory management
+void *settingsAlloc(uint32_t size)
+{
+    void *pRam = &allocRam[allocRamAddr];
+    uint32_t nextAddr = allocRamAddr + size;
+    if (nextAddr <= allocRamSize)
+    {
+        // OK
+        allocRamAddr = nextAddr;
+        memset(pRam, 0, size);
+    }
+    else
+    {
+        // Out of memory
+        pRam = 0;
+    }
+    return pRam;
+}
+
+
+uint32_t getAllocMemoryUsed(void)
+{
+    return allocRamAddr;
+}
+#endif
+
+
+#if ENABLE_NODE_CONSTRUCTORS == 1
+sNode_t *createSNode(uint16_t size)
+{
+    sNode_t *snode = (sNode_t *)SETTINGS_ALLOCATE(sizeof(sNode_t));
+    SETTINGS_ASSERT_TRUE(snode != 0);
+    snode->type = sNode;
+    snode->size = size;
+    return snode;
+}
+
+
+hNode_t *createHNode(uint16_t elementsCount)
+{
+    hNode_t *hnode = (hNode_t *)SETTINGS_ALLOCATE(sizeof(hNode_t));
+    SETTINGS_ASSERT_TRUE(hnode != 0);
+    hnode->type = hNode;
+    hnode->hList = (node_t **)SETTINGS_ALLOCATE(elementsCount * sizeof(node_t *));
+    hnode->hListSize = elementsCount;
+    SETTINGS_ASSERT_TRUE(hnode->hList != 0);
+    return hnode;
+}
+
+
+lNode_t *createLNode(uint16_t elementsCount, void *node)
+{
+    lNode_t *lnode = (lNode_t *)SETTINGS_ALLOCATE(sizeof(lNode_t));
+    SETTINGS_ASSERT_TRUE(lnode != 0);
+    lnode->type = lNode;
+    lnode->element = (node_t *)node;
+    lnode->hListSize = elementsCount;
+    return lnode;
+}
+
+
+void addToHList(hNode_t *hnode, uint32_t index, void *node)
+{
+    if (index < hnode->hListSize)
+    {
+        if (hnode->hList[index] == 0)
+        {
+            hnode->hList[index] = (node_t *)node;
+        }
+        else
+        {
+            SETTINGS_ASSERT_NEVER_EXECUTE();
+        }
+    }
+    else
+    {
+        SETTINGS_ASSERT_NEVER_EXECUTE();
+    }
+}
+
+
+// Set callback which takes request context
+// Returns the node, so it may wrap node constructor
+sNode_t *setChangeCallbackCtx(sNode_t *node, onChangeCallbackCtx changeCallbackCtx)
+{
+    node->changeCallbackCtx = changeCallbackCtx;
+    return node;
+}
+
+
+// Mark value as accessed often, see SETTINGS_RAM_LAYOUT
+// Returns the node, so it may wrap node constructor
+sNode_t *setHot(sNode_t *node)
+{
+    node->hot = 1;
+    return node;
+}
+
+
+// Set name used in path names (see settingsResolveName()), string is not copied
+// Returns the node, so it may wrap node constructor
+void *setName(void *node, const char *name)
+{
+    ((node_t *)node)->name = name;
+    return node;
+}
+
+#endif  // ENABLE_NODE_CONSTRUCTORS
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+
+
+validateResult validateU32(uint32_t value, struct u32Prm_t *prm)
+{
+    return ((prm->minValue <= value) && (value <= prm->maxValue)) ? ValidateOk : ValidateErr;
+}
+
+
+resultType handleRequestU32(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst)
+{
+    resultType result = Result_OK;
+    uint32_t val32;
+    uint32_t *pVal32;
+    //SETTINGS_DEBUG("U32 node rq %d, node size %d, ram %d, rom %d", rq, pNode->size, nodeRamBase, nodeRomBase);
+    switch (rq)
+    {
+        case rqRead:
+            val32 = loadValue(&ram[nodeRamBase], pNode->size);
+            if (rqst->raw)
+            {
+                // Raw form is MSB first
+                u32toBytesMsbFirst(&val32, rqst->raw, pNode->size);
+            }
+            else
+            {
+                pVal32 = (uint32_t *)rqst->val.i32;
+                *pVal32 = val32;
+            }
+            break;
+
+        case rqApplyNoCb:
+        case rqApply:
+        case rqStore:
+        case rqWriteNoCb:
+        case rqWrite:
+            if (rqst->raw)
+            {
+                // Serialize to validate
+                bytesToU32MsbFirst(rqst->raw, &val32, pNode->size);
+            }
+            else
+            {
+                pVal32 = (uint32_t *)rqst->val.i32;
+                val32 = *pVal32;
+            }
+            if (rq & rqApply)
+            {
+                if (validateU32(val32, &pNode->varData.u32Prm) == ValidateOk)
+                {
+                    storeValue(val32, &ram[nodeRamBase], pNode->size);
+                    // Request arguments and new value are provided to callback by request context
+                    if ((rq & rqApply) == rqApply)
+                    {
+                        rqst->ctx->value.i32 = val32;
+                        notifyChange(pNode, rq, rqst->ctx);
+                    }
+                }
+                else
+                {
+#if ERROR_ON_VALIDATE_FAILED == 1
+                    SETTINGS_ASSERT_NEVER_EXECUTE();
+#endif
+                    result = Result_ValidateError;
+                    break;
+                }
+            }
+            if (rq & rqStore)
+            {
+                if (pNode->storage == RomStored)
+                {
+                    writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
+                    result = (resultType)(result | Result_UpdatedRom);
+                }
+            }
+            break;
+
+        case rqValidate:
+            if (rqst->raw)
+            {
+                // Serialize to validate
+                bytesToU32MsbFirst(rqst->raw, &val32, pNode->size);
+            }
+            else
+            {
+                pVal32 = (uint32_t *)rqst->val.i32;
+                val32 = *pVal32;
+            }
+            result = (validateU32(val32, &pNode->varData.u32Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            break;
+
+        case rqGetMin:
+            if (rqst->raw)
+            {
+                u32toBytesMsbFirst(&pNode->varData.u32Prm.minValue, rqst->raw, pNode->size);
+            }
+            else
+            {
+                pVal32 = (uint32_t *)rqst->val.i32;
+                *pVal32 = pNode->varData.u32Prm.minValue;
+            }
+            break;
+
+        case rqGetMax:
+            if (rqst->raw)
+            {
+                u32toBytesMsbFirst(&pNode->varData.u32Prm.maxValue, rqst->raw, pNode->size);
+            }
+            else
+            {
+                pVal32 = (uint32_t *)rqst->val.i32;
+                *pVal32 = pNode->varData.u32Prm.maxValue;
+            }
+            break;
+
+        case rqGetSize:
+            if (rqst->raw)
+            {
+                u32toBytesMsbFirst(&pNode->size, rqst->raw, 4);
+            }
+            else
+            {
+                pVal32 = (uint32_t *)rqst->val.i32;
+                *pVal32 = pNode->size;
+            }
+            break;
+
+        case rqRestoreValidate:
+        case rqRestoreLoaded:
+            if (pNode->storage == RomStored)
+            {
+                // Value is in RAM already if it has been restored by image loader
+                if (rq == rqRestoreValidate)
+                    readRomValue(nodeRamBase, nodeRomBase, pNode->size);
+                val32 = loadValue(&ram[nodeRamBase], pNode->size);
+                result = (validateU32(val32, &pNode->varData.u32Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            }
+            else
+            {
+                val32 = pNode->varData.u32Prm.defaultValue;
+                storeValue(val32, &ram[nodeRamBase], pNode->size);
+            }
+            break;
+
+        case rqRestoreDefault:
+            val32 = pNode->varData.u32Prm.defaultValue;
+            storeValue(val32, &ram[nodeRamBase], pNode->size);
+            if (pNode->storage == RomStored)
+            {
+                writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
+                result = (resultType)(result | Result_UpdatedRom);
+            }
+            break;
+
+        default:
+            result = Result_WrongRequestType;
+            break;
+    }
+    return result;
+}
+
+
+validateResult validateI32(int32_t value, struct i32Prm_t *prm)
+{
+    return ((prm->minValue <= value) && (value <= prm->maxValue)) ? ValidateOk : ValidateErr;
+}
+
+
+validateResult validateU64(uint64_t value, struct u64Prm_t *prm)
+{
+    return ((prm->minValue <= value) && (value <= prm->maxValue)) ? ValidateOk : ValidateErr;
+}
+
+
+validateResult validateI64(int64_t value, struct i64Prm_t *prm)
+{
+    return ((prm->minValue <= value) && (value <= prm->maxValue)) ? ValidateOk : ValidateErr;
+}
+
+
+validateResult validateF32(float value, struct f32Prm_t *prm)
+{
+    return ((prm->minValue <= value) && (value <= prm->maxValue)) ? ValidateOk : ValidateErr;
+}
+
+
+validateResult validateF64(double value, struct f64Prm_t *prm)
+{
+    return ((prm->minValue <= value) && (value <= prm->maxValue)) ? ValidateOk : ValidateErr;
+}
+
+
+// i8, i16 and i32 nodes, values are sign extended
+resultType handleRequestI32(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst)
+{
+    resultType result = Result_OK;
+    int32_t value;
+    switch (rq)
+    {
+        case rqRead:
+            value = signExtend(loadValue(&ram[nodeRamBase], pNode->size), pNode->size);
+            if (rqst->raw)
+                putRawValue((uint32_t)value, rqst->raw, pNode->size);
+            else
+                *rqst->val.i32 = value;
+            break;
+
+        case rqApplyNoCb:
+        case rqApply:
+        case rqStore:
+        case rqWriteNoCb:
+        case rqWrite:
+            value = (rqst->raw) ? signExtend(getRawValue(rqst->raw, pNode->size), pNode->size) : *rqst->val.i32;
+            if (rq & rqApply)
+            {
+                if (validateI32(value, &pNode->varData.i32Prm) == ValidateOk)
+                {
+                    storeValue((uint32_t)value, &ram[nodeRamBase], pNode->size);
+                    // Request arguments and new value are provided to callback by request context
+                    if ((rq & rqApply) == rqApply)
+                    {
+                        rqst->ctx->value.i32 = value;
+                        notifyChange(pNode, rq, rqst->ctx);
+                    }
+                }
+                else
+                {
+#if ERROR_ON_VALIDATE_FAILED == 1
+                    SETTINGS_ASSERT_NEVER_EXECUTE();
+#endif
+                    result = Result_ValidateError;
+                    break;
+                }
+            }
+            if (rq & rqStore)
+            {
+                if (pNode->storage == RomStored)
+                {
+                    writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
+                    result = (resultType)(result | Result_UpdatedRom);
+                }
+            }
+            break;
+
+        case rqValidate:
+            value = (rqst->raw) ? signExtend(getRawValue(rqst->raw, pNode->size), pNode->size) : *rqst->val.i32;
+            result = (validateI32(value, &pNode->varData.i32Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            break;
+
+        case rqGetMin:
+            if (rqst->raw)
+                putRawValue((uint32_t)pNode->varData.i32Prm.minValue, rqst->raw, pNode->size);
+            else
+                *rqst->val.i32 = pNode->varData.i32Prm.minValue;
+            break;
+
+        case rqGetMax:
+            if (rqst->raw)
+                putRawValue((uint32_t)pNode->varData.i32Prm.maxValue, rqst->raw, pNode->size);
+            else
+                *rqst->val.i32 = pNode->varData.i32Prm.maxValue;
+            break;
+
+        case rqGetSize:
+            if (rqst->raw)
+                u32toBytesMsbFirst(&pNode->size, rqst->raw, 4);
+            else
+                *rqst->val.u32 = pNode->size;
+            break;
+
+        case rqRestoreValidate:
+        case rqRestoreLoaded:
+            if (pNode->storage == RomStored)
+            {
+                // Value is in RAM already if it has been restored by image loader
+                if (rq == rqRestoreValidate)
+                    readRomValue(nodeRamBase, nodeRomBase, pNode->size);
+                value = signExtend(loadValue(&ram[nodeRamBase], pNode->size), pNode->size);
+                result = (validateI32(value, &pNode->varData.i32Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            }
+            else
+            {
+                storeValue((uint32_t)pNode->varData.i32Prm.defaultValue, &ram[nodeRamBase], pNode->size);
+            }
+            break;
+
+        case rqRestoreDefault:
+            storeValue((uint32_t)pNode->varData.i32Prm.defaultValue, &ram[nodeRamBase], pNode->size);
+            if (pNode->storage == RomStored)
+            {
+                writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
+                result = (resultType)(result | Result_UpdatedRom);
+            }
+            break;
+
+        default:
+            result = Result_WrongRequestType;
+            break;
+    }
+    return result;
+}
+
+
+resultType handleRequestU64(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst)
+{
+    resultType result = Result_OK;
+    uint64_t value;
+    switch (rq)
+    {
+        case rqRead:
+            value = loadValue64(&ram[nodeRamBase]);
+            if (rqst->raw)
+                putRawValue64(value, rqst->raw);
+            else
+                *rqst->val.u64 = value;
+            break;
+
+        case rqApplyNoCb:
+        case rqApply:
+        case rqStore:
+        case rqWriteNoCb:
+        case rqWrite:
+            value = (rqst->raw) ? getRawValue64(rqst->raw) : *rqst->val.u64;
+            if (rq & rqApply)
+            {
+                if (validateU64(value, &pNode->varData.u64Prm) == ValidateOk)
+                {
+                    storeValue64(value, &ram[nodeRamBase]);
+                    // Request arguments and new value are provided to callback by request context
+                    if ((rq & rqApply) == rqApply)
+                    {
+                        rqst->ctx->value.u64 = value;
+                        notifyChange(pNode, rq, rqst->ctx);
+                    }
+                }
+                else
+                {
+#if ERROR_ON_VALIDATE_FAILED == 1
+                    SETTINGS_ASSERT_NEVER_EXECUTE();
+#endif
+                    result = Result_ValidateError;
+                    break;
+                }
+            }
+            if (rq & rqStore)
+            {
+                if (pNode->storage == RomStored)
+                {
+                    writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
+                    result = (resultType)(result | Result_UpdatedRom);
+                }
+            }
+            break;
+
+        case rqValidate:
+            value = (rqst->raw) ? getRawValue64(rqst->raw) : *rqst->val.u64;
+            result = (validateU64(value, &pNode->varData.u64Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            break;
+
+        case rqGetMin:
+            if (rqst->raw)
+                putRawValue64(pNode->varData.u64Prm.minValue, rqst->raw);
+            else
+                *rqst->val.u64 = pNode->varData.u64Prm.minValue;
+            break;
+
+        case rqGetMax:
+            if (rqst->raw)
+                putRawValue64(pNode->varData.u64Prm.maxValue, rqst->raw);
+            else
+                *rqst->val.u64 = pNode->varData.u64Prm.maxValue;
+            break;
+
+        case rqGetSize:
+            if (rqst->raw)
+                u32toBytesMsbFirst(&pNode->size, rqst->raw, 4);
+            else
+                *rqst->val.u32 = pNode->size;
+            break;
+
+        case rqRestoreValidate:
+        case rqRestoreLoaded:
+            if (pNode->storage == RomStored)
+            {
+                // Value is in RAM already if it has been restored by image loader
+                if (rq == rqRestoreValidate)
+                    readRomValue(nodeRamBase, nodeRomBase, pNode->size);
+                value = loadValue64(&ram[nodeRamBase]);
+                result = (validateU64(value, &pNode->varData.u64Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            }
+            else
+            {
+                storeValue64(pNode->varData.u64Prm.defaultValue, &ram[nodeRamBase]);
+            }
+            break;
+
+        case rqRestoreDefault:
+            storeValue64(pNode->varData.u64Prm.defaultValue, &ram[nodeRamBase]);
+            if (pNode->storage == RomStored)
+            {
+                writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
+                result = (resultType)(result | Result_UpdatedRom);
+            }
+            break;
+
+        default:
+            result = Result_WrongRequestType;
+            break;
+    }
+    return result;
+}
+
+
+resultType handleRequestI64(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst)
+{
+    resultType result = Result_OK;
+    int64_t value;
+    switch (rq)
+    {
+        case rqRead:
+            value = (int64_t)loadValue64(&ram[nodeRamBase]);
+            if (rqst->raw)
+                putRawValue64((uint64_t)value, rqst->raw);
+            else
+                *rqst->val.i64 = value;
+            break;
+
+        case rqApplyNoCb:
+        case rqApply:
+        case rqStore:
+        case rqWriteNoCb:
+        case rqWrite:
+            value = (rqst->raw) ? (int64_t)getRawValue64(rqst->raw) : *rqst->val.i64;
+            if (rq & rqApply)
+            {
+                if (validateI64(value, &pNode->varData.i64Prm) == ValidateOk)
+                {
+                    storeValue64((uint64_t)value, &ram[nodeRamBase]);
+                    // Request arguments and new value are provided to callback by request context
+                    if ((rq & rqApply) == rqApply)
+                    {
+                        rqst->ctx->value.i64 = value;
+                        notifyChange(pNode, rq, rqst->ctx);
+                    }
+                }
+                else
+                {
+#if ERROR_ON_VALIDATE_FAILED == 1
+                    SETTINGS_ASSERT_NEVER_EXECUTE();
+#endif
+                    result = Result_ValidateError;
+                    break;
+                }
+            }
+            if (rq & rqStore)
+            {
+                if (pNode->storage == RomStored)
+                {
+                    writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
+                    result = (resultType)(result | Result_UpdatedRom);
+                }
+            }
+            break;
+
+        case rqValidate:
+            value = (rqst->raw) ? (int64_t)getRawValue64(rqst->raw) : *rqst->val.i64;
+            result = (validateI64(value, &pNode->varData.i64Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            break;
+
+        case rqGetMin:
+            if (rqst->raw)
+                putRawValue64((uint64_t)pNode->varData.i64Prm.minValue, rqst->raw);
+            else
+                *rqst->val.i64 = pNode->varData.i64Prm.minValue;
+            break;
+
+        case rqGetMax:
+            if (rqst->raw)
+                putRawValue64((uint64_t)pNode->varData.i64Prm.maxValue, rqst->raw);
+            else
+                *rqst->val.i64 = pNode->varData.i64Prm.maxValue;
+            break;
+
+        case rqGetSize:
+            if (rqst->raw)
+                u32toBytesMsbFirst(&pNode->size, rqst->raw, 4);
+            else
+                *rqst->val.u32 = pNode->size;
+            break;
+
+        case rqRestoreValidate:
+        case rqRestoreLoaded:
+            if (pNode->storage == RomStored)
+            {
+                // Value is in RAM already if it has been restored by image loader
+                if (rq == rqRestoreValidate)
+                    readRomValue(nodeRamBase, nodeRomBase, pNode->size);
+                value = (int64_t)loadValue64(&ram[nodeRamBase]);
+                result = (validateI64(value, &pNode->varData.i64Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            }
+            else
+            {
+                storeValue64((uint64_t)pNode->varData.i64Prm.defaultValue, &ram[nodeRamBase]);
+            }
+            break;
+
+        case rqRestoreDefault:
+            storeValue64((uint64_t)pNode->varData.i64Prm.defaultValue, &ram[nodeRamBase]);
+            if (pNode->storage == RomStored)
+            {
+                writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
+                result = (resultType)(result | Result_UpdatedRom);
+            }
+            break;
+
+        default:
+            result = Result_WrongRequestType;
+            break;
+    }
+    return result;
+}
+
+
+// Raw form is MSB first bit pattern of the value
+resultType handleRequestF32(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst)
+{
+    resultType result = Result_OK;
+    float value;
+    switch (rq)
+    {
+        case rqRead:
+            value = loadF32(&ram[nodeRamBase]);
+            if (rqst->raw)
+                putRawValue(f32ToBits(value), rqst->raw, 4);
+            else
+                *rqst->val.f32 = value;
+            break;
+
+        case rqApplyNoCb:
+        case rqApply:
+        case rqStore:
+        case rqWriteNoCb:
+        case rqWrite:
+            value = (rqst->raw) ? settingsBitsToF32(getRawValue(rqst->raw, 4)) : *rqst->val.f32;
+            if (rq & rqApply)
+            {
+                if (validateF32(value, &pNode->varData.f32Prm) == ValidateOk)
+                {
+                    storeF32(value, &ram[nodeRamBase]);
+                    // Request arguments and new value are provided to callback by request context
+                    if ((rq & rqApply) == rqApply)
+                    {
+                        rqst->ctx->value.f32 = value;
+                        notifyChange(pNode, rq, rqst->ctx);
+                    }
+                }
+                else
+                {
+#if ERROR_ON_VALIDATE_FAILED == 1
+                    SETTINGS_ASSERT_NEVER_EXECUTE();
+#endif
+                    result = Result_ValidateError;
+                    break;
+                }
+            }
+            if (rq & rqStore)
+            {
+                if (pNode->storage == RomStored)
+                {
+                    writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
+                    result = (resultType)(result | Result_UpdatedRom);
+                }
+            }
+            break;
+
+        case rqValidate:
+            value = (rqst->raw) ? settingsBitsToF32(getRawValue(rqst->raw, 4)) : *rqst->val.f32;
+            result = (validateF32(value, &pNode->varData.f32Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            break;
+
+        case rqGetMin:
+            if (rqst->raw)
+                putRawValue(f32ToBits(pNode->varData.f32Prm.minValue), rqst->raw, 4);
+            else
+                *rqst->val.f32 = pNode->varData.f32Prm.minValue;
+            break;
+
+        case rqGetMax:
+            if (rqst->raw)
+                putRawValue(f32ToBits(pNode->varData.f32Prm.maxValue), rqst->raw, 4);
+            else
+                *rqst->val.f32 = pNode->varData.f32Prm.maxValue;
+            break;
+
+        case rqGetSize:
+            if (rqst->raw)
+                u32toBytesMsbFirst(&pNode->size, rqst->raw, 4);
+            else
+                *rqst->val.u32 = pNode->size;
+            break;
 
+        case rqRestoreValidate:
+        case rqRestoreLoaded:
+            if (pNode->storage == RomStored)
+            {
+                // Value is in RAM already if it has been restored by image loader
+                if (rq == rqRestoreValidate)
+                    readRomValue(nodeRamBase, nodeRomBase, pNode->size);
+                value = loadF32(&ram[nodeRamBase]);
+                result = (validateF32(value, &pNode->varData.f32Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            }
+            else
+            {
+                storeF32(pNode->varData.f32Prm.defaultValue, &ram[nodeRamBase]);
+            }
+            break;
 
+        case rqRestoreDefault:
+            storeF32(pNode->varData.f32Prm.defaultValue, &ram[nodeRamBase]);
+            if (pNode->storage == RomStored)
+            {
+                writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
+                result = (resultType)(result | Result_UpdatedRom);
+            }
+            break;
 
-validateResult validateU32(uint32_t value, struct u32Prm_t *prm)
-{
-    return ((prm->minValue <= value) && (value <= prm->maxValue)) ? ValidateOk : ValidateErr;
+        default:
+            result = Result_WrongRequestType;
+            break;
+    }
+    return result;
 }
 
 
-resultType handleRequestU32(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst)
+resultType handleRequestF64(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst)
 {
     resultType result = Result_OK;
-    uint32_t val32;
-    uint32_t *pVal32;
-    //SETTINGS_DEBUG("U32 node rq %d, node size %d, ram %d, rom %d", rq, pNode->size, nodeRamBase, nodeRomBase);
+    double value;
     switch (rq)
     {
         case rqRead:
+            value = loadF64(&ram[nodeRamBase]);
             if (rqst->raw)
-            {
-                memcpy(rqst->raw, &ram[nodeRamBase], pNode->size);
-            }
+                putRawValue64(f64ToBits(value), rqst->raw);
             else
-            {
-                pVal32 = (uint32_t *)rqst->val.i32;
-                bytesToU32MsbFirst(&ram[nodeRamBase], &val32, pNode->size);
-                *pVal32 = val32;
-            }
+                *rqst->val.f64 = value;
             break;
 
         case rqApplyNoCb:
@@ -767,26 +3823,18 @@ resultType handleRequestU32(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBa
         case rqStore:
         case rqWriteNoCb:
         case rqWrite:
-            if (rqst->raw)
-            {
-                // Serialize to validate
-                bytesToU32MsbFirst(rqst->raw, &val32, pNode->size);
-            }
-            else
-            {
-                pVal32 = (uint32_t *)rqst->val.i32;
-                val32 = *pVal32;
-            }
+            value = (rqst->raw) ? settingsBitsToF64(getRawValue64(rqst->raw)) : *rqst->val.f64;
             if (rq & rqApply)
             {
-                if (validateU32(val32, &pNode->varData.u32Prm) == ValidateOk)
+                if (validateF64(value, &pNode->varData.f64Prm) == ValidateOk)
                 {
-                    u32toBytesMsbFirst(&val32, &ram[nodeRamBase], pNode->size);
-                    // Request arguments may be provided by GetRequestArg() if required by callback
-                    // New value may be directly obtained using GetCallbackCache() if required by callback
-                    callbackCache.i32 = val32;
-                    if (pNode->changeCallback)
-                        pNode->changeCallback(rq, argHistory[0]);
+                    storeF64(value, &ram[nodeRamBase]);
+                    // Request arguments and new value are provided to callback by request context
+                    if ((rq & rqApply) == rqApply)
+                    {
+                        rqst->ctx->value.f64 = value;
+                        notifyChange(pNode, rq, rqst->ctx);
+                    }
                 }
                 else
                 {
@@ -801,82 +3849,59 @@ resultType handleRequestU32(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBa
             {
                 if (pNode->storage == RomStored)
                 {
-                    writeRom(nodeRomBase, nodeRamBase, pNode->size);
+                    writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
                     result = (resultType)(result | Result_UpdatedRom);
                 }
             }
             break;
 
         case rqValidate:
-            if (rqst->raw)
-            {
-                // Serialize to validate
-                bytesToU32MsbFirst(rqst->raw, &val32, pNode->size);
-            }
-            else
-            {
-                pVal32 = (uint32_t *)rqst->val.i32;
-                val32 = *pVal32;
-            }
-            result = (validateU32(*pVal32, &pNode->varData.u32Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+            value = (rqst->raw) ? settingsBitsToF64(getRawValue64(rqst->raw)) : *rqst->val.f64;
+            result = (validateF64(value, &pNode->varData.f64Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
             break;
 
         case rqGetMin:
             if (rqst->raw)
-            {
-                u32toBytesMsbFirst(&pNode->varData.u32Prm.minValue, rqst->raw, pNode->size);
-            }
+                putRawValue64(f64ToBits(pNode->varData.f64Prm.minValue), rqst->raw);
             else
-            {
-                pVal32 = (uint32_t *)rqst->val.i32;
-                *pVal32 = pNode->varData.u32Prm.minValue;
-            }
+                *rqst->val.f64 = pNode->varData.f64Prm.minValue;
             break;
 
         case rqGetMax:
             if (rqst->raw)
-            {
-                u32toBytesMsbFirst(&pNode->varData.u32Prm.maxValue, rqst->raw, pNode->size);
-            }
+                putRawValue64(f64ToBits(pNode->varData.f64Prm.maxValue), rqst->raw);
             else
-            {
-                pVal32 = (uint32_t *)rqst->val.i32;
-                *pVal32 = pNode->varData.u32Prm.maxValue;
-            }
+                *rqst->val.f64 = pNode->varData.f64Prm.maxValue;
             break;
 
         case rqGetSize:
             if (rqst->raw)
-            {
                 u32toBytesMsbFirst(&pNode->size, rqst->raw, 4);
-            }
             else
-            {
-                pVal32 = (uint32_t *)rqst->val.i32;
-                *pVal32 = pNode->size;
-            }
+                *rqst->val.u32 = pNode->size;
             break;
 
         case rqRestoreValidate:
+        case rqRestoreLoaded:
             if (pNode->storage == RomStored)
             {
-                readRom(nodeRamBase, nodeRomBase, pNode->size);
-                bytesToU32MsbFirst(&ram[nodeRamBase], &val32, pNode->size);
-                result = (validateU32(val32, &pNode->varData.u32Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
+                // Value is in RAM already if it has been restored by image loader
+                if (rq == rqRestoreValidate)
+                    readRomValue(nodeRamBase, nodeRomBase, pNode->size);
+                value = loadF64(&ram[nodeRamBase]);
+                result = (validateF64(value, &pNode->varData.f64Prm) == ValidateOk) ? Result_OK : Result_ValidateError;
             }
             else
             {
-                val32 = pNode->varData.u32Prm.defaultValue;
-                u32toBytesMsbFirst(&val32, &ram[nodeRamBase], pNode->size);
+                storeF64(pNode->varData.f64Prm.defaultValue, &ram[nodeRamBase]);
             }
             break;
 
         case rqRestoreDefault:
-            val32 = pNode->varData.u32Prm.defaultValue;
-            u32toBytesMsbFirst(&val32, &ram[nodeRamBase], pNode->size);
+            storeF64(pNode->varData.f64Prm.defaultValue, &ram[nodeRamBase]);
             if (pNode->storage == RomStored)
             {
-                writeRom(nodeRomBase, nodeRamBase, pNode->size);
+                writeRomValue(nodeRomBase, nodeRamBase, pNode->size);
                 result = (resultType)(result | Result_UpdatedRom);
             }
             break;
@@ -909,12 +3934,12 @@ resultType handleRequestCharArray(rqType rq, struct sNode_t *pNode, uint32_t nod
                 if (rqst->raw != 0)
                 {
                     memcpy(&ram[nodeRamBase], rqst->raw, pNode->size);
-                    // Request arguments may be provided by GetRequestArg() if required by callback
-                    // New value may be directly obtained using GetCallbackCache() if required by callback
-                    callbackCache.str = (char *)rqst->raw;
-                    // Request arguments may be provided by GetRequestArg() if required by callback
-                    if (pNode->changeCallback)
-                        pNode->changeCallback(rq, argHistory[0]);
+                    // Request arguments and new value are provided to callback by request context
+                    if ((rq & rqApply) == rqApply)
+                    {
+                        rqst->ctx->value.str = (char *)rqst->raw;
+                        notifyChange(pNode, rq, rqst->ctx);
+                    }
                 }
                 else
                 {
@@ -960,9 +3985,12 @@ resultType handleRequestCharArray(rqType rq, struct sNode_t *pNode, uint32_t nod
             break;
 
         case rqRestoreValidate:
+        case rqRestoreLoaded:
             if (pNode->storage == RomStored)
             {
-                readRom(nodeRamBase, nodeRomBase, pNode->size);
+                // Value is in RAM already if it has been restored by image loader
+                if (rq == rqRestoreValidate)
+                    readRom(nodeRamBase, nodeRomBase, pNode->size);
             }
             else
             {
@@ -993,6 +4021,116 @@ resultType handleRequestCharArray(rqType rq, struct sNode_t *pNode, uint32_t nod
 }
 
 
+// Requests address a range of the value (see request_t), raw data holds the range only.
+// Only the range is copied and written to ROM, so a part of a large table is updated at the cost of its size
+resultType handleRequestBlob(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst)
+{
+    resultType result = Result_OK;
+    uint32_t offset, length;
+    switch (rq)
+    {
+        case rqRead:
+            if (getBlobRange(pNode->size, rqst, &offset, &length))
+                memcpy(rqst->raw, &ram[nodeRamBase + offset], length);
+            else
+                result = Result_ValidateError;
+            break;
+
+        case rqApplyNoCb:
+        case rqApply:
+        case rqStore:
+        case rqWriteNoCb:
+        case rqWrite:
+            if (!getBlobRange(pNode->size, rqst, &offset, &length) || ((rq & rqApply) && (rqst->raw == 0)))
+            {
+#if ERROR_ON_VALIDATE_FAILED == 1
+                SETTINGS_ASSERT_NEVER_EXECUTE();
+#endif
+                result = Result_ValidateError;
+                break;
+            }
+            if (rq & rqApply)
+            {
+                memcpy(&ram[nodeRamBase + offset], rqst->raw, length);
+                // Changed range is provided to callback by request context
+                if ((rq & rqApply) == rqApply)
+                {
+                    rqst->ctx->value.str = (char *)rqst->raw;
+                    rqst->ctx->offset = offset;
+                    rqst->ctx->length = length;
+                    notifyChange(pNode, rq, rqst->ctx);
+                }
+            }
+            if (rq & rqStore)
+            {
+                if ((pNode->storage == RomStored) && (length != 0))
+                {
+                    writeRom(nodeRomBase + offset, nodeRamBase + offset, length);
+                    result = (resultType)(result | Result_UpdatedRom);
+                }
+            }
+            break;
+
+        case rqValidate:
+            // Blob content is assumed to be correct, range is checked only
+            result = (getBlobRange(pNode->size, rqst, &offset, &length) && (rqst->raw != 0)) ? Result_OK : Result_ValidateError;
+            break;
+
+        case rqGetMin:
+        case rqGetMax:
+            SETTINGS_ASSERT_NEVER_EXECUTE();
+            result = Result_WrongRequestType;
+            break;
+
+        case rqGetSize:
+            if (rqst->raw)
+            {
+                u32toBytesMsbFirst(&pNode->size, rqst->raw, 4);
+            }
+            else
+            {
+                uint32_t *pVal32 = (uint32_t *)rqst->val.i32;
+                *pVal32 = pNode->size;
+            }
+            break;
+
+        case rqRestoreValidate:
+        case rqRestoreLoaded:
+            if (pNode->storage == RomStored)
+            {
+                // Value is in RAM already if it has been restored by image loader
+                if (rq == rqRestoreValidate)
+                    readRom(nodeRamBase, nodeRomBase, pNode->size);
+            }
+            else
+            {
+                if (pNode->varData.blobPrm.defaultValue)
+                    memcpy(&ram[nodeRamBase], pNode->varData.blobPrm.defaultValue, pNode->size);
+                else
+                    memset(&ram[nodeRamBase], 0, pNode->size);
+            }
+            break;
+
+        case rqRestoreDefault:
+            if (pNode->varData.blobPrm.defaultValue)
+                memcpy(&ram[nodeRamBase], pNode->varData.blobPrm.defaultValue, pNode->size);
+            else
+                memset(&ram[nodeRamBase], 0, pNode->size);
+            if (pNode->storage == RomStored)
+            {
+                writeRom(nodeRomBase, nodeRamBase, pNode->size);
+                result = (resultType)(result | Result_UpdatedRom);
+            }
+            break;
+
+        default:
+            result = Result_WrongRequestType;
+            break;
+    }
+    return result;
+}
+
+
 #if ENABLE_NODE_CONSTRUCTORS == 1
 sNode_t *u32Node(uint8_t accessLevel, storageType storage,
                        uint32_t minValue, uint32_t maxValue, uint32_t defaultValue,
@@ -1054,6 +4192,132 @@ sNode_t *charNode(uint8_t accessLevel, storageType storage,
     node->varData.charArrayPrm.defaultValue = defaultValue;
     return node;
 }
+
+
+sNode_t *blobNode(uint8_t accessLevel, storageType storage,
+                       uint32_t size, const uint8_t *defaultValue,
+                       onChangeCallback changeCallback)
+{
+    sNode_t *node = createSNode(size);
+    node->rqHandler = handleRequestBlob;
+    node->accessLevel = accessLevel;
+    node->storage = storage;
+    node->changeCallback = changeCallback;
+    node->varData.blobPrm.defaultValue = defaultValue;
+    return node;
+}
+
+
+sNode_t *i32Node(uint8_t accessLevel, storageType storage,
+                       int32_t minValue, int32_t maxValue, int32_t defaultValue,
+                       onChangeCallback changeCallback)
+{
+    sNode_t *node = createSNode(4);
+    node->rqHandler = handleRequestI32;
+    node->accessLevel = accessLevel;
+    node->storage = storage;
+    node->changeCallback = changeCallback;
+    node->varData.i32Prm.defaultValue = defaultValue;
+    node->varData.i32Prm.minValue = minValue;
+    node->varData.i32Prm.maxValue = maxValue;
+    return node;
+}
+
+
+sNode_t *i16Node(uint8_t accessLevel, storageType storage,
+                       int32_t minValue, int32_t maxValue, int32_t defaultValue,
+                       onChangeCallback changeCallback)
+{
+    sNode_t *node = createSNode(2);
+    node->rqHandler = handleRequestI32;
+    node->accessLevel = accessLevel;
+    node->storage = storage;
+    node->changeCallback = changeCallback;
+    node->varData.i32Prm.defaultValue = defaultValue;
+    node->varData.i32Prm.minValue = minValue;
+    node->varData.i32Prm.maxValue = maxValue;
+    return node;
+}
+
+
+sNode_t *i8Node(uint8_t accessLevel, storageType storage,
+                       int32_t minValue, int32_t maxValue, int32_t defaultValue,
+                       onChangeCallback changeCallback)
+{
+    sNode_t *node = createSNode(1);
+    node->rqHandler = handleRequestI32;
+    node->accessLevel = accessLevel;
+    node->storage = storage;
+    node->changeCallback = changeCallback;
+    node->varData.i32Prm.defaultValue = defaultValue;
+    node->varData.i32Prm.minValue = minValue;
+    node->varData.i32Prm.maxValue = maxValue;
+    return node;
+}
+
+
+sNode_t *u64Node(uint8_t accessLevel, storageType storage,
+                       uint64_t minValue, uint64_t maxValue, uint64_t defaultValue,
+                       onChangeCallback changeCallback)
+{
+    sNode_t *node = createSNode(8);
+    node->rqHandler = handleRequestU64;
+    node->accessLevel = accessLevel;
+    node->storage = storage;
+    node->changeCallback = changeCallback;
+    node->varData.u64Prm.defaultValue = defaultValue;
+    node->varData.u64Prm.minValue = minValue;
+    node->varData.u64Prm.maxValue = maxValue;
+    return node;
+}
+
+
+sNode_t *i64Node(uint8_t accessLevel, storageType storage,
+                       int64_t minValue, int64_t maxValue, int64_t defaultValue,
+                       onChangeCallback changeCallback)
+{
+    sNode_t *node = createSNode(8);
+    node->rqHandler = handleRequestI64;
+    node->accessLevel = accessLevel;
+    node->storage = storage;
+    node->changeCallback = changeCallback;
+    node->varData.i64Prm.defaultValue = defaultValue;
+    node->varData.i64Prm.minValue = minValue;
+    node->varData.i64Prm.maxValue = maxValue;
+    return node;
+}
+
+
+sNode_t *f32Node(uint8_t accessLevel, storageType storage,
+                       float minValue, float maxValue, float defaultValue,
+                       onChangeCallback changeCallback)
+{
+    sNode_t *node = createSNode(4);
+    node->rqHandler = handleRequestF32;
+    node->accessLevel = accessLevel;
+    node->storage = storage;
+    node->changeCallback = changeCallback;
+    node->varData.f32Prm.defaultValue = defaultValue;
+    node->varData.f32Prm.minValue = minValue;
+    node->varData.f32Prm.maxValue = maxValue;
+    return node;
+}
+
+
+sNode_t *f64Node(uint8_t accessLevel, storageType storage,
+                       double minValue, double maxValue, double defaultValue,
+                       onChangeCallback changeCallback)
+{
+    sNode_t *node = createSNode(8);
+    node->rqHandler = handleRequestF64;
+    node->accessLevel = accessLevel;
+    node->storage = storage;
+    node->changeCallback = changeCallback;
+    node->varData.f64Prm.defaultValue = defaultValue;
+    node->varData.f64Prm.minValue = minValue;
+    node->varData.f64Prm.maxValue = maxValue;
+    return node;
+}
 #endif
 
 
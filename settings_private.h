@@ -15,7 +15,152 @@
 
 // Set amount of memory for storing all the serialized data
 // Amount of memory actually used must be checked after InitNode() call
+#ifndef SETTINGS_RAM_SIZE
 #define SETTINGS_RAM_SIZE                   4096
+#endif
+
+// Set size of ROM device (bytes)
+#ifndef SETTINGS_ROM_SIZE
+#define SETTINGS_ROM_SIZE                   4096
+#endif
+
+// Set page size of ROM device (bytes)
+// Write-back cache tracks changes and writes data to device by pages
+#define SETTINGS_ROM_PAGE_SIZE              32
+
+// ROM write modes
+#define ROM_WRITE_THROUGH                   0       // Every change is written to ROM device immediately
+#define ROM_WRITE_BACK                      1       // Changes are collected in ROM cache and written by settingsFlushDirty()
+#define ROM_WRITE_QUEUED                    2       // Changes are written to ROM cache and queued for ROM writer
+
+// Set ROM write mode
+// Write-back and queued modes reduce ROM traffic and do not stall caller, but require SETTINGS_ROM_SIZE bytes of cache
+#ifndef SETTINGS_ROM_WRITE_MODE
+#define SETTINGS_ROM_WRITE_MODE             ROM_WRITE_THROUGH
+#endif
+
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+
+// Set maximum count of pending ROM write ranges
+// Overlapping and adjacent ranges are merged, so the queue rarely needs to be long
+#define SETTINGS_ROM_QUEUE_SIZE             16
+
+// Set maximum amount of data written by ROM writer in one device transaction (bytes)
+#define SETTINGS_ROM_WRITER_CHUNK           SETTINGS_ROM_PAGE_SIZE
+
+// Define option to 1 to run ROM writer in a POSIX thread
+// If option is set to 0, settingsRomWriterStep() must be called periodically by a system task,
+// and SETTINGS_ROM_QUEUE_LOCK()/SETTINGS_ROM_QUEUE_UNLOCK() must be defined if the task may preempt settings requests
+#define ROM_WRITER_USE_PTHREAD              1
+
+#if ROM_WRITER_USE_PTHREAD == 0
+#define SETTINGS_ROM_QUEUE_LOCK()
+#define SETTINGS_ROM_QUEUE_UNLOCK()
+#endif
+
+#endif  // ROM_WRITE_QUEUED
+
+// Define option to 1 to keep two copies (banks) of ROM image
+// settingsFlushDirty() writes the whole image to inactive bank by one sequential write, followed by a trailer
+// with generation counter and image CRC. On startup the newest bank with valid CRC is restored, so an interrupted
+// flush never loses settings, and node CRCs need not be checked. Requires write-back mode.
+// Every bank takes half of ROM
+#ifndef ROM_DUAL_BANK
+#define ROM_DUAL_BANK                       0
+#endif
+
+#if (ROM_DUAL_BANK == 1) && (SETTINGS_ROM_WRITE_MODE != ROM_WRITE_BACK)
+#error "ROM_DUAL_BANK requires ROM_WRITE_BACK mode"
+#endif
+
+// ROM backends
+#define ROM_BACKEND_DIRECT                  0       // ROM device is overwritten in place (EEPROM, FRAM)
+#define ROM_BACKEND_JOURNAL                 1       // ROM device is flash, changes are appended to a journal (see settings_journal.c)
+
+// Set ROM backend
+// Journal keeps a copy of ROM image in RAM (SETTINGS_ROM_SIZE bytes), which is rebuilt from flash on startup
+#ifndef SETTINGS_ROM_BACKEND
+#define SETTINGS_ROM_BACKEND                ROM_BACKEND_DIRECT
+#endif
+
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+
+// Set size of flash device (bytes)
+// Flash is split into two halves. Journal is appended to one of them, and when it is full,
+// current image is compacted into the other one. Every half must fit the whole ROM image
+#ifndef SETTINGS_FLASH_SIZE
+#define SETTINGS_FLASH_SIZE                 16384
+#endif
+
+// Set erase block size of flash device (bytes)
+#define SETTINGS_FLASH_BLOCK_SIZE           4096
+
+// Set maximum data size of journal record (bytes). Longer writes are split into several records
+// Every record takes JOURNAL_RECORD_OVERHEAD bytes in addition to data
+#define SETTINGS_JOURNAL_RECORD_SIZE        64
+
+#endif  // ROM_BACKEND_JOURNAL
+
+// Define option to 1 to read ROM image on startup by a few large transfers
+// Values are then restored and validated from memory instead of making a device transaction per node
+// Requires SETTINGS_ROM_SIZE bytes of cache (shared with write-back and queued modes)
+#ifndef ROM_BULK_RESTORE
+#define ROM_BULK_RESTORE                    0
+#endif
+
+// Set maximum amount of data read from ROM device in one transaction (bytes)
+// Must be a multiple of SETTINGS_ROM_PAGE_SIZE
+#define SETTINGS_ROM_READ_CHUNK             512
+
+// Set maximum count of ROM ranges collected while writes are deferred by settingsRomBeginDefer()
+// Used if ROM cache is enabled. If list is full, collected ranges are written to device
+#define SETTINGS_ROM_DEFER_RANGES           16
+
+// Set size of buffer used by image serializer (bytes)
+// Whole ROM image is loaded and saved as a sequential stream of blocks of this size
+#define SETTINGS_ROM_STREAM_CHUNK           64
+
+// Define option to 1 to keep integer values in RAM in native byte order
+// Values are converted to MSB first only when they are moved to or from ROM, and when node CRCs are calculated,
+// so ROM format is the same for both options. Reads are single loads instead of a byte loop.
+// Option has no effect on big-endian targets, native order is MSB first there
+#ifndef SETTINGS_RAM_NATIVE_ENDIAN
+#define SETTINGS_RAM_NATIVE_ENDIAN          0
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#undef SETTINGS_RAM_NATIVE_ENDIAN
+#define SETTINGS_RAM_NATIVE_ENDIAN          0
+#endif
+
+// Set layout of values in RAM
+// RAM_LAYOUT_COMPACT: values are packed tightly in ROM image order, every host node starts with its CRC
+// RAM_LAYOUT_ALIGNED: integer values are aligned to their size, hot values (see sNode_t) are placed first
+//     in their host node and CRC follows terminating values. Nodes are padded, so that alignment is kept in lists.
+//     Suits cores where unaligned access is expensive. Padding cost is reported on init and by tools/settings_gen.py
+// ROM layout is the same for both options
+#define RAM_LAYOUT_COMPACT                  0
+#define RAM_LAYOUT_ALIGNED                  1
+
+#ifndef SETTINGS_RAM_LAYOUT
+#define SETTINGS_RAM_LAYOUT                 RAM_LAYOUT_COMPACT
+#endif
+
+// Set ROM image format version
+// Should be changed if ROM content can not be restored by new firmware
+#define SETTINGS_ROM_FORMAT_VERSION         1
+
+// Define option to 1 to migrate ROM image written before image header was added
+// Such image has the tree placed at address 0. It is accepted if CRCs of all host nodes match and is saved
+// again with header on init. Otherwise defaults are restored, as for any image which does not match the tree
+// Only direct ROM backend without dual bank could have written such image
+#ifndef LEGACY_IMAGE_MIGRATION
+#if (SETTINGS_ROM_BACKEND == ROM_BACKEND_DIRECT) && (ROM_DUAL_BANK == 0)
+#define LEGACY_IMAGE_MIGRATION              1
+#else
+#define LEGACY_IMAGE_MIGRATION              0
+#endif
+#endif
 
 // Define option to 1 to enable assertion for validate result
 // Hepls to discover errors
@@ -27,7 +172,9 @@
 
 // Define option to 1 to enable simple descriptor constructors
 // If option is set to 0, descriptors should be created statically or using another memory allocation mechanism
-#define ENABLE_NODE_CONSTRUCTORS           1
+#ifndef ENABLE_NODE_CONSTRUCTORS
+#define ENABLE_NODE_CONSTRUCTORS            1
+#endif
 
 #if ENABLE_NODE_CONSTRUCTORS == 1
 
@@ -45,6 +192,156 @@
 
 #endif  // ENABLE_NODE_CONSTRUCTORS
 
+// Define option to 1 to use tree generated by tools/settings_gen.py (settings_tree.c, settings_tree.h)
+// Descriptors are const and have all offsets resolved, so initNode() is not called on startup.
+// Generated header provides RAM addresses of values and read accessors. Top module must not define the tree then
+#ifndef ENABLE_STATIC_TREE
+#define ENABLE_STATIC_TREE                  0
+#endif
+
+#if (ENABLE_STATIC_TREE == 1) && (ENABLE_NODE_CONSTRUCTORS == 1)
+#error "ENABLE_STATIC_TREE requires ENABLE_NODE_CONSTRUCTORS set to 0"
+#endif
+
+// Define option to 1 to enable table of resolved terminating nodes (slots)
+// Slot table is built once after InitNode() and allows handle-based access without walking the tree
+// Table takes SETTINGS_SLOT_TABLE_SIZE * sizeof(slot_t) bytes of RAM (6 KB with default size on 64-bit hosts)
+#ifndef ENABLE_SLOT_TABLE
+#define ENABLE_SLOT_TABLE                   0
+#endif
+
+#if ENABLE_SLOT_TABLE == 1
+
+// Set maximum number of terminating nodes in the tree (every list element counts separately)
+#ifndef SETTINGS_SLOT_TABLE_SIZE
+#define SETTINGS_SLOT_TABLE_SIZE            64
+#endif
+
+// Define option to 1 to enable lookup of terminating nodes by path name (see settingsResolveName())
+// Path is made of node names (see setName()), for example "B0.C1" or "B1[10]". Slots with unnamed nodes on the path are not indexed
+// Minimal perfect hash index is built with slot table, lookup takes constant time and does no allocation.
+// Index takes about 13 bytes per slot, 5 bytes per slot more are used while it is built
+#ifndef ENABLE_NAME_INDEX
+#define ENABLE_NAME_INDEX                   1
+#endif
+
+// Define option to 1 to enable change subscriptions (see settingsSubscribe())
+// Any number of subscribers may watch a terminating node or a whole subtree. Subscribers are not called within
+// the request: a change posts an event to a lock-free queue, and events are delivered by settingsDispatchEvents().
+// While event of a node is pending, further changes of the node are merged into it, so a slow subscriber sees
+// the latest value once. Changes are posted where change callbacks are called, requests without callback post nothing.
+// Requires C11 atomics
+#ifndef ENABLE_SUBSCRIPTIONS
+#define ENABLE_SUBSCRIPTIONS                0
+#endif
+
+#if ENABLE_SUBSCRIPTIONS == 1
+
+// Set maximum count of subscriptions
+#ifndef SETTINGS_MAX_SUBSCRIBERS
+#define SETTINGS_MAX_SUBSCRIBERS            16
+#endif
+
+// Set size of event queue, must be a power of 2
+// A node takes at most one entry, so events are never dropped if queue is not smaller than count of watched nodes
+#define SETTINGS_EVENT_QUEUE_SIZE           64
+
+// Set size of watch trie, must be a power of 2
+// Subscribers are found by walking the trie along path of changed node. Every watched path prefix takes an entry,
+// entries are found by hash, so trie should be at least twice as big as count of watched prefixes
+#ifndef SETTINGS_WATCH_TRIE_SIZE
+#define SETTINGS_WATCH_TRIE_SIZE            64
+#endif
+
+#if (SETTINGS_EVENT_QUEUE_SIZE & (SETTINGS_EVENT_QUEUE_SIZE - 1)) != 0
+#error "SETTINGS_EVENT_QUEUE_SIZE must be a power of 2"
+#endif
+#if (SETTINGS_WATCH_TRIE_SIZE & (SETTINGS_WATCH_TRIE_SIZE - 1)) != 0
+#error "SETTINGS_WATCH_TRIE_SIZE must be a power of 2"
+#endif
+
+#endif  // ENABLE_SUBSCRIPTIONS
+
+#endif  // ENABLE_SLOT_TABLE
+
+// Define option to 1 to reject requests made with access level lower than access level of terminating node
+// Requests are rejected by Result_AccessDenied. Internal calls like settings_ReadI32() use the highest access level.
+// Check is opt-in: requests made before access levels were added leave accLevel unset and would be rejected.
+// If option is set to 1, accLevel of every request must be set by caller
+// Access masks of subtrees are kept anyway (see settingsGetVisibleHandles())
+#ifndef ENABLE_ACCESS_CHECK
+#define ENABLE_ACCESS_CHECK                 0
+#endif
+
+// Set number of bytes processed by CRC16 calculation per step: 1, 4 or 8
+// Bigger values are faster for long nodes, but require CRC16_SLICE_COUNT * 512 bytes of lookup tables
+// For example, 700 bytes take about 2800, 740 and 400 ns on x86-64 with 1, 4 and 8 (see bench/crc.c)
+#ifndef CRC16_SLICE_COUNT
+#define CRC16_SLICE_COUNT                   1
+#endif
+
+// Define option to 1 to update host node CRC incrementally when a single value is changed
+// Cost of a write does not depend on host node size, since only changed bytes are processed
+// Host node CRC invalidated by resetSettingsToDefaults() stays invalid until restart, whatever request API is used
+// If option is set to 0, CRC is recalculated over the whole host node, so a write makes it valid again
+#define USE_INCREMENTAL_CRC                 1
+
+// Set maximum count of requests sorted and executed together by settingsRequestBatch() (up to 255)
+// Longer batches are processed by parts. Every request of a part takes sizeof(slot_t) bytes of stack
+#define SETTINGS_BATCH_SIZE                 32
+
+#if SETTINGS_BATCH_SIZE > 255
+#error "SETTINGS_BATCH_SIZE must not exceed 255"
+#endif
+
+// Define option to 1 to enable transactions (see settingsBegin())
+// A commit log is reserved at the end of ROM, so that a commit survives power loss as a whole or not at all
+// The log takes SETTINGS_TXN_LOG_SIZE bytes of ROM (378 bytes with default sizes below), which are not available to the tree
+// Atomic commit requires ROM cache (write-back or queued mode, or ROM_BULK_RESTORE)
+// If ROM_DUAL_BANK is set, commit log is not used: commit flushes the whole image to inactive bank
+#ifndef ENABLE_TRANSACTIONS
+#define ENABLE_TRANSACTIONS                 0
+#endif
+
+#if ENABLE_TRANSACTIONS == 1
+
+// Set maximum count of write requests made within a transaction
+// Must not exceed SETTINGS_BATCH_SIZE, and SETTINGS_ROM_DEFER_RANGES must be at least twice as big
+#define SETTINGS_TXN_MAX_REQUESTS           8
+
+// Set size of buffer for values written within a transaction (bytes)
+#define SETTINGS_TXN_BUFFER_SIZE            256
+
+// Size of ROM commit log (bytes). Fits values and host node CRCs of the biggest transaction
+#define SETTINGS_TXN_LOG_SIZE               (ROM_LOG_HEADER_SIZE + SETTINGS_TXN_BUFFER_SIZE + \
+                                             SETTINGS_TXN_MAX_REQUESTS * 2 * ROM_LOG_ENTRY_HEADER_SIZE + \
+                                             SETTINGS_TXN_MAX_REQUESTS * NODE_CRC_SIZE)
+
+#if SETTINGS_TXN_MAX_REQUESTS > SETTINGS_BATCH_SIZE
+#error "SETTINGS_TXN_MAX_REQUESTS must not exceed SETTINGS_BATCH_SIZE"
+#endif
+#if SETTINGS_ROM_DEFER_RANGES < (2 * SETTINGS_TXN_MAX_REQUESTS)
+#error "SETTINGS_ROM_DEFER_RANGES must be at least twice as big as SETTINGS_TXN_MAX_REQUESTS"
+#endif
+
+#endif  // ENABLE_TRANSACTIONS
+
+// Define option to 1 to allow reading values from several threads while another thread modifies them
+// Reads are lock-free: a sequence counter of the host node is checked before and after copying the value,
+// and the read is retried if the node has been modified meanwhile. All other requests are serialized by a mutex
+// Requires POSIX threads and C11 atomics. initSettings() must be complete before concurrent access is started
+#ifndef SETTINGS_CONCURRENT_READERS
+#define SETTINGS_CONCURRENT_READERS         0
+#endif
+
+#if SETTINGS_CONCURRENT_READERS == 1
+
+// Set number of sequence counters
+// Host nodes are mapped to counters by RAM address. Nodes sharing a counter may cause extra read retries
+#define SETTINGS_SEQLOCK_COUNT              16
+
+#endif  // SETTINGS_CONCURRENT_READERS
+
 //-------------------------------------------------------//
 
 
@@ -104,6 +401,143 @@ typedef resultType (*requestHandler)(rqType rq, struct sNode_t *node, uint32_t n
 #define NODE_CRC_SEED       0xFFFF
 
 
+// Integer values are stored in RAM MSB first, or in native byte order (see SETTINGS_RAM_NATIVE_ENDIAN)
+// Intended use: reading values by fixed address (see ENABLE_STATIC_TREE)
+#include <string.h>
+
+#if SETTINGS_RAM_NATIVE_ENDIAN == 1
+
+static inline uint32_t settingsRamLoad16(const uint8_t *data)
+{
+    uint16_t value;
+    memcpy(&value, data, 2);
+    return value;
+}
+
+static inline uint32_t settingsRamLoad32(const uint8_t *data)
+{
+    uint32_t value;
+    memcpy(&value, data, 4);
+    return value;
+}
+
+static inline uint64_t settingsRamLoad64(const uint8_t *data)
+{
+    uint64_t value;
+    memcpy(&value, data, 8);
+    return value;
+}
+
+#define SETTINGS_RAM_U8(addr)           ((uint32_t)ram[addr])
+#define SETTINGS_RAM_U16(addr)          settingsRamLoad16(&ram[addr])
+#define SETTINGS_RAM_U32(addr)          settingsRamLoad32(&ram[addr])
+#define SETTINGS_RAM_U64(addr)          settingsRamLoad64(&ram[addr])
+
+#else
+
+#define SETTINGS_RAM_U8(addr)           ((uint32_t)ram[addr])
+#define SETTINGS_RAM_U16(addr)          (((uint32_t)ram[addr] << 8) | ram[(addr) + 1])
+#define SETTINGS_RAM_U32(addr)          (((uint32_t)ram[addr] << 24) | ((uint32_t)ram[(addr) + 1] << 16) | \
+                                         ((uint32_t)ram[(addr) + 2] << 8) | ram[(addr) + 3])
+#define SETTINGS_RAM_U64(addr)          (((uint64_t)SETTINGS_RAM_U32(addr) << 32) | SETTINGS_RAM_U32((addr) + 4))
+
+#endif  // SETTINGS_RAM_NATIVE_ENDIAN
+
+// Signed and floating point values are kept in RAM as bit patterns of the same size
+static inline float settingsBitsToF32(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+static inline double settingsBitsToF64(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, 8);
+    return value;
+}
+
+#define SETTINGS_RAM_I8(addr)           ((int32_t)(int8_t)SETTINGS_RAM_U8(addr))
+#define SETTINGS_RAM_I16(addr)          ((int32_t)(int16_t)SETTINGS_RAM_U16(addr))
+#define SETTINGS_RAM_I32(addr)          ((int32_t)SETTINGS_RAM_U32(addr))
+#define SETTINGS_RAM_I64(addr)          ((int64_t)SETTINGS_RAM_U64(addr))
+#define SETTINGS_RAM_F32(addr)          settingsBitsToF32(SETTINGS_RAM_U32(addr))
+#define SETTINGS_RAM_F64(addr)          settingsBitsToF64(SETTINGS_RAM_U64(addr))
+
+
+// ROM image header. All fields are stored MSB first
+// Tree is stored right after the header
+#define ROM_HEADER_VERSION_OFFSET       0       // Format version, 2 bytes
+#define ROM_HEADER_HASH_OFFSET          2       // Tree layout hash, 2 bytes
+#define ROM_HEADER_LENGTH_OFFSET        4       // Tree size, 4 bytes
+#define ROM_HEADER_CRC_OFFSET           8       // Header CRC, 2 bytes
+#define ROM_HEADER_SIZE                 10
+
+
+// ROM commit log header, placed at ROM_LOG_BASE. All fields are stored MSB first
+// Log entries follow the header, every entry is ROM address (4 bytes), count (2 bytes) and data
+#define ROM_LOG_STATE_OFFSET            0       // ROM_LOG_COMMITTED if log must be replayed, 2 bytes
+#define ROM_LOG_COUNT_OFFSET            2       // Count of entries, 2 bytes
+#define ROM_LOG_LENGTH_OFFSET           4       // Total size of entries, 4 bytes
+#define ROM_LOG_CRC_OFFSET              8       // CRC of header and entries, 2 bytes
+#define ROM_LOG_HEADER_SIZE             10
+#define ROM_LOG_ENTRY_HEADER_SIZE       6
+#define ROM_LOG_COMMITTED               0xA55A
+
+#if (ENABLE_TRANSACTIONS == 1) && (ROM_DUAL_BANK == 0)
+#define ROM_LOG_BASE                    (SETTINGS_ROM_SIZE - SETTINGS_TXN_LOG_SIZE)
+#else
+#define ROM_LOG_BASE                    SETTINGS_ROM_SIZE
+#endif
+
+
+// Journal half header, placed at the start of every half of flash. All fields are stored MSB first
+// Records follow the header, every record is ROM address (4 bytes), count (2 bytes), data and CRC (2 bytes)
+// Erased ROM address marks the end of journal
+#define JOURNAL_MAGIC_OFFSET            0       // JOURNAL_MAGIC, 2 bytes
+#define JOURNAL_SEQUENCE_OFFSET         2       // Incremented by every compaction, the half with bigger value is newer, 4 bytes
+#define JOURNAL_CRC_OFFSET              6       // Header CRC, 2 bytes
+#define JOURNAL_HEADER_SIZE             8
+#define JOURNAL_MAGIC                   0x4A4C
+#define JOURNAL_RECORD_HEADER_SIZE      6
+#define JOURNAL_RECORD_OVERHEAD         (JOURNAL_RECORD_HEADER_SIZE + NODE_CRC_SIZE)
+
+
+// ROM bank trailer, placed at the end of every bank if ROM_DUAL_BANK is set. All fields are stored MSB first
+#define ROM_BANK_GENERATION_OFFSET      0       // Incremented by every flush, the bank with bigger value is newer, 4 bytes
+#define ROM_BANK_LENGTH_OFFSET          4       // Length of image, 4 bytes
+#define ROM_BANK_CRC_OFFSET             8       // CRC of image and trailer, 2 bytes
+#define ROM_BANK_TRAILER_SIZE           10
+
+#if ROM_DUAL_BANK == 1
+#define ROM_BANK_SIZE                   ((SETTINGS_ROM_SIZE / 2) / SETTINGS_ROM_PAGE_SIZE * SETTINGS_ROM_PAGE_SIZE)
+#define ROM_BANK_TRAILER_OFFSET         (ROM_BANK_SIZE - ROM_BANK_TRAILER_SIZE)
+#define ROM_IMAGE_LIMIT                 ROM_BANK_TRAILER_OFFSET
+#else
+#define ROM_IMAGE_LIMIT                 ROM_LOG_BASE
+#endif
+
+// Storage size required from storage driver
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+#define SETTINGS_STORAGE_SIZE           SETTINGS_FLASH_SIZE
+#else
+#define SETTINGS_STORAGE_SIZE           SETTINGS_ROM_SIZE
+#endif
+
+
+// Node restore modes for validateNode()
+#define RESTORE_FROM_ROM                0       // Values are read from ROM and validated
+#define RESTORE_DEFAULTS                1       // Default values are restored and written to ROM
+#define RESTORE_FROM_RAM                2       // Values have been restored to RAM by settingsLoadImage() and are validated in place
+#define RESTORE_FROM_BANK               3       // Same as RESTORE_FROM_RAM, but image CRC is verified and node CRCs are not checked
+
+
+// Access mask of a single access level, and of all levels up to given one
+#define ACCESS_MASK(level)              ((uint8_t)(1U << (level)))
+#define ACCESS_MASK_UP_TO(level)        ((uint8_t)((2U << (level)) - 1))
+
+
 // Node type
 typedef enum {
     sNode,          // Simple (terminating) node
@@ -114,7 +548,10 @@ typedef enum {
 
 #define GENERIC_NODE_PATTERN            nodeType type;  \
                                         uint32_t ramOffset;     /* Used by hNode for fast indexed access */  \
-                                        uint32_t romOffset;
+                                        uint32_t romOffset;     \
+                                        uint32_t slotOffset;    /* Index of first terminating node relative to host node */ \
+                                        const char *name;       /* Used in path names, list elements are addressed by index */ \
+                                        uint8_t accessMask;     /* Bit per access level of terminating nodes in subtree, see ACCESS_MASK() */
 
 
 // Generic node descriptor
@@ -130,6 +567,8 @@ struct hNode_t {
     // Custom
     uint16_t hListSize;             // Child list size
     struct node_t **hList;          // List of child node descriptors
+    uint32_t crcOffset;             // RAM offset of node CRC, see SETTINGS_RAM_LAYOUT
+    uint32_t slotCount;             // Count of terminating nodes in subtree
 };
 
 
@@ -142,6 +581,8 @@ struct lNode_t {
     struct node_t *element;         // Child node descriptor (since all are equal, single descriptor is used)
     uint32_t elementRamSize;
     uint32_t elementRomSize;
+    uint32_t elementSlotCount;
+    uint32_t crcOffset;             // RAM offset of node CRC, see SETTINGS_RAM_LAYOUT
 };
 
 
@@ -152,11 +593,51 @@ struct u32Prm_t {
 };
 
 
+struct i32Prm_t {
+    int32_t defaultValue;
+    int32_t minValue;
+    int32_t maxValue;
+};
+
+
+struct u64Prm_t {
+    uint64_t defaultValue;
+    uint64_t minValue;
+    uint64_t maxValue;
+};
+
+
+struct i64Prm_t {
+    int64_t defaultValue;
+    int64_t minValue;
+    int64_t maxValue;
+};
+
+
+struct f32Prm_t {
+    float defaultValue;
+    float minValue;
+    float maxValue;
+};
+
+
+struct f64Prm_t {
+    double defaultValue;
+    double minValue;
+    double maxValue;
+};
+
+
 struct charArrayPrm_t {
     const char *defaultValue;
 };
 
 
+struct blobPrm_t {
+    const uint8_t *defaultValue;            // May be 0, value is set to zeros then
+};
+
+
 // Simple (terminating) node descriptor
 struct sNode_t {
     // Common
@@ -165,11 +646,19 @@ struct sNode_t {
     uint32_t size;
     uint8_t accessLevel;
     storageType storage;
+    uint8_t hot;                    // Value is accessed often and is placed first in aligned RAM layout
     onChangeCallback changeCallback;
+    onChangeCallbackCtx changeCallbackCtx;
     requestHandler rqHandler;
     union {
-        struct u32Prm_t u32Prm;
+        struct u32Prm_t u32Prm;                 // u8, u16 and u32
+        struct i32Prm_t i32Prm;                 // i8, i16 and i32
+        struct u64Prm_t u64Prm;
+        struct i64Prm_t i64Prm;
+        struct f32Prm_t f32Prm;
+        struct f64Prm_t f64Prm;
         struct charArrayPrm_t charArrayPrm;     // not 0-terminated
+        struct blobPrm_t blobPrm;
     } varData;
 };
 
@@ -181,16 +670,95 @@ typedef struct lNode_t lNode_t;
 typedef struct sNode_t sNode_t;
 
 
+// Resolved terminating node (slot)
+// Contains everything required to handle a request without walking the tree
+struct slot_t {
+    sNode_t *node;                  // Terminating node descriptor
+    requestHandler rqHandler;       // Copy of node request handler
+    uint32_t size;                  // Copy of node size
+    uint32_t ramOffset;             // Absolute RAM address of the value
+    uint32_t romOffset;             // Absolute ROM address of the value
+    node_t *hostNode;               // Hierarchy or list node which holds CRC for the value
+    uint32_t hostRamOffset;         // Absolute RAM address of the host node
+    uint32_t hostRomOffset;         // Absolute ROM address of the host node
+    uint32_t crcRamOffset;          // Absolute RAM address of the host node CRC
+    uint32_t crcTail;               // Count of host node CRC payload bytes following the value
+    uint8_t accessLevel;            // Copy of node access level
+    uint32_t depth;                 // Count of arguments used to address the node
+    uint16_t arg[SETTINGS_MAX_DEPTH];   // Arguments used to address the node
+#if ENABLE_NAME_INDEX == 1
+    uint64_t nameHash;              // Hash of path name, see settingsResolveName()
+#endif
+};
+
+typedef struct slot_t slot_t;
+
+
+// Subscription to changes of a subtree, see settingsSubscribe()
+// Terminating nodes of a subtree have consecutive handles
+struct subscriber_t {
+    settingsHandle_t first;         // Handle of the first terminating node of subtree
+    uint32_t count;                 // Count of terminating nodes in subtree
+    uint32_t depth;                 // Count of arguments of subtree path, path is the same as leading arguments of first node
+    uint16_t watchNode;             // Watch trie entry of the path
+    uint16_t next;                  // Next subscription of the same path
+    settingsEventCallback callback; // 0 for unused entry
+    void *userData;                 // Passed to callback
+};
+
+typedef struct subscriber_t subscriber_t;
+
+
+// Entry of watch trie, made for every path prefix watched by subscriptions
+// Children are found by hash of parent entry and argument, entries are never moved while trie is in use
+struct watchNode_t {
+    uint16_t parent;                // Parent entry, WATCH_ROOT for top level nodes
+    uint16_t arg;                   // Argument which selects the node within parent
+    uint16_t subscriber;            // First subscription of the path, WATCH_NONE if there is no one
+    uint16_t used;                  // 0 for free entry
+};
+
+typedef struct watchNode_t watchNode_t;
+
+
+// Nodes passed by tree walk
+// Allows to resume walk for a request which has the same leading arguments as the previous one
+struct nodeTrail_t {
+    uint32_t depth;                             // Count of arguments used by the walk
+    uint32_t arg[SETTINGS_MAX_DEPTH];           // Argument used at every level
+    node_t *node[SETTINGS_MAX_DEPTH];           // Node reached at every level, node[0] is root
+    uint32_t ramOffset[SETTINGS_MAX_DEPTH];     // Absolute RAM address of the node
+    uint32_t romOffset[SETTINGS_MAX_DEPTH];     // Absolute ROM address of the node
+};
+
+typedef struct nodeTrail_t nodeTrail_t;
+
+
 // Node init context data
 struct nodeInitContext_t {
     uint32_t depth;             // Current depth for a node
     uint32_t maxDepth;          // Maximum depth for whole tree
     uint32_t maxAllowedDepth;   // Maximum alowed depth (if maxDepth esceeds this value, error is generated)
+    uint32_t ramAlign;          // RAM alignment of the last initialized node
+    uint32_t ramPadding;        // Count of RAM bytes used for alignment in whole tree
 };
 
 typedef struct nodeInitContext_t nodeInitContext_t;
 
 
+// Sequential access to ROM image, used to load and save whole tree by blocks
+struct romStream_t {
+    uint32_t romAddr;           // ROM address of the first byte in buffer
+    uint32_t romEnd;            // ROM address following the last byte of image
+    uint32_t count;             // Count of valid bytes in buffer
+    uint32_t pos;               // Current read position in buffer
+    uint8_t save;               // 1 - data is moved from RAM to ROM, 0 - from ROM to RAM
+    uint8_t data[SETTINGS_ROM_STREAM_CHUNK];
+};
+
+typedef struct romStream_t romStream_t;
+
+
 // Paramater validation result
 typedef enum {
     ValidateOk,
@@ -200,16 +768,78 @@ typedef enum {
 
 
 
-    resultType initNode(node_t *node, uint32_t *ramSize, uint32_t *romSize, nodeInitContext_t *ctx);
-    resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase, uint8_t useDefaults);
+    resultType initNode(node_t *node, uint32_t *ramSize, uint32_t *romSize, uint32_t *slotCount, nodeInitContext_t *ctx);
+    resultType validateNode(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase, uint8_t restoreMode);
     resultType invalidateNodeCrc(node_t *node, uint32_t nodeRamBase, uint32_t nodeRomBase, uint8_t wholeTree);
+    uint16_t getTreeHash(node_t *node, uint16_t crc);
+    resultType settingsLoadImage(uint32_t treeRomSize);
+    void settingsSaveImage(uint32_t treeRomSize);
+    void writeRomHeader(uint32_t treeRomSize);
     void makeCRC16Table(void);
     uint16_t getCRC16(uint8_t *data, uint16_t len, uint16_t crc);
+    uint16_t shiftCRC16(uint16_t crc, uint32_t zeroBytes);
 
     resultType settingsRequest(request_t *rqst);
+    resultType settingsRequestBatch(request_t *rqs, uint32_t n);
+#if ENABLE_TRANSACTIONS == 1
+    resultType settingsBegin(void);
+    resultType settingsCommit(void);
+    void settingsAbort(void);
+#endif
     uint32_t getRequestArg(uint32_t historyIndex);
     callbackCache_t *getCallbackCache(void);
 
+    void settingsSetStorageDriver(const settingsStorageDriver_t *driver);
+    const settingsStorageDriver_t *settingsGetStorageDriver(void);
+    void storageRead(uint32_t addr, uint8_t *data, uint32_t count);
+    void storageWrite(uint32_t addr, const uint8_t *data, uint32_t count);
+    void storageErase(uint32_t addr, uint32_t count);
+    void storageFlush(void);
+
+    void readRom(uint32_t ramAddr, uint32_t romAddr, uint32_t count);
+    void writeRom(uint32_t romAddr, uint32_t ramAddr, uint32_t count);
+    void readRomData(uint32_t romAddr, uint8_t *data, uint32_t count);
+    void writeRomData(uint32_t romAddr, const uint8_t *data, uint32_t count);
+    void settingsRomLoad(uint32_t size);
+    uint8_t settingsRomImageVerified(void);
+    uint32_t settingsRomGeneration(void);
+    void settingsRomBeginDefer(void);
+    void settingsRomEndDefer(void);
+    void settingsRomCommitDefer(void);
+    void settingsRomRecover(void);
+    void settingsRomDropCache(void);
+    uint32_t settingsFlushDirty(uint32_t maxPages);
+    settingsRomStats_t *getRomStats(void);
+    void settingsWaitIdle(void);
+    settingsRomQueueStats_t *getRomQueueStats(void);
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+    uint32_t settingsRomWriterStep(void);
+#endif
+
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+    void journalRead(uint32_t romAddr, uint8_t *data, uint32_t count);
+    void journalWrite(uint32_t romAddr, const uint8_t *data, uint32_t count);
+    void journalUnmount(void);
+#endif
+
+#if ENABLE_SLOT_TABLE == 1
+    void buildSlotTable(uint32_t slotCount);
+    settingsHandle_t settingsResolve(request_t *rqst);
+    resultType settingsRequestByHandle(settingsHandle_t handle, request_t *rqst);
+    int32_t settings_ReadI32ByHandle(settingsHandle_t handle);
+    float settings_ReadF32ByHandle(settingsHandle_t handle);
+    uint32_t settingsGetVisibleHandles(request_t *rqst, uint32_t depth, settingsHandle_t *handles, uint32_t maxCount);
+#if ENABLE_NAME_INDEX == 1
+    settingsHandle_t settingsResolveName(const char *name);
+#endif
+#if ENABLE_SUBSCRIPTIONS == 1
+    uint32_t settingsSubscribe(request_t *rqst, uint32_t depth, settingsEventCallback callback, void *userData);
+    void settingsUnsubscribe(uint32_t id);
+    uint32_t settingsDispatchEvents(uint32_t maxEvents);
+    settingsEventStats_t *getEventStats(void);
+#endif
+#endif
+
 #if ENABLE_NODE_CONSTRUCTORS == 1
 #if USE_SETTINGS_MEMORY_ALLOC == 1
     void *settingsAlloc(uint32_t size);
@@ -220,6 +850,9 @@ typedef enum {
     lNode_t *createLNode(uint16_t elementsCount, void *node);
 
     void addToHList(hNode_t *hnode, uint32_t index, void *node);
+    sNode_t *setChangeCallbackCtx(sNode_t *node, onChangeCallbackCtx changeCallbackCtx);
+    sNode_t *setHot(sNode_t *node);
+    void *setName(void *node, const char *name);
 
     sNode_t *u32Node(uint8_t accessLevel, storageType storage,
                        uint32_t defaultValue, uint32_t minValue, uint32_t maxValue,
@@ -233,10 +866,46 @@ typedef enum {
     sNode_t *charNode(uint8_t accessLevel, storageType storage,
                            uint32_t size, const char *defaultValue,
                            onChangeCallback changeCallback);
+    sNode_t *i32Node(uint8_t accessLevel, storageType storage,
+                           int32_t minValue, int32_t maxValue, int32_t defaultValue,
+                           onChangeCallback changeCallback);
+    sNode_t *i16Node(uint8_t accessLevel, storageType storage,
+                           int32_t minValue, int32_t maxValue, int32_t defaultValue,
+                           onChangeCallback changeCallback);
+    sNode_t *i8Node(uint8_t accessLevel, storageType storage,
+                           int32_t minValue, int32_t maxValue, int32_t defaultValue,
+                           onChangeCallback changeCallback);
+    sNode_t *u64Node(uint8_t accessLevel, storageType storage,
+                           uint64_t minValue, uint64_t maxValue, uint64_t defaultValue,
+                           onChangeCallback changeCallback);
+    sNode_t *i64Node(uint8_t accessLevel, storageType storage,
+                           int64_t minValue, int64_t maxValue, int64_t defaultValue,
+                           onChangeCallback changeCallback);
+    sNode_t *f32Node(uint8_t accessLevel, storageType storage,
+                           float minValue, float maxValue, float defaultValue,
+                           onChangeCallback changeCallback);
+    sNode_t *f64Node(uint8_t accessLevel, storageType storage,
+                           double minValue, double maxValue, double defaultValue,
+                           onChangeCallback changeCallback);
+    sNode_t *blobNode(uint8_t accessLevel, storageType storage,
+                           uint32_t size, const uint8_t *defaultValue,
+                           onChangeCallback changeCallback);
 #endif
+    void notifyChange(sNode_t *pNode, rqType rq, requestContext_t *ctx);
     validateResult validateU32(uint32_t value, struct u32Prm_t *prm);
+    validateResult validateI32(int32_t value, struct i32Prm_t *prm);
+    validateResult validateU64(uint64_t value, struct u64Prm_t *prm);
+    validateResult validateI64(int64_t value, struct i64Prm_t *prm);
+    validateResult validateF32(float value, struct f32Prm_t *prm);
+    validateResult validateF64(double value, struct f64Prm_t *prm);
     resultType handleRequestU32(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst);
+    resultType handleRequestI32(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst);
+    resultType handleRequestU64(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst);
+    resultType handleRequestI64(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst);
+    resultType handleRequestF32(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst);
+    resultType handleRequestF64(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst);
     resultType handleRequestCharArray(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst);
+    resultType handleRequestBlob(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, request_t *rqst);
 
 
 
@@ -277,11 +946,126 @@ typedef enum {
     {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = sz, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handler, \
     .varData.charArrayPrm = {.defaultValue = dflt}}
 
+// Same as above, but callback takes request context (see onChangeCallbackCtx)
+#define u8NodeCtx(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 1, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestU32, \
+    .varData.u32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define u16NodeCtx(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 2, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestU32, \
+    .varData.u32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define u32NodeCtx(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 4, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestU32, \
+    .varData.u32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define charNodeCtx(accs, stor, sz, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = sz, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestCharArray, \
+    .varData.charArrayPrm = {.defaultValue = dflt}}
+
+// Signed, 64-bit and floating point nodes, each type has its own request handler
+#define i8Node(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 1, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handleRequestI32, \
+    .varData.i32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i8NodeRq(accs, stor, min, max, dflt, callback, handler)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 1, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handler, \
+    .varData.i32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i8NodeCtx(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 1, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestI32, \
+    .varData.i32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i16Node(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 2, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handleRequestI32, \
+    .varData.i32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i16NodeRq(accs, stor, min, max, dflt, callback, handler)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 2, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handler, \
+    .varData.i32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i16NodeCtx(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 2, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestI32, \
+    .varData.i32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i32Node(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 4, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handleRequestI32, \
+    .varData.i32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i32NodeRq(accs, stor, min, max, dflt, callback, handler)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 4, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handler, \
+    .varData.i32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i32NodeCtx(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 4, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestI32, \
+    .varData.i32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define u64Node(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 8, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handleRequestU64, \
+    .varData.u64Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define u64NodeRq(accs, stor, min, max, dflt, callback, handler)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 8, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handler, \
+    .varData.u64Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define u64NodeCtx(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 8, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestU64, \
+    .varData.u64Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i64Node(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 8, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handleRequestI64, \
+    .varData.i64Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i64NodeRq(accs, stor, min, max, dflt, callback, handler)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 8, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handler, \
+    .varData.i64Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define i64NodeCtx(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 8, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestI64, \
+    .varData.i64Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define f32Node(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 4, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handleRequestF32, \
+    .varData.f32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define f32NodeRq(accs, stor, min, max, dflt, callback, handler)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 4, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handler, \
+    .varData.f32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define f32NodeCtx(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 4, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestF32, \
+    .varData.f32Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define f64Node(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 8, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handleRequestF64, \
+    .varData.f64Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define f64NodeRq(accs, stor, min, max, dflt, callback, handler)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 8, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handler, \
+    .varData.f64Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+#define f64NodeCtx(accs, stor, min, max, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = 8, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestF64, \
+    .varData.f64Prm = {.defaultValue = dflt, .minValue = min, .maxValue = max}}
+
+// Blob nodes, requests may address a range of the value (see request_t)
+#define blobNode(accs, stor, sz, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = sz, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handleRequestBlob, \
+    .varData.blobPrm = {.defaultValue = dflt}}
+
+#define blobNodeRq(accs, stor, sz, dflt, callback, handler)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = sz, .accessLevel = accs, .storage = stor, .changeCallback = callback, .rqHandler = handler, \
+    .varData.blobPrm = {.defaultValue = dflt}}
+
+#define blobNodeCtx(accs, stor, sz, dflt, callback)   \
+    {.type = sNode, .ramOffset = 0, .romOffset = 0, .size = sz, .accessLevel = accs, .storage = stor, .changeCallbackCtx = callback, .rqHandler = handleRequestBlob, \
+    .varData.blobPrm = {.defaultValue = dflt}}
+
 #define hNode(list) \
     {.type = hNode, .ramOffset = 0, .romOffset = 0, .hListSize = sizeof(list)/sizeof(node_t *), .hList = list}
 
 #define lNode(count, node) \
-    {.type = lNode, .ramOffset = 0, .romOffset = 0, .hListSize = count, .element = node, .elementRamSize = 0, .elementRomSize = 0}
+    {.type = lNode, .ramOffset = 0, .romOffset = 0, .hListSize = count, .element = node, .elementRamSize = 0, .elementRomSize = 0, .elementSlotCount = 0}
 
 #endif
 
@@ -42,6 +42,7 @@ typedef enum {
     rqGetMin = 0x10,
     rqGetMax = 0x20,
     rqGetSize = 0x40,
+    rqRestoreLoaded = 0xFD,     // Validate value restored to RAM by image loader
     rqRestoreValidate = 0xFE,
     rqRestoreDefault = 0xFF
 } rqType;
@@ -58,6 +59,12 @@ typedef enum {
     Result_NotEnoughArguments,
     Result_DepthExceeded,
     Result_ValidateError,
+    Result_ImageMismatch,
+    Result_TransactionFull,
+    Result_TransactionState,
+    Result_StorageError,
+    Result_AccessDenied,            // Access level of request is lower than access level of the node
+    Result_LegacyImage,             // ROM image has been written without header, see LEGACY_IMAGE_MIGRATION
     Result_UpdatedRom = 0x80        // May be ORed with other results
 } resultType;
 
@@ -68,23 +75,124 @@ typedef struct {
     accessLevel accLevel;
     uint32_t arg[SETTINGS_MAX_DEPTH];
     union {
-        int32_t *i32;
+        int32_t *i32;               // 8-bit to 32-bit integers
+        uint32_t *u32;
+        int64_t *i64;
+        uint64_t *u64;
+        float *f32;
+        double *f64;
     } val;
     uint8_t *raw;                   // Raw serialized data. If set to non-zero, data must be read or written in raw serialized form
-                                    // Char arrays always use raw form.
+                                    // Char arrays and blobs always use raw form.
+    uint32_t offset;                // Range of blob value: raw data holds length bytes starting at offset.
+    uint32_t length;                // Length of 0 selects bytes from offset to the end. Ignored by other nodes
     resultType result;              // Returned request result
+    struct requestContext_t *ctx;   // Request context, set by settings module for request handlers and cleared on return
 } request_t;
 
 
+// Handle of a resolved terminating node, see settingsResolve()
+typedef uint32_t settingsHandle_t;
+
+#define SETTINGS_INVALID_HANDLE             0xFFFFFFFF
+
+
+// Pass to settingsFlushDirty() to write all dirty pages
+#define SETTINGS_FLUSH_ALL                  0xFFFFFFFF
+
+
+// ROM device access statistics
+typedef struct {
+    uint32_t readCalls;
+    uint32_t readBytes;
+    uint32_t writeCalls;
+    uint32_t writeBytes;
+    uint32_t mappedBytes;           // Bytes read directly from memory mapped storage, bypassing the device
+} settingsRomStats_t;
+
+
+// ROM write queue statistics
+typedef struct {
+    uint32_t depth;                 // Current count of pending ranges
+    uint32_t maxDepth;              // Maximum count of pending ranges
+    uint32_t enqueued;              // Count of ranges added to the queue
+    uint32_t coalesced;             // Count of ranges merged with pending ones
+    uint32_t written;               // Count of device transactions made by ROM writer
+    uint32_t stalls;                // Count of writes which had to wait for free queue entry
+} settingsRomQueueStats_t;
+
+
+// Pass to settingsDispatchEvents() to deliver all pending events
+#define SETTINGS_DISPATCH_ALL               0xFFFFFFFF
+
+// Returned by settingsSubscribe() if subscription is not made
+#define SETTINGS_INVALID_SUBSCRIPTION       0xFFFFFFFF
+
+
+// Change event, delivered to subscribers by settingsDispatchEvents()
+typedef struct {
+    settingsHandle_t handle;        // Changed terminating node, its current value may be read by settingsRequestByHandle()
+    uint32_t depth;                 // Count of arguments used to address the node
+    const uint16_t *arg;            // Arguments indexed by depth
+    uint32_t changes;               // Count of changes merged into this event
+} settingsEvent_t;
+
+// Subscriber function prototype
+typedef void (*settingsEventCallback)(const settingsEvent_t *event, void *userData);
+
+
+// Change event statistics
+typedef struct {
+    uint32_t posted;                // Count of changes made to watched nodes
+    uint32_t coalesced;             // Count of changes merged with a pending event of the same node
+    uint32_t dropped;               // Count of changes lost because event queue was full
+    uint32_t dispatched;            // Count of events delivered by settingsDispatchEvents()
+} settingsEventStats_t;
+
+
+// Storage driver, registered by settingsSetStorageDriver() before initSettings()
+// Addresses are device addresses: ROM image, commit log and banks for direct backend, flash for journal backend
+typedef struct {
+    void (*read)(void *ctx, uint32_t addr, uint8_t *data, uint32_t count);
+    void (*write)(void *ctx, uint32_t addr, const uint8_t *data, uint32_t count);
+    void (*flush)(void *ctx);                           // Make completed writes durable. May be 0
+    void (*erase)(void *ctx, uint32_t addr);            // Set block of pageSize bytes to 0xFF. Required by journal backend only
+    const uint8_t *(*map)(void *ctx);                   // Get memory mapped content of storage. May be 0
+    uint32_t size;                                      // Storage size (bytes)
+    uint32_t pageSize;                                  // Erase block size of flash, write unit of other devices (bytes)
+    void *ctx;                                          // Passed to every function
+} settingsStorageDriver_t;
+
+
 // Values cache for change callback
 typedef union {
     int32_t i32;
+    uint32_t u32;
+    int64_t i64;
+    uint64_t u64;
+    float f32;
+    double f64;
     char *str;
 } callbackCache_t;
 
+// Request context, built on stack for every request and passed to change callbacks
+struct requestContext_t {
+    uint32_t depth;                 // Count of arguments used to address the node
+    const uint16_t *arg;            // Arguments indexed by depth: arg[0] selects top level node, arg[depth - 1] is the last one
+    callbackCache_t value;          // New value
+    uint32_t offset;                // Changed range of blob value, value.str points to its new bytes. Set for blobs only
+    uint32_t length;
+};
+
+typedef struct requestContext_t requestContext_t;
+
 // Callback function prototype
+// Legacy form, request arguments and new value are provided by getRequestArg() and getCallbackCache()
 typedef void (*onChangeCallback)(rqType rq, uint32_t lastArg);
 
+// Callback function prototype with request context
+typedef void (*onChangeCallbackCtx)(rqType rq, const requestContext_t *ctx);
+
 
 
 
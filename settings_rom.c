@@ -0,0 +1,1116 @@
+/******************************************************************************
+    ROM access layer of settings module
+    Connects RAM image to storage driver, implements write-back cache, queued ROM writer,
+    commit log for atomic update of several ranges and dual-bank ROM layout
+
+    This file should not be modified for configuration reasons
+******************************************************************************/
+
+#include <string.h>
+#include "settings_private.h"
+#include "settings_public.h"
+#if (SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED) && (ROM_WRITER_USE_PTHREAD == 1)
+#include <pthread.h>
+#endif
+
+
+#define ROM_PAGE_COUNT          ((SETTINGS_ROM_SIZE + SETTINGS_ROM_PAGE_SIZE - 1) / SETTINGS_ROM_PAGE_SIZE)
+#define ROM_PAGE_BITMAP_SIZE    ((ROM_PAGE_COUNT + 31) / 32)
+
+#define PAGE_BIT_TEST(map, page)    ((map)[(page) >> 5] & (1UL << ((page) & 0x1F)))
+#define PAGE_BIT_SET(map, page)     ((map)[(page) >> 5] |= (1UL << ((page) & 0x1F)))
+#define PAGE_BIT_CLEAR(map, page)   ((map)[(page) >> 5] &= ~(1UL << ((page) & 0x1F)))
+
+// ROM cache is used by write-back and queued modes, and for bulk restore
+#define USE_ROM_CACHE           ((SETTINGS_ROM_WRITE_MODE != ROM_WRITE_THROUGH) || (ROM_BULK_RESTORE == 1))
+
+// Deferred writes are collected in ROM cache
+#define USE_ROM_DEFER           USE_ROM_CACHE
+
+#if (SETTINGS_ROM_READ_CHUNK < SETTINGS_ROM_PAGE_SIZE) || (SETTINGS_ROM_READ_CHUNK % SETTINGS_ROM_PAGE_SIZE)
+#error "SETTINGS_ROM_READ_CHUNK must be a multiple of SETTINGS_ROM_PAGE_SIZE"
+#endif
+
+// Commit log is used by transactions unless dual-bank layout makes every flush atomic
+#define USE_ROM_LOG             ((ENABLE_TRANSACTIONS == 1) && (ROM_DUAL_BANK == 0))
+
+#if (ENABLE_TRANSACTIONS == 1) && !USE_ROM_CACHE
+#error "Transactions require ROM cache: use write-back or queued mode, or enable ROM_BULK_RESTORE"
+#endif
+
+#if (SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED) && (ROM_WRITER_USE_PTHREAD == 1)
+#define SETTINGS_ROM_QUEUE_LOCK()       pthread_mutex_lock(&queueLock)
+#define SETTINGS_ROM_QUEUE_UNLOCK()     pthread_mutex_unlock(&queueLock)
+#elif SETTINGS_ROM_WRITE_MODE != ROM_WRITE_QUEUED
+#define SETTINGS_ROM_QUEUE_LOCK()
+#define SETTINGS_ROM_QUEUE_UNLOCK()
+#endif
+
+
+// RAM is private
+extern uint8_t ram[SETTINGS_RAM_SIZE];
+
+// ROM device and write queue statistics
+static settingsRomStats_t romStats;
+static settingsRomQueueStats_t queueStats;
+
+// Storage driver, see settingsSetStorageDriver()
+static const settingsStorageDriver_t *storage;
+// Content of memory mapped storage, 0 if storage is not mapped
+static const uint8_t *storageMap;
+
+#if USE_ROM_CACHE
+// ROM image cache. Pages are loaded on first access
+static uint8_t romCache[SETTINGS_ROM_SIZE];
+static uint32_t pageCached[ROM_PAGE_BITMAP_SIZE];
+#endif
+
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_BACK
+static uint32_t pageDirty[ROM_PAGE_BITMAP_SIZE];
+static uint32_t dirtyPagesCount;
+#endif
+
+#if ROM_DUAL_BANK == 1
+// ROM cache holds image of active bank. Changes are written to the other bank
+static uint32_t activeBank;
+static uint32_t bankGeneration;
+static uint32_t imageSize;
+static uint8_t imageVerified;
+#define ROM_BANK_BASE(bank)     ((bank) * ROM_BANK_SIZE)
+#define ROM_CACHE_BASE          ROM_BANK_BASE(activeBank)
+#else
+#define ROM_CACHE_BASE          0
+#endif
+
+// Pending range of ROM addresses, data is taken from ROM cache when range is written
+typedef struct {
+    uint32_t romAddr;
+    uint32_t count;
+} romRange_t;
+
+#if USE_ROM_DEFER
+static romRange_t deferRanges[SETTINGS_ROM_DEFER_RANGES];
+static uint32_t deferCount;
+static uint32_t deferDepth;
+#endif
+
+#if USE_ROM_LOG
+// Commit log writer. Entries are collected in buffer and written to device by chunks
+typedef struct {
+    uint32_t romAddr;           // ROM address of the first byte in buffer
+    uint32_t count;             // Count of bytes in buffer
+    uint16_t crc;               // CRC of all bytes written so far
+    uint8_t data[SETTINGS_ROM_STREAM_CHUNK];
+} logWriter_t;
+#endif
+
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+static romRange_t romQueue[SETTINGS_ROM_QUEUE_SIZE];
+static uint32_t queueHead;
+static uint32_t writerBusy;
+
+#if ROM_WRITER_USE_PTHREAD == 1
+static pthread_mutex_t queueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t deviceLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workCond = PTHREAD_COND_INITIALIZER;          // Signaled when a range is queued
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;          // Signaled when a range is written
+static pthread_t writerThread;
+static uint32_t writerStarted;
+#endif
+#endif
+
+// External functions
+
+    uint16_t getCRC16(uint8_t *data, uint16_t len, uint16_t crc);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    void u32toBytesMsbFirst(uint32_t *number, uint8_t *bytes, uint32_t count);
+    void bytesToU32MsbFirst(uint8_t *bytes, uint32_t *number, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+    // Prototypes
+
+    static void deviceRead(uint32_t romAddr, uint8_t *data, uint32_t count);
+    static void deviceWrite(uint32_t romAddr, const uint8_t *data, uint32_t count);
+    static void deviceFlush(void);
+#if USE_ROM_CACHE
+    static void loadCachePages(uint32_t firstPage, uint32_t lastPage);
+#endif
+#if USE_ROM_CACHE && (SETTINGS_ROM_BACKEND == ROM_BACKEND_DIRECT)
+    static void readMapped(uint32_t romAddr, uint8_t *data, uint32_t count);
+#endif
+#if USE_ROM_CACHE
+    static void writeCache(uint32_t romAddr, const uint8_t *data, uint32_t count);
+#endif
+#if USE_ROM_DEFER
+    static void addDeferRange(uint32_t romAddr, uint32_t count);
+    static void sortDeferRanges(void);
+    static void writeDeferRanges(void);
+#endif
+#if USE_ROM_LOG
+    static void appendLog(logWriter_t *log, const uint8_t *data, uint32_t count);
+    static void flushLog(logWriter_t *log);
+    static void commitDeferRanges(void);
+    static uint32_t checkLog(uint32_t length, uint16_t crc);
+    static void replayLog(uint32_t count, uint32_t length);
+#endif
+#if ROM_DUAL_BANK == 1
+    static uint16_t getImageCRC(uint32_t length, uint32_t generation);
+    static uint8_t loadBank(uint32_t bank, uint32_t generation, uint32_t length, uint32_t crc);
+    static void selectBank(void);
+    static void flushBank(void);
+#endif
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+    static void enqueueRange(uint32_t romAddr, uint32_t count);
+#if ROM_WRITER_USE_PTHREAD == 1
+    static void *romWriterThread(void *arg);
+#endif
+#endif
+
+
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// Device access
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+static void deviceRead(uint32_t romAddr, uint8_t *data, uint32_t count)
+{
+#if (SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED) && (ROM_WRITER_USE_PTHREAD == 1)
+    pthread_mutex_lock(&deviceLock);
+#endif
+    romStats.readCalls++;
+    romStats.readBytes += count;
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+    journalRead(romAddr, data, count);
+#else
+    storageRead(romAddr, data, count);
+#endif
+#if (SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED) && (ROM_WRITER_USE_PTHREAD == 1)
+    pthread_mutex_unlock(&deviceLock);
+#endif
+}
+
+
+static void deviceWrite(uint32_t romAddr, const uint8_t *data, uint32_t count)
+{
+#if (SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED) && (ROM_WRITER_USE_PTHREAD == 1)
+    pthread_mutex_lock(&deviceLock);
+#endif
+    romStats.writeCalls++;
+    romStats.writeBytes += count;
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+    journalWrite(romAddr, data, count);
+#else
+    storageWrite(romAddr, data, count);
+#endif
+#if (SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED) && (ROM_WRITER_USE_PTHREAD == 1)
+    pthread_mutex_unlock(&deviceLock);
+#endif
+}
+
+
+// Make all completed device writes durable
+// Used as a barrier between writes whose order matters after power loss
+static void deviceFlush(void)
+{
+#if (SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED) && (ROM_WRITER_USE_PTHREAD == 1)
+    pthread_mutex_lock(&deviceLock);
+#endif
+    storageFlush();
+#if (SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED) && (ROM_WRITER_USE_PTHREAD == 1)
+    pthread_mutex_unlock(&deviceLock);
+#endif
+}
+
+
+#if USE_ROM_CACHE
+// Read pages which are not cached yet
+// Adjacent pages are read by single device transaction of up to SETTINGS_ROM_READ_CHUNK bytes
+static void loadCachePages(uint32_t firstPage, uint32_t lastPage)
+{
+    uint32_t page, runStart, runEnd;
+    page = firstPage;
+    while (page <= lastPage)
+    {
+        if (PAGE_BIT_TEST(pageCached, page))
+        {
+            page++;
+            continue;
+        }
+        runStart = page;
+        while ((page <= lastPage) && !PAGE_BIT_TEST(pageCached, page) &&
+               ((page - runStart) < (SETTINGS_ROM_READ_CHUNK / SETTINGS_ROM_PAGE_SIZE)))
+        {
+            PAGE_BIT_SET(pageCached, page);
+            page++;
+        }
+        runStart *= SETTINGS_ROM_PAGE_SIZE;
+        runEnd = page * SETTINGS_ROM_PAGE_SIZE;
+        if (runEnd > SETTINGS_ROM_SIZE)
+            runEnd = SETTINGS_ROM_SIZE;
+        deviceRead(ROM_CACHE_BASE + runStart, &romCache[runStart], runEnd - runStart);
+    }
+}
+#endif  // USE_ROM_CACHE
+
+
+#if USE_ROM_CACHE && (SETTINGS_ROM_BACKEND == ROM_BACKEND_DIRECT)
+// Copy data from memory mapped storage without loading it to cache
+// Cached pages are taken from cache, as they may hold changes which have not reached storage yet
+static void readMapped(uint32_t romAddr, uint8_t *data, uint32_t count)
+{
+    uint32_t page, runEnd, cached;
+    while (count != 0)
+    {
+        page = romAddr / SETTINGS_ROM_PAGE_SIZE;
+        cached = PAGE_BIT_TEST(pageCached, page) ? 1 : 0;
+        runEnd = (page + 1) * SETTINGS_ROM_PAGE_SIZE;
+        while ((runEnd < romAddr + count) && ((PAGE_BIT_TEST(pageCached, runEnd / SETTINGS_ROM_PAGE_SIZE) ? 1 : 0) == cached))
+            runEnd += SETTINGS_ROM_PAGE_SIZE;
+        if (runEnd > romAddr + count)
+            runEnd = romAddr + count;
+        if (cached)
+        {
+            memcpy(data, &romCache[romAddr], runEnd - romAddr);
+        }
+        else
+        {
+            memcpy(data, &storageMap[ROM_CACHE_BASE + romAddr], runEnd - romAddr);
+            romStats.mappedBytes += runEnd - romAddr;
+        }
+        data += runEnd - romAddr;
+        count -= runEnd - romAddr;
+        romAddr = runEnd;
+    }
+}
+#endif
+
+
+#if USE_ROM_CACHE
+// Copy data to ROM cache
+static void writeCache(uint32_t romAddr, const uint8_t *data, uint32_t count)
+{
+    uint32_t page, firstPage, lastPage;
+    firstPage = romAddr / SETTINGS_ROM_PAGE_SIZE;
+    lastPage = (romAddr + count - 1) / SETTINGS_ROM_PAGE_SIZE;
+    // Partially written pages must be loaded to keep the rest of the page intact
+    if (romAddr % SETTINGS_ROM_PAGE_SIZE)
+        loadCachePages(firstPage, firstPage);
+    if (((romAddr + count) % SETTINGS_ROM_PAGE_SIZE) && ((romAddr + count) < SETTINGS_ROM_SIZE))
+        loadCachePages(lastPage, lastPage);
+    memcpy(&romCache[romAddr], data, count);
+    for (page=firstPage; page<=lastPage; page++)
+    {
+        PAGE_BIT_SET(pageCached, page);
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_BACK
+        if (!PAGE_BIT_TEST(pageDirty, page))
+        {
+            PAGE_BIT_SET(pageDirty, page);
+            dirtyPagesCount++;
+        }
+#endif
+    }
+}
+#endif
+
+
+#if USE_ROM_DEFER
+// Add range to the list of deferred writes
+// Range is merged with a collected one if they overlap or adjoin
+// Ranges of a transaction always fit the list (see SETTINGS_TXN_MAX_REQUESTS)
+static void addDeferRange(uint32_t romAddr, uint32_t count)
+{
+    romRange_t *entry;
+    uint32_t i, start, end;
+    for (i=0; i<deferCount; i++)
+    {
+        entry = &deferRanges[i];
+        if ((romAddr <= entry->romAddr + entry->count) && (entry->romAddr <= romAddr + count))
+        {
+            start = (romAddr < entry->romAddr) ? romAddr : entry->romAddr;
+            end = (romAddr + count > entry->romAddr + entry->count) ? romAddr + count : entry->romAddr + entry->count;
+            entry->romAddr = start;
+            entry->count = end - start;
+            return;
+        }
+    }
+    if (deferCount == SETTINGS_ROM_DEFER_RANGES)
+        writeDeferRanges();
+    deferRanges[deferCount].romAddr = romAddr;
+    deferRanges[deferCount].count = count;
+    deferCount++;
+}
+
+
+// Sort collected ranges by address and merge ranges which have become adjacent
+static void sortDeferRanges(void)
+{
+    romRange_t range;
+    uint32_t i, j, end;
+    for (i=1; i<deferCount; i++)
+    {
+        range = deferRanges[i];
+        for (j=i; (j>0) && (deferRanges[j - 1].romAddr > range.romAddr); j--)
+            deferRanges[j] = deferRanges[j - 1];
+        deferRanges[j] = range;
+    }
+    i = 0;
+    j = 0;
+    while (i < deferCount)
+    {
+        range = deferRanges[i++];
+        while ((i < deferCount) && (deferRanges[i].romAddr <= range.romAddr + range.count))
+        {
+            end = deferRanges[i].romAddr + deferRanges[i].count;
+            if (end > range.romAddr + range.count)
+                range.count = end - range.romAddr;
+            i++;
+        }
+        deferRanges[j++] = range;
+    }
+    deferCount = j;
+}
+
+
+// Pass collected ranges to device in address order, every range is written by single device transaction
+// In write-back mode pages are already marked dirty and nothing is written
+// Must be called with queue locked
+static void writeDeferRanges(void)
+{
+    uint32_t i;
+    sortDeferRanges();
+    for (i=0; i<deferCount; i++)
+    {
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+        enqueueRange(deferRanges[i].romAddr, deferRanges[i].count);
+#elif SETTINGS_ROM_WRITE_MODE == ROM_WRITE_THROUGH
+        deviceWrite(deferRanges[i].romAddr, &romCache[deferRanges[i].romAddr], deferRanges[i].count);
+#endif
+    }
+    deferCount = 0;
+}
+#endif  // USE_ROM_DEFER
+
+
+#if USE_ROM_LOG
+// Add bytes to commit log
+static void appendLog(logWriter_t *log, const uint8_t *data, uint32_t count)
+{
+    uint32_t chunk;
+    while (count != 0)
+    {
+        chunk = SETTINGS_ROM_STREAM_CHUNK - log->count;
+        if (chunk > count)
+            chunk = count;
+        memcpy(&log->data[log->count], data, chunk);
+        log->count += chunk;
+        data += chunk;
+        count -= chunk;
+        if (log->count == SETTINGS_ROM_STREAM_CHUNK)
+            flushLog(log);
+    }
+}
+
+
+// Write buffered bytes of commit log to device
+static void flushLog(logWriter_t *log)
+{
+    if (log->count == 0)
+        return;
+    log->crc = getCRC16(log->data, log->count, log->crc);
+    deviceWrite(log->romAddr, log->data, log->count);
+    log->romAddr += log->count;
+    log->count = 0;
+}
+
+
+// Write collected ranges to device atomically
+// Ranges are written to commit log first. Log is marked committed by its header, which is written last,
+// then ranges are written to their home addresses and the log is cleared.
+// If power is lost meanwhile, either nothing has changed or the log is replayed by settingsRomRecover()
+// Must be called with queue locked
+static void commitDeferRanges(void)
+{
+    logWriter_t log;
+    uint8_t header[ROM_LOG_HEADER_SIZE];
+    uint8_t entry[ROM_LOG_ENTRY_HEADER_SIZE];
+    uint32_t i, value, length;
+    sortDeferRanges();
+    if (deferCount == 0)
+        return;
+    length = 0;
+    for (i=0; i<deferCount; i++)
+        length += ROM_LOG_ENTRY_HEADER_SIZE + deferRanges[i].count;
+    SETTINGS_ASSERT_TRUE((ROM_LOG_HEADER_SIZE + length) <= SETTINGS_TXN_LOG_SIZE);
+
+    value = ROM_LOG_COMMITTED;
+    u32toBytesMsbFirst(&value, &header[ROM_LOG_STATE_OFFSET], 2);
+    u32toBytesMsbFirst(&deferCount, &header[ROM_LOG_COUNT_OFFSET], 2);
+    u32toBytesMsbFirst(&length, &header[ROM_LOG_LENGTH_OFFSET], 4);
+    log.romAddr = ROM_LOG_BASE + ROM_LOG_HEADER_SIZE;
+    log.count = 0;
+    log.crc = getCRC16(header, ROM_LOG_CRC_OFFSET, NODE_CRC_SEED);
+    for (i=0; i<deferCount; i++)
+    {
+        u32toBytesMsbFirst(&deferRanges[i].romAddr, &entry[0], 4);
+        u32toBytesMsbFirst(&deferRanges[i].count, &entry[4], 2);
+        appendLog(&log, entry, ROM_LOG_ENTRY_HEADER_SIZE);
+        appendLog(&log, &romCache[deferRanges[i].romAddr], deferRanges[i].count);
+    }
+    flushLog(&log);
+    value = log.crc;
+    u32toBytesMsbFirst(&value, &header[ROM_LOG_CRC_OFFSET], NODE_CRC_SIZE);
+    deviceFlush();
+    deviceWrite(ROM_LOG_BASE, header, ROM_LOG_HEADER_SIZE);
+    deviceFlush();
+
+    for (i=0; i<deferCount; i++)
+        deviceWrite(deferRanges[i].romAddr, &romCache[deferRanges[i].romAddr], deferRanges[i].count);
+    deviceFlush();
+    value = 0;
+    u32toBytesMsbFirst(&value, header, 2);
+    deviceWrite(ROM_LOG_BASE + ROM_LOG_STATE_OFFSET, header, 2);
+    deferCount = 0;
+}
+
+
+// Check CRC of commit log entries
+// Returns 1 if log is intact
+static uint32_t checkLog(uint32_t length, uint16_t crc)
+{
+    uint8_t buffer[SETTINGS_ROM_STREAM_CHUNK];
+    uint8_t header[ROM_LOG_HEADER_SIZE];
+    uint32_t romAddr, chunk, value;
+    deviceRead(ROM_LOG_BASE, header, ROM_LOG_HEADER_SIZE);
+    bytesToU32MsbFirst(&header[ROM_LOG_CRC_OFFSET], &value, NODE_CRC_SIZE);
+    crc = getCRC16(header, ROM_LOG_CRC_OFFSET, crc);
+    romAddr = ROM_LOG_BASE + ROM_LOG_HEADER_SIZE;
+    while (length != 0)
+    {
+        chunk = (length > SETTINGS_ROM_STREAM_CHUNK) ? SETTINGS_ROM_STREAM_CHUNK : length;
+        deviceRead(romAddr, buffer, chunk);
+        crc = getCRC16(buffer, chunk, crc);
+        romAddr += chunk;
+        length -= chunk;
+    }
+    return (crc == value);
+}
+
+
+// Copy commit log entries to their home addresses
+static void replayLog(uint32_t count, uint32_t length)
+{
+    uint8_t buffer[SETTINGS_ROM_STREAM_CHUNK];
+    uint32_t logAddr, logEnd, romAddr, size, chunk;
+    logAddr = ROM_LOG_BASE + ROM_LOG_HEADER_SIZE;
+    logEnd = logAddr + length;
+    while (count--)
+    {
+        SETTINGS_ASSERT_TRUE((logAddr + ROM_LOG_ENTRY_HEADER_SIZE) <= logEnd);
+        deviceRead(logAddr, buffer, ROM_LOG_ENTRY_HEADER_SIZE);
+        bytesToU32MsbFirst(&buffer[0], &romAddr, 4);
+        bytesToU32MsbFirst(&buffer[4], &size, 2);
+        logAddr += ROM_LOG_ENTRY_HEADER_SIZE;
+        SETTINGS_ASSERT_TRUE(((logAddr + size) <= logEnd) && ((romAddr + size) <= ROM_LOG_BASE));
+        while (size != 0)
+        {
+            chunk = (size > SETTINGS_ROM_STREAM_CHUNK) ? SETTINGS_ROM_STREAM_CHUNK : size;
+            deviceRead(logAddr, buffer, chunk);
+            deviceWrite(romAddr, buffer, chunk);
+            logAddr += chunk;
+            romAddr += chunk;
+            size -= chunk;
+        }
+    }
+}
+#endif  // USE_ROM_LOG
+
+
+#if ROM_DUAL_BANK == 1
+// Get CRC of cached image and bank trailer
+static uint16_t getImageCRC(uint32_t length, uint32_t generation)
+{
+    uint8_t trailer[ROM_BANK_CRC_OFFSET];
+    uint32_t pos, chunk;
+    uint16_t crc = NODE_CRC_SEED;
+    for (pos=0; pos<length; pos+=chunk)
+    {
+        chunk = ((length - pos) > 0x8000) ? 0x8000 : (length - pos);
+        crc = getCRC16(&romCache[pos], (uint16_t)chunk, crc);
+    }
+    u32toBytesMsbFirst(&generation, &trailer[ROM_BANK_GENERATION_OFFSET], 4);
+    u32toBytesMsbFirst(&length, &trailer[ROM_BANK_LENGTH_OFFSET], 4);
+    return getCRC16(trailer, ROM_BANK_CRC_OFFSET, crc);
+}
+
+
+// Load image of a bank to cache and check its CRC
+// Returns 1 if bank is valid, otherwise cache is left empty
+static uint8_t loadBank(uint32_t bank, uint32_t generation, uint32_t length, uint32_t crc)
+{
+    if ((length == 0) || (length > ROM_IMAGE_LIMIT))
+        return 0;
+    activeBank = bank;
+    memset(pageCached, 0, sizeof(pageCached));
+    loadCachePages(0, (length - 1) / SETTINGS_ROM_PAGE_SIZE);
+    if (crc == getImageCRC(length, generation))
+        return 1;
+    memset(pageCached, 0, sizeof(pageCached));
+    return 0;
+}
+
+
+// Find the newest valid bank and load its image to cache
+// If neither bank is valid, cache is empty and the next flush writes bank 0
+static void selectBank(void)
+{
+    uint8_t trailer[ROM_BANK_TRAILER_SIZE];
+    uint32_t generation[2], length[2], crc[2];
+    uint32_t bank, newest, i;
+    for (bank=0; bank<2; bank++)
+    {
+        deviceRead(ROM_BANK_BASE(bank) + ROM_BANK_TRAILER_OFFSET, trailer, ROM_BANK_TRAILER_SIZE);
+        bytesToU32MsbFirst(&trailer[ROM_BANK_GENERATION_OFFSET], &generation[bank], 4);
+        bytesToU32MsbFirst(&trailer[ROM_BANK_LENGTH_OFFSET], &length[bank], 4);
+        bytesToU32MsbFirst(&trailer[ROM_BANK_CRC_OFFSET], &crc[bank], NODE_CRC_SIZE);
+    }
+    // Generation counter may wrap around
+    newest = ((int32_t)(generation[1] - generation[0]) > 0) ? 1 : 0;
+    for (i=0; i<2; i++)
+    {
+        bank = newest ^ i;
+        if (loadBank(bank, generation[bank], length[bank], crc[bank]))
+        {
+            bankGeneration = generation[bank];
+            imageVerified = 1;
+            return;
+        }
+    }
+    activeBank = 1;
+    bankGeneration = generation[newest];
+    imageVerified = 0;
+}
+
+
+// Write whole cached image to inactive bank and make it active
+// Trailer is written last, so that the bank becomes valid only when the image is complete
+static void flushBank(void)
+{
+    uint8_t trailer[ROM_BANK_TRAILER_SIZE];
+    uint32_t bank, generation, crc;
+    SETTINGS_ASSERT_TRUE(imageSize != 0);
+    loadCachePages(0, (imageSize - 1) / SETTINGS_ROM_PAGE_SIZE);
+    bank = activeBank ^ 1;
+    generation = bankGeneration + 1;
+    deviceWrite(ROM_BANK_BASE(bank), romCache, imageSize);
+    u32toBytesMsbFirst(&generation, &trailer[ROM_BANK_GENERATION_OFFSET], 4);
+    u32toBytesMsbFirst(&imageSize, &trailer[ROM_BANK_LENGTH_OFFSET], 4);
+    crc = getImageCRC(imageSize, generation);
+    u32toBytesMsbFirst(&crc, &trailer[ROM_BANK_CRC_OFFSET], NODE_CRC_SIZE);
+    deviceFlush();
+    deviceWrite(ROM_BANK_BASE(bank) + ROM_BANK_TRAILER_OFFSET, trailer, ROM_BANK_TRAILER_SIZE);
+    // The other bank is overwritten by the next flush, so this one must be durable first
+    deviceFlush();
+    activeBank = bank;
+    bankGeneration = generation;
+    memset(pageDirty, 0, sizeof(pageDirty));
+    dirtyPagesCount = 0;
+}
+#endif  // ROM_DUAL_BANK
+
+
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+// Add range to ROM write queue
+// Range is merged with a pending one if they overlap or adjoin
+// Must be called with queue locked
+static void enqueueRange(uint32_t romAddr, uint32_t count)
+{
+    romRange_t *entry;
+    uint32_t i, start, end;
+    for (i=0; i<queueStats.depth; i++)
+    {
+        entry = &romQueue[(queueHead + i) % SETTINGS_ROM_QUEUE_SIZE];
+        if ((romAddr <= entry->romAddr + entry->count) && (entry->romAddr <= romAddr + count))
+        {
+            start = (romAddr < entry->romAddr) ? romAddr : entry->romAddr;
+            end = (romAddr + count > entry->romAddr + entry->count) ? romAddr + count : entry->romAddr + entry->count;
+            entry->romAddr = start;
+            entry->count = end - start;
+            queueStats.coalesced++;
+            return;
+        }
+    }
+    while (queueStats.depth >= SETTINGS_ROM_QUEUE_SIZE)
+    {
+        // Queue is full, wait until writer frees an entry
+        queueStats.stalls++;
+#if ROM_WRITER_USE_PTHREAD == 1
+        pthread_cond_wait(&doneCond, &queueLock);
+#else
+        SETTINGS_ROM_QUEUE_UNLOCK();
+        settingsRomWriterStep();
+        SETTINGS_ROM_QUEUE_LOCK();
+#endif
+    }
+    entry = &romQueue[(queueHead + queueStats.depth) % SETTINGS_ROM_QUEUE_SIZE];
+    entry->romAddr = romAddr;
+    entry->count = count;
+    queueStats.depth++;
+    queueStats.enqueued++;
+    if (queueStats.depth > queueStats.maxDepth)
+        queueStats.maxDepth = queueStats.depth;
+#if ROM_WRITER_USE_PTHREAD == 1
+    if (!writerStarted)
+    {
+        writerStarted = 1;
+        pthread_create(&writerThread, 0, romWriterThread, 0);
+    }
+    pthread_cond_signal(&workCond);
+#endif
+}
+
+
+#if ROM_WRITER_USE_PTHREAD == 1
+static void *romWriterThread(void *arg)
+{
+    (void)arg;
+    while (1)
+    {
+        pthread_mutex_lock(&queueLock);
+        while (queueStats.depth == 0)
+            pthread_cond_wait(&workCond, &queueLock);
+        pthread_mutex_unlock(&queueLock);
+        settingsRomWriterStep();
+    }
+    return 0;
+}
+#endif
+#endif  // ROM_WRITE_QUEUED
+
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// Public
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+// Register storage driver
+// Must be called before initSettings(). Driver must stay valid while settings module is used.
+// ROM cache is dropped, so that a driver may be replaced at run time after flushing pending writes
+void settingsSetStorageDriver(const settingsStorageDriver_t *driver)
+{
+    SETTINGS_ASSERT_TRUE((driver->read != 0) && (driver->write != 0) && (driver->size >= SETTINGS_STORAGE_SIZE));
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+    SETTINGS_ASSERT_TRUE((driver->erase != 0) && (driver->pageSize != 0) && ((SETTINGS_FLASH_BLOCK_SIZE % driver->pageSize) == 0));
+#endif
+    settingsRomDropCache();
+    storage = driver;
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_DIRECT
+    // Journal backend rebuilds image from records, so mapping of flash is not used
+    storageMap = driver->map ? driver->map(driver->ctx) : 0;
+#endif
+}
+
+
+// Get registered storage driver, 0 if none is registered
+const settingsStorageDriver_t *settingsGetStorageDriver(void)
+{
+    return storage;
+}
+
+
+// Read data from storage
+// Intended use: device access of ROM layer and journal backend
+void storageRead(uint32_t addr, uint8_t *data, uint32_t count)
+{
+    SETTINGS_ASSERT_TRUE((storage != 0) && ((addr + count) <= storage->size));
+    storage->read(storage->ctx, addr, data, count);
+}
+
+
+// Write data to storage
+void storageWrite(uint32_t addr, const uint8_t *data, uint32_t count)
+{
+    SETTINGS_ASSERT_TRUE((storage != 0) && ((addr + count) <= storage->size));
+    storage->write(storage->ctx, addr, data, count);
+}
+
+
+// Erase blocks of storage, addr and count must be multiples of driver page size
+void storageErase(uint32_t addr, uint32_t count)
+{
+    uint32_t end;
+    SETTINGS_ASSERT_TRUE((storage != 0) && (storage->erase != 0) && ((addr + count) <= storage->size));
+    SETTINGS_ASSERT_TRUE(((addr % storage->pageSize) == 0) && ((count % storage->pageSize) == 0));
+    for (end = addr + count; addr < end; addr += storage->pageSize)
+        storage->erase(storage->ctx, addr);
+}
+
+
+// Make completed writes durable
+void storageFlush(void)
+{
+    SETTINGS_ASSERT_TRUE(storage != 0);
+    if (storage->flush)
+        storage->flush(storage->ctx);
+}
+
+
+// Copy data from ROM to RAM
+void readRom(uint32_t ramAddr, uint32_t romAddr, uint32_t count)
+{
+    SETTINGS_ASSERT_TRUE((ramAddr + count) <= SETTINGS_RAM_SIZE);
+    readRomData(romAddr, &ram[ramAddr], count);
+}
+
+
+// Copy data from RAM to ROM
+void writeRom(uint32_t romAddr, uint32_t ramAddr, uint32_t count)
+{
+    SETTINGS_ASSERT_TRUE((ramAddr + count) <= SETTINGS_RAM_SIZE);
+    writeRomData(romAddr, &ram[ramAddr], count);
+}
+
+
+// Read data from ROM to buffer
+void readRomData(uint32_t romAddr, uint8_t *data, uint32_t count)
+{
+    SETTINGS_ASSERT_TRUE((romAddr + count) <= ROM_IMAGE_LIMIT);
+    if (count == 0)
+        return;
+#if USE_ROM_CACHE
+    SETTINGS_ROM_QUEUE_LOCK();
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_DIRECT
+    if (storageMap != 0)
+    {
+        readMapped(romAddr, data, count);
+        SETTINGS_ROM_QUEUE_UNLOCK();
+        return;
+    }
+#endif
+    loadCachePages(romAddr / SETTINGS_ROM_PAGE_SIZE, (romAddr + count - 1) / SETTINGS_ROM_PAGE_SIZE);
+    memcpy(data, &romCache[romAddr], count);
+    SETTINGS_ROM_QUEUE_UNLOCK();
+#else
+    deviceRead(romAddr, data, count);
+#endif
+}
+
+
+// Write data from buffer to ROM
+// In write-back mode data is written to cache and marked dirty, device is updated by settingsFlushDirty()
+// In queued mode data is written to cache and the range is queued for ROM writer, caller is not stalled
+void writeRomData(uint32_t romAddr, const uint8_t *data, uint32_t count)
+{
+    SETTINGS_ASSERT_TRUE((romAddr + count) <= ROM_IMAGE_LIMIT);
+    if (count == 0)
+        return;
+#if USE_ROM_DEFER
+    if (deferDepth != 0)
+    {
+        // Device is updated by settingsRomEndDefer() or settingsRomCommitDefer()
+        SETTINGS_ROM_QUEUE_LOCK();
+        writeCache(romAddr, data, count);
+        addDeferRange(romAddr, count);
+        SETTINGS_ROM_QUEUE_UNLOCK();
+        return;
+    }
+#endif
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_BACK
+    writeCache(romAddr, data, count);
+#elif SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+    SETTINGS_ROM_QUEUE_LOCK();
+    writeCache(romAddr, data, count);
+    enqueueRange(romAddr, count);
+    SETTINGS_ROM_QUEUE_UNLOCK();
+#else
+    deviceWrite(romAddr, data, count);
+#if USE_ROM_CACHE
+    // Keep restored image consistent with device
+    memcpy(&romCache[romAddr], data, count);
+#endif
+#endif
+}
+
+
+// Defer ROM writes until settingsRomEndDefer() or settingsRomCommitDefer() is called
+// Intended use: collecting writes of a batch, so that every contiguous range is written to device once
+// Calls may be nested. Has no effect if ROM cache is not used
+void settingsRomBeginDefer(void)
+{
+#if USE_ROM_DEFER
+    deferDepth++;
+#endif
+}
+
+
+// Write ROM ranges collected since settingsRomBeginDefer()
+void settingsRomEndDefer(void)
+{
+#if USE_ROM_DEFER
+    SETTINGS_ASSERT_TRUE(deferDepth != 0);
+    if (--deferDepth == 0)
+    {
+        SETTINGS_ROM_QUEUE_LOCK();
+        writeDeferRanges();
+        SETTINGS_ROM_QUEUE_UNLOCK();
+    }
+#endif
+}
+
+
+// Write ROM ranges collected since settingsRomBeginDefer() atomically, through commit log
+// Must not be nested into another deferral. Pending writes of queued mode are finished first
+void settingsRomCommitDefer(void)
+{
+#if (ENABLE_TRANSACTIONS == 1) && (ROM_DUAL_BANK == 1)
+    // Bank switch is atomic, pages are dirty already
+    SETTINGS_ASSERT_TRUE(deferDepth == 1);
+    deferDepth = 0;
+    deferCount = 0;
+    flushBank();
+#elif USE_ROM_LOG
+    SETTINGS_ASSERT_TRUE(deferDepth == 1);
+    settingsWaitIdle();
+    SETTINGS_ROM_QUEUE_LOCK();
+    deferDepth = 0;
+    commitDeferRanges();
+    SETTINGS_ROM_QUEUE_UNLOCK();
+#endif
+}
+
+
+// Finish commit interrupted by power loss
+// Must be called on startup before ROM is accessed. Intact committed log is replayed, any other log is discarded
+void settingsRomRecover(void)
+{
+#if USE_ROM_LOG
+    uint8_t header[ROM_LOG_HEADER_SIZE];
+    uint32_t state, count, length;
+    deviceRead(ROM_LOG_BASE, header, ROM_LOG_HEADER_SIZE);
+    bytesToU32MsbFirst(&header[ROM_LOG_STATE_OFFSET], &state, 2);
+    if (state != ROM_LOG_COMMITTED)
+        return;
+    bytesToU32MsbFirst(&header[ROM_LOG_COUNT_OFFSET], &count, 2);
+    bytesToU32MsbFirst(&header[ROM_LOG_LENGTH_OFFSET], &length, 4);
+    if (((ROM_LOG_HEADER_SIZE + length) <= SETTINGS_TXN_LOG_SIZE) && checkLog(length, NODE_CRC_SEED))
+    {
+        replayLog(count, length);
+        deviceFlush();
+    }
+    state = 0;
+    u32toBytesMsbFirst(&state, header, 2);
+    deviceWrite(ROM_LOG_BASE + ROM_LOG_STATE_OFFSET, header, 2);
+#endif
+}
+
+
+// Discard ROM cache and all writes which have not reached device yet
+// Intended use: simulating power loss in testbenches
+void settingsRomDropCache(void)
+{
+    SETTINGS_ROM_QUEUE_LOCK();
+#if USE_ROM_CACHE
+    memset(pageCached, 0, sizeof(pageCached));
+#endif
+#if USE_ROM_DEFER
+    deferCount = 0;
+    deferDepth = 0;
+#endif
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_BACK
+    memset(pageDirty, 0, sizeof(pageDirty));
+    dirtyPagesCount = 0;
+#elif SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+    queueStats.depth = 0;
+#endif
+#if SETTINGS_ROM_BACKEND == ROM_BACKEND_JOURNAL
+    journalUnmount();
+#endif
+    SETTINGS_ROM_QUEUE_UNLOCK();
+}
+
+
+// Read ROM image from device into cache
+// Intended use: restoring whole tree on startup by a few large transfers, so that
+// following readRom() calls do not access device. Pages which are cached already are kept
+// If ROM_DUAL_BANK is set, the newest valid bank is selected first. Must be called on startup then,
+// size sets length of image written by following flushes
+// Memory mapped storage is not copied to cache, readRom() takes data from the mapping
+void settingsRomLoad(uint32_t size)
+{
+#if USE_ROM_CACHE
+    SETTINGS_ASSERT_TRUE(size <= ROM_IMAGE_LIMIT);
+    if (size == 0)
+        return;
+    SETTINGS_ROM_QUEUE_LOCK();
+#if ROM_DUAL_BANK == 1
+    imageSize = size;
+    selectBank();
+#endif
+    if (storageMap == 0)
+        loadCachePages(0, (size - 1) / SETTINGS_ROM_PAGE_SIZE);
+    SETTINGS_ROM_QUEUE_UNLOCK();
+#else
+    (void)size;
+#endif
+}
+
+
+// Check if ROM image has been restored from a bank with valid CRC
+// Node CRCs need not be checked then
+uint8_t settingsRomImageVerified(void)
+{
+#if ROM_DUAL_BANK == 1
+    return imageVerified;
+#else
+    return 0;
+#endif
+}
+
+
+// Get generation of active bank, it is incremented by every bank switch
+// Returns 0 if ROM_DUAL_BANK is not set
+uint32_t settingsRomGeneration(void)
+{
+#if ROM_DUAL_BANK == 1
+    return bankGeneration;
+#else
+    return 0;
+#endif
+}
+
+
+// Write dirty pages of ROM cache to device
+// Up to maxPages pages are written, adjacent dirty pages are written by single device transaction
+// If ROM_DUAL_BANK is set, whole image is written to inactive bank regardless of maxPages
+// Returns count of pages which are still dirty
+uint32_t settingsFlushDirty(uint32_t maxPages)
+{
+#if ROM_DUAL_BANK == 1
+    (void)maxPages;
+    if (dirtyPagesCount != 0)
+        flushBank();
+    return 0;
+#elif SETTINGS_ROM_WRITE_MODE == ROM_WRITE_BACK
+    uint32_t page, runStart, runEnd;
+    page = 0;
+    while ((page < ROM_PAGE_COUNT) && (maxPages != 0) && (dirtyPagesCount != 0))
+    {
+        if (!PAGE_BIT_TEST(pageDirty, page))
+        {
+            page++;
+            continue;
+        }
+        runStart = page;
+        while ((page < ROM_PAGE_COUNT) && (maxPages != 0) && PAGE_BIT_TEST(pageDirty, page))
+        {
+            PAGE_BIT_CLEAR(pageDirty, page);
+            dirtyPagesCount--;
+            maxPages--;
+            page++;
+        }
+        runStart *= SETTINGS_ROM_PAGE_SIZE;
+        runEnd = page * SETTINGS_ROM_PAGE_SIZE;
+        if (runEnd > SETTINGS_ROM_SIZE)
+            runEnd = SETTINGS_ROM_SIZE;
+        deviceWrite(runStart, &romCache[runStart], runEnd - runStart);
+    }
+    deviceFlush();
+    return dirtyPagesCount;
+#elif SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+    // Pending ranges are written by ROM writer
+    (void)maxPages;
+    settingsWaitIdle();
+    deviceFlush();
+    return 0;
+#else
+    // Every change is written to device immediately, storage may still buffer it
+    (void)maxPages;
+    deviceFlush();
+    return 0;
+#endif
+}
+
+
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+// Write up to SETTINGS_ROM_WRITER_CHUNK bytes of the oldest pending range to device
+// Returns 1 if anything has been written, 0 if queue is empty
+uint32_t settingsRomWriterStep(void)
+{
+    static uint8_t buffer[SETTINGS_ROM_WRITER_CHUNK];
+    romRange_t *entry;
+    uint32_t romAddr, count;
+    SETTINGS_ROM_QUEUE_LOCK();
+    if ((queueStats.depth == 0) || writerBusy)
+    {
+        SETTINGS_ROM_QUEUE_UNLOCK();
+        return 0;
+    }
+    // Take data from cache, so that the latest value is always written
+    entry = &romQueue[queueHead];
+    romAddr = entry->romAddr;
+    count = (entry->count > SETTINGS_ROM_WRITER_CHUNK) ? SETTINGS_ROM_WRITER_CHUNK : entry->count;
+    memcpy(buffer, &romCache[romAddr], count);
+    entry->romAddr += count;
+    entry->count -= count;
+    if (entry->count == 0)
+    {
+        queueHead = (queueHead + 1) % SETTINGS_ROM_QUEUE_SIZE;
+        queueStats.depth--;
+    }
+    writerBusy = 1;
+    SETTINGS_ROM_QUEUE_UNLOCK();
+
+    deviceWrite(romAddr, buffer, count);
+
+    SETTINGS_ROM_QUEUE_LOCK();
+    writerBusy = 0;
+    queueStats.written++;
+#if ROM_WRITER_USE_PTHREAD == 1
+    pthread_cond_broadcast(&doneCond);
+#endif
+    SETTINGS_ROM_QUEUE_UNLOCK();
+    return 1;
+}
+#endif
+
+
+// Wait until all queued ROM writes are done
+// Does nothing if ROM writer is not used
+void settingsWaitIdle(void)
+{
+#if SETTINGS_ROM_WRITE_MODE == ROM_WRITE_QUEUED
+#if ROM_WRITER_USE_PTHREAD == 1
+    pthread_mutex_lock(&queueLock);
+    while ((queueStats.depth != 0) || writerBusy)
+        pthread_cond_wait(&doneCond, &queueLock);
+    pthread_mutex_unlock(&queueLock);
+#else
+    while (settingsRomWriterStep());
+#endif
+#endif
+}
+
+
+// Get ROM device access statistics
+// Intended use: measuring ROM traffic. Counters may be cleared by caller
+settingsRomStats_t *getRomStats(void)
+{
+    return &romStats;
+}
+
+
+// Get ROM write queue statistics
+settingsRomQueueStats_t *getRomQueueStats(void)
+{
+    return &queueStats;
+}
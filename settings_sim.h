@@ -0,0 +1,42 @@
+/******************************************************************************
+    Simulated ROM driver of settings module
+    Provided by settings.c if it is built with __NOROM__. For testbenches only
+******************************************************************************/
+#ifndef SETTINGS_SIM_H
+#define SETTINGS_SIM_H
+
+#include <stdint.h>
+
+
+// Set write latency of simulated ROM driver (us) to model a slow device
+#ifndef SIM_ROM_WRITE_LATENCY_US
+#define SIM_ROM_WRITE_LATENCY_US        0
+#endif
+
+// Pass to simRomPowerCut() to disable simulated power loss
+#define SIM_ROM_POWER_ON                0xFFFFFFFF
+
+
+// Statistics of simulated ROM device, see simGetFlashStats()
+typedef struct {
+    uint32_t writeBytes;            // Bytes written by settings module
+    uint32_t programBytes;          // Bytes programmed to flash, including rewritten blocks of in-place updates
+    uint32_t erases;                // Count of block erases
+    uint32_t maxBlockErases;        // Erase count of the most worn block
+    uint64_t busyNs;                // Device busy time according to timing model
+} simFlashStats_t;
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    simFlashStats_t *simGetFlashStats(void);
+    void simRomPowerCut(uint32_t bytesLeft);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // SETTINGS_SIM_H
@@ -0,0 +1,276 @@
+/******************************************************************************
+    File-backed storage drivers of settings module
+    Plain driver accesses file by pread()/pwrite() and flushes it by fdatasync().
+    Mmap driver maps file to memory, so that ROM image is restored without device reads,
+    and flushes written range by msync()
+
+    This file should not be modified for configuration reasons
+******************************************************************************/
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "settings_private.h"
+#include "settings_storage.h"
+
+// Erase and write unit of file storage
+#define FILE_STORAGE_PAGE_SIZE      512
+
+#ifdef __APPLE__
+#define fdatasync(fd)               fsync(fd)
+#endif
+
+
+    // Prototypes
+
+    static resultType openFile(settingsFileStorage_t *storage, const char *path, uint32_t size);
+    static void fileRead(void *ctx, uint32_t addr, uint8_t *data, uint32_t count);
+    static void fileWrite(void *ctx, uint32_t addr, const uint8_t *data, uint32_t count);
+    static void fileFlush(void *ctx);
+    static void fileErase(void *ctx, uint32_t addr);
+    static void mmapRead(void *ctx, uint32_t addr, uint8_t *data, uint32_t count);
+    static void mmapWrite(void *ctx, uint32_t addr, const uint8_t *data, uint32_t count);
+    static void mmapFlush(void *ctx);
+    static void mmapErase(void *ctx, uint32_t addr);
+    static const uint8_t *mmapGet(void *ctx);
+    static void markDirty(settingsFileStorage_t *storage, uint32_t addr, uint32_t count);
+
+
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// File access
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+// Open file and extend it to required size
+// Appended bytes are set to 0xFF, as if storage was erased
+static resultType openFile(settingsFileStorage_t *storage, const char *path, uint32_t size)
+{
+    uint8_t erased[FILE_STORAGE_PAGE_SIZE];
+    struct stat st;
+    uint32_t pos, count;
+    memset(storage, 0, sizeof(settingsFileStorage_t));
+    storage->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (storage->fd < 0)
+    {
+        SETTINGS_DEBUG("Storage %s can not be opened\n", path);
+        return Result_StorageError;
+    }
+    storage->size = size;
+    if (fstat(storage->fd, &st) != 0)
+        st.st_size = 0;
+    memset(erased, 0xFF, sizeof(erased));
+    for (pos = (st.st_size < size) ? (uint32_t)st.st_size : size; pos < size; pos += count)
+    {
+        count = ((size - pos) > FILE_STORAGE_PAGE_SIZE) ? FILE_STORAGE_PAGE_SIZE : (size - pos);
+        if (pwrite(storage->fd, erased, count, pos) != (ssize_t)count)
+        {
+            SETTINGS_DEBUG("Storage %s can not be extended\n", path);
+            close(storage->fd);
+            return Result_StorageError;
+        }
+    }
+    storage->driver.size = size;
+    storage->driver.pageSize = FILE_STORAGE_PAGE_SIZE;
+    storage->driver.ctx = storage;
+    return Result_OK;
+}
+
+
+static void fileRead(void *ctx, uint32_t addr, uint8_t *data, uint32_t count)
+{
+    settingsFileStorage_t *storage = (settingsFileStorage_t *)ctx;
+    ssize_t done;
+    while (count != 0)
+    {
+        done = pread(storage->fd, data, count, addr);
+        if ((done < 0) && (errno == EINTR))
+            continue;
+        if (done <= 0)
+        {
+            // Unreadable bytes look erased, so that image is rejected by CRC check
+            memset(data, 0xFF, count);
+            storage->errors++;
+            return;
+        }
+        data += done;
+        addr += done;
+        count -= done;
+    }
+}
+
+
+static void fileWrite(void *ctx, uint32_t addr, const uint8_t *data, uint32_t count)
+{
+    settingsFileStorage_t *storage = (settingsFileStorage_t *)ctx;
+    ssize_t done;
+    while (count != 0)
+    {
+        done = pwrite(storage->fd, data, count, addr);
+        if ((done < 0) && (errno == EINTR))
+            continue;
+        if (done <= 0)
+        {
+            storage->errors++;
+            return;
+        }
+        data += done;
+        addr += done;
+        count -= done;
+    }
+}
+
+
+static void fileFlush(void *ctx)
+{
+    settingsFileStorage_t *storage = (settingsFileStorage_t *)ctx;
+    if (fdatasync(storage->fd) != 0)
+        storage->errors++;
+}
+
+
+static void fileErase(void *ctx, uint32_t addr)
+{
+    uint8_t erased[FILE_STORAGE_PAGE_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    fileWrite(ctx, addr, erased, FILE_STORAGE_PAGE_SIZE);
+}
+
+
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// Memory mapped file access
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+static void mmapRead(void *ctx, uint32_t addr, uint8_t *data, uint32_t count)
+{
+    settingsFileStorage_t *storage = (settingsFileStorage_t *)ctx;
+    memcpy(data, &storage->map[addr], count);
+}
+
+
+static void mmapWrite(void *ctx, uint32_t addr, const uint8_t *data, uint32_t count)
+{
+    settingsFileStorage_t *storage = (settingsFileStorage_t *)ctx;
+    memcpy(&storage->map[addr], data, count);
+    markDirty(storage, addr, count);
+}
+
+
+// Write back range of mapping which has been changed since last flush
+static void mmapFlush(void *ctx)
+{
+    settingsFileStorage_t *storage = (settingsFileStorage_t *)ctx;
+    uint32_t start, pageSize;
+    if (storage->dirtyStart >= storage->dirtyEnd)
+        return;
+    // msync() requires address aligned to system page
+    pageSize = (uint32_t)sysconf(_SC_PAGESIZE);
+    start = storage->dirtyStart / pageSize * pageSize;
+    if (msync(&storage->map[start], storage->dirtyEnd - start, MS_SYNC) != 0)
+        storage->errors++;
+    storage->dirtyStart = storage->size;
+    storage->dirtyEnd = 0;
+}
+
+
+static void mmapErase(void *ctx, uint32_t addr)
+{
+    settingsFileStorage_t *storage = (settingsFileStorage_t *)ctx;
+    memset(&storage->map[addr], 0xFF, FILE_STORAGE_PAGE_SIZE);
+    markDirty(storage, addr, FILE_STORAGE_PAGE_SIZE);
+}
+
+
+static const uint8_t *mmapGet(void *ctx)
+{
+    return ((settingsFileStorage_t *)ctx)->map;
+}
+
+
+static void markDirty(settingsFileStorage_t *storage, uint32_t addr, uint32_t count)
+{
+    if (addr < storage->dirtyStart)
+        storage->dirtyStart = addr;
+    if (addr + count > storage->dirtyEnd)
+        storage->dirtyEnd = addr + count;
+}
+
+
+
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+// Public
+//-----------------------------------------------------------------//
+//-----------------------------------------------------------------//
+
+// Open storage file accessed by pread()/pwrite()
+// File is created if it does not exist. Register storage->driver by settingsSetStorageDriver() then
+resultType settingsFileStorageOpen(settingsFileStorage_t *storage, const char *path, uint32_t size)
+{
+    resultType result = openFile(storage, path, size);
+    if (result != Result_OK)
+        return result;
+    storage->driver.read = fileRead;
+    storage->driver.write = fileWrite;
+    storage->driver.flush = fileFlush;
+    storage->driver.erase = fileErase;
+    return Result_OK;
+}
+
+
+// Open storage file accessed through shared memory mapping
+// ROM image is restored directly from the mapping, without reading it to ROM cache
+resultType settingsMmapStorageOpen(settingsFileStorage_t *storage, const char *path, uint32_t size)
+{
+    void *map;
+    resultType result = openFile(storage, path, size);
+    if (result != Result_OK)
+        return result;
+    map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, storage->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        SETTINGS_DEBUG("Storage %s can not be mapped\n", path);
+        close(storage->fd);
+        return Result_StorageError;
+    }
+    storage->map = (uint8_t *)map;
+    storage->dirtyStart = size;
+    storage->dirtyEnd = 0;
+    storage->driver.read = mmapRead;
+    storage->driver.write = mmapWrite;
+    storage->driver.flush = mmapFlush;
+    storage->driver.erase = mmapErase;
+    storage->driver.map = mmapGet;
+    return Result_OK;
+}
+
+
+// Flush and close storage file
+// Driver must not be used by settings module anymore
+void settingsFileStorageClose(settingsFileStorage_t *storage)
+{
+    if (storage->map)
+    {
+        mmapFlush(storage);
+        munmap(storage->map, storage->size);
+        storage->map = 0;
+    }
+    else
+    {
+        fileFlush(storage);
+    }
+    close(storage->fd);
+    storage->fd = -1;
+}
+
+#endif  // __unix__ || __APPLE__
@@ -0,0 +1,43 @@
+/******************************************************************************
+    File-backed storage drivers of settings module
+    Settings are persisted to a file, accessed by pread()/pwrite() or through a shared memory mapping.
+    Available on POSIX systems
+
+    Usage:
+        settingsFileStorage_t fileStorage;
+        settingsMmapStorageOpen(&fileStorage, "settings.bin", SETTINGS_STORAGE_SIZE);
+        settingsSetStorageDriver(&fileStorage.driver);
+        initSettings(0);
+******************************************************************************/
+#ifndef SETTINGS_STORAGE_H
+#define SETTINGS_STORAGE_H
+
+#include "settings_public.h"
+
+
+// File storage state, driver is filled by open functions
+typedef struct {
+    int fd;
+    uint8_t *map;                   // Shared mapping of file, 0 for pread()/pwrite() driver
+    uint32_t size;
+    uint32_t dirtyStart;            // Range of mapping written since last flush
+    uint32_t dirtyEnd;
+    uint32_t errors;                // Count of failed reads, writes and flushes
+    settingsStorageDriver_t driver;
+} settingsFileStorage_t;
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+    resultType settingsFileStorageOpen(settingsFileStorage_t *storage, const char *path, uint32_t size);
+    resultType settingsMmapStorageOpen(settingsFileStorage_t *storage, const char *path, uint32_t size);
+    void settingsFileStorageClose(settingsFileStorage_t *storage);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // SETTINGS_STORAGE_H
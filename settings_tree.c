@@ -0,0 +1,57 @@
+/******************************************************************************
+    Settings tree descriptors
+    Generated by tools/settings_gen.py from settings_tree.json, do not edit
+******************************************************************************/
+
+#include "settings_private.h"
+#include "settings_tree.h"
+
+#if ENABLE_STATIC_TREE == 1
+
+#if SETTINGS_TREE_RAM_LAYOUT != SETTINGS_RAM_LAYOUT
+#error "Settings tree has been generated for another RAM layout"
+#endif
+#if SETTINGS_TREE_RAM_SIZE > SETTINGS_RAM_SIZE
+#error "Settings tree does not fit SETTINGS_RAM_SIZE"
+#endif
+#if SETTINGS_TREE_DEPTH > SETTINGS_MAX_DEPTH
+#error "Settings tree is deeper than SETTINGS_MAX_DEPTH"
+#endif
+#if (ENABLE_SLOT_TABLE == 1) && (SETTINGS_TREE_SLOT_COUNT > SETTINGS_SLOT_TABLE_SIZE)
+#error "Settings tree does not fit SETTINGS_SLOT_TABLE_SIZE"
+#endif
+
+// Change callbacks must be defined in top module
+void onB0ParamsChanged(rqType rq, uint32_t lastArg);
+void onC2ParamsChanged(rqType rq, const requestContext_t *ctx);
+
+
+static const sNode_t node_A0_B0_C0 = {.type = sNode, .ramOffset = 2, .romOffset = 2, .slotOffset = 0, .name = "C0", .accessMask = 1, .size = 4, .accessLevel = AccessByAll, .storage = RomStored, .changeCallback = onB0ParamsChanged, .rqHandler = handleRequestU32,
+    .varData.u32Prm = {.defaultValue = 12345, .minValue = 0, .maxValue = 100000}};
+
+static const sNode_t node_A0_B0_C1 = {.type = sNode, .ramOffset = 6, .romOffset = 6, .slotOffset = 1, .name = "C1", .accessMask = 1, .size = 1, .accessLevel = AccessByAll, .storage = RomStored, .changeCallback = onB0ParamsChanged, .rqHandler = handleRequestU32,
+    .varData.u32Prm = {.defaultValue = 5, .minValue = 0, .maxValue = 144}};
+
+static node_t *const hList_A0_B0[2] = {(node_t *)&node_A0_B0_C0, (node_t *)&node_A0_B0_C1};
+static const hNode_t node_A0_B0 = {.type = hNode, .ramOffset = 4, .romOffset = 2, .slotOffset = 1, .name = "B0",
+    .accessMask = 1, .hListSize = 2, .hList = (node_t **)hList_A0_B0, .crcOffset = 0, .slotCount = 2};
+
+static const char dflt_A0_B1_C2[20] = "Default text";
+static const sNode_t node_A0_B1_C2 = {.type = sNode, .ramOffset = 2, .romOffset = 2, .slotOffset = 0, .name = "C2", .accessMask = 1, .size = 20, .accessLevel = AccessByAll, .storage = RomStored, .changeCallbackCtx = onC2ParamsChanged, .rqHandler = handleRequestCharArray,
+    .varData.charArrayPrm = {.defaultValue = dflt_A0_B1_C2}};
+
+static const lNode_t node_A0_B1 = {.type = lNode, .ramOffset = 11, .romOffset = 9, .slotOffset = 3, .name = "B1",
+    .accessMask = 1, .hListSize = 35, .element = (node_t *)&node_A0_B1_C2, .elementRamSize = 20, .elementRomSize = 20, .elementSlotCount = 1,
+    .crcOffset = 0};
+
+static const sNode_t node_A0_B2 = {.type = sNode, .ramOffset = 2, .romOffset = 2, .slotOffset = 0, .name = "B2", .accessMask = 1, .size = 2, .accessLevel = AccessByAll, .storage = NotRomStored, .rqHandler = handleRequestU32,
+    .varData.u32Prm = {.defaultValue = 16, .minValue = 1, .maxValue = 1024}};
+
+static node_t *const hList_A0[3] = {(node_t *)&node_A0_B0, (node_t *)&node_A0_B1, (node_t *)&node_A0_B2};
+static const hNode_t node_A0 = {.type = hNode, .ramOffset = 0, .romOffset = ROM_HEADER_SIZE, .slotOffset = 0, .name = "A0",
+    .accessMask = 1, .hListSize = 3, .hList = (node_t **)hList_A0, .crcOffset = 0, .slotCount = 38};
+
+// Descriptors are never modified, so const qualifier may be dropped
+hNode_t *hRoot = (hNode_t *)&node_A0;
+
+#endif  // ENABLE_STATIC_TREE
@@ -0,0 +1,99 @@
+/******************************************************************************
+    Settings tree layout
+    Generated by tools/settings_gen.py from settings_tree.json, do not edit
+******************************************************************************/
+#ifndef SETTINGS_TREE_H
+#define SETTINGS_TREE_H
+
+#include "settings_private.h"
+
+#define SETTINGS_TREE_RAM_SIZE          713
+#define SETTINGS_TREE_ROM_SIZE          711
+#define SETTINGS_TREE_SLOT_COUNT        38
+#define SETTINGS_TREE_DEPTH             3
+#define SETTINGS_TREE_RAM_LAYOUT        RAM_LAYOUT_COMPACT
+#define SETTINGS_TREE_RAM_PADDING       0
+
+// RAM addresses of values. Every list node on the path takes an element index
+#define SETTINGS_RAM_ADDR_B0_C0                  6
+#define SETTINGS_RAM_ADDR_B0_C1                  10
+#define SETTINGS_RAM_ADDR_B1_C2(i0)              (11 + (i0) * 20 + 2)
+#define SETTINGS_RAM_ADDR_B2                     2
+
+
+#if ENABLE_STATIC_TREE == 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+    // RAM is private, accessors below are the only exception
+    extern uint8_t ram[SETTINGS_RAM_SIZE];
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+// Read accessors. Values are read from RAM by fixed addresses, without walking the tree
+// Must not be used while another thread modifies settings (see SETTINGS_CONCURRENT_READERS)
+// Char values are not 0-terminated
+static inline uint32_t settings_get_B0_C0(void) { return SETTINGS_RAM_U32(SETTINGS_RAM_ADDR_B0_C0); }
+static inline uint32_t settings_get_B0_C1(void) { return SETTINGS_RAM_U8(SETTINGS_RAM_ADDR_B0_C1); }
+static inline const char *settings_get_B1_C2(uint32_t i0) { return (const char *)&ram[SETTINGS_RAM_ADDR_B1_C2(i0)]; }
+static inline uint32_t settings_get_B2(void) { return SETTINGS_RAM_U16(SETTINGS_RAM_ADDR_B2); }
+
+#ifdef __cplusplus
+
+// Layout of values for typed accessors (see settings.hpp)
+// Value<args...> is defined only for request arguments which address a value
+namespace settingsTree
+{
+    template<uint32_t... args> struct Value;
+    struct Blob;                    // Type of blob values, which are read and written by ranges
+
+    // B0_C0
+    template<> struct Value<0, 0>
+    {
+        typedef uint32_t type;
+        static const uint32_t size = 4;
+        static const uint32_t ramAddr = 6;
+        static const settingsHandle_t handle = 1;
+        static const bool direct = true;    // Value is read directly from RAM, node has default request handler
+    };
+
+    // B0_C1
+    template<> struct Value<0, 1>
+    {
+        typedef uint8_t type;
+        static const uint32_t size = 1;
+        static const uint32_t ramAddr = 10;
+        static const settingsHandle_t handle = 2;
+        static const bool direct = true;    // Value is read directly from RAM, node has default request handler
+    };
+
+    // B1_C2
+    template<uint32_t i0> struct Value<1, i0>
+    {
+        static_assert(i0 < 35, "List index is out of range");
+        typedef char type;
+        static const uint32_t size = 20;
+        static const uint32_t ramAddr = (11 + (i0) * 20 + 2);
+        static const settingsHandle_t handle = (3 + (i0) * 1 + 0);
+        static const bool direct = true;    // Value is read directly from RAM, node has default request handler
+    };
+
+    // B2
+    template<> struct Value<2>
+    {
+        typedef uint16_t type;
+        static const uint32_t size = 2;
+        static const uint32_t ramAddr = 2;
+        static const settingsHandle_t handle = 0;
+        static const bool direct = true;    // Value is read directly from RAM, node has default request handler
+    };
+}
+
+#endif // __cplusplus
+
+#endif  // ENABLE_STATIC_TREE
+
+#endif // SETTINGS_TREE_H
@@ -0,0 +1,133 @@
+/******************************************************************************
+    File storage test
+
+    Settings are saved to a file by pread()/pwrite() driver and by mmap driver.
+    After restart saved values must be restored from the file.
+    Time of restoring whole ROM image is reported for both drivers
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "settings.h"
+#include "settings_private.h"
+#include "settings_storage.h"
+
+
+// Count of measured image loads
+#define TEST_LOADS          20000
+
+// Index of C2 string changed by test
+#define TEST_STR_INDEX      5
+
+
+typedef resultType (*storageOpen)(settingsFileStorage_t *storage, const char *path, uint32_t size);
+
+static const char testStr[C2_SIZE] = "Stored in file";
+
+
+static uint64_t getTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Open storage and init settings from it
+static resultType start(settingsFileStorage_t *storage, storageOpen open, const char *path)
+{
+    if (open(storage, path, SETTINGS_STORAGE_SIZE) != Result_OK)
+        return Result_StorageError;
+    settingsSetStorageDriver(&storage->driver);
+    return initSettings(0);
+}
+
+
+// Save values, restart and check them
+static uint8_t testStorage(const char *name, storageOpen open, const char *path)
+{
+    settingsFileStorage_t storage;
+    request_t rq;
+    char str[C2_SIZE];
+    uint8_t failed = 0;
+
+    printf("*** %s: new file ***\n", name);
+    unlink(path);
+    if (start(&storage, open, path) != Result_UpdatedRom)
+        failed = 1;
+    settings_WriteI32NoCbf(pGroup_B0, b0param_C0, 4321);
+    memcpy(str, testStr, C2_SIZE);
+    rq.rq = rqWriteNoCb;
+    rq.arg[0] = pGroup_B1;
+    rq.arg[1] = TEST_STR_INDEX;
+    rq.raw = (uint8_t *)str;
+    settingsRequest(&rq);
+    flushSettingsToRom();
+    settingsFileStorageClose(&storage);
+
+    printf("*** %s: restart ***\n", name);
+    if (start(&storage, open, path) != Result_OK)
+        failed = 1;
+    settings_ReadStr(pGroup_B1, TEST_STR_INDEX, str);
+    if ((settings_ReadI32(pGroup_B0, b0param_C0) != 4321) || (memcmp(str, testStr, C2_SIZE) != 0))
+        failed = 1;
+    if (storage.errors != 0)
+        failed = 1;
+    settingsFileStorageClose(&storage);
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
+
+
+// Restore whole ROM image repeatedly, as done on startup
+static void measureLoad(const char *name, storageOpen open, const char *path)
+{
+    static uint8_t image[ROM_IMAGE_LIMIT];
+    settingsFileStorage_t storage;
+    settingsRomStats_t *stats = getRomStats();
+    uint64_t start;
+    uint32_t i;
+
+    open(&storage, path, SETTINGS_STORAGE_SIZE);
+    settingsSetStorageDriver(&storage.driver);
+    memset(stats, 0, sizeof(settingsRomStats_t));
+    start = getTimeNs();
+    for (i=0; i<TEST_LOADS; i++)
+    {
+        settingsRomDropCache();
+        settingsRomLoad(ROM_IMAGE_LIMIT);
+        readRomData(0, image, ROM_IMAGE_LIMIT);
+    }
+    printf("%-8s %8.2f us/load %6u device reads/load %6u bytes read %6u bytes mapped\n", name,
+           (double)(getTimeNs() - start) / 1000.0 / TEST_LOADS,
+           stats->readCalls / TEST_LOADS, stats->readBytes / TEST_LOADS, stats->mappedBytes / TEST_LOADS);
+    settingsFileStorageClose(&storage);
+}
+
+
+int main(void)
+{
+    uint8_t failed;
+    failed = testStorage("File", settingsFileStorageOpen, "settings-file.bin");
+    failed |= testStorage("Mmap", settingsMmapStorageOpen, "settings-mmap.bin");
+
+    printf("*** Load of %d byte image ***\n", ROM_IMAGE_LIMIT);
+    measureLoad("File", settingsFileStorageOpen, "settings-file.bin");
+    measureLoad("Mmap", settingsMmapStorageOpen, "settings-mmap.bin");
+    unlink("settings-file.bin");
+    unlink("settings-mmap.bin");
+    return failed;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
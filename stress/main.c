@@ -0,0 +1,233 @@
+/******************************************************************************
+    Stress test and read throughput benchmark for concurrent readers
+
+    Settings module must be built with SETTINGS_CONCURRENT_READERS set to 1
+    Usage: tb-settings-stress [max reader threads]
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include "settings.h"
+#include "settings_private.h"
+
+#if (SETTINGS_CONCURRENT_READERS != 1) || (ENABLE_SLOT_TABLE != 1)
+#error "Stress test requires SETTINGS_CONCURRENT_READERS and ENABLE_SLOT_TABLE set to 1"
+#endif
+
+
+// Duration of stress test (ms)
+#define STRESS_DURATION_MS          1000
+
+// Duration of every benchmark step (ms)
+#define BENCH_DURATION_MS           200
+
+// Count of reader threads used by stress test
+#define STRESS_READERS              4
+
+// Count of C2 elements modified by writer
+#define STRESS_STRINGS              4
+
+// Values written to C0 by writer. Any mix of their bytes is a different value
+#define VALUE_A                     0x0000FFFF
+#define VALUE_B                     0x00010000
+
+
+typedef struct {
+    uint64_t reads;
+    uint64_t torn;
+} readerStats_t;
+
+static atomic_int stopFlag;
+static atomic_int writerEnabled;
+static settingsHandle_t handleC0;
+
+
+static uint64_t getTimeUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+static void writeStrNoCb(uint32_t index, char fill)
+{
+    request_t rq;
+    char str[C2_SIZE];
+    memset(str, fill, C2_SIZE);
+    rq.rq = rqWriteNoCb;
+    rq.arg[0] = pGroup_B1;
+    rq.arg[1] = index;
+    rq.raw = (uint8_t *)str;
+    settingsRequest(&rq);
+}
+
+
+static uint8_t isValidValue(int32_t value)
+{
+    return ((value == VALUE_A) || (value == VALUE_B)) ? 1 : 0;
+}
+
+
+// Check that all chars of the string are written by the same request
+static uint8_t isValidStr(const char *str)
+{
+    uint32_t i;
+    for (i=1; i<C2_SIZE; i++)
+    {
+        if (str[i] != str[0])
+            return 0;
+    }
+    return 1;
+}
+
+
+static void *writerThread(void *arg)
+{
+    uint64_t *writes = (uint64_t *)arg;
+    uint32_t i = 0;
+    while (!atomic_load(&stopFlag))
+    {
+        if (!atomic_load(&writerEnabled))
+        {
+            usleep(1000);
+            continue;
+        }
+        settings_WriteI32NoCbf(pGroup_B0, b0param_C0, (i & 1) ? VALUE_B : VALUE_A);
+        writeStrNoCb(i % STRESS_STRINGS, (char)('a' + (i % 26)));
+        (*writes)++;
+        i++;
+    }
+    return 0;
+}
+
+
+static void *stressReaderThread(void *arg)
+{
+    readerStats_t *stats = (readerStats_t *)arg;
+    char str[C2_SIZE];
+    uint32_t i = 0;
+    while (!atomic_load(&stopFlag))
+    {
+        if (!isValidValue(settings_ReadI32(pGroup_B0, b0param_C0)))
+            stats->torn++;
+        if (!isValidValue(settings_ReadI32ByHandle(handleC0)))
+            stats->torn++;
+        settings_ReadStr(pGroup_B1, i % STRESS_STRINGS, str);
+        if (!isValidStr(str))
+            stats->torn++;
+        stats->reads += 3;
+        i++;
+    }
+    return 0;
+}
+
+
+static void *benchReaderThread(void *arg)
+{
+    readerStats_t *stats = (readerStats_t *)arg;
+    while (!atomic_load(&stopFlag))
+    {
+        if (!isValidValue(settings_ReadI32(pGroup_B0, b0param_C0)))
+            stats->torn++;
+        stats->reads++;
+    }
+    return 0;
+}
+
+
+// Run reader threads with a writer for a given time
+static void runReaders(uint32_t count, void *(*reader)(void *), uint32_t durationMs, uint8_t withWriter,
+                       readerStats_t *total, uint64_t *writes)
+{
+    pthread_t writer;
+    pthread_t *threads = calloc(count, sizeof(pthread_t));
+    readerStats_t *stats = calloc(count, sizeof(readerStats_t));
+    uint32_t i;
+
+    atomic_store(&stopFlag, 0);
+    atomic_store(&writerEnabled, withWriter);
+    *writes = 0;
+    pthread_create(&writer, 0, writerThread, writes);
+    for (i=0; i<count; i++)
+        pthread_create(&threads[i], 0, reader, &stats[i]);
+    usleep(durationMs * 1000);
+    atomic_store(&stopFlag, 1);
+
+    total->reads = 0;
+    total->torn = 0;
+    for (i=0; i<count; i++)
+    {
+        pthread_join(threads[i], 0);
+        total->reads += stats[i].reads;
+        total->torn += stats[i].torn;
+    }
+    pthread_join(writer, 0);
+    free(threads);
+    free(stats);
+}
+
+
+int main(int argc, char *argv[])
+{
+    request_t rq;
+    readerStats_t total;
+    uint64_t writes, start, elapsed;
+    uint32_t i, maxReaders;
+    uint32_t failed = 0;
+
+    maxReaders = (argc > 1) ? (uint32_t)atoi(argv[1]) : 8;
+    if (maxReaders == 0)
+        maxReaders = 1;
+
+    printf("*** Init ***\n");
+    initSettings(0);
+    settings_WriteI32NoCbf(pGroup_B0, b0param_C0, VALUE_A);
+    for (i=0; i<STRESS_STRINGS; i++)
+        writeStrNoCb(i, 'a');
+    rq.arg[0] = pGroup_B0;
+    rq.arg[1] = b0param_C0;
+    handleC0 = settingsResolve(&rq);
+
+    printf("*** Stress test: %d readers, 1 writer, %d ms ***\n", STRESS_READERS, STRESS_DURATION_MS);
+    runReaders(STRESS_READERS, stressReaderThread, STRESS_DURATION_MS, 1, &total, &writes);
+    printf("Reads: %llu, writes: %llu, torn reads: %llu\n",
+           (unsigned long long)total.reads, (unsigned long long)writes, (unsigned long long)total.torn);
+    if ((total.torn != 0) || (writes == 0))
+        failed = 1;
+
+    printf("*** Read throughput, %d ms per step ***\n", BENCH_DURATION_MS);
+    printf("readers  no writer (Mreads/s)  with writer (Mreads/s)  writes/s\n");
+    for (i=1; i<=maxReaders; i++)
+    {
+        start = getTimeUs();
+        runReaders(i, benchReaderThread, BENCH_DURATION_MS, 0, &total, &writes);
+        elapsed = getTimeUs() - start;
+        printf("%7d  %21.2f", i, (double)total.reads / elapsed);
+        failed |= (total.torn != 0);
+
+        start = getTimeUs();
+        runReaders(i, benchReaderThread, BENCH_DURATION_MS, 1, &total, &writes);
+        elapsed = getTimeUs() - start;
+        printf("  %22.2f  %8.0f\n", (double)total.reads / elapsed, (double)writes * 1000000.0 / elapsed);
+        failed |= (total.torn != 0);
+    }
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed ? 1 : 0;
+}
+
+
+void assert_true(int x)
+{
+    if (!x)
+    {
+        printf("Assert failed\n");
+        abort();
+    }
+}
@@ -3,14 +3,24 @@ CONFIG += console
 CONFIG -= app_bundle
 CONFIG -= qt
 
+# Required by queued ROM writer (ROM_WRITER_USE_PTHREAD)
+unix: LIBS += -lpthread
+
 SOURCES += \
         main.c \
         settings.c \
+        settings_journal.c \
         settings_private.c \
+        settings_rom.c \
+        settings_storage.c \
+        settings_tree.c \
         utils.c
 
 HEADERS += \
     settings.h \
     settings_private.h \
     settings_public.h \
+    settings_sim.h \
+    settings_storage.h \
+    settings_tree.h \
     utils.h
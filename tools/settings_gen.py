@@ -0,0 +1,485 @@
+#!/usr/bin/env python3
+"""
+Settings tree generator
+
+Turns a tree schema (JSON) into const node descriptors with resolved RAM, ROM and slot offsets,
+so that initSettings() does not need to call initNode() (see ENABLE_STATIC_TREE).
+Offsets are assigned the same way as by initNode() for given RAM layout (see SETTINGS_RAM_LAYOUT).
+In ROM and in compact RAM layout every host node starts with its CRC, terminating children are placed first,
+then hierarchy and list children in list order. Aligned RAM layout places hot terminating children first,
+aligns numeric values to their size and moves CRC after terminating children.
+
+Usage:
+    settings_gen.py [--layout compact|aligned] [--report] settings_tree.json settings_tree
+
+    --layout    RAM layout of generated descriptors, must match SETTINGS_RAM_LAYOUT. Compact by default
+    --report    Print RAM and ROM cost of both layouts
+
+Creates settings_tree.c with descriptors and settings_tree.h with tree size, RAM addresses
+of all values, read accessors which compile down to fixed-address loads, and value layout
+for typed C++ accessors (see settings.hpp).
+
+Schema node fields:
+    name        Node name, used in descriptor, address and accessor names, and in path names (see settingsResolveName())
+    type        "hNode", "lNode", "u8", "u16", "u32", "u64", "i8", "i16", "i32", "i64", "f32", "f64", "char" or "blob"
+    children    List of child nodes (hNode)
+    count       Count of elements (lNode)
+    element     Element node (lNode)
+    access      Access level, "AccessByAll" by default
+    storage     "RomStored" (default) or "NotRomStored"
+    min, max, default
+                Limits and default value of numeric nodes
+    size        Size of char or blob node (bytes)
+    default     Default text of char node, padded with zeros to node size
+                Default bytes of blob node (list of numbers), padded with zeros to node size
+    callback    Change callback, legacy form (see onChangeCallback)
+    callbackCtx Change callback taking request context (see onChangeCallbackCtx)
+    handler     Custom request handler. Values of such nodes are never read directly from RAM
+    hot         Value is accessed often and is placed first in aligned RAM layout
+"""
+
+import argparse
+import json
+import os
+import sys
+
+NODE_CRC_SIZE = 2
+VALUE_SIZES = {"u8": 1, "u16": 2, "u32": 4, "u64": 8, "i8": 1, "i16": 2, "i32": 4, "i64": 8, "f32": 4, "f64": 8}
+CPP_TYPES = {"u8": "uint8_t", "u16": "uint16_t", "u32": "uint32_t", "u64": "uint64_t", "i8": "int8_t", "i16": "int16_t",
+             "i32": "int32_t", "i64": "int64_t", "f32": "float", "f64": "double", "char": "char",
+             "blob": "Blob"}
+# Default request handler, parameters member of descriptor and type returned by read accessor
+NUMERIC_TYPES = {"u8": ("handleRequestU32", "u32Prm", "uint32_t"), "u16": ("handleRequestU32", "u32Prm", "uint32_t"),
+                 "u32": ("handleRequestU32", "u32Prm", "uint32_t"), "u64": ("handleRequestU64", "u64Prm", "uint64_t"),
+                 "i8": ("handleRequestI32", "i32Prm", "int32_t"), "i16": ("handleRequestI32", "i32Prm", "int32_t"),
+                 "i32": ("handleRequestI32", "i32Prm", "int32_t"), "i64": ("handleRequestI64", "i64Prm", "int64_t"),
+                 "f32": ("handleRequestF32", "f32Prm", "float"), "f64": ("handleRequestF64", "f64Prm", "double")}
+LAYOUTS = {"compact": "RAM_LAYOUT_COMPACT", "aligned": "RAM_LAYOUT_ALIGNED"}
+ACCESS_LEVELS = ["AccessByAll", "AccessByService", "AccessByDev"]
+
+
+# RAM layout policy and padding inserted by it
+class Layout:
+    def __init__(self, name):
+        self.name = name
+        self.aligned = (name == "aligned")
+        self.padding = 0
+
+    def align(self, offset, align):
+        aligned = (offset + align - 1) // align * align
+        self.padding += aligned - offset
+        return aligned
+
+
+class Node:
+    def __init__(self, schema, path, index=0):
+        self.schema = schema
+        self.index = index                  # Request argument which selects the node in parent list
+        self.type = schema["type"]
+        self.path = path + [schema["name"]]
+        self.ident = "_".join(self.path)
+        self.ramOffset = 0
+        self.romOffset = 0
+        self.slotOffset = 0
+        self.crcOffset = 0
+        self.slotCount = 0                  # Count of terminating nodes in subtree of hNode
+        self.children = []
+        self.element = None
+        if self.type == "hNode":
+            self.children = [Node(child, self.path, i) for i, child in enumerate(schema["children"])]
+        elif self.type == "lNode":
+            self.element = Node(schema["element"], self.path)
+        elif self.type not in VALUE_SIZES and self.type not in ("char", "blob"):
+            sys.exit("Unknown node type %s of %s" % (self.type, self.ident))
+
+    def isHost(self):
+        return self.type in ("hNode", "lNode")
+
+    def size(self):
+        return VALUE_SIZES[self.type] if self.type in VALUE_SIZES else self.schema["size"]
+
+    def romStored(self):
+        return self.schema.get("storage", "RomStored") == "RomStored"
+
+    def hot(self):
+        return bool(self.schema.get("hot", False))
+
+    # Access levels of terminating nodes of subtree, as by initNode()
+    def accessMask(self):
+        if self.type == "hNode":
+            mask = 0
+            for child in self.children:
+                mask |= child.accessMask()
+            return mask
+        if self.type == "lNode":
+            return self.element.accessMask()
+        access = self.schema.get("access", "AccessByAll")
+        if access not in ACCESS_LEVELS:
+            sys.exit("Unknown access level %s of %s" % (access, self.ident))
+        return 1 << ACCESS_LEVELS.index(access)
+
+    # RAM alignment of value in aligned layout, as by getValueAlign()
+    def valueAlign(self):
+        if self.type in ("char", "blob") and "handler" not in self.schema:
+            return 1
+        return self.size() if self.size() in (2, 4, 8) else 1
+
+    # Assign offsets of children, returns RAM size, ROM size, slot count, depth and RAM alignment of the node
+    def init(self, layout):
+        if not self.isHost():
+            return (self.size(), (self.size() if self.romStored() else 0), 1, 1,
+                    self.valueAlign() if layout.aligned else 1)
+        ram = 0 if layout.aligned else NODE_CRC_SIZE
+        rom = NODE_CRC_SIZE
+        slots = 0
+        depth = 0
+        align = 1
+        if self.type == "hNode":
+            # Terminating nodes are placed first, as by initNode()
+            leaves = [c for c in self.children if not c.isHost()]
+            for child in leaves:
+                childRam, childRom, childSlots, childDepth, childAlign = child.init(layout)
+                child.romOffset, child.slotOffset = rom, slots
+                if not layout.aligned:
+                    child.ramOffset = ram
+                    ram += childRam
+                rom += childRom
+                slots += childSlots
+                depth = max(depth, childDepth)
+            if layout.aligned:
+                # Hot values first, then all others, both by descending alignment
+                for child in sorted(leaves, key=lambda c: (not c.hot(), -c.valueAlign())):
+                    ram = layout.align(ram, child.valueAlign())
+                    child.ramOffset = ram
+                    ram += child.size()
+                    align = max(align, child.valueAlign())
+                self.crcOffset = ram
+                ram += NODE_CRC_SIZE
+            for child in [c for c in self.children if c.isHost()]:
+                childRam, childRom, childSlots, childDepth, childAlign = child.init(layout)
+                ram = layout.align(ram, childAlign)
+                align = max(align, childAlign)
+                child.ramOffset, child.romOffset, child.slotOffset = ram, rom, slots
+                ram += childRam
+                rom += childRom
+                slots += childSlots
+                depth = max(depth, childDepth)
+            ram = layout.align(ram, align)
+            self.slotCount = slots
+        else:
+            count = self.schema["count"]
+            padding = layout.padding
+            childRam, childRom, childSlots, depth, align = self.element.init(layout)
+            # Padding inside element is repeated by every element
+            layout.padding += (layout.padding - padding) * max(count - 1, 0)
+            self.element.ramOffset, self.element.romOffset, self.element.slotOffset = ram, rom, slots
+            self.elementRamSize, self.elementRomSize, self.elementSlotCount = childRam, childRom, childSlots
+            ram += childRam * count
+            rom += childRom * count
+            slots += childSlots * count
+            if layout.aligned:
+                self.crcOffset = ram
+                ram = layout.align(ram + NODE_CRC_SIZE, align)
+        return ram, rom, slots, depth + 1, align
+
+
+# C literal of a numeric value
+def literal(valueType, value):
+    if valueType == "f32":
+        return "%sf" % repr(float(value))
+    if valueType == "f64":
+        return repr(float(value))
+    if valueType == "u64":
+        return "%dULL" % value
+    if valueType == "i64":
+        # Minimum value has no literal of its own
+        return "(%dLL - 1)" % (value + 1) if value == -2**63 else "%dLL" % value
+    if valueType == "i32" and value == -2**31:
+        return "(%d - 1)" % (value + 1)
+    return "%d" % value
+
+
+def descriptors(node, out, callbacks):
+    if node.type == "hNode":
+        for child in node.children:
+            descriptors(child, out, callbacks)
+        out.append("static node_t *const hList_%s[%d] = {%s};" % (node.ident, len(node.children),
+                   ", ".join("(node_t *)&node_%s" % c.ident for c in node.children)))
+        out.append("static const hNode_t node_%s = {.type = hNode, .ramOffset = %s, .romOffset = %s, .slotOffset = %d, .name = \"%s\","
+                   % (node.ident, node.ramOffset, node.romOffset, node.slotOffset, node.schema["name"]))
+        out.append("    .accessMask = %d, .hListSize = %d, .hList = (node_t **)hList_%s, .crcOffset = %d, .slotCount = %d};" % (node.accessMask(), len(node.children), node.ident, node.crcOffset, node.slotCount))
+        out.append("")
+    elif node.type == "lNode":
+        descriptors(node.element, out, callbacks)
+        out.append("static const lNode_t node_%s = {.type = lNode, .ramOffset = %d, .romOffset = %d, .slotOffset = %d, .name = \"%s\","
+                   % (node.ident, node.ramOffset, node.romOffset, node.slotOffset, node.schema["name"]))
+        out.append("    .accessMask = %d, .hListSize = %d, .element = (node_t *)&node_%s, .elementRamSize = %d, .elementRomSize = %d, .elementSlotCount = %d,"
+                   % (node.accessMask(), node.schema["count"], node.element.ident, node.elementRamSize, node.elementRomSize, node.elementSlotCount))
+        out.append("    .crcOffset = %d};" % node.crcOffset)
+        out.append("")
+    else:
+        s = node.schema
+        fields = ".type = sNode, .ramOffset = %d, .romOffset = %d, .slotOffset = %d, .name = \"%s\", .accessMask = %d, .size = %d, .accessLevel = %s, .storage = %s" % (
+            node.ramOffset, node.romOffset, node.slotOffset, s["name"], node.accessMask(), node.size(), s.get("access", "AccessByAll"),
+            s.get("storage", "RomStored"))
+        if node.hot():
+            fields += ", .hot = 1"
+        if "callback" in s:
+            fields += ", .changeCallback = %s" % s["callback"]
+            callbacks[s["callback"]] = "void %s(rqType rq, uint32_t lastArg);" % s["callback"]
+        if "callbackCtx" in s:
+            fields += ", .changeCallbackCtx = %s" % s["callbackCtx"]
+            callbacks[s["callbackCtx"]] = "void %s(rqType rq, const requestContext_t *ctx);" % s["callbackCtx"]
+        if "handler" in s:
+            handler = s["handler"]
+            callbacks[handler] = ("resultType %s(rqType rq, struct sNode_t *pNode, uint32_t nodeRamBase, uint32_t nodeRomBase, "
+                                  "request_t *rqst);" % handler)
+        elif node.type == "char":
+            handler = "handleRequestCharArray"
+        elif node.type == "blob":
+            handler = "handleRequestBlob"
+        else:
+            handler = NUMERIC_TYPES[node.type][0]
+        if node.type == "char":
+            text = s.get("default", "").replace("\\", "\\\\").replace('"', '\\"')
+            out.append("static const char dflt_%s[%d] = \"%s\";" % (node.ident, node.size(), text))
+            fields += ", .rqHandler = %s,\n    .varData.charArrayPrm = {.defaultValue = dflt_%s}" % (handler, node.ident)
+        elif node.type == "blob":
+            if "default" in s:
+                data = s["default"]
+                if len(data) > node.size() or any(not 0 <= b <= 255 for b in data):
+                    sys.exit("Wrong default value of %s" % node.ident)
+                out.append("static const uint8_t dflt_%s[%d] = {%s};" % (node.ident, node.size(), ", ".join(str(b) for b in data)))
+                fields += ", .rqHandler = %s,\n    .varData.blobPrm = {.defaultValue = dflt_%s}" % (handler, node.ident)
+            else:
+                fields += ", .rqHandler = %s,\n    .varData.blobPrm = {.defaultValue = 0}" % handler
+        else:
+            fields += ", .rqHandler = %s,\n    .varData.%s = {.defaultValue = %s, .minValue = %s, .maxValue = %s}" % (
+                handler, NUMERIC_TYPES[node.type][1], literal(node.type, s["default"]), literal(node.type, s["min"]),
+                literal(node.type, s["max"]))
+        out.append("static const sNode_t node_%s = {%s};" % (node.ident, fields))
+        out.append("")
+
+
+# Value reached by request arguments
+# Every list on the path takes an index argument, RAM address and slot index are expressions of indexes
+class Value:
+    def __init__(self):
+        self.node = None
+        self.args = []                      # Request arguments, numbers or index names
+        self.indexes = []                   # Index names
+        self.bounds = []                    # Element count of list selected by every index
+        self.ram = []                       # Terms of RAM address
+        self.slot = []                      # Terms of slot index (handle)
+
+    def step(self, arg, ram, slot):
+        value = Value()
+        value.args = self.args + [arg]
+        value.indexes = list(self.indexes)
+        value.bounds = list(self.bounds)
+        value.ram = self.ram + ram
+        value.slot = self.slot + slot
+        return value
+
+    def name(self):
+        return "_".join(self.node.path[1:])
+
+    def expr(self, terms):
+        return ("(%s)" % " + ".join(terms)) if self.indexes else str(eval(" + ".join(terms)))
+
+
+def values(node, value, out):
+    if node.type == "hNode":
+        for child in node.children:
+            values(child, value.step(str(child.index), [str(child.ramOffset)], [str(child.slotOffset)]), out)
+    elif node.type == "lNode":
+        index = "i%d" % len(value.indexes)
+        element = value.step(index, ["(%s) * %d" % (index, node.elementRamSize), str(node.element.ramOffset)],
+                             ["(%s) * %d" % (index, node.elementSlotCount), str(node.element.slotOffset)])
+        element.indexes.append(index)
+        element.bounds.append(node.schema["count"])
+        values(node.element, element, out)
+    else:
+        value.node = node
+        out.append(value)
+
+
+# Absolute RAM addresses of all numeric values, every list element counts separately
+def instances(node, base, out):
+    if node.type == "hNode":
+        for child in node.children:
+            instances(child, base + child.ramOffset, out)
+    elif node.type == "lNode":
+        for i in range(node.schema["count"]):
+            instances(node.element, base + i * node.elementRamSize + node.element.ramOffset, out)
+    elif node.valueAlign() > 1:
+        out.append((base, node.valueAlign()))
+
+
+# Print RAM and ROM cost of both layouts
+def report(schema):
+    print("%-8s %8s %8s %8s %10s" % ("Layout", "RAM", "ROM", "Padding", "Unaligned"))
+    for name in LAYOUTS:
+        root = Node(schema, [])
+        layout = Layout(name)
+        ramSize, romSize = root.init(layout)[:2]
+        values = []
+        instances(root, 0, values)
+        unaligned = len([addr for addr, align in values if addr % align])
+        print("%-8s %8d %8d %8d %6d of %d" % (name, ramSize, romSize, layout.padding, unaligned, len(values)))
+
+
+def generate(schemaPath, outBase, layoutName):
+    with open(schemaPath) as f:
+        root = Node(json.load(f), [])
+    if root.type != "hNode":
+        sys.exit("Root node must be hNode")
+    layout = Layout(layoutName)
+    ramSize, romSize, slotCount, depth = root.init(layout)[:4]
+    tag = "Generated by tools/settings_gen.py from %s, do not edit" % os.path.basename(schemaPath)
+    guard = os.path.basename(outBase).upper() + "_H"
+    header = os.path.basename(outBase) + ".h"
+
+    lines = ["/******************************************************************************",
+             "    Settings tree descriptors",
+             "    " + tag,
+             "******************************************************************************/",
+             "",
+             '#include "settings_private.h"',
+             '#include "%s"' % header,
+             "",
+             "#if ENABLE_STATIC_TREE == 1",
+             "",
+             "#if SETTINGS_TREE_RAM_LAYOUT != SETTINGS_RAM_LAYOUT",
+             '#error "Settings tree has been generated for another RAM layout"',
+             "#endif",
+             "#if SETTINGS_TREE_RAM_SIZE > SETTINGS_RAM_SIZE",
+             '#error "Settings tree does not fit SETTINGS_RAM_SIZE"',
+             "#endif",
+             "#if SETTINGS_TREE_DEPTH > SETTINGS_MAX_DEPTH",
+             '#error "Settings tree is deeper than SETTINGS_MAX_DEPTH"',
+             "#endif",
+             "#if (ENABLE_SLOT_TABLE == 1) && (SETTINGS_TREE_SLOT_COUNT > SETTINGS_SLOT_TABLE_SIZE)",
+             '#error "Settings tree does not fit SETTINGS_SLOT_TABLE_SIZE"',
+             "#endif",
+             ""]
+    # Root is placed right after ROM image header
+    root.romOffset = "ROM_HEADER_SIZE"
+    body = []
+    callbacks = {}
+    descriptors(root, body, callbacks)
+    if callbacks:
+        lines.append("// Change callbacks must be defined in top module")
+        lines += ["%s" % callbacks[name] for name in sorted(callbacks)]
+        lines += ["", ""]
+    lines += body
+    lines += ["// Descriptors are never modified, so const qualifier may be dropped",
+              "hNode_t *hRoot = (hNode_t *)&node_%s;" % root.ident,
+              "",
+              "#endif  // ENABLE_STATIC_TREE",
+              ""]
+    with open(outBase + ".c", "w", newline="\r\n") as f:
+        f.write("\n".join(lines))
+
+    leaves = []
+    values(root, Value(), leaves)
+    lines = ["/******************************************************************************",
+             "    Settings tree layout",
+             "    " + tag,
+             "******************************************************************************/",
+             "#ifndef %s" % guard,
+             "#define %s" % guard,
+             "",
+             '#include "settings_private.h"',
+             "",
+             "#define SETTINGS_TREE_RAM_SIZE          %d" % ramSize,
+             "#define SETTINGS_TREE_ROM_SIZE          %d" % romSize,
+             "#define SETTINGS_TREE_SLOT_COUNT        %d" % slotCount,
+             "#define SETTINGS_TREE_DEPTH             %d" % depth,
+             "#define SETTINGS_TREE_RAM_LAYOUT        %s" % LAYOUTS[layoutName],
+             "#define SETTINGS_TREE_RAM_PADDING       %d" % layout.padding,
+             "",
+             "// RAM addresses of values. Every list node on the path takes an element index",
+             ]
+    for value in leaves:
+        name = "SETTINGS_RAM_ADDR_" + value.name()
+        if value.indexes:
+            name += "(%s)" % ", ".join(value.indexes)
+        lines.append("#define %-40s %s" % (name, value.expr(value.ram)))
+    lines += ["",
+              "",
+              "#if ENABLE_STATIC_TREE == 1",
+              "",
+              "#ifdef __cplusplus",
+              'extern "C"',
+              "{",
+              "#endif // __cplusplus",
+              "    // RAM is private, accessors below are the only exception",
+              "    extern uint8_t ram[SETTINGS_RAM_SIZE];",
+              "#ifdef __cplusplus",
+              "}",
+              "#endif // __cplusplus",
+              "",
+              "// Read accessors. Values are read from RAM by fixed addresses, without walking the tree",
+              "// Must not be used while another thread modifies settings (see SETTINGS_CONCURRENT_READERS)",
+              "// Char values are not 0-terminated"]
+    for value in leaves:
+        node = value.node
+        args = ", ".join("uint32_t %s" % i for i in value.indexes) or "void"
+        addr = "SETTINGS_RAM_ADDR_" + value.name() + ("(%s)" % ", ".join(value.indexes) if value.indexes else "")
+        name = "settings_get_" + value.name()
+        if node.type == "char":
+            lines.append("static inline const char *%s(%s) { return (const char *)&ram[%s]; }" % (name, args, addr))
+        elif node.type == "blob":
+            lines.append("static inline const uint8_t *%s(%s) { return &ram[%s]; }" % (name, args, addr))
+        else:
+            lines.append("static inline %s %s(%s) { return SETTINGS_RAM_%s(%s); }" % (
+                NUMERIC_TYPES[node.type][2], name, args, node.type.upper(), addr))
+    lines += ["",
+              "#ifdef __cplusplus",
+              "",
+              "// Layout of values for typed accessors (see settings.hpp)",
+              "// Value<args...> is defined only for request arguments which address a value",
+              "namespace settingsTree",
+              "{",
+              "    template<uint32_t... args> struct Value;",
+              "    struct Blob;                    // Type of blob values, which are read and written by ranges"]
+    for value in leaves:
+        node = value.node
+        lines += ["",
+                  "    // %s" % value.name(),
+                  "    template<%s> struct Value<%s>" % (", ".join("uint32_t %s" % i for i in value.indexes), ", ".join(value.args)),
+                  "    {"]
+        for index, bound in zip(value.indexes, value.bounds):
+            lines.append('        static_assert(%s < %d, "List index is out of range");' % (index, bound))
+        lines += ["        typedef %s type;" % CPP_TYPES[node.type],
+                  "        static const uint32_t size = %d;" % node.size(),
+                  "        static const uint32_t ramAddr = %s;" % value.expr(value.ram),
+                  "        static const settingsHandle_t handle = %s;" % value.expr(value.slot),
+                  "        static const bool direct = %s;    // Value is read directly from RAM, node has default request handler"
+                  % ("false" if "handler" in node.schema else "true"),
+                  "    };"]
+    lines += ["}",
+              "",
+              "#endif // __cplusplus",
+              "",
+              "#endif  // ENABLE_STATIC_TREE",
+              "",
+              "#endif // %s" % guard,
+              ""]
+    with open(outBase + ".h", "w", newline="\r\n") as f:
+        f.write("\n".join(lines))
+    print("%s: %s RAM layout, RAM %d, ROM %d bytes, %d slots, depth %d" % (schemaPath, layoutName, ramSize, romSize, slotCount, depth))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Settings tree generator")
+    parser.add_argument("--layout", choices=sorted(LAYOUTS), default="compact", help="RAM layout (see SETTINGS_RAM_LAYOUT)")
+    parser.add_argument("--report", action="store_true", help="print RAM and ROM cost of both layouts")
+    parser.add_argument("schema", help="tree schema (JSON)")
+    parser.add_argument("output", help="output base name")
+    args = parser.parse_args()
+    generate(args.schema, args.output, args.layout)
+    if args.report:
+        with open(args.schema) as f:
+            report(json.load(f))
@@ -317,3 +317,25 @@ void bytesToU32MsbFirst(uint8_t *bytes, uint32_t *number, uint32_t count)
     *number = temp32u;
 }
 
+
+// Converting 64-bit word into 8 bytes
+// First byte is the most significant
+void u64toBytesMsbFirst(uint64_t *number, uint8_t *bytes)
+{
+    uint32_t i;
+    for (i=0; i<8; i++)
+        bytes[i] = (uint8_t)(*number >> (56 - 8 * i));
+}
+
+
+// Converting 8 bytes into 64-bit word
+// First byte is the most significant
+void bytesToU64MsbFirst(uint8_t *bytes, uint64_t *number)
+{
+    uint64_t temp64u = 0;
+    uint32_t i;
+    for (i=0; i<8; i++)
+        temp64u = (temp64u << 8) | bytes[i];
+    *number = temp64u;
+}
+
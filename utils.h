@@ -43,6 +43,8 @@ extern "C"
     void bytesToU32LsbFirst(uint8_t *bytes, uint32_t *number, uint32_t count);
     void u32toBytesMsbFirst(uint32_t *number, uint8_t *bytes, uint32_t count);
     void bytesToU32MsbFirst(uint8_t *bytes, uint32_t *number, uint32_t count);
+    void u64toBytesMsbFirst(uint64_t *number, uint8_t *bytes);
+    void bytesToU64MsbFirst(uint8_t *bytes, uint64_t *number);
 
     uint32_t bitcmp(uint8_t *data1, uint8_t *data2, uint32_t byte_count);
 